@@ -201,12 +201,15 @@ static boolean mainEntry( void *p,
 	CAppPtr pThis = (CAppPtr)p;
 	CtlAddItem addItemInfo = { 0 };
 	int itemID = 1;
-	UNUSED( change );
 
 	ASSERT( pThis );
 
-	// Clear the display
-	IDISPLAY_ClearScreen( GetDisplay( pThis ) );
+	// Keep the menu's screen while the sample states cover it
+	State_KeepScreen( p, TRUE );
+
+	// Clear the display, unless the framework has put the menu back
+	if ( !( change & StateChange_restored ) )
+		IDISPLAY_ClearScreen( GetDisplay( pThis ) );
 
 	IMENUCTL_SetTitle( (IMenuCtl *)
 		pThis->m_app.m_apControl[ Ctl_NavMenu ],
@@ -235,17 +238,28 @@ static boolean mainEntry( void *p,
 		pThis->m_app.m_apControl[ Ctl_NavMenu ], 
 		&addItemInfo );
 
-	ICONTROL_SetProperties( pThis->m_app.m_apControl[ Ctl_NavMenu ],
-		MP_UNDERLINE_TITLE );
-
-	// Size the menu.
-	ICONTROL_SetRect( pThis->m_app.m_apControl[ Ctl_NavMenu ], 
-		&pThis->m_rc );
+	// The menu's already on the display; just make it take keys.
+	if ( change & StateChange_restored )
+	{
+		ICONTROL_SetProperties( pThis->m_app.m_apControl[ Ctl_NavMenu ],
+			MP_UNDERLINE_TITLE );
+		ICONTROL_SetRect( pThis->m_app.m_apControl[ Ctl_NavMenu ], 
+			&pThis->m_rc );
+		// ...and highlight the item the kept screen shows.
+		if ( GetAppData( pThis )->wMainSel )
+			IMENUCTL_SetSel( (IMenuCtl *)
+				pThis->m_app.m_apControl[ Ctl_NavMenu ], 
+				GetAppData( pThis )->wMainSel );
+		ICONTROL_SetActive( pThis->m_app.m_apControl[ Ctl_NavMenu ], TRUE );
+		Control_SetShown( pThis->m_app.m_apControl[ Ctl_NavMenu ], TRUE );
+		return TRUE;
+	}
 
-	ICONTROL_SetActive( pThis->m_app.m_apControl[ Ctl_NavMenu ], TRUE );
-	ICONTROL_Redraw( pThis->m_app.m_apControl[ Ctl_NavMenu ] );
+	// Size and show the menu.
+	Control_ShowControl( pThis->m_app.m_apControl[ Ctl_NavMenu ],
+		MP_UNDERLINE_TITLE, pThis->m_rc );
 
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 
 	return TRUE;
 
@@ -266,7 +280,10 @@ static boolean mainExit( void *p,
 
 	ASSERT( pThis );
 
-	ICONTROL_Reset( pThis->m_app.m_apControl[ Ctl_NavMenu ] );
+	// Remember what's highlighted, since the menu's screen is kept
+	GetAppData( pThis )->wMainSel = IMENUCTL_GetSel( (IMenuCtl *)
+		pThis->m_app.m_apControl[ Ctl_NavMenu ] );
+	Control_HideControl( pThis->m_app.m_apControl[ Ctl_NavMenu ] );
 
 	return TRUE;
 }
@@ -351,7 +368,7 @@ static boolean displayEntry( void *p,
 	// Free the bitmap in question
 	IBITMAP_Release( pIBitmap );
 	
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 	return TRUE;   
 }
 
@@ -466,7 +483,7 @@ static boolean transformEntry( void *p,
 	}	
 		
 	// Update the display
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 	return TRUE;  
 }
 
@@ -549,7 +566,7 @@ static boolean _entry( void *p,
 	// Clear the display
 	IDISPLAY_ClearScreen( GetDisplay( pThis )  );
 
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 	return TRUE;  
 }
 
@@ -20,15 +20,43 @@
 /*
 * Prototypes
 */
+static void remindDue( CAppPtr pThis );
 
 /*
 * Implementation
 */
 
-typedef struct _NumericNode DBRecordCache;
-typedef struct _NumericNode *DBRecordCachePtr;
+/*
+* The record indexes the application keeps, by EAppIndex.
+*/
+static const struct
+{
+	AEEDBFieldName iKeyField;
+	const char *pszFile;
+} saIndexes[ Idx_LastIndex ] =
+{
+	{ Fld_Time, APP_INDEX_NAME },
+	{ Fld_DueTime, APP_DUETIME_INDEX_NAME },
+	{ Fld_DueMiles, APP_DUEMILES_INDEX_NAME }
+};
+
+/*
+* The files the application saves from the database's records, 
+* which go when the database is truncated or compacted.
+*/
+static const char * const sapszDerived[] =
+{
+	APP_INDEX_NAME,
+	APP_DUETIME_INDEX_NAME,
+	APP_DUEMILES_INDEX_NAME,
+	APP_AGGREGATE_NAME
+};
 
-#define GetRecordCache( p ) (GetAppData( pThis )->m_recordCache)
+/*
+* The note on each record add() makes.
+*/
+static const AECHAR saszSampleNote[] = 
+	{ 'S', 'a', 'm', 'p', 'l', 'e', ' ', 'e', 'n', 't', 'r', 'y', 0 };
 
 /**
 * Initialize the application-specific data.
@@ -50,7 +78,17 @@ int AS_Init( CAppPtr pThis )
 	{
 		MEMSET( pAppData, 0, sizeof( CAppData ) );
 		SetAppData(pThis, pAppData );
-		result = SUCCESS;
+		result = DBHandleMgrNew( GetShell( pThis ), APP_DATABASE_NAME,
+								 &pAppData->m_pDBMgr );
+		if ( result == SUCCESS )
+		{
+			DBHandleSetDerived( pAppData->m_pDBMgr, sapszDerived, 
+				sizeof( sapszDerived ) / sizeof( sapszDerived[ 0 ] ) );
+
+			// Finish copying back any records a compaction left
+			// aside; if it can't be done now, the next one will.
+			DBHandleRecover( pAppData->m_pDBMgr );
+		}
 	}
 
 	return result;
@@ -64,24 +102,17 @@ int AS_Init( CAppPtr pThis )
 void AS_Free( CAppPtr pThis )
 {
 	CAppDataPtr pAppData;
+	int i;
 
 	ASSERT( pThis );
 
 	pAppData = GetAppData( pThis );
 	if ( pAppData )
 	{	
-		if ( pAppData->m_recordCache )
-		{
-			DBRecordCachePtr pTemp, pNode;
-			pNode = pAppData->m_recordCache;
-			while( pNode )
-			{
-				pTemp = pNode;
-				pNode = NodeNext( pTemp );
-				FREE( pTemp );
-			}
-		}
-		if ( pAppData->m_recordCache ) FREE( pAppData->m_recordCache );
+		for ( i = 0; i < Idx_LastIndex; i++ ) 
+			DBIndexFree( pAppData->m_apIndex[ i ] );
+		if ( pAppData->m_pAggregates ) FREE( pAppData->m_pAggregates );
+		DBHandleMgrFree( pAppData->m_pDBMgr );
 		FREE( pAppData );
 		pAppData = NULL;
 	}
@@ -107,127 +138,73 @@ boolean AS_HandleNotify( CAppPtr pThis, uint16 wParam, uint32 dwParam )
 {
 	DBGPRINTF( "Notification %x %x", wParam, dwParam );
 
+	// Whatever woke us, say what's due
+	remindDue( pThis );
 	return TRUE;
 }
 
 
-/**
-* Sets a record field to the specific value from a database entry
-* @param pRecord: RAM-resident record in which to set value
-* @param iFieldName: name of field to set
-* @param iFieldType: data type of field
-* @param pData: pointer to data to set
-* @param piFieldLength: size of pointer to data allocated
-* @return: SUCCESS on success, or else BREW error code
+/* 
+* This is the first state of the application
 */
-int AS_DBFieldFromDatabase( CAppRecordPtr pRecord, 
-						   AEEDBFieldName iFieldName, 
-						   AEEDBFieldType iFieldType,
-						   byte *pData, uint16 iFieldLength )
-{
-	int result = SUCCESS;
 
-	switch (iFieldName)
+/** 
+* Gets one of the record indexes, loading it from its file or
+* building it from the database if it isn't already in memory. 
+* A freshly built index is saved.
+* @param CAppPtr pThis: this applicaton
+* @param IDatabase *pIDatabase: the open database
+* @param EAppIndex iIndex: which index
+* @return the index, or NULL if there's not enough memory
+*/
+static DBIndexPtr getIndex( CAppPtr pThis, IDatabase *pIDatabase,
+							EAppIndex iIndex )
+{
+	DBIndexPtr *ppIndex = &GetAppData( pThis )->m_apIndex[ iIndex ];
+
+	if ( !*ppIndex &&
+		 DBIndexLoad( GetShell( pThis ), saIndexes[ iIndex ].pszFile, 
+					  pIDatabase, saIndexes[ iIndex ].iKeyField, 
+					  ppIndex ) != SUCCESS &&
+		 DBIndexBuild( pIDatabase, saIndexes[ iIndex ].iKeyField, 
+					   ppIndex ) == SUCCESS )
 	{
-	case Fld_EntryType:
-		pRecord->m_type = *((uint16 *)pData);
-		break;			
-	case Fld_Time:
-		pRecord->m_nTime = *((uint32 *)pData);
-		break;
-	case Fld_Miles:
-		pRecord->m_nMiles = *((uint32 *)pData);
-		break;
-	case Fld_Other:
-		pRecord->m_nOther = *((uint32 *)pData);
-		break;
-	case Fld_Cost:
-		pRecord->m_nCost = *((uint32 *)pData);
-		break;
-	case Fld_DueTime:
-		pRecord->m_nDueTime = *((uint32 *)pData);
-		break;
-	case Fld_DueMiles:
-		pRecord->m_nMiles = *((uint32 *)pData);
-		break;
-
-		// We probably shouldn't be here.
-	default:
-		result = EBADPARM;
-		break;
+		DBIndexSave( GetShell( pThis ), saIndexes[ iIndex ].pszFile, 
+					 *ppIndex );
 	}
-	return result;
+	return *ppIndex;
 }
 
-
-/**
-* Sets a database record field to the specific value from a record 
-* @param pRecord: RAM-resident record from which to set value
-* @param iFieldName: name of field to set
-* @param piFieldType: pointer to where to store data type of field
-* @param ppData: pointer to pointer where data is to copy
-* @param piFieldLength: pointer to size of pointer to data allocated
-* @return: SUCCESS on success, or else BREW error code
+/** 
+* Gets the totals for each kind of entry, loading them from 
+* their file or computing them from the database if they aren't
+* already in memory. Freshly computed totals are saved.
+* @param CAppPtr pThis: this applicaton
+* @param IDatabase *pIDatabase: the open database
+* @return the totals, or NULL if there's not enough memory
 */
-int AS_DBFieldToDatabase( CAppRecordPtr pRecord, 
-						 AEEDBFieldName iFieldName, 
-						 AEEDBFieldType *piFieldType,
-						 byte **ppData, uint16 *piFieldLength )
+static DBAggregatesPtr getAggregates( CAppPtr pThis, IDatabase *pIDatabase )
 {
-	int result = SUCCESS;
-
-	switch (iFieldName)
+	CAppDataPtr pAppData = GetAppData( pThis );
+	DBAggregatesPtr pAgg = pAppData->m_pAggregates;
+
+	if ( pAgg ) return pAgg;
+	pAgg = (DBAggregatesPtr)MALLOC( sizeof( DBAggregates ) );
+	if ( !pAgg ) return NULL;
+	if ( DBAggregatesLoad( GetShell( pThis ), APP_AGGREGATE_NAME, 
+						   pIDatabase, pAgg ) != SUCCESS )
 	{
-		// For each field, set the field to the contents
-	case Fld_EntryType:
-		*ppData = (byte *)&(pRecord->m_type);
-		*piFieldType = AEEDB_FT_WORD;
-		*piFieldLength = sizeof( uint16 );
-		break;
-	case Fld_Time:
-		*ppData = (byte *)&(pRecord->m_nTime);
-		*piFieldType = AEEDB_FT_DWORD;
-		*piFieldLength = sizeof( uint32 );
-		break;			
-	case Fld_Miles:
-		*ppData = (byte *)&(pRecord->m_nMiles);
-		*piFieldType = AEEDB_FT_DWORD;
-		*piFieldLength = sizeof( uint32 );
-		break;			
-	case Fld_Other:
-		*ppData = (byte *)&(pRecord->m_nOther);
-		*piFieldType = AEEDB_FT_DWORD;
-		*piFieldLength = sizeof( uint32 );
-		break;			
-	case Fld_Cost:
-		*ppData = (byte *)&(pRecord->m_nCost);
-		*piFieldType = AEEDB_FT_DWORD;
-		*piFieldLength = sizeof( uint32 );
-		break;						
-	case Fld_DueTime:
-		*ppData = (byte *)&(pRecord->m_nDueTime);
-		*piFieldType = AEEDB_FT_DWORD;
-		*piFieldLength = sizeof( uint32 );
-		break;			
-	case Fld_DueMiles:
-		*ppData = (byte *)&(pRecord->m_nDueMiles);
-		*piFieldType = AEEDB_FT_DWORD;
-		*piFieldLength = sizeof( uint32 );
-		break;				
-
-		// We probably shouldn't be here.
-	default:
-		result = EBADPARM;
-		break;
+		if ( DBAggregatesBuild( pIDatabase, pAgg ) != SUCCESS )
+		{
+			FREE( pAgg );
+			return NULL;
+		}
+		DBAggregatesSave( GetShell( pThis ), APP_AGGREGATE_NAME, pAgg );
 	}
-	return result;
+	pAppData->m_pAggregates = pAgg;
+	return pAgg;
 }
 
-
-/* 
-* This is the first state of the application
-*/
-
 /** 
 * Adds some records to the database.
 * @param void *p: this applicaton
@@ -236,57 +213,66 @@ int AS_DBFieldToDatabase( CAppRecordPtr pRecord,
 static void add( void *p ) 
 {
 	CAppPtr pThis = (CAppPtr)p;
-	CAppRecord record;
-	AEEDBField *arFields;
-	IDBMgr *pIDBMgr;
+	CAppDataPtr pAppData = GetAppData( pThis );
+	CAppRecord arRecords[ ME_Undefined - ME_Gas ];
+	uint16 arIDs[ ME_Undefined - ME_Gas ];
+	DBInsertStats stats;
 	IDatabase *pIDatabase;
-	IDBRecord *pIDBRecord;
-	int i;
+	uint16 i;
+	int iIndex;
+	DBIndexPtr *ppIndex;
 	int miles = 20000;
 	uint32 time = ISHELL_GetSeconds( GetShell( pThis ) );
 
-	// Open the database
-	if ( ISHELL_CreateInstance( GetShell( pThis ), 
-		AEECLSID_DBMGR, (void **)&pIDBMgr ) != SUCCESS ) 
-		return;
-	pIDatabase = IDBMGR_OpenDatabase( pIDBMgr, 
-		APP_DATABASE_NAME, TRUE );
-	IDBMGR_Release( pIDBMgr );
+	// Get the database
+	pIDatabase = DBHandleGet( pAppData->m_pDBMgr );
 	if ( !pIDatabase ) return;
+	for ( iIndex = 0; iIndex < Idx_LastIndex; iIndex++ )
+		getIndex( pThis, pIDatabase, iIndex );
+	getAggregates( pThis, pIDatabase );
 
 #define EIGHTWEEKSASSECONDS (4838400)
-	for ( i = ME_Gas; i < ME_Undefined; i++ )
+	for ( i = 0; i < ME_Undefined - ME_Gas; i++ )
 	{
-		record.m_type = i;
-		record.m_nMiles = miles;
+		arRecords[ i ].m_type = ME_Gas + i;
+		arRecords[ i ].m_nMiles = miles;
 		miles += 500;
-		record.m_nDueMiles = miles;
-		record.m_nTime = time;
-		record.m_nDueTime = record.m_nTime + EIGHTWEEKSASSECONDS;
-		record.m_nCost = 2495;
-		record.m_nOther = 31415;
-		if ( DBFreezeRecord( &record, &arFields ) == SUCCESS )
+		arRecords[ i ].m_nDueMiles = miles;
+		arRecords[ i ].m_nTime = time;
+		arRecords[ i ].m_nDueTime = time + EIGHTWEEKSASSECONDS;
+		arRecords[ i ].m_nCost = 2495;
+		arRecords[ i ].m_nOther = 31415;
+		arRecords[ i ].m_pszNote = (AECHAR *)saszSampleNote;
+		arRecords[ i ].m_nNoteBytes = sizeof( saszSampleNote );
+		time += ( 24 * 60 * 60 );
+	}
+	DBInsertRecords( pIDatabase, arRecords, ME_Undefined - ME_Gas, 
+					 arIDs, pAppData->m_pAggregates, &stats );
+	DBGPRINTF( "Added %d records in %d ms", 
+			   stats.m_nRecords, stats.m_nMSecs );
+
+	// Keep the indexes current; if one can't be, drop it and
+	// let the next use rebuild it.
+	for ( iIndex = 0; iIndex < Idx_LastIndex; iIndex++ )
+	{
+		ppIndex = &pAppData->m_apIndex[ iIndex ];
+		for ( i = 0; i < stats.m_nRecords && *ppIndex; i++ )
 		{
-			pIDBRecord = IDATABASE_CreateRecord( pIDatabase, 
-				arFields, 
-				Fld_LastField );		
-			IDBRECORD_Release( pIDBRecord );
+			if ( DBIndexInsertRecord( ppIndex, arIDs[ i ], 
+									  &arRecords[ i ] ) != SUCCESS )
+			{
+				DBIndexFree( *ppIndex );
+				*ppIndex = NULL;
+			}
 		}
-		if ( arFields ) 
-			FREE( arFields );
-		time += ( 24 * 60 * 60 );
+		if ( *ppIndex ) 
+			DBIndexSave( GetShell( pThis ), saIndexes[ iIndex ].pszFile, 
+						 *ppIndex );
 	}
-	IDATABASE_Release( pIDatabase );
-}
-
-static int32 orderRecordsByTime( void *p, 
-								DBRecordCachePtr n1, 
-								DBRecordCachePtr n2 )
-{
-	int32 result = 0;
-	UNUSED( p );	
-	// Compare the two
-	return n2->m_nMetaData - n1->m_nMetaData;
+	if ( pAppData->m_pAggregates ) 
+		DBAggregatesSave( GetShell( pThis ), APP_AGGREGATE_NAME, 
+						  pAppData->m_pAggregates );
+	DBHandleRelease( pAppData->m_pDBMgr );
 }
 
 /** 
@@ -298,137 +284,215 @@ static int32 orderRecordsByTime( void *p,
 static void sort( void *p ) 
 {
 	CAppPtr pThis = (CAppPtr)p;
-	IDBMgr *pIDBMgr;
 	IDatabase *pIDatabase;
-	IDBRecord *pIDBRecord;
-	DBRecordCachePtr pNode, pHead;
-	AEEDBFieldType iFieldType;
-	uint16 iFieldLength;
-	uint32 *pt;
+	DBQuery query;
+	DBRecordView view;
 	CAppRecordPtr pRecord;
+	DBAggregatesPtr pAgg;
+	int i;
 
-	pHead = MALLOC( sizeof( DBRecordCache ) );
-	GetAppData(pThis)->m_recordCache = pHead;
-	if ( pHead )
+	// Get the database
+	pIDatabase = DBHandleGet( GetAppData( pThis )->m_pDBMgr );
+	if ( !pIDatabase ) return;
+
+	// Visit every record in order of time.
+	// Dump each record to the debug log so we can see it
+	DBQueryInit( &query, pIDatabase, 
+				 getIndex( pThis, pIDatabase, Idx_Time ) );
+	while ( DBQueryNext( &query, &view ) )
 	{
-		MEMSET( pHead, 0, sizeof( DBRecordCache ) );
+		pRecord = DBRecordViewGet( &view );
+		DBGPRINTF("Type : %d", pRecord->m_type );
+		DBGPRINTF("Time : %d", pRecord->m_nTime );
+		DBGPRINTF("Miles: %d", pRecord->m_nMiles );
+		DBGPRINTF("Cost : %d", pRecord->m_nCost );
+		DBGPRINTF("Other: %d", pRecord->m_nOther );
+		DBGPRINTF("Next (time) : %d", pRecord->m_nDueTime );
+		DBGPRINTF("Next (miles): %d", pRecord->m_nDueMiles );
+		DBReleaseRecordView( &view );
 	}
-	else return;
 
-	// Open the database
-	if ( ISHELL_CreateInstance( GetShell( pThis ), 
-		AEECLSID_DBMGR, (void **)&pIDBMgr ) != SUCCESS ) 
-		return;
-	GetAppData( pThis )->m_pIDatabase = pIDatabase = 
-		IDBMGR_OpenDatabase( pIDBMgr, APP_DATABASE_NAME, TRUE );
+	// And the totals for each kind of entry
+	pAgg = getAggregates( pThis, pIDatabase );
+	if ( pAgg && pAgg->m_bStale ) 
+	{
+		DBAggregatesVerify( pIDatabase, pAgg, NULL );
+		DBAggregatesSave( GetShell( pThis ), APP_AGGREGATE_NAME, pAgg );
+	}
+	for ( i = ME_Gas; pAgg && i < ME_Undefined; i++ )
+	{
+		if ( !pAgg->m_arGroups[ i ].m_nCount ) continue;
+		DBGPRINTF("Type %d: %d entries, cost %d, miles %d to %d, last %d", i,
+				  pAgg->m_arGroups[ i ].m_nCount, pAgg->m_arGroups[ i ].m_nSum,
+				  pAgg->m_arGroups[ i ].m_nMin, pAgg->m_arGroups[ i ].m_nMax,
+				  pAgg->m_arGroups[ i ].m_nLast );
+	}
 
-	IDBMGR_Release( pIDBMgr );
-	if ( !pIDatabase ) return;
+	DBHandleRelease( GetAppData( pThis )->m_pDBMgr );
+}
 
-	// Iterate across each record of the database, adding
-	// each to the linked list in turn.
-	IDATABASE_Reset( pIDatabase );
-	pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
+/** 
+* Removes all records in the database.
+* @param void *p: this applicaton
+* @return nothing
+*/
+static void del( void *p ) 
+{
+	CAppPtr pThis = (CAppPtr)p;
+	CAppDataPtr pAppData = GetAppData( pThis );
+	DBMaintStats stats;
+	int i;
 
-	while( pIDBRecord != NULL )
+	// The indexes go with the records; truncating removes their files
+	for ( i = 0; i < Idx_LastIndex; i++ )
 	{
-		pNode = (DBRecordCachePtr)MALLOC( sizeof( DBRecordCache ) );
-		if ( !pNode )
-		{
-			DBRecordCachePtr pTemp;
-			pNode = NodeNext( pHead );
-			while( pNode )
-			{
-				pTemp = pNode;
-				pNode = NodeNext( pTemp );
-				FREE( pTemp );
-			}
-			return;
-		}
-		pNode->m_nData = IDBRECORD_GetID( pIDBRecord );	
-
-		DBRecordField( pIDBRecord, Fld_Time, &iFieldType, &pt, &iFieldLength );	
-		pNode->m_nMetaData = *pt;
-		FREE( pt );
-
-		NodeLinkSorted( pThis, pHead, pNode, orderRecordsByTime, DBRecordCache );
-		IDBRECORD_Release( pIDBRecord );
-		pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
+		DBIndexFree( pAppData->m_apIndex[ i ] );
+		pAppData->m_apIndex[ i ] = NULL;
 	}
-	// Iterate across all the nodes.
-	// Dump their contents to the debug log so we can see each record
-	pNode = NodeNext( pHead );
 
-	while( pNode )
+	// Dropping the whole database is much faster than 
+	// removing its records one by one.
+	if ( DBHandleTruncate( pAppData->m_pDBMgr, &stats ) != SUCCESS ) return;
+	DBGPRINTF( "Removed %d records, %d bytes, in %d ms", 
+			   stats.m_nRecords, stats.m_nBytes, stats.m_nMSecs );
+
+	// Nothing left to total
+	if ( pAppData->m_pAggregates )
 	{
-		pRecord = NULL;
-		pIDBRecord = IDATABASE_GetRecordByID( pIDatabase, (uint16)pNode->m_nData );
-		if ( pIDBRecord ) DBThawRecord( pIDBRecord, &pRecord );
-		if ( pRecord )
-		{
-			DBGPRINTF("Type : %d", pRecord->m_type );
-			DBGPRINTF("Time : %d", pRecord->m_nTime );
-			DBGPRINTF("Miles: %d", pRecord->m_nMiles );
-			DBGPRINTF("Cost : %d", pRecord->m_nCost );
-			DBGPRINTF("Other: %d", pRecord->m_nOther );
-			DBGPRINTF("Next (time) : %d", pRecord->m_nDueTime );
-			DBGPRINTF("Next (miles): %d", pRecord->m_nDueMiles );
-		}
-		if ( pIDBRecord ) IDBRECORD_Release( pIDBRecord );
-		if ( pRecord ) FREE( pRecord );
-		pNode = NodeNext( pNode );
+		MEMSET( pAppData->m_pAggregates, 0, sizeof( DBAggregates ) );
+		DBAggregatesSave( GetShell( pThis ), APP_AGGREGATE_NAME, 
+						  pAppData->m_pAggregates );
 	}
+}
 
-	IDATABASE_Release( pIDatabase );
-	GetAppData( pThis )->m_pIDatabase  = NULL;
 
-	if ( pHead )
+/** 
+* Finds the newest entry of a kind, the one made at the time its
+* totals say was the last, in the time index.
+* @param IDatabase *pIDatabase: the open database
+* @param DBIndexPtr pTimeIndex: the records in order of time
+* @param uint16 nType: the kind of entry
+* @param uint32 nLast: when the newest entry of that kind was made
+* @param DBRecordViewPtr pView: returns the entry, to be released
+* with DBReleaseRecordView
+* @return SUCCESS, or EFAILED if there's no such entry
+*/
+static int remindNewest( IDatabase *pIDatabase, DBIndexPtr pTimeIndex,
+						 uint16 nType, uint32 nLast, 
+						 DBRecordViewPtr pView )
+{
+	IDBRecord *pIDBRecord;
+	uint16 i;
+
+	for ( i = DBIndexFind( pTimeIndex, nLast ); 
+		  i < pTimeIndex->m_nEntries && 
+		  pTimeIndex->m_arEntries[ i ].m_nKey == nLast; 
+		  i++ )
 	{
-		DBRecordCachePtr pTemp, pNode;
-		pNode = pHead;
-		while( pNode )
-		{
-			pTemp = pNode;
-			pNode = NodeNext( pTemp );
-			FREE( pTemp );
-		}
+		pIDBRecord = IDATABASE_GetRecordByID( pIDatabase, 
+							pTimeIndex->m_arEntries[ i ].m_nID );
+		if ( !pIDBRecord ) continue;
+		if ( DBThawRecordView( pIDBRecord, pView ) == SUCCESS &&
+			 DBRecordViewGet( pView )->m_type == nType )
+			return SUCCESS;
+		DBReleaseRecordView( pView );
 	}
+	return EFAILED;
 }
 
 /** 
-* Removes all records in the database.
-* @param void *p: this applicaton
+* Lists the services due soonest by date and by mileage to the
+* debug log, after any that are overdue. Each service supersedes
+* the ones of its kind before it, so only the newest entry of 
+* each kind can be overdue; the rest are listed from now on. 
+* This reads only the indexes, the totals and the records it 
+* lists, so it's cheap enough to do from a notification or an 
+* alarm.
+* @param CAppPtr pThis: this applicaton
 * @return nothing
 */
-static void del( void *p ) 
+static void remindDue( CAppPtr pThis )
 {
-	CAppPtr pThis = (CAppPtr)p;
-	IDBMgr *pIDBMgr;
+	CAppDataPtr pAppData = GetAppData( pThis );
 	IDatabase *pIDatabase;
 	IDBRecord *pIDBRecord;
+	DBIndexPtr pIndex, pTimeIndex;
+	DBAggregatesPtr pAgg;
+	DBRecordView view;
+	CAppRecordPtr pRecord;
+	uint16 arIDs[ APP_DUE_COUNT ];
+	uint32 nNow, nDue;
+	int iIndex, i, n;
 
-	// Open the database
-	if ( ISHELL_CreateInstance( GetShell( pThis ), 
-		AEECLSID_DBMGR, (void **)&pIDBMgr ) != SUCCESS ) 
-		return;
-	GetAppData( pThis )->m_pIDatabase = pIDatabase = 
-		IDBMGR_OpenDatabase( pIDBMgr, APP_DATABASE_NAME, TRUE );
-	IDBMGR_Release( pIDBMgr );
+	pIDatabase = DBHandleGet( pAppData->m_pDBMgr );
 	if ( !pIDatabase ) return;
 
+	// A removal can leave the totals' bounds out of date
+	pAgg = getAggregates( pThis, pIDatabase );
+	if ( pAgg && pAgg->m_bStale ) 
+	{
+		DBAggregatesVerify( pIDatabase, pAgg, NULL );
+		DBAggregatesSave( GetShell( pThis ), APP_AGGREGATE_NAME, pAgg );
+	}
+	pTimeIndex = getIndex( pThis, pIDatabase, Idx_Time );
 
-	IDATABASE_Reset( pIDatabase );
-	pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
-
-	while( pIDBRecord != NULL )
+	for ( iIndex = Idx_DueTime; iIndex <= Idx_DueMiles; iIndex++ )
 	{
-	    IDBRECORD_Remove(  pIDBRecord );
-		pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
+		// Overdue is before now, or the odometer's last reading
+		nNow = 0;
+		if ( iIndex == Idx_DueTime ) 
+		{
+			nNow = ISHELL_GetSeconds( GetShell( pThis ) );
+		}
+		else if ( pAgg )
+		{
+			for ( i = ME_Gas; i < ME_Undefined; i++ )
+				if ( pAgg->m_arGroups[ i ].m_nMax > nNow ) 
+					nNow = pAgg->m_arGroups[ i ].m_nMax;
+		}
+
+		// The newest entry of each kind that's come due
+		for ( i = ME_Gas; pAgg && pTimeIndex && i < ME_Undefined; i++ )
+		{
+			if ( !pAgg->m_arGroups[ i ].m_nCount ||
+				 remindNewest( pIDatabase, pTimeIndex, (uint16)i,
+							   pAgg->m_arGroups[ i ].m_nLast, 
+							   &view ) != SUCCESS ) 
+				continue;
+			pRecord = DBRecordViewGet( &view );
+			nDue = iIndex == Idx_DueTime ? 
+				pRecord->m_nDueTime : pRecord->m_nDueMiles;
+			if ( nDue < nNow )
+				DBGPRINTF( "Overdue: type %d at %d or %d miles", 
+						   pRecord->m_type,
+						   pRecord->m_nDueTime,
+						   pRecord->m_nDueMiles );
+			DBReleaseRecordView( &view );
+		}
+
+		// Then what's due soonest from now on, in the order 
+		// the index keeps them in
+		pIndex = getIndex( pThis, pIDatabase, iIndex );
+		if ( !pIndex ) continue;
+		n = DBIndexNext( pIndex, nNow, arIDs, APP_DUE_COUNT );
+		for ( i = 0; i < n; i++ )
+		{
+			pIDBRecord = IDATABASE_GetRecordByID( pIDatabase, arIDs[ i ] );
+			if ( !pIDBRecord ) continue;
+			if ( DBThawRecordView( pIDBRecord, &view ) == SUCCESS )
+			{
+				pRecord = DBRecordViewGet( &view );
+				DBGPRINTF( "Due: type %d at %d or %d miles", 
+						   pRecord->m_type,
+						   pRecord->m_nDueTime,
+						   pRecord->m_nDueMiles );
+			}
+			DBReleaseRecordView( &view );
+		}
 	}
-	IDATABASE_Release( pIDatabase );
+	DBHandleRelease( pAppData->m_pDBMgr );
 }
 
-
 /** 
 * Performs actions associated with a menu selection.
 * @param void *p: this applicaton
@@ -502,7 +566,7 @@ static boolean mainEntry( void *p,
 
 	Control_ShowControl( GetMenu( pThis ), MP_UNDERLINE_TITLE, pThis->m_rc );
 
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 
 	return TRUE;
 
@@ -523,6 +587,8 @@ static boolean mainExit( void *p,
 
 	ASSERT( pThis );
 
+	Control_HideControl( GetMenu( pThis ) );
+
 	return TRUE;
 }
 
@@ -555,8 +621,11 @@ boolean AS_MainHandleEvent( void *p,
 			result = mainEntry( p, wParam );
 			break;
 
-		case EVT_APP_STOP:
 		case EVT_APP_SUSPEND:
+			// Don't hold the database open while suspended
+			DBHandleClose( pAppData->m_pDBMgr );
+			// Fall through
+		case EVT_APP_STOP:
 			result = mainExit( p, wParam );
 			break;
 
@@ -564,6 +633,11 @@ boolean AS_MainHandleEvent( void *p,
 			result = handleMenuChoice( p, wParam );
 			break;
 
+		case EVT_ALARM:
+			remindDue( pThis );
+			result = TRUE;
+			break;
+
 		default:
 			break;
 	}
@@ -591,7 +665,7 @@ static boolean _entry( void *p,
 	// Clear the display
 	IDISPLAY_ClearScreen( GetDisplay( pThis )  );
 
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 	return TRUE;  
 }
 
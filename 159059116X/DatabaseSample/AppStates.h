@@ -39,14 +39,6 @@ int AS_Init( CAppPtr pApp );
 void AS_Free( CAppPtr pApp );
 void AS_DefaultPrefs( CAppPrefsPtr pPrefs );
 boolean AS_HandleNotify( CAppPtr pThis, uint16 wParam, uint32 dwParam );
-int AS_DBFieldFromDatabase( CAppRecordPtr pRecord, 
-				  		    AEEDBFieldName iFieldName, 
-							AEEDBFieldType iFieldType,
-							byte *pData, uint16 iFieldLength );
-int AS_DBFieldToDatabase( CAppRecordPtr pRecord, 
-			  	          AEEDBFieldName iFieldName, 
-						  AEEDBFieldType *piFieldType,
-						  byte **ppData, uint16 *piFieldLength );
 
 
 /*
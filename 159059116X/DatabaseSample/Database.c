@@ -16,168 +16,1867 @@
 
 #include "inc.h"
 
+/*
+ * Where each field of a CAppRecord is, how long it is and how 
+ * it's stored, by field name, made from APP_RECORD_FIELDS. A
+ * variable-length field's length is 0; its member is a pointer,
+ * and its length is the uint16 at its length offset.
+ */
+#define DB_FIELD_OFFSET( member ) \
+	( (uint16)(uint32)&( (CAppRecordPtr)0 )->member )
+
+static const uint16 sarFieldOffset[ Fld_LastField ] =
+{
+	0,
+#define APP_RECORD_FIELD( name, member, type, dbtype ) \
+	DB_FIELD_OFFSET( member ),
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype ) \
+	DB_FIELD_OFFSET( member ),
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
+};
+
+static const uint16 sarFieldLength[ Fld_LastField ] =
+{
+	0,
+#define APP_RECORD_FIELD( name, member, type, dbtype ) sizeof( type ),
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype ) 0,
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
+};
+
+static const uint16 sarLengthOffset[ Fld_LastField ] =
+{
+	0,
+#define APP_RECORD_FIELD( name, member, type, dbtype ) 0,
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype ) \
+	DB_FIELD_OFFSET( length ),
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
+};
+
+static const AEEDBFieldType sarFieldType[ Fld_LastField ] =
+{
+	AEEDB_FT_NONE,
+#define APP_RECORD_FIELD( name, member, type, dbtype ) dbtype,
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype ) dbtype,
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
+};
+
+/*
+ * Bytes of a record's fixed-width fields, and how many fields
+ * are variable-length.
+ */
+static const uint16 snRecordBytes =
+#define APP_RECORD_FIELD( name, member, type, dbtype ) sizeof( type ) +
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype )
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
+	0;
+
+static const uint16 snVarFields =
+#define APP_RECORD_FIELD( name, member, type, dbtype )
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype ) 1 +
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
+	0;
+
+/*
+ * A variable-length field's data pointer and length in a record.
+ */
+#define DB_VARFIELD_DATA( pr, f ) \
+	( *(byte **)( (byte *)(pr) + sarFieldOffset[ f ] ) )
+#define DB_VARFIELD_LENGTH( pr, f ) \
+	( *(uint16 *)( (byte *)(pr) + sarLengthOffset[ f ] ) )
+
+/*
+ * What DBHandleCompact adds to the database's name to name the
+ * database it copies records to.
+ */
+#define DB_COMPACT_SUFFIX ".tmp"
+
+/**
+ * Reads every field of a database record in one pass and
+ * files each by name. The directory borrows the record's 
+ * field data rather than copying it.
+ * @param pRecord: database record
+ * @param pDir: directory to fill
+ * @return SUCCESS, or EBADPARM if the record has a field
+ * named DB_MAX_FIELDS or more
+ */
+int DBFieldDirBuild( IDBRecord *pRecord, DBFieldDirPtr pDir )
+{
+	AEEDBFieldName iFieldName;
+	AEEDBFieldType iFieldType;
+	uint16 iFieldLength;
+	DBFieldEntryPtr pField;
+	byte *pData;
+
+	ASSERT( pRecord && pDir );
+	MEMSET( pDir, 0, sizeof( DBFieldDir ) );
+	pDir->m_pRecord = pRecord;
+
+	// Begin at the beginning
+	IDBRECORD_Reset( pRecord );
+	iFieldType = IDBRECORD_NextField( pRecord, 
+									  &iFieldName, &iFieldLength );
+
+	// While there are fields to examine...
+	while( iFieldType != AEEDB_FT_NONE )
+	{
+		if ( (uint32)iFieldName >= DB_MAX_FIELDS ) return EBADPARM;
+		pData = IDBRECORD_GetField( pRecord, &iFieldName, 
+									&iFieldType, &iFieldLength );
+		if ( pData )
+		{
+			pField = &pDir->m_arFields[ iFieldName ];
+			pField->m_iType = iFieldType;
+			pField->m_nLength = iFieldLength;
+			pField->m_pData = pData;
+			pDir->m_nFields++;
+		}
+		iFieldType = IDBRECORD_NextField( pRecord, 
+										  &iFieldName, &iFieldLength );
+	}
+	return SUCCESS;
+}
+
+/*
+ * Files a field array by name, as DBFieldDirBuild does for a
+ * database record.
+ * @param arFields: fields
+ * @param nFields: number of fields
+ * @param pDir: directory to fill
+ * @return nothing
+ */
+static void _dbFieldDirFromFields( AEEDBField *arFields, int nFields,
+								   DBFieldDirPtr pDir )
+{
+	DBFieldEntryPtr pField;
+	int i;
+
+	MEMSET( pDir, 0, sizeof( DBFieldDir ) );
+	for ( i = 0; i < nFields; i++ )
+	{
+		if ( (uint32)arFields[ i ].fName >= DB_MAX_FIELDS ) continue;
+		pField = &pDir->m_arFields[ arFields[ i ].fName ];
+		pField->m_iType = arFields[ i ].fType;
+		pField->m_nLength = arFields[ i ].wDataLen;
+		pField->m_pData = (byte *)arFields[ i ].pBuffer;
+		pDir->m_nFields++;
+	}
+}
+
+/*
+ * Sets each field of a RAM-resident record from a database 
+ * record's field directory.
+ * @param pDir: the database record's field directory
+ * @param pResult: RAM-resident record to fill, zeroed
+ * @param bCopy: TRUE to copy variable-length fields, or FALSE to
+ * point them at the database record's own buffers
+ * @return SUCCESS, ENOMEMORY, or EBADPARM if the record has a 
+ * field that isn't in APP_RECORD_FIELDS or is the wrong length;
+ * on failure, copied fields are left for _dbFreeVarFields
+ */
+static int _dbThaw( DBFieldDirPtr pDir, CAppRecordPtr pResult,
+					boolean bCopy )
+{
+	DBFieldEntryPtr pField;
+	AEEDBFieldName iFieldName;
+	byte *pData;
+	uint16 nFound = 0;
+
+	for ( iFieldName = 1; iFieldName < Fld_LastField; iFieldName++ )
+	{
+		pField = DBFieldDirGet( pDir, iFieldName );
+		if ( !pField ) continue;
+		nFound++;
+		if ( sarFieldLength[ iFieldName ] )
+		{
+			if ( pField->m_nLength != sarFieldLength[ iFieldName ] ) 
+				return EBADPARM;
+			MEMCPY( (byte *)pResult + sarFieldOffset[ iFieldName ], 
+					pField->m_pData, sarFieldLength[ iFieldName ] );
+			continue;
+		}
+
+		// Variable-length fields are borrowed, or copied to keep
+		if ( !pField->m_nLength ) continue;
+		pData = pField->m_pData;
+		if ( bCopy )
+		{
+			pData = (byte *)MALLOC( pField->m_nLength );
+			if ( !pData ) return ENOMEMORY;
+			MEMCPY( pData, pField->m_pData, pField->m_nLength );
+		}
+		DB_VARFIELD_DATA( pResult, iFieldName ) = pData;
+		DB_VARFIELD_LENGTH( pResult, iFieldName ) = pField->m_nLength;
+	}
+	
+	return nFound == pDir->m_nFields ? SUCCESS : EBADPARM;
+}
+
+/*
+ * Frees the variable-length fields of a record DBThawRecord made.
+ * @param pRecord: record
+ * @return nothing
+ */
+static void _dbFreeVarFields( CAppRecordPtr pRecord )
+{
+	AEEDBFieldName iFieldName;
+
+	for ( iFieldName = 1; iFieldName < Fld_LastField; iFieldName++ )
+	{
+		if ( sarFieldLength[ iFieldName ] ) continue;
+		if ( DB_VARFIELD_DATA( pRecord, iFieldName ) ) 
+			FREE( DB_VARFIELD_DATA( pRecord, iFieldName ) );
+		DB_VARFIELD_DATA( pRecord, iFieldName ) = NULL;
+	}
+}
+
 /**
  * Takes a record from the database and creates a RAM-resident 
- * copy of the record.
+ * copy of the record, including its variable-length fields.
  * @param pRecord: database record to thaw
- * @param ppResult: pointer to pointer to store result (caller must free)
- * @return SUCCESS on success with record at *ppResult
- * On failure, check *ppResult and free any fields!
+ * @param ppResult: pointer to pointer to store result (free with 
+ * DBFreeRecord)
+ * @return SUCCESS on success with record at *ppResult; on 
+ * failure, *ppResult is NULL and there's nothing to free
  */
 int DBThawRecord( IDBRecord *pRecord, 
 				  CAppRecordPtr *ppResult )
 {
-	AEEDBFieldName iFieldName;
-	AEEDBFieldType iFieldType;
-	uint16 iFieldLength;
-	uint16 iRecordID;
+	DBFieldDir dir;
 	CAppRecordPtr pResult;
-	byte *pData;
-	int result = SUCCESS;	
+	int result;
 	
 	ASSERT( pRecord && ppResult );
 
 	// Allocate our result
+	*ppResult = NULL;
 	pResult = MALLOC( sizeof( CAppRecord ) );
 	if ( !pResult ) return ENOMEMORY;
-	*ppResult = pResult;
 	MEMSET( pResult, 0, sizeof( CAppRecord ) );
 	
-	// Begin at the beginning
-	iRecordID = IDBRECORD_GetID( pRecord );
-	IDBRECORD_Reset( pRecord );
+	// Read the record once, then visit each field it has
+	result = DBFieldDirBuild( pRecord, &dir );
+	if ( result == SUCCESS ) result = _dbThaw( &dir, pResult, TRUE );
+	if ( result == SUCCESS ) 
+		*ppResult = pResult;
+	else
+		DBFreeRecord( pResult );
+	return result;
+}
 
-	// Get the first field
-	iFieldType = IDBRECORD_NextField( pRecord, 
-									  &iFieldName, &iFieldLength);
+/**
+ * Frees a record DBThawRecord made, and its variable-length fields.
+ * @param pRecord: record to free, or NULL
+ * @return nothing
+ */
+void DBFreeRecord( CAppRecordPtr pRecord )
+{
+	if ( !pRecord ) return;
+	_dbFreeVarFields( pRecord );
+	FREE( pRecord );
+}
 
-	// While there are fields to examine...
-	while( result == SUCCESS && 
-		   iFieldType != AEEDB_FT_NONE )
+/**
+ * Takes a record from the database and creates a read-only view 
+ * of it. Fixed-width fields are copied into the view; variable-
+ * length fields point into the database record, which the view
+ * takes over. Release both with DBReleaseRecordView.
+ * @param pRecord: database record to view
+ * @param pView: view to fill
+ * @return SUCCESS on success; release the view either way
+ */
+int DBThawRecordView( IDBRecord *pRecord, DBRecordViewPtr pView )
+{
+	DBFieldDir dir;
+	int result;
+
+	ASSERT( pRecord && pView );
+
+	MEMSET( &pView->m_record, 0, sizeof( CAppRecord ) );
+	pView->m_pRecord = pRecord;
+	result = DBFieldDirBuild( pRecord, &dir );
+	if ( result == SUCCESS ) 
+		result = _dbThaw( &dir, &pView->m_record, FALSE );
+	return result;
+}
+
+/**
+ * Releases a record view and the database record it was read from.
+ * @param pView: view to release
+ * @return nothing
+ */
+void DBReleaseRecordView( DBRecordViewPtr pView )
+{
+	ASSERT( pView );
+
+	if ( pView->m_pRecord ) IDBRECORD_Release( pView->m_pRecord );
+	pView->m_pRecord = NULL;
+#ifdef _DEBUG
+	// Make anything still holding the view's fields obvious
+	MEMSET( &pView->m_record, 0xDB, sizeof( CAppRecord ) );
+#endif
+}
+
+#ifdef _DEBUG
+/**
+ * Gets the record a view holds, asserting that the view
+ * hasn't been released.
+ * @param pView: view
+ * @return the record
+ */
+CAppRecordPtr DBRecordViewCheck( DBRecordViewPtr pView )
+{
+	ASSERT( pView && pView->m_pRecord );
+	return &pView->m_record;
+}
+#endif
+
+/*
+ * Sets each field of a database field array from a RAM-resident
+ * record. The fields point into the record, or for variable-
+ * length fields, at the data the record points to.
+ * @param pRecord: record to freeze
+ * @param arFields: array of Fld_LastField - 1 fields to fill
+ * @return the number of fields filled; NULL fields are left out
+ */
+static int _dbFreeze( CAppRecordPtr pRecord, AEEDBField *arFields )
+{
+	AEEDBFieldName iFieldName;
+	byte *pData;
+	uint16 nLength;
+	int nFields = 0;
+
+	for ( iFieldName = 1; iFieldName < Fld_LastField; iFieldName++ )
 	{
-		// Get the contents of this field
-		pData = IDBRECORD_GetField( pRecord, &iFieldName, 
-									&iFieldType, &iFieldLength );					
-		if (!pData) break;
-
-		// Copy variable-length fields for storage
-		if ( iFieldType == AEEDB_FT_BITMAP ||
-			 iFieldType == AEEDB_FT_BINARY ||
-			 iFieldType == AEEDB_FT_STRING )
-		{
-			byte *pTemp = (byte *)MALLOC( iFieldLength );
-			
-			if ( !pTemp ) return ENOMEMORY;
-			MEMCPY( pTemp, pData, iFieldLength );
-			pData = pTemp;
-		}
-		result = AS_DBFieldFromDatabase( pResult, 
-										 iFieldName, iFieldType,
-									     pData, iFieldLength );
-		iFieldType = IDBRECORD_NextField( pRecord, 
-										  &iFieldName, &iFieldLength);
+		pData = (byte *)pRecord + sarFieldOffset[ iFieldName ];
+		nLength = sarFieldLength[ iFieldName ];
+		if ( !nLength )
+		{
+			pData = DB_VARFIELD_DATA( pRecord, iFieldName );
+			nLength = DB_VARFIELD_LENGTH( pRecord, iFieldName );
+			if ( !pData ) continue;
+		}
+		arFields[ nFields ].fType = sarFieldType[ iFieldName ];
+		arFields[ nFields ].fName = iFieldName;
+		arFields[ nFields ].wDataLen = nLength; 
+		arFields[ nFields ].pBuffer = pData;
+		nFields++;
 	}
-	
-	return result;
+	return nFields;
 }
 
 /**
  * Takes a record from RAM and creates a serialized
- * copy of the record for storage in the database
+ * copy of the record for storage in the database. The fields
+ * point into the record, which must outlive them.
  * @param pRecord: database record to freeze
  * @param **ppResult: pointer to where to store address of field array (caller must free) 
- * @return SUCCESS on success with record at *ppResult
- * On failure, check *ppResult and free any fields!
+ * @param pnFields: where to store how many fields there are
+ * @return SUCCESS on success with record at *ppResult, or 
+ * ENOMEMORY with NULL there
  */
 int DBFreezeRecord( CAppRecordPtr pRecord, 
-				  AEEDBField **ppResult )
+				  AEEDBField **ppResult, int *pnFields )
 {
 	AEEDBField *arFields;	
-	AEEDBFieldName iFieldName;
-	AEEDBFieldType iFieldType;
-	uint16 iFieldLength;
-	byte *pData;
-	int result = SUCCESS;
 	
-	ASSERT( pRecord && ppResult );
+	ASSERT( pRecord && ppResult && pnFields );
 	
 	// Allocate our result buffer
 	arFields = (AEEDBField *)MALLOC( Fld_LastField * sizeof( AEEDBField ) );
-	if ( !arFields ) return ENOMEMORY;
 	*ppResult = arFields;
+	*pnFields = 0;
+	if ( !arFields ) return ENOMEMORY;
 
-	// For each field, get the database representation
-	for ( iFieldName = 1; iFieldName < Fld_LastField; iFieldName++ )
+	*pnFields = _dbFreeze( pRecord, arFields );
+	return SUCCESS;
+}
+
+/**
+ * Adds many records to a database at once. Each record is frozen
+ * into the same field array, so the batch needs no heap.
+ * @param pIDatabase: open database
+ * @param arRecords: records to add
+ * @param nRecords: how many records to add
+ * @param arIDs: where to store each new record's ID, or NULL
+ * @param pAgg: aggregates to count the new records in, or NULL
+ * @param pStats: where to store the batch's statistics, or NULL
+ * @return SUCCESS if every record was added; on failure, 
+ * pStats->m_nRecords tells how many were
+ */
+int DBInsertRecords( IDatabase *pIDatabase, 
+					 CAppRecordPtr arRecords, uint16 nRecords,
+					 uint16 *arIDs, DBAggregatesPtr pAgg,
+					 DBInsertStatsPtr pStats )
+{
+	AEEDBField arFields[ Fld_LastField ];
+	IDBRecord *pIDBRecord;
+	DBFieldDir dir;
+	uint32 nStart = GETUPTIMEMS();
+	uint16 i;
+	int nFields;
+	int result = SUCCESS;
+
+	ASSERT( pIDatabase && ( arRecords || !nRecords ) );
+
+	for ( i = 0; i < nRecords && result == SUCCESS; i++ )
 	{
-		result = AS_DBFieldToDatabase( pRecord, 
-									   iFieldName, 
-									   &iFieldType,
-									   &pData, 
-									   &iFieldLength );
-		if ( result != SUCCESS ) break;		
-		arFields[iFieldName-1].fType = iFieldType;
-		arFields[iFieldName-1].fName = iFieldName;
-		arFields[iFieldName-1].wDataLen = iFieldLength; 
-		arFields[iFieldName-1].pBuffer  = (void*)(pData);
+		nFields = _dbFreeze( &arRecords[ i ], arFields );
+		pIDBRecord = IDATABASE_CreateRecord( pIDatabase, 
+											 arFields, nFields );
+		if ( !pIDBRecord ) 
+		{
+			result = EFAILED;
+			break;
+		}
+		if ( arIDs ) arIDs[ i ] = IDBRECORD_GetID( pIDBRecord );
+		if ( pAgg )
+		{
+			_dbFieldDirFromFields( arFields, nFields, &dir );
+			DBAggregatesInsert( pAgg, &dir );
+		}
+		IDBRECORD_Release( pIDBRecord );
 	}
-	
-	if ( result != SUCCESS )
+
+	if ( pStats )
 	{
-		// Free the field array before exiting
-		FREE( arFields );
-		*ppResult = NULL;
+		pStats->m_nRecords = i;
+		pStats->m_nMSecs = GETUPTIMEMS() - nStart;
+		// A batch that takes under a millisecond counts as one
+		pStats->m_nRecordsPerSec = 
+			i * 1000 / ( pStats->m_nMSecs ? pStats->m_nMSecs : 1 );
 	}
 	return result;
 }
 
 /**
- * Fetches the indicated field from a database record
+ * Fetches the indicated field from a database record. To read 
+ * several fields of one record, build a DBFieldDir once instead.
  * @param pRecord: database record 
  * @param ppResult: pointer to pointer to store result (caller must free)
- * @return SUCCESS on success with record at *ppResult
- * On failure, check *ppResult and free any fields!
+ * @return SUCCESS on success with record at *ppResult; on
+ * failure, there's nothing to free
  */
 int DBRecordField( IDBRecord *pRecord, 
 				   AEEDBFieldName iFieldName,
 				   AEEDBFieldType *piFieldType,
 				   void **ppResult, uint16 *piFieldLength )
 {
-	AEEDBFieldType iFieldType;
-	AEEDBFieldName iThisFieldName;
-	byte *pData;	
+	DBFieldDir dir;
+	DBFieldEntryPtr pField;
 	
-	ASSERT( pRecord && piFieldType && piFieldType && 
+	ASSERT( pRecord && piFieldType && 
 	        ppResult && piFieldLength );
 	
-	// Begin at the beginning
-	IDBRECORD_Reset( pRecord );
+	if ( DBFieldDirBuild( pRecord, &dir ) != SUCCESS ) return EBADPARM;
+	pField = DBFieldDirGet( &dir, iFieldName );
+	if ( !pField ) return EBADPARM;
 
-	// Get the first field
-	iFieldType = IDBRECORD_NextField( pRecord, 
-									  &iThisFieldName, 
-									  piFieldLength);
+	// Copy the contents to a new buffer
+	*piFieldType = pField->m_iType;
+	*piFieldLength = pField->m_nLength;
+	*ppResult = (byte *)MALLOC( pField->m_nLength );		
+	if ( !*ppResult ) return ENOMEMORY;
+	MEMCPY( *ppResult, pField->m_pData, pField->m_nLength );
+	return SUCCESS;
+}
 
-	// While there are fields to examine...
-	while( iFieldType != AEEDB_FT_NONE )
+/*
+ * Record indexes
+ */
+
+/**
+ * @name DBINDEX_MAGIC
+ * @memo Index file signature.
+ * @doc This marks the start of a saved record index.
+ */
+#define DBINDEX_MAGIC ( 0x44424931 )
+
+/*
+ * The header at the front of a saved record index; the 
+ * entries follow it.
+ */
+typedef struct _DBIndexHeader
+{
+	uint32 m_dwMagic;
+	uint32 m_iKeyField;
+	uint32 m_nEntries;
+} DBIndexHeader;
+
+/*
+ * Orders two index entries by key, and then by record ID
+ * so that records with the same key keep a fixed order.
+ * @param pa: first entry
+ * @param pb: second entry
+ * @return TRUE if the first entry belongs before the second
+ */
+static boolean _dbIndexBefore( const DBIndexEntry *pa, const DBIndexEntry *pb )
+{
+	return pa->m_nKey < pb->m_nKey ||
+		   ( pa->m_nKey == pb->m_nKey && pa->m_nID < pb->m_nID );
+}
+
+/*
+ * Moves an entry down a heap until both of its children
+ * belong before it.
+ * @param arEntries: the heap
+ * @param i: entry to move
+ * @param n: number of entries in the heap
+ * @return nothing
+ */
+static void _dbIndexSift( DBIndexEntry *arEntries, uint32 i, uint32 n )
+{
+	DBIndexEntry entry = arEntries[ i ];
+	uint32 child;
+
+	while ( ( child = 2 * i + 1 ) < n )
+	{
+		if ( child + 1 < n && 
+			 _dbIndexBefore( &arEntries[ child ], &arEntries[ child + 1 ] ) )
+			child++;
+		if ( !_dbIndexBefore( &entry, &arEntries[ child ] ) ) break;
+		arEntries[ i ] = arEntries[ child ];
+		i = child;
+	}
+	arEntries[ i ] = entry;
+}
+
+/*
+ * Sorts index entries in place. BREW has no qsort, and a 
+ * heapsort needs no extra memory.
+ * @param arEntries: entries to sort
+ * @param n: number of entries
+ * @return nothing
+ */
+static void _dbIndexSort( DBIndexEntry *arEntries, uint32 n )
+{
+	DBIndexEntry entry;
+	uint32 i;
+
+	for ( i = n / 2; i > 0; i-- ) _dbIndexSift( arEntries, i - 1, n );
+	for ( i = n; i > 1; i-- )
+	{
+		entry = arEntries[ 0 ];
+		arEntries[ 0 ] = arEntries[ i - 1 ];
+		arEntries[ i - 1 ] = entry;
+		_dbIndexSift( arEntries, 0, i - 1 );
+	}
+}
+
+/*
+ * Allocates an empty index.
+ * @param iKeyField: field the index is keyed on
+ * @param nAlloc: how many entries to make room for
+ * @return the new index, or NULL
+ */
+static DBIndexPtr _dbIndexNew( AEEDBFieldName iKeyField, uint16 nAlloc )
+{
+	DBIndexPtr pIndex;
+
+	pIndex = (DBIndexPtr)MALLOC( sizeof( DBIndex ) + 
+								 nAlloc * sizeof( DBIndexEntry ) );
+	if ( !pIndex ) return NULL;
+	pIndex->m_iKeyField = iKeyField;
+	pIndex->m_nEntries = 0;
+	pIndex->m_nAlloc = (uint16)( nAlloc + 1 );
+	return pIndex;
+}
+
+/*
+ * Reads a numeric field, such as a record's key.
+ * @param pDir: the record's field directory
+ * @param iField: field to read
+ * @param pnKey: where to store the field's value
+ * @return SUCCESS, or a BREW error code if the record has no
+ * byte, word or double word field by that name
+ */
+static int _dbFieldValue( DBFieldDirPtr pDir, AEEDBFieldName iField,
+						  uint32 *pnKey )
+{
+	DBFieldEntryPtr pField = DBFieldDirGet( pDir, iField );
+	uint32 nLong;
+	uint16 nWord;
+
+	// Field data needn't be aligned, so copy it out
+	if ( !pField ) return EBADPARM;
+	if ( pField->m_nLength == sizeof( uint32 ) ) 
+	{
+		MEMCPY( &nLong, pField->m_pData, sizeof( uint32 ) );
+		*pnKey = nLong;
+	}
+	else if ( pField->m_nLength == sizeof( uint16 ) ) 
+	{
+		MEMCPY( &nWord, pField->m_pData, sizeof( uint16 ) );
+		*pnKey = nWord;
+	}
+	else if ( pField->m_nLength == sizeof( byte ) ) 
+		*pnKey = *( (byte *)pField->m_pData );
+	else 
+		return EBADPARM;
+	return SUCCESS;
+}
+
+/**
+ * Builds a sorted index of every record in a database with one
+ * pass over the database and an in-place sort.
+ * @param pIDatabase: database to index
+ * @param iKeyField: field to key the index on
+ * @param ppResult: where to store the index (caller must free)
+ * @return SUCCESS on success with the index at *ppResult
+ */
+int DBIndexBuild( IDatabase *pIDatabase, AEEDBFieldName iKeyField,
+				  DBIndexPtr *ppResult )
+{
+	DBIndexPtr pIndex;
+	IDBRecord *pIDBRecord;
+	DBIndexEntry *pEntry;
+	DBFieldDir dir;
+	uint32 nRecords;
+	int result = SUCCESS;
+
+	ASSERT( pIDatabase && ppResult );
+	*ppResult = NULL;
+
+	nRecords = IDATABASE_GetRecordCount( pIDatabase );
+	if ( nRecords > 0xFFFE ) return EBADPARM;
+	pIndex = _dbIndexNew( iKeyField, (uint16)nRecords );
+	if ( !pIndex ) return ENOMEMORY;
+
+	IDATABASE_Reset( pIDatabase );
+	pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
+	while ( pIDBRecord && result == SUCCESS )
 	{
-		// Is this the field we want?
-		if ( iThisFieldName == iFieldName )
+		if ( pIndex->m_nEntries == pIndex->m_nAlloc ) 
 		{
-			// Get the contents of this field
-			pData = IDBRECORD_GetField( pRecord, &iFieldName, 
-										piFieldType, piFieldLength );					
-			if (!pData) break;
-			
-			// Copy the contents to a new buffer
-			*ppResult = (byte *)MALLOC( *piFieldLength );		
-			if ( !*ppResult ) return ENOMEMORY;
-			MEMCPY( *ppResult, pData, *piFieldLength );
-			return SUCCESS;
+			result = EFAILED;
 		}
-		iFieldType = IDBRECORD_NextField( pRecord, 
-										  &iThisFieldName, 
-										  piFieldLength);
+		else
+		{
+			pEntry = &pIndex->m_arEntries[ pIndex->m_nEntries ];
+			pEntry->m_nID = IDBRECORD_GetID( pIDBRecord );
+			result = DBFieldDirBuild( pIDBRecord, &dir );
+			if ( result == SUCCESS )
+				result = _dbFieldValue( &dir, iKeyField, &pEntry->m_nKey );
+			if ( result == SUCCESS ) pIndex->m_nEntries++;
+		}
+		IDBRECORD_Release( pIDBRecord );
+		if ( result == SUCCESS ) 
+			pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
+	}
+
+	if ( result != SUCCESS )
+	{
+		FREE( pIndex );
+		return result;
+	}
+	_dbIndexSort( pIndex->m_arEntries, pIndex->m_nEntries );
+	*ppResult = pIndex;
+	return SUCCESS;
+}
+
+/**
+ * Finds where a key belongs in an index.
+ * @param pIndex: index to search
+ * @param nKey: key to find
+ * @return position of the first entry whose key is not less
+ * than nKey, or the number of entries if there is none
+ */
+uint16 DBIndexFind( DBIndexPtr pIndex, uint32 nKey )
+{
+	uint16 nLow = 0, nHigh, nMid;
+
+	ASSERT( pIndex );
+	nHigh = pIndex->m_nEntries;
+	while ( nLow < nHigh )
+	{
+		nMid = (uint16)( nLow + ( nHigh - nLow ) / 2 );
+		if ( pIndex->m_arEntries[ nMid ].m_nKey < nKey ) nLow = nMid + 1;
+		else nHigh = nMid;
+	}
+	return nLow;
+}
+
+/**
+ * Adds a record to an index, keeping it sorted.
+ * @param ppIndex: index to add to; may move if it must grow
+ * @param nID: record ID
+ * @param nKey: record key
+ * @return SUCCESS, or ENOMEMORY leaving the index unchanged
+ */
+int DBIndexInsert( DBIndexPtr *ppIndex, uint16 nID, uint32 nKey )
+{
+	DBIndexPtr pIndex;
+	DBIndexEntry entry;
+	uint16 i, nAlloc;
+
+	ASSERT( ppIndex && *ppIndex );
+	pIndex = *ppIndex;
+	if ( pIndex->m_nEntries == pIndex->m_nAlloc )
+	{
+		if ( pIndex->m_nAlloc >= 0xFFFE ) return ENOMEMORY;
+		nAlloc = pIndex->m_nAlloc + pIndex->m_nAlloc / 2 + 16;
+		if ( pIndex->m_nAlloc > 0xFFFE - pIndex->m_nAlloc / 2 - 16 ) 
+			nAlloc = 0xFFFE;
+		pIndex = (DBIndexPtr)REALLOC( pIndex, sizeof( DBIndex ) + 
+			( nAlloc - 1 ) * sizeof( DBIndexEntry ) );
+		if ( !pIndex ) return ENOMEMORY;
+		pIndex->m_nAlloc = nAlloc;
+		*ppIndex = pIndex;
+	}
+
+	// Equal keys are ordered by ID, so step past those
+	// whose IDs belong first.
+	entry.m_nKey = nKey;
+	entry.m_nID = nID;
+	i = DBIndexFind( pIndex, nKey );
+	while ( i < pIndex->m_nEntries && 
+			_dbIndexBefore( &pIndex->m_arEntries[ i ], &entry ) ) i++;
+	MEMMOVE( &pIndex->m_arEntries[ i + 1 ], &pIndex->m_arEntries[ i ],
+			 ( pIndex->m_nEntries - i ) * sizeof( DBIndexEntry ) );
+	pIndex->m_arEntries[ i ] = entry;
+	pIndex->m_nEntries++;
+	return SUCCESS;
+}
+
+/**
+ * Adds a RAM-resident record to an index, keeping it sorted.
+ * @param ppIndex: index to add to; may move if it must grow
+ * @param nID: the record's ID in the database
+ * @param pRecord: the record
+ * @return SUCCESS, or a BREW error code leaving the index unchanged
+ */
+int DBIndexInsertRecord( DBIndexPtr *ppIndex, uint16 nID, 
+						 CAppRecordPtr pRecord )
+{
+	AEEDBFieldName iKeyField;
+
+	ASSERT( ppIndex && *ppIndex && pRecord );
+	iKeyField = (*ppIndex)->m_iKeyField;
+	if ( (uint32)iKeyField >= Fld_LastField || 
+		 sarFieldLength[ iKeyField ] != sizeof( uint32 ) ) 
+		return EBADPARM;
+	return DBIndexInsert( ppIndex, nID, 
+		*( (uint32 *)( (byte *)pRecord + sarFieldOffset[ iKeyField ] ) ) );
+}
+
+/**
+ * Removes a record from an index.
+ * @param pIndex: index
+ * @param nID: the record's ID
+ * @param nKey: the record's key
+ * @return SUCCESS, or EBADPARM if the record isn't in the index
+ */
+int DBIndexRemove( DBIndexPtr pIndex, uint16 nID, uint32 nKey )
+{
+	uint16 i;
+
+	ASSERT( pIndex );
+	for ( i = DBIndexFind( pIndex, nKey ); 
+		  i < pIndex->m_nEntries && pIndex->m_arEntries[ i ].m_nKey == nKey; 
+		  i++ )
+	{
+		if ( pIndex->m_arEntries[ i ].m_nID != nID ) continue;
+		MEMMOVE( &pIndex->m_arEntries[ i ], &pIndex->m_arEntries[ i + 1 ],
+				 ( pIndex->m_nEntries - i - 1 ) * sizeof( DBIndexEntry ) );
+		pIndex->m_nEntries--;
+		return SUCCESS;
 	}
-	
 	return EBADPARM;
 }
+
+/**
+ * Gets the first records in an index whose keys are at least
+ * a given value, such as the services due soonest from now.
+ * @param pIndex: index
+ * @param nFrom: least key to return
+ * @param arIDs: where to store the records' IDs, in key order
+ * @param nMax: most records to return
+ * @return number of records returned
+ */
+uint16 DBIndexNext( DBIndexPtr pIndex, uint32 nFrom, 
+					uint16 *arIDs, uint16 nMax )
+{
+	uint16 i, n;
+
+	ASSERT( pIndex && ( arIDs || !nMax ) );
+	i = DBIndexFind( pIndex, nFrom );
+	for ( n = 0; n < nMax && i < pIndex->m_nEntries; n++, i++ )
+		arIDs[ n ] = pIndex->m_arEntries[ i ].m_nID;
+	return n;
+}
+
+/**
+ * Reads an index saved by DBIndexSave. The index is only
+ * loaded if it was keyed on the same field and holds as
+ * many records as the database does now.
+ * @param pIShell: shell
+ * @param pszFile: index file name
+ * @param pIDatabase: database the index belongs to
+ * @param iKeyField: field the index must be keyed on
+ * @param ppResult: where to store the index (caller must free)
+ * @return SUCCESS on success with the index at *ppResult, or 
+ * EFAILED if there's no usable index and it must be rebuilt
+ */
+int DBIndexLoad( IShell *pIShell, const char *pszFile, 
+				 IDatabase *pIDatabase, AEEDBFieldName iKeyField,
+				 DBIndexPtr *ppResult )
+{
+	IFileMgr *pIFileMgr = NULL;
+	IFile *pIFile = NULL;
+	DBIndexHeader header;
+	DBIndexPtr pIndex = NULL;
+	uint32 nBytes;
+	int result = EFAILED;
+
+	ASSERT( pIShell && pszFile && pIDatabase && ppResult );
+	*ppResult = NULL;
+
+	if ( ISHELL_CreateInstance( pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return EFAILED;
+	pIFile = IFILEMGR_OpenFile( pIFileMgr, pszFile, _OFM_READ );
+	IFILEMGR_Release( pIFileMgr );
+	if ( !pIFile ) return EFAILED;
+
+	if ( IFILE_Read( pIFile, &header, sizeof( header ) ) == sizeof( header ) &&
+		 header.m_dwMagic == DBINDEX_MAGIC &&
+		 header.m_iKeyField == (uint32)iKeyField &&
+		 header.m_nEntries == IDATABASE_GetRecordCount( pIDatabase ) &&
+		 header.m_nEntries <= 0xFFFE )
+	{
+		pIndex = _dbIndexNew( iKeyField, (uint16)header.m_nEntries );
+		nBytes = header.m_nEntries * sizeof( DBIndexEntry );
+		if ( pIndex && 
+			 IFILE_Read( pIFile, pIndex->m_arEntries, nBytes ) == nBytes )
+		{
+			pIndex->m_nEntries = (uint16)header.m_nEntries;
+			result = SUCCESS;
+		}
+	}
+	IFILE_Release( pIFile );
+
+	if ( result == SUCCESS ) *ppResult = pIndex;
+	else if ( pIndex ) FREE( pIndex );
+	return result;
+}
+
+/**
+ * Writes an index to a file, replacing any earlier one.
+ * @param pIShell: shell
+ * @param pszFile: index file name
+ * @param pIndex: index to save
+ * @return SUCCESS, or EFAILED leaving no index file behind
+ */
+int DBIndexSave( IShell *pIShell, const char *pszFile, DBIndexPtr pIndex )
+{
+	IFileMgr *pIFileMgr = NULL;
+	IFile *pIFile;
+	DBIndexHeader header;
+	uint32 nBytes;
+	int result = SUCCESS;
+
+	ASSERT( pIShell && pszFile && pIndex );
+	header.m_dwMagic = DBINDEX_MAGIC;
+	header.m_iKeyField = (uint32)pIndex->m_iKeyField;
+	header.m_nEntries = pIndex->m_nEntries;
+	nBytes = header.m_nEntries * sizeof( DBIndexEntry );
+
+	if ( ISHELL_CreateInstance( pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return EFAILED;
+	IFILEMGR_Remove( pIFileMgr, pszFile );
+	pIFile = IFILEMGR_OpenFile( pIFileMgr, pszFile, _OFM_CREATE );
+	if ( !pIFile ||
+		 IFILE_Write( pIFile, &header, sizeof( header ) ) != sizeof( header ) ||
+		 IFILE_Write( pIFile, pIndex->m_arEntries, nBytes ) != nBytes )
+		result = EFAILED;
+	if ( pIFile ) IFILE_Release( pIFile );
+
+	// Don't leave a partial index behind
+	if ( result != SUCCESS ) IFILEMGR_Remove( pIFileMgr, pszFile );
+	IFILEMGR_Release( pIFileMgr );
+	return result;
+}
+
+/**
+ * Releases an index.
+ * @param pIndex: index to release; may be NULL
+ * @return nothing
+ */
+void DBIndexFree( DBIndexPtr pIndex )
+{
+	if ( pIndex ) FREE( pIndex );
+}
+
+
+/*
+ * Database handles
+ */
+
+/*
+ * Closes the database.
+ * @param pMgr: handle manager
+ * @return nothing
+ */
+static void _dbHandleClose( DBHandleMgrPtr pMgr )
+{
+	if ( pMgr->m_pIDatabase ) IDATABASE_Release( pMgr->m_pIDatabase );
+	pMgr->m_pIDatabase = NULL;
+	pMgr->m_bClosing = FALSE;
+}
+
+/*
+ * Closes the database when it's been idle for DB_IDLE_MSECS.
+ * @param pMgr: handle manager
+ * @return nothing
+ */
+static void _dbHandleIdle( DBHandleMgrPtr pMgr )
+{
+	if ( pMgr->m_nRefs ) return;
+	pMgr->m_stats.m_nIdleCloses++;
+	_dbHandleClose( pMgr );
+}
+
+/*
+ * Removes the files saved from the database's records, which 
+ * a change to every record ID or record count leaves stale.
+ * @param pMgr: handle manager
+ * @return nothing
+ */
+static void _dbHandleRemoveDerived( DBHandleMgrPtr pMgr )
+{
+	IFileMgr *pIFileMgr;
+	uint16 i;
+
+	if ( !pMgr->m_nDerived ||
+		 ISHELL_CreateInstance( pMgr->m_pIShell, AEECLSID_FILEMGR, 
+								(void **)&pIFileMgr ) != SUCCESS )
+		return;
+	for ( i = 0; i < pMgr->m_nDerived; i++ )
+		IFILEMGR_Remove( pIFileMgr, pMgr->m_apszDerived[ i ] );
+	IFILEMGR_Release( pIFileMgr );
+}
+
+/**
+ * Creates a database handle manager. The database isn't opened
+ * until a state asks for it.
+ * @param pIShell: shell
+ * @param pszName: name of the database; must outlive the manager
+ * @param ppResult: where to store the manager (free with DBHandleMgrFree)
+ * @return SUCCESS or ENOMEMORY
+ */
+int DBHandleMgrNew( IShell *pIShell, const char *pszName, 
+					DBHandleMgrPtr *ppResult )
+{
+	DBHandleMgrPtr pMgr;
+
+	ASSERT( pIShell && pszName && ppResult );
+	pMgr = (DBHandleMgrPtr)MALLOC( sizeof( DBHandleMgr ) );
+	*ppResult = pMgr;
+	if ( !pMgr ) return ENOMEMORY;
+	MEMSET( pMgr, 0, sizeof( DBHandleMgr ) );
+	pMgr->m_pIShell = pIShell;
+	pMgr->m_pszName = pszName;
+	return SUCCESS;
+}
+
+/**
+ * Names the files saved from the database's records, such as
+ * those written by DBIndexSave and DBAggregatesSave. They're
+ * only checked against the number of records when they're 
+ * loaded, so DBHandleTruncate and DBHandleCompact remove them.
+ * @param pMgr: handle manager
+ * @param apszFiles: the file names; must outlive the manager
+ * @param nFiles: how many names
+ * @return nothing
+ */
+void DBHandleSetDerived( DBHandleMgrPtr pMgr, 
+						 const char * const *apszFiles, uint16 nFiles )
+{
+	ASSERT( pMgr && ( apszFiles || !nFiles ) );
+	pMgr->m_apszDerived = apszFiles;
+	pMgr->m_nDerived = nFiles;
+}
+
+/**
+ * Closes the database and frees a database handle manager.
+ * @param pMgr: handle manager; may be NULL
+ * @return nothing
+ */
+void DBHandleMgrFree( DBHandleMgrPtr pMgr )
+{
+	if ( !pMgr ) return;
+	ASSERT( !pMgr->m_nRefs );
+	ISHELL_CancelTimer( pMgr->m_pIShell, (PFNNOTIFY)_dbHandleIdle, pMgr );
+	_dbHandleClose( pMgr );
+	FREE( pMgr );
+}
+
+/**
+ * Gets a handle to the database, opening it if need be.
+ * Release the handle with DBHandleRelease, not IDATABASE_Release.
+ * @param pMgr: handle manager
+ * @return the database, or NULL if it couldn't be opened
+ */
+IDatabase *DBHandleGet( DBHandleMgrPtr pMgr )
+{
+	IDBMgr *pIDBMgr;
+
+	ASSERT( pMgr );
+	if ( pMgr->m_pIDatabase )
+	{
+		pMgr->m_stats.m_nOpensAvoided++;
+		ISHELL_CancelTimer( pMgr->m_pIShell, 
+							(PFNNOTIFY)_dbHandleIdle, pMgr );
+	}
+	else
+	{
+		if ( ISHELL_CreateInstance( pMgr->m_pIShell, 
+				AEECLSID_DBMGR, (void **)&pIDBMgr ) != SUCCESS ) 
+			return NULL;
+		pMgr->m_pIDatabase = 
+			IDBMGR_OpenDatabase( pIDBMgr, pMgr->m_pszName, TRUE );
+		IDBMGR_Release( pIDBMgr );
+		if ( !pMgr->m_pIDatabase ) return NULL;
+		pMgr->m_stats.m_nOpens++;
+	}
+	pMgr->m_nRefs++;
+	return pMgr->m_pIDatabase;
+}
+
+/**
+ * Releases a handle from DBHandleGet. When the last one is
+ * released, the database is closed after DB_IDLE_MSECS.
+ * @param pMgr: handle manager
+ * @return nothing
+ */
+void DBHandleRelease( DBHandleMgrPtr pMgr )
+{
+	ASSERT( pMgr && pMgr->m_nRefs );
+	if ( --pMgr->m_nRefs ) return;
+	if ( pMgr->m_bClosing ) 
+		_dbHandleClose( pMgr );
+	else 
+		ISHELL_SetTimer( pMgr->m_pIShell, DB_IDLE_MSECS, 
+						 (PFNNOTIFY)_dbHandleIdle, pMgr );
+}
+
+/**
+ * Closes the database now, or as soon as the last handle is
+ * released if a state still holds one. Call this on 
+ * EVT_APP_SUSPEND.
+ * @param pMgr: handle manager
+ * @return nothing
+ */
+void DBHandleClose( DBHandleMgrPtr pMgr )
+{
+	ASSERT( pMgr );
+	ISHELL_CancelTimer( pMgr->m_pIShell, (PFNNOTIFY)_dbHandleIdle, pMgr );
+	if ( pMgr->m_nRefs ) 
+		pMgr->m_bClosing = TRUE;
+	else 
+		_dbHandleClose( pMgr );
+}
+
+
+/*
+ * Fills in maintenance statistics.
+ * @param pStats: statistics to fill, or NULL
+ * @param nStart: uptime when the operation began
+ * @param nRecords: records removed or rewritten
+ * @param nBytes: bytes reclaimed
+ * @param bEstimated: TRUE if nBytes is an estimate
+ * @return nothing
+ */
+static void _dbMaintStats( DBMaintStatsPtr pStats, uint32 nStart,
+						   uint32 nRecords, uint32 nBytes,
+						   boolean bEstimated )
+{
+	if ( !pStats ) return;
+	pStats->m_nRecords = nRecords;
+	pStats->m_nBytes = nBytes;
+	pStats->m_bEstimated = bEstimated;
+	pStats->m_nMSecs = GETUPTIMEMS() - nStart;
+}
+
+/*
+ * Copies every record of one database to the end of another,
+ * field for field.
+ * @param pFrom: database to copy from
+ * @param pTo: database to copy to
+ * @param pnRecords: where to store how many records were copied
+ * @param pnSpan: where to store one more than the greatest record
+ * ID copied from
+ * @return SUCCESS, or a BREW error code
+ */
+static int _dbCopyRecords( IDatabase *pFrom, IDatabase *pTo,
+						   uint32 *pnRecords, uint32 *pnSpan )
+{
+	AEEDBField arFields[ DB_MAX_FIELDS ];
+	IDBRecord *pIDBRecord, *pNew;
+	DBFieldEntryPtr pField;
+	AEEDBFieldName iFieldName;
+	DBFieldDir dir;
+	int nFields;
+	int result = SUCCESS;
+
+	*pnRecords = *pnSpan = 0;
+	IDATABASE_Reset( pFrom );
+	pIDBRecord = IDATABASE_GetNextRecord( pFrom );
+	while( pIDBRecord != NULL && result == SUCCESS )
+	{
+		if ( IDBRECORD_GetID( pIDBRecord ) >= *pnSpan )
+			*pnSpan = IDBRECORD_GetID( pIDBRecord ) + 1;
+		result = DBFieldDirBuild( pIDBRecord, &dir );
+
+		nFields = 0;
+		for ( iFieldName = 0; iFieldName < DB_MAX_FIELDS; iFieldName++ )
+		{
+			pField = DBFieldDirGet( &dir, iFieldName );
+			if ( !pField ) continue;
+			arFields[ nFields ].fType = pField->m_iType;
+			arFields[ nFields ].fName = iFieldName;
+			arFields[ nFields ].wDataLen = pField->m_nLength;
+			arFields[ nFields ].pBuffer = pField->m_pData;
+			nFields++;
+		}
+		if ( result == SUCCESS )
+		{
+			pNew = IDATABASE_CreateRecord( pTo, arFields, nFields );
+			if ( pNew ) 
+			{
+				IDBRECORD_Release( pNew );
+				(*pnRecords)++;
+			}
+			else 
+				result = EFAILED;
+		}
+		IDBRECORD_Release( pIDBRecord );
+		if ( result == SUCCESS ) 
+			pIDBRecord = IDATABASE_GetNextRecord( pFrom );
+	}
+	return result;
+}
+
+/**
+ * Empties the database by removing it; the next DBHandleGet
+ * creates it again. This takes the same time however many 
+ * records there are, and leaves nothing to compact. No state
+ * may hold a handle, and any indexes or aggregates of the 
+ * database in memory must be discarded; the files named with
+ * DBHandleSetDerived are removed.
+ * @param pMgr: handle manager
+ * @param pStats: where to store what was removed, or NULL
+ * @return SUCCESS, EITEMBUSY if a state holds a handle, or a 
+ * BREW error code
+ */
+int DBHandleTruncate( DBHandleMgrPtr pMgr, DBMaintStatsPtr pStats )
+{
+	IDBMgr *pIDBMgr;
+	IDatabase *pIDatabase;
+	uint32 nStart = GETUPTIMEMS();
+	uint32 nRecords = 0;
+	int result;
+
+	ASSERT( pMgr );
+	if ( pMgr->m_nRefs ) return EITEMBUSY;
+
+	// Count what's going, then close the database so it can go
+	pIDatabase = DBHandleGet( pMgr );
+	if ( pIDatabase )
+	{
+		nRecords = IDATABASE_GetRecordCount( pIDatabase );
+		DBHandleRelease( pMgr );
+	}
+	DBHandleClose( pMgr );
+
+	result = ISHELL_CreateInstance( pMgr->m_pIShell, 
+				AEECLSID_DBMGR, (void **)&pIDBMgr );
+	if ( result != SUCCESS ) return result;
+	result = IDBMGR_Remove( pIDBMgr, pMgr->m_pszName );
+	IDBMGR_Release( pIDBMgr );
+	_dbHandleRemoveDerived( pMgr );
+
+	if ( result == EFILENOEXISTS ) result = SUCCESS;
+	if ( result != SUCCESS ) nRecords = 0;
+
+	// Variable-length fields go uncounted
+	_dbMaintStats( pStats, nStart, nRecords, nRecords * snRecordBytes,
+				   snVarFields != 0 );
+	return result;
+}
+
+/*
+ * Names the database DBHandleCompact copies records to.
+ * @param pMgr: handle manager
+ * @param pszTemp: where to store the name; MAX_FILE_NAME bytes
+ * @return SUCCESS, or EBADPARM if the name would be too long
+ */
+static int _dbCompactName( DBHandleMgrPtr pMgr, char *pszTemp )
+{
+	if ( STRLEN( pMgr->m_pszName ) + sizeof( DB_COMPACT_SUFFIX ) > 
+		 MAX_FILE_NAME ) 
+		return EBADPARM;
+	STRCPY( pszTemp, pMgr->m_pszName );
+	STRCAT( pszTemp, DB_COMPACT_SUFFIX );
+	return SUCCESS;
+}
+
+/*
+ * Replaces the database with a new one holding the records of
+ * another, the last step of a compaction. The records get new 
+ * IDs, so the files named with DBHandleSetDerived are removed.
+ * No state may hold a handle.
+ * @param pMgr: handle manager
+ * @param pIDBMgr: database manager
+ * @param pITemp: database to copy the records from
+ * @return SUCCESS, or a BREW error code
+ */
+static int _dbCopyBack( DBHandleMgrPtr pMgr, IDBMgr *pIDBMgr, 
+						IDatabase *pITemp )
+{
+	IDatabase *pIDatabase;
+	uint32 nCopied, nSpan;
+	int result;
+
+	DBHandleClose( pMgr );
+	_dbHandleRemoveDerived( pMgr );
+	result = IDBMGR_Remove( pIDBMgr, pMgr->m_pszName );
+	if ( result == EFILENOEXISTS ) result = SUCCESS;
+	if ( result != SUCCESS ) return result;
+
+	pIDatabase = DBHandleGet( pMgr );
+	if ( !pIDatabase ) return EFAILED;
+	result = _dbCopyRecords( pITemp, pIDatabase, &nCopied, &nSpan );
+	DBHandleRelease( pMgr );
+	return result;
+}
+
+/**
+ * Finishes a compaction that was cut short. If the database 
+ * DBHandleCompact copies records to is left over with more 
+ * records than the database, the copy back didn't finish, and 
+ * it's done again from the start; otherwise the database is 
+ * whole. Either way, the leftover is then removed. Call this on
+ * launch, before any state uses the database. No state may hold
+ * a handle.
+ * @param pMgr: handle manager
+ * @return SUCCESS if there was nothing to finish or it's done,
+ * EITEMBUSY if a state holds a handle, or a BREW error code
+ */
+int DBHandleRecover( DBHandleMgrPtr pMgr )
+{
+	char szTemp[ MAX_FILE_NAME ];
+	IDBMgr *pIDBMgr;
+	IDatabase *pIDatabase, *pITemp;
+	uint32 nRecords = 0;
+	int result;
+
+	ASSERT( pMgr );
+	if ( pMgr->m_nRefs ) return EITEMBUSY;
+	result = _dbCompactName( pMgr, szTemp );
+	if ( result != SUCCESS ) return result;
+
+	result = ISHELL_CreateInstance( pMgr->m_pIShell, 
+				AEECLSID_DBMGR, (void **)&pIDBMgr );
+	if ( result != SUCCESS ) return result;
+
+	pITemp = IDBMGR_OpenDatabase( pIDBMgr, szTemp, FALSE );
+	if ( pITemp )
+	{
+		pIDatabase = DBHandleGet( pMgr );
+		if ( pIDatabase )
+		{
+			nRecords = IDATABASE_GetRecordCount( pIDatabase );
+			DBHandleRelease( pMgr );
+		}
+		if ( nRecords < IDATABASE_GetRecordCount( pITemp ) )
+			result = _dbCopyBack( pMgr, pIDBMgr, pITemp );
+		IDATABASE_Release( pITemp );
+		if ( result == SUCCESS ) IDBMGR_Remove( pIDBMgr, szTemp );
+	}
+	IDBMGR_Release( pIDBMgr );
+	return result;
+}
+
+/**
+ * Rewrites the database's records one after another in a new
+ * database, reclaiming the space removed records left behind.
+ * The records are copied to a second database and back, so
+ * this needs room for a second copy of the records but no more 
+ * heap than one record. Records get new IDs, so any indexes of
+ * the database in memory must be discarded; the files named 
+ * with DBHandleSetDerived are removed. No state may hold a handle.
+ * If the copy out fails, the second database, whose name is the
+ * database's name followed by DB_COMPACT_SUFFIX, is removed and
+ * the database is as it was. If the copy back fails, the records
+ * are left in the second database for DBHandleRecover to copy 
+ * back; this calls it before it begins.
+ * @param pMgr: handle manager
+ * @param pStats: where to store what was rewritten, or NULL;
+ * the bytes reclaimed are estimated from the gaps in record IDs
+ * @return SUCCESS, EITEMBUSY if a state holds a handle, or a 
+ * BREW error code
+ */
+int DBHandleCompact( DBHandleMgrPtr pMgr, DBMaintStatsPtr pStats )
+{
+	char szTemp[ MAX_FILE_NAME ];
+	IDBMgr *pIDBMgr;
+	IDatabase *pIDatabase, *pITemp;
+	uint32 nStart = GETUPTIMEMS();
+	uint32 nRecords = 0, nSpan = 0;
+	int result;
+
+	ASSERT( pMgr );
+	if ( pMgr->m_nRefs ) return EITEMBUSY;
+	result = _dbCompactName( pMgr, szTemp );
+	if ( result != SUCCESS ) return result;
+
+	// Finish any compaction that was cut short first
+	result = DBHandleRecover( pMgr );
+	if ( result != SUCCESS ) return result;
+
+	result = ISHELL_CreateInstance( pMgr->m_pIShell, 
+				AEECLSID_DBMGR, (void **)&pIDBMgr );
+	if ( result != SUCCESS ) return result;
+
+	// Copy the records out...
+	pITemp = IDBMGR_OpenDatabase( pIDBMgr, szTemp, TRUE );
+	pIDatabase = DBHandleGet( pMgr );
+	if ( !pITemp || !pIDatabase ) 
+		result = EFAILED;
+	else if ( IDATABASE_GetRecordCount( pITemp ) )
+		result = EFILEEXISTS;
+	if ( result == SUCCESS ) 
+		result = _dbCopyRecords( pIDatabase, pITemp, &nRecords, &nSpan );
+
+	// Part of a copy is no use, and the database is still whole
+	if ( result != SUCCESS && result != EFILEEXISTS && pITemp )
+	{
+		IDATABASE_Release( pITemp );
+		pITemp = NULL;
+		IDBMGR_Remove( pIDBMgr, szTemp );
+	}
+	if ( pIDatabase ) DBHandleRelease( pMgr );
+	DBHandleClose( pMgr );
+
+	// ...and back into a new database, whose record IDs no saved
+	// index or aggregate matches
+	if ( result == SUCCESS ) 
+		result = _dbCopyBack( pMgr, pIDBMgr, pITemp );
+
+	if ( pITemp ) IDATABASE_Release( pITemp );
+	if ( result == SUCCESS ) IDBMGR_Remove( pIDBMgr, szTemp );
+	IDBMGR_Release( pIDBMgr );
+
+	if ( result != SUCCESS ) nRecords = nSpan = 0;
+	_dbMaintStats( pStats, nStart, nRecords, 
+				   ( nSpan - nRecords ) * snRecordBytes, TRUE );
+	return result;
+}
+
+
+/*
+ * Queries
+ */
+
+/**
+ * Begins a query that matches every record.
+ * @param pQuery: query to set up
+ * @param pIDatabase: database to query
+ * @param pIndex: index to visit the records in order of, or NULL;
+ * it mustn't change while the query runs
+ * @return nothing
+ */
+void DBQueryInit( DBQueryPtr pQuery, IDatabase *pIDatabase, 
+				  DBIndexPtr pIndex )
+{
+	ASSERT( pQuery && pIDatabase );
+	MEMSET( pQuery, 0, sizeof( DBQuery ) );
+	pQuery->m_pIDatabase = pIDatabase;
+	pQuery->m_pIndex = pIndex;
+}
+
+/**
+ * Restricts a query to records with a field in a range. 
+ * Restricting a field twice matches values in both ranges.
+ * Set every restriction before the first DBQueryNext.
+ * @param pQuery: query
+ * @param iField: a byte, word or double word field
+ * @param nLow: least value that matches
+ * @param nHigh: greatest value that matches
+ * @return SUCCESS, or EBADPARM if the field can't be queried
+ */
+int DBQueryWhere( DBQueryPtr pQuery, AEEDBFieldName iField,
+				  uint32 nLow, uint32 nHigh )
+{
+	DBRange *pRange;
+
+	ASSERT( pQuery && !pQuery->m_bStarted );
+	if ( (uint32)iField >= DB_MAX_FIELDS ) return EBADPARM;
+	pRange = &pQuery->m_arRanges[ iField ];
+	if ( pRange->m_bSet )
+	{
+		if ( nLow < pRange->m_nLow ) nLow = pRange->m_nLow;
+		if ( nHigh > pRange->m_nHigh ) nHigh = pRange->m_nHigh;
+	}
+	pRange->m_bSet = TRUE;
+	pRange->m_nLow = nLow;
+	pRange->m_nHigh = nHigh;
+	return SUCCESS;
+}
+
+/*
+ * Narrows a query that follows an index to the entries whose
+ * keys are in range.
+ * @param pQuery: query
+ * @return nothing
+ */
+static void _dbQueryStart( DBQueryPtr pQuery )
+{
+	DBIndexPtr pIndex = pQuery->m_pIndex;
+	DBRange *pRange;
+
+	pQuery->m_bStarted = TRUE;
+	IDATABASE_Reset( pQuery->m_pIDatabase );
+	if ( !pIndex ) return;
+
+	pQuery->m_iEnd = pIndex->m_nEntries;
+	pRange = &pQuery->m_arRanges[ pIndex->m_iKeyField ];
+	if ( !pRange->m_bSet ) return;
+	if ( pRange->m_nLow > pRange->m_nHigh ) 
+	{
+		pQuery->m_iEnd = 0;
+		return;
+	}
+	pQuery->m_iNext = DBIndexFind( pIndex, pRange->m_nLow );
+	if ( pRange->m_nHigh != MAX_UINT32 ) 
+		pQuery->m_iEnd = DBIndexFind( pIndex, pRange->m_nHigh + 1 );
+}
+
+/*
+ * Tests a record against a query's ranges.
+ * @param pQuery: query
+ * @param pDir: the record's field directory
+ * @return TRUE if every restricted field is in range
+ */
+static boolean _dbQueryMatch( DBQueryPtr pQuery, DBFieldDirPtr pDir )
+{
+	DBRange *pRange;
+	AEEDBFieldName iField;
+	uint32 nValue;
+
+	for ( iField = 0; iField < DB_MAX_FIELDS; iField++ )
+	{
+		pRange = &pQuery->m_arRanges[ iField ];
+		if ( !pRange->m_bSet ) continue;
+		if ( _dbFieldValue( pDir, iField, &nValue ) != SUCCESS ||
+			 nValue < pRange->m_nLow || nValue > pRange->m_nHigh )
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Gets the next record a query matches.
+ * @param pQuery: query
+ * @param pView: where to store the record; release it with
+ * DBReleaseRecordView
+ * @return TRUE with the record at pView, or FALSE when there are
+ * no more
+ */
+boolean DBQueryNext( DBQueryPtr pQuery, DBRecordViewPtr pView )
+{
+	IDBRecord *pIDBRecord;
+	DBFieldDir dir;
+
+	ASSERT( pQuery && pView );
+	if ( !pQuery->m_bStarted ) _dbQueryStart( pQuery );
+
+	for ( ;; )
+	{
+		// Get the next candidate
+		if ( pQuery->m_pIndex )
+		{
+			if ( pQuery->m_iNext >= pQuery->m_iEnd ) return FALSE;
+			pIDBRecord = IDATABASE_GetRecordByID( pQuery->m_pIDatabase, 
+				pQuery->m_pIndex->m_arEntries[ pQuery->m_iNext++ ].m_nID );
+			if ( !pIDBRecord ) continue;
+		}
+		else
+		{
+			pIDBRecord = IDATABASE_GetNextRecord( pQuery->m_pIDatabase );
+			if ( !pIDBRecord ) return FALSE;
+		}
+		pQuery->m_nExamined++;
+
+		// Test its fields, and only thaw it if it matches
+		if ( DBFieldDirBuild( pIDBRecord, &dir ) == SUCCESS &&
+			 _dbQueryMatch( pQuery, &dir ) )
+		{
+			MEMSET( &pView->m_record, 0, sizeof( CAppRecord ) );
+			pView->m_pRecord = pIDBRecord;
+			if ( _dbThaw( &dir, &pView->m_record, FALSE ) == SUCCESS )
+			{
+				pQuery->m_nMatched++;
+				return TRUE;
+			}
+		}
+		IDBRECORD_Release( pIDBRecord );
+	}
+}
+
+
+/*
+ * Aggregates
+ */
+
+/**
+ * @name DBAGG_MAGIC
+ * @memo Aggregates file signature.
+ * @doc This marks the start of saved aggregates.
+ */
+#define DBAGG_MAGIC ( 0x44424131 )
+
+/*
+ * Finds the group a record's aggregates are kept in.
+ * @param pAgg: aggregates
+ * @param pDir: the record's field directory
+ * @return the group, or NULL if the record has no valid group
+ */
+static DBAggregatePtr _dbAggGroup( DBAggregatesPtr pAgg, DBFieldDirPtr pDir )
+{
+	uint32 nGroup;
+
+	if ( _dbFieldValue( pDir, DB_AGG_GROUP_FIELD, &nGroup ) != SUCCESS ||
+		 nGroup >= DB_AGG_GROUPS )
+		return NULL;
+	return &pAgg->m_arGroups[ nGroup ];
+}
+
+/**
+ * Counts a record added to the database in its group's totals.
+ * @param pAgg: aggregates
+ * @param pDir: the record's field directory
+ * @return nothing
+ */
+void DBAggregatesInsert( DBAggregatesPtr pAgg, DBFieldDirPtr pDir )
+{
+	DBAggregatePtr pGroup;
+	uint32 nValue;
+
+	ASSERT( pAgg && pDir );
+	pAgg->m_nRecords++;
+	pGroup = _dbAggGroup( pAgg, pDir );
+	if ( !pGroup ) return;
+
+	if ( _dbFieldValue( pDir, DB_AGG_SUM_FIELD, &nValue ) == SUCCESS )
+		pGroup->m_nSum += nValue;
+	if ( _dbFieldValue( pDir, DB_AGG_RANGE_FIELD, &nValue ) == SUCCESS )
+	{
+		if ( !pGroup->m_nCount || nValue < pGroup->m_nMin ) 
+			pGroup->m_nMin = nValue;
+		if ( !pGroup->m_nCount || nValue > pGroup->m_nMax ) 
+			pGroup->m_nMax = nValue;
+	}
+	if ( _dbFieldValue( pDir, DB_AGG_LAST_FIELD, &nValue ) == SUCCESS &&
+		 nValue > pGroup->m_nLast )
+		pGroup->m_nLast = nValue;
+	pGroup->m_nCount++;
+}
+
+/**
+ * Takes a record being removed from the database out of its
+ * group's totals. If the record held its group's least, greatest
+ * or last value, the aggregates are marked stale.
+ * @param pAgg: aggregates
+ * @param pDir: the record's field directory
+ * @return nothing
+ */
+void DBAggregatesRemove( DBAggregatesPtr pAgg, DBFieldDirPtr pDir )
+{
+	DBAggregatePtr pGroup;
+	uint32 nValue;
+
+	ASSERT( pAgg && pDir );
+	if ( pAgg->m_nRecords <= 1 )
+	{
+		// An empty database leaves nothing to be out of date
+		MEMSET( pAgg, 0, sizeof( DBAggregates ) );
+		return;
+	}
+	pAgg->m_nRecords--;
+	pGroup = _dbAggGroup( pAgg, pDir );
+	if ( !pGroup || !pGroup->m_nCount ) return;
+
+	// The group's last member leaves nothing to be out of date
+	if ( --pGroup->m_nCount == 0 )
+	{
+		MEMSET( pGroup, 0, sizeof( DBAggregate ) );
+		return;
+	}
+	if ( _dbFieldValue( pDir, DB_AGG_SUM_FIELD, &nValue ) == SUCCESS )
+		pGroup->m_nSum -= nValue;
+	if ( _dbFieldValue( pDir, DB_AGG_RANGE_FIELD, &nValue ) == SUCCESS &&
+		 ( nValue == pGroup->m_nMin || nValue == pGroup->m_nMax ) )
+		pAgg->m_bStale = TRUE;
+	if ( _dbFieldValue( pDir, DB_AGG_LAST_FIELD, &nValue ) == SUCCESS &&
+		 nValue == pGroup->m_nLast )
+		pAgg->m_bStale = TRUE;
+}
+
+/**
+ * Computes aggregates by reading every record in a database.
+ * @param pIDatabase: database
+ * @param pAgg: aggregates to fill
+ * @return SUCCESS, or a BREW error code
+ */
+int DBAggregatesBuild( IDatabase *pIDatabase, DBAggregatesPtr pAgg )
+{
+	IDBRecord *pIDBRecord;
+	DBFieldDir dir;
+	int result = SUCCESS;
+
+	ASSERT( pIDatabase && pAgg );
+	MEMSET( pAgg, 0, sizeof( DBAggregates ) );
+
+	IDATABASE_Reset( pIDatabase );
+	pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
+	while ( pIDBRecord && result == SUCCESS )
+	{
+		result = DBFieldDirBuild( pIDBRecord, &dir );
+		if ( result == SUCCESS ) DBAggregatesInsert( pAgg, &dir );
+		IDBRECORD_Release( pIDBRecord );
+		if ( result == SUCCESS ) 
+			pIDBRecord = IDATABASE_GetNextRecord( pIDatabase );
+	}
+	return result;
+}
+
+/**
+ * Recomputes aggregates from the database, compares them with 
+ * those kept, and keeps the recomputed ones.
+ * @param pIDatabase: database
+ * @param pAgg: aggregates to verify
+ * @param pnWrong: where to store how many groups were wrong, or NULL
+ * @return SUCCESS if the aggregates kept were right, EFAILED if
+ * they were wrong, or a BREW error code if they couldn't be 
+ * recomputed
+ */
+int DBAggregatesVerify( IDatabase *pIDatabase, DBAggregatesPtr pAgg,
+						uint32 *pnWrong )
+{
+	DBAggregatesPtr pFresh;
+	uint32 i, nWrong = 0;
+	int result;
+
+	ASSERT( pIDatabase && pAgg );
+	pFresh = (DBAggregatesPtr)MALLOC( sizeof( DBAggregates ) );
+	if ( !pFresh ) return ENOMEMORY;
+	result = DBAggregatesBuild( pIDatabase, pFresh );
+	if ( result == SUCCESS )
+	{
+		for ( i = 0; i < DB_AGG_GROUPS; i++ )
+			if ( MEMCMP( &pFresh->m_arGroups[ i ], &pAgg->m_arGroups[ i ], 
+						 sizeof( DBAggregate ) ) ) 
+				nWrong++;
+		if ( pFresh->m_nRecords != pAgg->m_nRecords || nWrong )
+			result = EFAILED;
+		MEMCPY( pAgg, pFresh, sizeof( DBAggregates ) );
+	}
+	FREE( pFresh );
+	if ( pnWrong ) *pnWrong = nWrong;
+	return result;
+}
+
+/**
+ * Reads aggregates saved by DBAggregatesSave. They're only 
+ * loaded if they count as many records as the database holds.
+ * @param pIShell: shell
+ * @param pszFile: aggregates file name
+ * @param pIDatabase: database the aggregates belong to
+ * @param pAgg: where to store the aggregates
+ * @return SUCCESS, or EFAILED if they must be rebuilt
+ */
+int DBAggregatesLoad( IShell *pIShell, const char *pszFile, 
+					  IDatabase *pIDatabase, DBAggregatesPtr pAgg )
+{
+	IFileMgr *pIFileMgr = NULL;
+	IFile *pIFile;
+	uint32 dwMagic;
+	int result = EFAILED;
+
+	ASSERT( pIShell && pszFile && pIDatabase && pAgg );
+	if ( ISHELL_CreateInstance( pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return EFAILED;
+	pIFile = IFILEMGR_OpenFile( pIFileMgr, pszFile, _OFM_READ );
+	IFILEMGR_Release( pIFileMgr );
+	if ( !pIFile ) return EFAILED;
+
+	if ( IFILE_Read( pIFile, &dwMagic, sizeof( dwMagic ) ) == sizeof( dwMagic ) &&
+		 dwMagic == DBAGG_MAGIC &&
+		 IFILE_Read( pIFile, pAgg, sizeof( DBAggregates ) ) == 
+			sizeof( DBAggregates ) &&
+		 pAgg->m_nRecords == IDATABASE_GetRecordCount( pIDatabase ) )
+		result = SUCCESS;
+	IFILE_Release( pIFile );
+
+	if ( result != SUCCESS ) MEMSET( pAgg, 0, sizeof( DBAggregates ) );
+	return result;
+}
+
+/**
+ * Writes aggregates to a file, replacing any earlier ones.
+ * @param pIShell: shell
+ * @param pszFile: aggregates file name
+ * @param pAgg: aggregates to save
+ * @return SUCCESS, or EFAILED leaving no file behind
+ */
+int DBAggregatesSave( IShell *pIShell, const char *pszFile, 
+					  DBAggregatesPtr pAgg )
+{
+	IFileMgr *pIFileMgr = NULL;
+	IFile *pIFile;
+	uint32 dwMagic = DBAGG_MAGIC;
+	int result = SUCCESS;
+
+	ASSERT( pIShell && pszFile && pAgg );
+	if ( ISHELL_CreateInstance( pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return EFAILED;
+	IFILEMGR_Remove( pIFileMgr, pszFile );
+	pIFile = IFILEMGR_OpenFile( pIFileMgr, pszFile, _OFM_CREATE );
+	if ( !pIFile ||
+		 IFILE_Write( pIFile, &dwMagic, sizeof( dwMagic ) ) != sizeof( dwMagic ) ||
+		 IFILE_Write( pIFile, pAgg, sizeof( DBAggregates ) ) != 
+			sizeof( DBAggregates ) )
+		result = EFAILED;
+	if ( pIFile ) IFILE_Release( pIFile );
+
+	// Don't leave partial aggregates behind
+	if ( result != SUCCESS ) IFILEMGR_Remove( pIFileMgr, pszFile );
+	IFILEMGR_Release( pIFileMgr );
+	return result;
+}
+
+/**
+ * Removes a record from the database, taking it out of the
+ * aggregates first. Like IDBRECORD_Remove, this releases the record.
+ * @param pRecord: record to remove
+ * @param pAgg: aggregates to take the record out of, or NULL
+ * @return SUCCESS, or a BREW error code
+ */
+int DBRemoveRecord( IDBRecord *pRecord, DBAggregatesPtr pAgg )
+{
+	DBFieldDir dir;
+
+	ASSERT( pRecord );
+	if ( pAgg && DBFieldDirBuild( pRecord, &dir ) == SUCCESS )
+		DBAggregatesRemove( pAgg, &dir );
+	return IDBRECORD_Remove( pRecord );
+}
+
+/*
+ * Drops the entries for removed records from an index, keeping
+ * the rest in order.
+ * @param pIndex: index
+ * @param pbmRemoved: one bit for each record ID, set if removed
+ * @return nothing
+ */
+static void _dbIndexSweep( DBIndexPtr pIndex, const byte *pbmRemoved )
+{
+	DBIndexEntry *pFrom, *pTo, *pEnd;
+
+	pTo = pIndex->m_arEntries;
+	pEnd = pIndex->m_arEntries + pIndex->m_nEntries;
+	for ( pFrom = pIndex->m_arEntries; pFrom < pEnd; pFrom++ )
+	{
+		if ( !( pbmRemoved[ pFrom->m_nID >> 3 ] & 
+				( 1 << ( pFrom->m_nID & 7 ) ) ) )
+			*pTo++ = *pFrom;
+	}
+	pIndex->m_nEntries = (uint16)( pTo - pIndex->m_arEntries );
+}
+
+/**
+ * Removes every record a query matches in one pass, taking each
+ * out of the aggregates as it goes. The indexes are swept once 
+ * when the query is done, rather than once for each record; an
+ * index that can't be swept is freed and set to NULL.
+ * @param pQuery: query, not yet started
+ * @param pAgg: aggregates to take the records out of, or NULL
+ * @param apIndex: indexes to take the records out of
+ * @param nIndexes: number of indexes
+ * @param pStats: where to store what was removed, or NULL
+ * @return SUCCESS, or a BREW error code
+ */
+int DBQueryDelete( DBQueryPtr pQuery, DBAggregatesPtr pAgg, 
+				   DBIndexPtr *apIndex, int nIndexes, 
+				   DBMaintStatsPtr pStats )
+{
+	DBRecordView view;
+	byte *pbmRemoved = NULL;
+	uint32 nStart = GETUPTIMEMS();
+	uint32 nRecords = 0, nBytes = 0, nRecordBytes;
+	AEEDBFieldName iFieldName;
+	uint16 nID;
+	int i, result = SUCCESS;
+
+	ASSERT( pQuery && ( apIndex || !nIndexes ) );
+
+	// One bit for each record ID there can be
+	if ( nIndexes ) 
+	{
+		pbmRemoved = (byte *)MALLOC( 0x10000 / 8 );
+		if ( pbmRemoved ) MEMSET( pbmRemoved, 0, 0x10000 / 8 );
+	}
+
+	while ( result == SUCCESS && DBQueryNext( pQuery, &view ) )
+	{
+		nRecordBytes = snRecordBytes;
+		for ( iFieldName = 1; iFieldName < Fld_LastField; iFieldName++ )
+			if ( !sarFieldLength[ iFieldName ] ) 
+				nRecordBytes += 
+					DB_VARFIELD_LENGTH( &view.m_record, iFieldName );
+
+		// Removing the record releases it
+		nID = IDBRECORD_GetID( view.m_pRecord );
+		result = DBRemoveRecord( view.m_pRecord, pAgg );
+		view.m_pRecord = NULL;
+		DBReleaseRecordView( &view );
+		if ( result != SUCCESS ) break;
+		if ( pbmRemoved ) pbmRemoved[ nID >> 3 ] |= 1 << ( nID & 7 );
+		nRecords++;
+		nBytes += nRecordBytes;
+	}
+
+	for ( i = 0; i < nIndexes && nRecords; i++ )
+	{
+		if ( !apIndex[ i ] ) continue;
+		if ( pbmRemoved ) 
+		{
+			_dbIndexSweep( apIndex[ i ], pbmRemoved );
+		}
+		else
+		{
+			DBIndexFree( apIndex[ i ] );
+			apIndex[ i ] = NULL;
+		}
+	}
+	if ( pbmRemoved ) FREE( pbmRemoved );
+
+	_dbMaintStats( pStats, nStart, nRecords, nBytes, FALSE );
+	return result;
+}
@@ -14,8 +14,350 @@
  *  for use with BREW databases
  */
 
+/**
+ * @name DBHandleStats
+ * @memo Database handle manager statistics.
+ */
+typedef struct _DBHandleStats
+{
+	/// Times the database was opened
+	uint32 m_nOpens;
+	/// Handles given out without opening the database
+	uint32 m_nOpensAvoided;
+	/// Times the database was closed because no one used it
+	uint32 m_nIdleCloses;
+} DBHandleStats, *DBHandleStatsPtr;
+
+/**
+ * @name DBHandleMgr
+ * @memo Database handle manager.
+ * @doc The handle manager opens a database the first time a
+ * state asks for it with DBHandleGet, and shares the one handle
+ * among every state that asks afterwards. Each DBHandleGet must
+ * be paired with a DBHandleRelease. When the last handle is 
+ * released the database stays open for DB_IDLE_MSECS in case 
+ * it's wanted again; DBHandleClose closes it at once, as on 
+ * EVT_APP_SUSPEND.
+ */
+typedef struct _DBHandleMgr
+{
+	/// The shell
+	IShell *m_pIShell;
+	/// Name of the database
+	const char *m_pszName;
+	/// The open database, or NULL
+	IDatabase *m_pIDatabase;
+	/// Handles given out and not yet released
+	uint16 m_nRefs;
+	/// TRUE to close the database when the last handle is released
+	boolean m_bClosing;
+	/// Files saved from the database's records, such as indexes
+	const char * const *m_apszDerived;
+	uint16 m_nDerived;
+	/// How the manager has been used
+	DBHandleStats m_stats;
+} DBHandleMgr, *DBHandleMgrPtr;
+
+/**
+ * @name DBMaintStats
+ * @memo Database maintenance statistics.
+ * @doc DBHandleTruncate, DBHandleCompact and DBQueryDelete 
+ * report what they did here. Bytes are record field data, as
+ * APP_RECORD_FIELDS lays it out. Compaction can't tell how many
+ * records were removed before it, so it estimates the bytes from 
+ * the gaps in record IDs; truncation doesn't read the records, so
+ * it counts only their fixed-width fields. Either sets m_bEstimated.
+ */
+typedef struct _DBMaintStats
+{
+	/// Records removed, or for compaction, records rewritten
+	uint32 m_nRecords;
+	/// Bytes of record data reclaimed
+	uint32 m_nBytes;
+	/// TRUE if m_nBytes is an estimate
+	boolean m_bEstimated;
+	/// Milliseconds the operation took
+	uint32 m_nMSecs;
+} DBMaintStats, *DBMaintStatsPtr;
+
+/**
+ * @name DBHandleGetStats
+ * @memo Gets a handle manager's statistics.
+ * @param pm: handle manager (DBHandleMgrPtr)
+ * @return statistics (DBHandleStatsPtr)
+ */
+#define DBHandleGetStats( pm ) ( &(pm)->m_stats )
+
+int DBHandleMgrNew( IShell *pIShell, const char *pszName, 
+					DBHandleMgrPtr *ppResult );
+void DBHandleMgrFree( DBHandleMgrPtr pMgr );
+IDatabase *DBHandleGet( DBHandleMgrPtr pMgr );
+void DBHandleRelease( DBHandleMgrPtr pMgr );
+void DBHandleClose( DBHandleMgrPtr pMgr );
+void DBHandleSetDerived( DBHandleMgrPtr pMgr, 
+						 const char * const *apszFiles, uint16 nFiles );
+int DBHandleTruncate( DBHandleMgrPtr pMgr, DBMaintStatsPtr pStats );
+int DBHandleCompact( DBHandleMgrPtr pMgr, DBMaintStatsPtr pStats );
+int DBHandleRecover( DBHandleMgrPtr pMgr );
+
+/**
+ * @name DBIndexEntry
+ * @memo One entry in a sorted record index.
+ * @doc An index entry pairs a record's key with its record ID.
+ */
+typedef struct _DBIndexEntry
+{
+	/// The record's key
+	uint32 m_nKey;
+	/// The record's ID
+	uint16 m_nID;
+} DBIndexEntry, *DBIndexEntryPtr;
+
+/**
+ * @name DBIndex
+ * @memo A sorted record index.
+ * @doc A record index holds the ID and key of every record in a
+ * database in one block, sorted by key and then by ID, so records
+ * can be visited in order or found by binary search without 
+ * reading the database. Build it with DBIndexBuild or DBIndexLoad,
+ * keep it current with DBIndexInsert, and release it with DBIndexFree.
+ */
+typedef struct _DBIndex
+{
+	/// The field the index is keyed on
+	AEEDBFieldName m_iKeyField;
+	/// How many entries are in use
+	uint16 m_nEntries;
+	/// How many entries there's room for
+	uint16 m_nAlloc;
+	/// The entries, in order
+	DBIndexEntry m_arEntries[ 1 ];
+} DBIndex, *DBIndexPtr;
+
+int DBIndexBuild( IDatabase *pIDatabase, AEEDBFieldName iKeyField,
+				  DBIndexPtr *ppResult );
+int DBIndexInsert( DBIndexPtr *ppIndex, uint16 nID, uint32 nKey );
+int DBIndexInsertRecord( DBIndexPtr *ppIndex, uint16 nID, 
+						 CAppRecordPtr pRecord );
+int DBIndexRemove( DBIndexPtr pIndex, uint16 nID, uint32 nKey );
+uint16 DBIndexNext( DBIndexPtr pIndex, uint32 nFrom, 
+					uint16 *arIDs, uint16 nMax );
+uint16 DBIndexFind( DBIndexPtr pIndex, uint32 nKey );
+int DBIndexLoad( IShell *pIShell, const char *pszFile, 
+				 IDatabase *pIDatabase, AEEDBFieldName iKeyField,
+				 DBIndexPtr *ppResult );
+int DBIndexSave( IShell *pIShell, const char *pszFile, DBIndexPtr pIndex );
+void DBIndexFree( DBIndexPtr pIndex );
+
+/**
+ * @name DBFieldEntry
+ * @memo One field of a record's field directory.
+ * @doc The field's data belongs to the database record, and is
+ * only good until the record is updated or released.
+ */
+typedef struct _DBFieldEntry
+{
+	/// The field's type, or AEEDB_FT_NONE if the record hasn't the field
+	AEEDBFieldType m_iType;
+	/// The field's length
+	uint16 m_nLength;
+	/// The field's data
+	byte *m_pData;
+} DBFieldEntry, *DBFieldEntryPtr;
+
+/**
+ * @name DBFieldDir
+ * @memo A record's field directory.
+ * @doc DBFieldDirBuild reads every field of a database record in
+ * one pass and files each by its name, so that looking fields up
+ * afterwards with DBFieldDirGet doesn't touch the record. A 
+ * directory is small enough to keep on the stack.
+ */
+typedef struct _DBFieldDir
+{
+	/// The record the directory describes
+	IDBRecord *m_pRecord;
+	/// How many fields the record has
+	uint16 m_nFields;
+	/// The fields, by name
+	DBFieldEntry m_arFields[ DB_MAX_FIELDS ];
+} DBFieldDir, *DBFieldDirPtr;
+
+/**
+ * @name DBFieldDirGet
+ * @memo Looks up a field in a field directory.
+ * @param pd: field directory (DBFieldDirPtr)
+ * @param f: name of the field (AEEDBFieldName)
+ * @return the field's entry (DBFieldEntryPtr), or NULL if the record hasn't the field
+ */
+#define DBFieldDirGet( pd, f ) \
+	( (uint32)(f) < DB_MAX_FIELDS && \
+	  (pd)->m_arFields[ f ].m_iType != AEEDB_FT_NONE ? \
+	  &(pd)->m_arFields[ f ] : NULL )
+
+int DBFieldDirBuild( IDBRecord *pRecord, DBFieldDirPtr pDir );
+
+/**
+ * @name DBRecordView
+ * @memo A read-only view of a database record.
+ * @doc A view holds a record's fields, filled in place without
+ * allocating, and the database record they were read from. The
+ * fixed-width fields are copied into the view; variable-length 
+ * fields, such as strings, point into the database record, so 
+ * they're only good until the view is released. Create one with 
+ * DBThawRecordView, read it with DBRecordViewGet, and release it 
+ * and the database record together with DBReleaseRecordView.
+ * Debug builds assert if a view is read after it's released.
+ */
+typedef struct _DBRecordView
+{
+	/// The record's fields
+	CAppRecord m_record;
+	/// The database record the fields were read from
+	IDBRecord *m_pRecord;
+} DBRecordView, *DBRecordViewPtr;
+
+/**
+ * @name DBRecordViewGet
+ * @memo Gets the record a view holds.
+ * @param pv: record view (DBRecordViewPtr)
+ * @return the record (CAppRecordPtr)
+ */
+#ifdef _DEBUG
+#define DBRecordViewGet( pv ) DBRecordViewCheck( pv )
+CAppRecordPtr DBRecordViewCheck( DBRecordViewPtr pView );
+#else
+#define DBRecordViewGet( pv ) ( &(pv)->m_record )
+#endif
+
+int DBThawRecordView( IDBRecord *pRecord, DBRecordViewPtr pView );
+void DBReleaseRecordView( DBRecordViewPtr pView );
+
+/**
+ * @name DBRange
+ * @memo A range of values for one field of a query.
+ */
+typedef struct _DBRange
+{
+	/// TRUE if the query restricts this field
+	boolean m_bSet;
+	/// The least value that matches
+	uint32 m_nLow;
+	/// The greatest value that matches
+	uint32 m_nHigh;
+} DBRange;
+
+/**
+ * @name DBQuery
+ * @memo A query over a database's records.
+ * @doc A query picks out the records whose numeric fields fall
+ * within ranges set with DBQueryWhere. DBQueryNext tests each 
+ * candidate record's fields before thawing it, and returns
+ * matching records one at a time as record views. If the query
+ * is given a record index, it visits records in index order,
+ * and a range on the index's key is found by binary search 
+ * rather than by reading records.
+ */
+typedef struct _DBQuery
+{
+	/// The database
+	IDatabase *m_pIDatabase;
+	/// The index to follow, or NULL to read the records in database order
+	DBIndexPtr m_pIndex;
+	/// The range each field must fall within
+	DBRange m_arRanges[ DB_MAX_FIELDS ];
+	/// Next index entry to visit, and the one after the last
+	uint16 m_iNext, m_iEnd;
+	/// TRUE once the query has begun
+	boolean m_bStarted;
+	/// Records read
+	uint32 m_nExamined;
+	/// Records returned
+	uint32 m_nMatched;
+} DBQuery, *DBQueryPtr;
+
+void DBQueryInit( DBQueryPtr pQuery, IDatabase *pIDatabase, 
+				  DBIndexPtr pIndex );
+int DBQueryWhere( DBQueryPtr pQuery, AEEDBFieldName iField,
+				  uint32 nLow, uint32 nHigh );
+boolean DBQueryNext( DBQueryPtr pQuery, DBRecordViewPtr pView );
+
+/**
+ * @name DBAggregate
+ * @memo Totals for one group of records.
+ */
+typedef struct _DBAggregate
+{
+	/// Records in the group
+	uint32 m_nCount;
+	/// Sum of DB_AGG_SUM_FIELD
+	uint32 m_nSum;
+	/// Least DB_AGG_RANGE_FIELD
+	uint32 m_nMin;
+	/// Greatest DB_AGG_RANGE_FIELD
+	uint32 m_nMax;
+	/// Greatest DB_AGG_LAST_FIELD
+	uint32 m_nLast;
+} DBAggregate, *DBAggregatePtr;
+
+/**
+ * @name DBAggregates
+ * @memo Totals kept for each group of records in a database.
+ * @doc Aggregates are grouped on DB_AGG_GROUP_FIELD, and kept 
+ * current as DBInsertRecords and DBRemoveRecord change the 
+ * database, so reading them needn't read any records. Removing
+ * a record can leave a group's least, greatest or last value 
+ * out of date; m_bStale is set when it does, and 
+ * DBAggregatesVerify brings them up to date.
+ */
+typedef struct _DBAggregates
+{
+	/// Records the aggregates count
+	uint32 m_nRecords;
+	/// TRUE if a removal has left a bound out of date
+	boolean m_bStale;
+	/// Totals for each group
+	DBAggregate m_arGroups[ DB_AGG_GROUPS ];
+} DBAggregates, *DBAggregatesPtr;
+
+void DBAggregatesInsert( DBAggregatesPtr pAgg, DBFieldDirPtr pDir );
+void DBAggregatesRemove( DBAggregatesPtr pAgg, DBFieldDirPtr pDir );
+int DBAggregatesBuild( IDatabase *pIDatabase, DBAggregatesPtr pAgg );
+int DBAggregatesVerify( IDatabase *pIDatabase, DBAggregatesPtr pAgg,
+						uint32 *pnWrong );
+int DBAggregatesLoad( IShell *pIShell, const char *pszFile, 
+					  IDatabase *pIDatabase, DBAggregatesPtr pAgg );
+int DBAggregatesSave( IShell *pIShell, const char *pszFile, 
+					  DBAggregatesPtr pAgg );
+int DBRemoveRecord( IDBRecord *pRecord, DBAggregatesPtr pAgg );
+int DBQueryDelete( DBQueryPtr pQuery, DBAggregatesPtr pAgg, 
+				   DBIndexPtr *apIndex, int nIndexes, 
+				   DBMaintStatsPtr pStats );
+
+/**
+ * @name DBInsertStats
+ * @memo Batch insert statistics.
+ * @doc DBInsertRecords reports how a batch went here.
+ */
+typedef struct _DBInsertStats
+{
+	/// Records added
+	uint32 m_nRecords;
+	/// Milliseconds the batch took
+	uint32 m_nMSecs;
+	/// Records added per second
+	uint32 m_nRecordsPerSec;
+} DBInsertStats, *DBInsertStatsPtr;
+
+int DBInsertRecords( IDatabase *pIDatabase, 
+					 CAppRecordPtr arRecords, uint16 nRecords,
+					 uint16 *arIDs, DBAggregatesPtr pAgg,
+					 DBInsertStatsPtr pStats );
+
 int DBThawRecord( IDBRecord *pRecord, CAppRecordPtr *ppResult );
-int DBFreezeRecord( CAppRecordPtr pRecord, AEEDBField **ppResult );
+void DBFreeRecord( CAppRecordPtr pRecord );
+int DBFreezeRecord( CAppRecordPtr pRecord, AEEDBField **ppResult,
+					int *pnFields );
 int DBRecordField( IDBRecord *pRecord, 
 				   AEEDBFieldName iFieldName,
 				   AEEDBFieldType *piFieldType,
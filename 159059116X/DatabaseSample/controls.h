@@ -17,14 +17,15 @@
 /**
  * @name Control_ShowControl
  * @memo Activates a control.
- * @doc Sets the specified control's options and bounds and shows the control.
+ * @doc Sets the specified control's options and bounds and shows the control. Once a control has been shown this way, the framework passes it events only until it's hidden with Control_HideControl; a control that's never been shown this way gets events whenever it's active.
  */
 
 #define Control_ShowControl( c, o, r ) \
-	ICONTROL_SetProperties( (IControl *)c, o ); \
-	ICONTROL_SetRect( (IControl *)c, &r ); \
-	ICONTROL_SetActive( (IControl *)c, TRUE ); \
-	ICONTROL_Redraw( (IControl *)c );
+	ICONTROL_SetProperties( c, o ); \
+	ICONTROL_SetRect( c, &r ); \
+	ICONTROL_SetActive( c, TRUE ); \
+	ICONTROL_Redraw( c ); \
+	Control_SetShown( (IControl *)c, TRUE );
 
 /**
  * @name Control_HideControl
@@ -32,7 +33,8 @@
  * @doc Hides a control by deactivating and resetting the control. You must still refresh the screen region occupied by the control.
  */
 #define Control_HideControl( control ) \
-	ICONTROL_Reset( (IControl *)control ); 
+	ICONTROL_Reset( control ); \
+	Control_SetShown( (IControl *)control, FALSE );
 
 
 /**
@@ -41,13 +43,14 @@
  * @doc Clears the display, resets the menu control, and resets its bounding rect
  */
 #define Control_InitializeMenu( pThis )\
-  IDISPLAY_ClearScreen( GetDisplay( pThis ) ); \
+  IDISPLAY_ClearScreen( ((CAppPtr)pThis)->m_app.a.m_pIDisplay ); \
   IMENUCTL_Reset( GetMenu(pThis) ); \
   IMENUCTL_SetRect( GetMenu(pThis), &pThis->m_rc ) 
 
 /*
  * Prototypes
  */
+void Control_SetShown( IControl *pIControl, boolean bShown );
 void Control_TextSetDefaultSoftKeyInfo( ITextCtl *pITextCtl, 
 										IMenuCtl *pIMenuCtl, 
 										uint16 okIcon, 
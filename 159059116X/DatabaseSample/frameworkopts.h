@@ -34,6 +34,64 @@
  */
 #define MAX_NUM_CONTROLS ( 10 )
 
+/**
+ * @name STATE_POOL_DEPTH
+ * @memo number of preallocated state nodes.
+ * @doc This tells the framework how many state nodes to preallocate at launch. Deeper state stacks still work, but take their nodes from the heap; check the pool statistics to see if this is large enough.
+ */
+#define STATE_POOL_DEPTH ( 8 )
+
+/**
+ * @name STATE_ARENA_SIZE
+ * @memo size of the state scratch arena.
+ * @doc This tells the framework how many bytes of scratch memory to share among all of the states on the stack. States obtain scratch memory with State_Alloc; it's released when the state is popped.
+ */
+#define STATE_ARENA_SIZE ( 2048 )
+
+/**
+ * @name STATE_ARENA_BUDGET
+ * @memo scratch memory available to one state.
+ * @doc This tells the framework the most scratch memory any one state may obtain from the arena.
+ */
+#define STATE_ARENA_BUDGET ( 512 )
+
+/**
+ * @name STATE_TRACE
+ * @memo state transition tracing.
+ * @doc Define this to have the framework record each call it makes to a state's event handler during a transition, and write the record to the debug log on exit. Tracing costs nothing when this isn't defined.
+ */
+#ifdef _DEBUG
+#define STATE_TRACE
+#endif
+
+/**
+ * @name STATE_TRACE_DEPTH
+ * @memo number of state transition trace entries.
+ * @doc This tells the framework how many of the most recent handler calls to keep when tracing state transitions.
+ */
+#define STATE_TRACE_DEPTH ( 32 )
+
+/**
+ * @name STATE_SCREEN_BUDGET
+ * @memo heap bytes for kept screens.
+ * @doc This tells the framework how much heap it may use to keep copies of covered states' screens. A 128x160 16-bit display takes 40960 bytes per screen; when the budget is full the shallowest states' screens are discarded first.
+ */
+#define STATE_SCREEN_BUDGET ( 81920 )
+
+/**
+ * @name STATE_FRAME_MSECS
+ * @memo delay before a requested frame.
+ * @doc This tells the framework how long to wait after State_RequestFrame before sending EVT_STATE_FRAME. Requests that arrive in the meantime are merged into the one frame, and key repeats are delivered but drawn by it; zero sends it on the next pass through the shell's event loop.
+ */
+#define STATE_FRAME_MSECS ( 0 )
+
+/**
+ * @name STATE_SNAPSHOT_FILE
+ * @memo state stack snapshot file.
+ * @doc The framework writes the state stack and each state's scratch data to this file on EVT_APP_SUSPEND. If the shell stops the application while it's suspended, the next launch restores the stack from it instead of showing the copyright screen.
+ */
+#define STATE_SNAPSHOT_FILE "stack.snp"
+
 /**
  * @name AS_FIRSTSTATE
  * @memo Application first state.
@@ -41,6 +99,13 @@
  */
 #define AS_FIRSTSTATE ( AS_MainHandleEvent ) 
 
+/**
+ * @name AS_STATES
+ * @memo Application state registry.
+ * @doc This lists every state function the application pushes. The state stack snapshot names states by their position in this list, so add new states to the end.
+ */
+#define AS_STATES { AS_MainHandleEvent }
+
 /**
  * @name APP_PREFS_VERSION 
  * @memo Application preferences structure version.
@@ -56,6 +121,66 @@
  */
 #define APP_DATABASE_NAME "mileage"
 
+/**
+ * @name APP_INDEX_NAME
+ * @memo Application database index name.
+ * @doc This is the name of the file holding the application database's record index, so that the index needn't be rebuilt on every launch.
+ */
+#define APP_INDEX_NAME APP_DATABASE_NAME ".idx"
+
+/**
+ * @name APP_DUETIME_INDEX_NAME, APP_DUEMILES_INDEX_NAME
+ * @memo Application database due index names.
+ * @doc These are the names of the files holding the indexes of records by when and at what mileage each service is next due.
+ */
+#define APP_DUETIME_INDEX_NAME APP_DATABASE_NAME ".idt"
+#define APP_DUEMILES_INDEX_NAME APP_DATABASE_NAME ".idm"
+
+/**
+ * @name APP_DUE_COUNT
+ * @memo Number of services to remind about.
+ * @doc This is how many of the services due soonest, by date and by mileage, the application lists when reminded.
+ */
+#define APP_DUE_COUNT ( 3 )
+
+/**
+ * @name DB_MAX_FIELDS
+ * @memo Number of database field names.
+ * @doc This tells the database functions how many field names a record's field directory must hold. Every field name the application uses must be less than this.
+ */
+#define DB_MAX_FIELDS ( 9 )
+
+/**
+ * @name DB_IDLE_MSECS
+ * @memo Idle time before the database is closed.
+ * @doc This tells the database handle manager how long to keep the application database open after the last state releases it, so that a state that needs it again soon doesn't have to reopen it.
+ */
+#define DB_IDLE_MSECS ( 5000 )
+
+/**
+ * @name APP_AGGREGATE_NAME
+ * @memo Application database aggregates name.
+ * @doc This is the name of the file holding the totals kept for each kind of entry in the application database.
+ */
+#define APP_AGGREGATE_NAME APP_DATABASE_NAME ".agg"
+
+/**
+ * @name DB_AGG_GROUP_FIELD, DB_AGG_GROUPS
+ * @memo How database aggregates are grouped.
+ * @doc The database keeps a set of totals for each value of DB_AGG_GROUP_FIELD, which must be less than DB_AGG_GROUPS.
+ */
+#define DB_AGG_GROUP_FIELD ( Fld_EntryType )
+#define DB_AGG_GROUPS ( ME_Undefined )
+
+/**
+ * @name DB_AGG_SUM_FIELD, DB_AGG_RANGE_FIELD, DB_AGG_LAST_FIELD
+ * @memo What database aggregates total.
+ * @doc For each group the database sums DB_AGG_SUM_FIELD, tracks the least and greatest DB_AGG_RANGE_FIELD, and tracks the greatest DB_AGG_LAST_FIELD.
+ */
+#define DB_AGG_SUM_FIELD ( Fld_Cost )
+#define DB_AGG_RANGE_FIELD ( Fld_Miles )
+#define DB_AGG_LAST_FIELD ( Fld_Time )
+
 
 /**
  * @name CAppPrefs
@@ -70,6 +195,23 @@ typedef struct
   uint32 m_nFuel;
 } CAppPrefs, *CAppPrefsPtr;
 
+/**
+ * @name EAppIndex
+ * @memo Application database indexes.
+ * @doc This enumerates the record indexes the application keeps.
+ */
+typedef enum
+{
+	/// Records by time, for listing
+	Idx_Time = 0,
+	/// Records by when they're next due
+	Idx_DueTime,
+	/// Records by the mileage they're next due at
+	Idx_DueMiles,
+	/// The last item. Don't change or remove this.
+	Idx_LastIndex
+} EAppIndex;
+
 /**
  * @name CAppData
  * @memo Application data structure.
@@ -77,32 +219,65 @@ typedef struct
  */
 typedef struct 
 {
-    IDatabase *m_pIDatabase;
-    void *m_recordCache;
+    /// The application database's handles
+    struct _DBHandleMgr *m_pDBMgr;
+    /// Record indexes, by EAppIndex
+    struct _DBIndex *m_apIndex[ Idx_LastIndex ];
+    /// Totals for each kind of entry
+    struct _DBAggregates *m_pAggregates;
 } CAppData, *CAppDataPtr;
 
 
+/**
+ * @name APP_RECORD_FIELDS
+ * @memo Application database record fields.
+ * @doc This lists the fields of an application database record,
+ * one APP_RECORD_FIELD( name, member, type, dbtype ) per fixed-width
+ * field: the field's name in the database, its member in CAppRecord,
+ * the member's C type, and the AEEDB_FT_ type it's stored as. A 
+ * variable-length field, such as a string, is listed with
+ * APP_RECORD_VARFIELD( name, member, type, length, dbtype ) instead;
+ * its member points to the field's data, of C type type, and the 
+ * uint16 member length holds how many bytes it has. A NULL field
+ * isn't stored. The field name enumeration, the record structure 
+ * and the tables the database functions use to freeze and thaw 
+ * records are all made from this list, so a field is added or 
+ * changed here and nowhere else. New fields go at the end, so that
+ * records already stored keep their field names.
+ */
+#define APP_RECORD_FIELDS \
+	/* Mileage event type, an EMileageEntryType */ \
+	APP_RECORD_FIELD( Fld_EntryType, m_type, uint16, AEEDB_FT_WORD ) \
+	/* When the event occurred, in seconds */ \
+	APP_RECORD_FIELD( Fld_Time, m_nTime, uint32, AEEDB_FT_DWORD ) \
+	/* What the odometer read when the event occurred */ \
+	APP_RECORD_FIELD( Fld_Miles, m_nMiles, uint32, AEEDB_FT_DWORD ) \
+	/* Argument of the event (gallons purchased, &c) */ \
+	APP_RECORD_FIELD( Fld_Other, m_nOther, uint32, AEEDB_FT_DWORD ) \
+	/* What the event cost, in cents */ \
+	APP_RECORD_FIELD( Fld_Cost, m_nCost, uint32, AEEDB_FT_DWORD ) \
+	/* When this item will be due again, in seconds */ \
+	APP_RECORD_FIELD( Fld_DueTime, m_nDueTime, uint32, AEEDB_FT_DWORD ) \
+	/* When this item will be due again, in miles */ \
+	APP_RECORD_FIELD( Fld_DueMiles, m_nDueMiles, uint32, AEEDB_FT_DWORD ) \
+	/* A note about the event, with its terminator, or NULL */ \
+	APP_RECORD_VARFIELD( Fld_Note, m_pszNote, AECHAR, m_nNoteBytes, \
+						 AEEDB_FT_STRING )
+
 /**
  * @name EAppRecordFieldName
  * @memo Application database field names.
- * @doc This enumerates the records in the application database
+ * @doc This enumerates the fields in APP_RECORD_FIELDS.
  */
 typedef enum 
 {
-	/// Mileage event type
-	Fld_EntryType = 1,
-	/// Time
-	Fld_Time,
-	/// Odometer
-	Fld_Miles,
-	/// Other agument for event
-	Fld_Other,
-	/// Cost of event
-	Fld_Cost,
-	/// Time at which to do this service again
-	Fld_DueTime,
-	/// Mileage at which to do this service again
-	Fld_DueMiles,
+	/// Field names begin at one
+	Fld_None = 0,
+#define APP_RECORD_FIELD( name, member, type, dbtype ) name,
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype ) name,
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
 	/// The last item. Don't change or remove this.
 	Fld_LastField
 } EAppRecordFieldName;
@@ -126,22 +301,14 @@ typedef enum _EMileageEntryType
 /**
  * @name CAppRecord
  * @memo Application database record structure.
- * @doc This structure contains the RAM-resident format for a single database record.
+ * @doc This structure contains the RAM-resident format for a single database record, one member for each field in APP_RECORD_FIELDS, and a length for each variable-length one.
  */
 typedef struct 
 {
-  /// Mileage event
-  EMileageEntryType m_type; 
-  /// When the event occurred
-  uint32 m_nTime;  // time in seconds
-  /// What the odometer read when the event occurred
-  uint32 m_nMiles; 
-  /// argument of the event (gallons purchased, &c)
-  uint32 m_nOther; 
-  /// What the event cost
-  uint32  m_nCost; // in cents
-  /// When this item will be due again (time)
-  uint32 m_nDueTime; // time in seconds
-  /// When this item will be due again (miles)
-  uint32 m_nDueMiles;
+#define APP_RECORD_FIELD( name, member, type, dbtype ) type member;
+#define APP_RECORD_VARFIELD( name, member, type, length, dbtype ) \
+	type *member; uint16 length;
+	APP_RECORD_FIELDS
+#undef APP_RECORD_FIELD
+#undef APP_RECORD_VARFIELD
 } CAppRecord, *CAppRecordPtr;
@@ -275,7 +275,7 @@ static boolean _entry( void *p,
   // Clear the display
   IDISPLAY_ClearScreen( GetDisplay( pThis )  );
 
-  IDISPLAY_Update( GetDisplay( pThis ) );
+  State_Invalidate( pThis, NULL );
   return TRUE;  
 }
 
@@ -192,8 +192,9 @@ static void mainDraw( CAppPtr pThis )
 	AEEEllipse ellipse;
 	byte r, g, b, shape;
 	boolean fill;
-	uint16 *arRandom = pData->arRandom;
+	uint16 *arRandom = (uint16 *)State_GetScratch( pThis );
 	
+	if ( !arRandom ) return;
 	i = 0;
 
 	// Clear our canvas
@@ -269,6 +270,7 @@ static boolean mainEntry( void *p,
 {
 	CAppPtr pThis = (CAppPtr)p;
 	CAppDataPtr pData;
+	uint16 *arRandom;
 
 	UNUSED( change );
 
@@ -276,15 +278,21 @@ static boolean mainEntry( void *p,
 
 	pData = GetAppData( pThis );
 
-	// Clear the display
-	IDISPLAY_ClearScreen( GetDisplay( pThis ) );
-
 	// Decide what to draw.
 	// We're going to get a shape, colors, and three coordinates 
-	// for each shape
+	// for each shape, kept in this state's scratch memory until
+	// it's popped.
+	arRandom = (uint16 *)State_GetScratch( pThis );
+	if ( !arRandom )
+		arRandom = (uint16 *)State_Alloc( pThis, 
+			NUMSHAPES * POINTSPERSHAPE * sizeof( uint16 ) );
+	if ( !arRandom ) return FALSE;
+
+	// Clear the display
+	IDISPLAY_ClearScreen( GetDisplay( pThis ) );
 
 	// Get a buffer filled with random numbers
-	GETRAND( (byte *)pData->arRandom, 
+	GETRAND( (byte *)arRandom, 
 		NUMSHAPES * 5 * sizeof( uint16 ) );
 	
 	IGRAPHICS_Pan( pData->pIGraphics, 
@@ -436,7 +444,7 @@ static boolean _entry( void *p,
 	// Clear the display
 	IDISPLAY_ClearScreen( GetDisplay( pThis )  );
 
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 	return TRUE;  
 }
 
@@ -34,6 +34,64 @@
  */
 #define MAX_NUM_CONTROLS ( 10 )
 
+/**
+ * @name STATE_POOL_DEPTH
+ * @memo number of preallocated state nodes.
+ * @doc This tells the framework how many state nodes to preallocate at launch. Deeper state stacks still work, but take their nodes from the heap; check the pool statistics to see if this is large enough.
+ */
+#define STATE_POOL_DEPTH ( 8 )
+
+/**
+ * @name STATE_ARENA_SIZE
+ * @memo size of the state scratch arena.
+ * @doc This tells the framework how many bytes of scratch memory to share among all of the states on the stack. States obtain scratch memory with State_Alloc; it's released when the state is popped.
+ */
+#define STATE_ARENA_SIZE ( 2048 )
+
+/**
+ * @name STATE_ARENA_BUDGET
+ * @memo scratch memory available to one state.
+ * @doc This tells the framework the most scratch memory any one state may obtain from the arena.
+ */
+#define STATE_ARENA_BUDGET ( 512 )
+
+/**
+ * @name STATE_TRACE
+ * @memo state transition tracing.
+ * @doc Define this to have the framework record each call it makes to a state's event handler during a transition, and write the record to the debug log on exit. Tracing costs nothing when this isn't defined.
+ */
+#ifdef _DEBUG
+#define STATE_TRACE
+#endif
+
+/**
+ * @name STATE_TRACE_DEPTH
+ * @memo number of state transition trace entries.
+ * @doc This tells the framework how many of the most recent handler calls to keep when tracing state transitions.
+ */
+#define STATE_TRACE_DEPTH ( 32 )
+
+/**
+ * @name STATE_SCREEN_BUDGET
+ * @memo heap bytes for kept screens.
+ * @doc This tells the framework how much heap it may use to keep copies of covered states' screens. A 128x160 16-bit display takes 40960 bytes per screen; when the budget is full the shallowest states' screens are discarded first.
+ */
+#define STATE_SCREEN_BUDGET ( 81920 )
+
+/**
+ * @name STATE_FRAME_MSECS
+ * @memo delay before a requested frame.
+ * @doc This tells the framework how long to wait after State_RequestFrame before sending EVT_STATE_FRAME. Requests that arrive in the meantime are merged into the one frame, and key repeats are delivered but drawn by it; zero sends it on the next pass through the shell's event loop.
+ */
+#define STATE_FRAME_MSECS ( 0 )
+
+/**
+ * @name STATE_SNAPSHOT_FILE
+ * @memo state stack snapshot file.
+ * @doc The framework writes the state stack and each state's scratch data to this file on EVT_APP_SUSPEND. If the shell stops the application while it's suspended, the next launch restores the stack from it instead of showing the copyright screen.
+ */
+#define STATE_SNAPSHOT_FILE "stack.snp"
+
 /**
  * @name AS_FIRSTSTATE
  * @memo Application first state.
@@ -41,6 +99,13 @@
  */
 #define AS_FIRSTSTATE ( AS_MainHandleEvent ) 
 
+/**
+ * @name AS_STATES
+ * @memo Application state registry.
+ * @doc This lists every state function the application pushes. The state stack snapshot names states by their position in this list, so add new states to the end.
+ */
+#define AS_STATES { AS_MainHandleEvent }
+
 /**
  * @name APP_PREFS_VERSION 
  * @memo Application preferences structure version.
@@ -72,7 +137,6 @@ typedef struct
 	IGraphics	*pIGraphics;
 	uint16	cxCanvas, cyCanvas;
 	uint16 x, y;
-	uint16 arRandom[ NUMSHAPES * POINTSPERSHAPE ];
 } CAppData, *CAppDataPtr;
 
 /**
@@ -0,0 +1,1704 @@
+/*
+ *  @name AEEHost.c
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides the implementation of the host-side shell
+ *  emulator declared in AEEHost.h. It plays the part of the
+ *  handset: it owns the applet, the display, the framework
+ *  controls, the timer list and the posted-event queue, and it
+ *  counts the work the framework asks of it.
+ *
+ *  Time is virtual. GETTIMEMS() and ISHELL_SetTimer() only
+ *  advance when the driver calls Host_AdvanceTime(), so a run is
+ *  reproducible regardless of how fast the host machine is.
+ */
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "AEEHost.h"
+#include "AEESprite.h"
+
+/*
+ * The framework's class constructor, from Main.c.
+ */
+extern int AEEClsCreateInstance( AEECLSID clsID,
+								 IShell *pIShell,
+								 IModule *pIModule,
+								 void **ppObj );
+
+/**
+ * @name HOST_MAX_TIMERS
+ * @memo Timer slots.
+ * @doc How many ISHELL_SetTimer callbacks may be outstanding at once.
+ */
+#define HOST_MAX_TIMERS ( 32 )
+
+/**
+ * @name HOST_MAX_EVENTS
+ * @memo Posted event queue length.
+ * @doc How many ISHELL_PostEvent events may be waiting for Host_Pump.
+ */
+#define HOST_MAX_EVENTS ( 64 )
+
+/**
+ * @name HOST_MAX_MENUITEMS
+ * @memo Menu capacity.
+ * @doc How many items an emulated menu or soft key control can hold.
+ */
+#define HOST_MAX_MENUITEMS ( 32 )
+
+/**
+ * @name HOST_MAX_TEXT
+ * @memo Text capacity.
+ * @doc How many characters an emulated text control can hold.
+ */
+#define HOST_MAX_TEXT ( 128 )
+
+/**
+ * @name HOST_MAX_DATABASES
+ * @memo Database capacity.
+ * @doc How many databases the emulated handset can hold. Databases live in host memory until Host_Shutdown, so they survive relaunching the applet.
+ */
+#define HOST_MAX_DATABASES ( 4 )
+
+/**
+ * @name HOST_MAX_RESOURCES
+ * @memo Resource capacity.
+ * @doc How many resources Host_SetResource can register.
+ */
+#define HOST_MAX_RESOURCES ( 8 )
+
+/**
+ * @name HOST_KEY_MAGENTA
+ * @memo Default transparency color.
+ * @doc New bitmaps treat magenta as transparent, as the handset's do, until IBITMAP_SetTransparencyColor says otherwise.
+ */
+#define HOST_KEY_MAGENTA ( 0xF81F )
+
+/*
+ * Allocations carry their size in front of the block so that
+ * FREE can keep the in-use byte count honest.
+ */
+typedef struct _HostBlock
+{
+	uint32 nSize;
+	uint32 nPad[ 3 ];
+} HostBlock;
+
+struct IShell
+{
+	int unused;
+};
+
+struct IModule
+{
+	int unused;
+};
+
+struct IImage
+{
+	int unused;
+};
+
+struct IBitmap
+{
+	/// Width and height in pixels
+	int cx, cy;
+	/// The pixels, row by row
+	uint16 *pBits;
+	/// Pixels AEE_RO_TRANSPARENT doesn't copy
+	uint16 wKey;
+	/// TRUE for the display's device bitmap
+	boolean bDevice;
+	uint32 nRefs;
+	/// Handed out by IBITMAP_QueryInterface
+	IDIB dib;
+};
+
+struct IHeap
+{
+	int unused;
+};
+
+struct IFileMgr
+{
+	int unused;
+};
+
+struct IFile
+{
+	FILE *fp;
+};
+
+/*
+ * A database record: its fields, with their data in the same
+ * block after the field array.
+ */
+typedef struct _HostDBRecord
+{
+	uint16 wID;
+	int nFields;
+	AEEDBField arFields[ 1 ];
+} HostDBRecord;
+
+/*
+ * A database. A record's ID is its slot; removed records leave
+ * an empty slot, so IDs are never reused.
+ */
+typedef struct _HostDatabase
+{
+	char szName[ MAX_FILE_NAME ];
+	HostDBRecord **arRecords;
+	uint32 nSlots, nAlloc, nRecords;
+} HostDatabase;
+
+struct IDBMgr
+{
+	int unused;
+};
+
+struct IDatabase
+{
+	HostDatabase *pDb;
+	/// Next slot IDATABASE_GetNextRecord will look at
+	uint32 iNext;
+};
+
+struct IDBRecord
+{
+	HostDatabase *pDb;
+	HostDBRecord *pRec;
+	/// The current field, or -1 before the first
+	int iField;
+};
+
+struct IDisplay
+{
+	/// Width and height in pixels
+	int cx, cy;
+	/// The back buffer that drawing operations touch
+	uint16 *pFrame;
+	/// The emulated panel that IDISPLAY_Update copies to
+	uint16 *pPanel;
+};
+
+typedef struct _HostMenuItem
+{
+	uint16 wItemID;
+	uint32 dwData;
+} HostMenuItem;
+
+struct IControl
+{
+	AEECLSID cls;
+	boolean bActive;
+	AEERect rc;
+	uint32 dwProps;
+	/// Menu and soft key items
+	HostMenuItem arItems[ HOST_MAX_MENUITEMS ];
+	int nItems;
+	int nSel;
+	/// Text and static contents; NULL when empty
+	AECHAR *pText;
+	AECHAR szText[ HOST_MAX_TEXT + 1 ];
+	/// A text control's soft key menu
+	IControl *pSoftKey;
+};
+
+typedef struct _HostTimer
+{
+	PFNNOTIFY pfn;
+	void *pUser;
+	uint32 nDue;
+} HostTimer;
+
+typedef struct _HostEvent
+{
+	AEEEvent eCode;
+	uint16 wParam;
+	uint32 dwParam;
+} HostEvent;
+
+typedef struct _HostResource
+{
+	uint16 nID;
+	/// The host file holding the resource's data
+	char szFile[ 256 ];
+} HostResource;
+
+typedef struct _HostPrefs
+{
+	AEECLSID cls;
+	uint16 wVer;
+	uint16 nSize;
+	void *pData;
+} HostPrefs;
+
+/*
+ * The emulated handset.
+ */
+static struct
+{
+	IShell shell;
+	IModule module;
+	IDisplay display;
+	IBitmap deviceBitmap;
+	int nColorDepth;
+
+	AEEApplet *pApplet;
+	boolean bClosed;
+
+	uint32 nNow;
+	uint32 nRand;
+	HostTimer arTimers[ HOST_MAX_TIMERS ];
+	HostEvent arEvents[ HOST_MAX_EVENTS ];
+	int nEventHead, nEventCount;
+	HostPrefs prefs;
+	HostResource arResources[ HOST_MAX_RESOURCES ];
+
+	HostDatabase arDatabases[ HOST_MAX_DATABASES ];
+
+	boolean bDebug;
+	boolean bVirtualUpTime;
+	HostStats stats;
+} sHost;
+
+
+/*
+ * Standard library
+ */
+
+void *Host_Malloc( uint32 nSize )
+{
+	HostBlock *pBlock;
+
+	// BREW's MALLOC returns zeroed memory, and the framework relies on it.
+	pBlock = (HostBlock *)calloc( 1, sizeof( HostBlock ) + nSize );
+	if ( !pBlock ) return NULL;
+	pBlock->nSize = nSize;
+
+	sHost.stats.nMalloc++;
+	sHost.stats.nBytesInUse += nSize;
+	if ( sHost.stats.nBytesInUse > sHost.stats.nBytesPeak )
+		sHost.stats.nBytesPeak = sHost.stats.nBytesInUse;
+
+	return pBlock + 1;
+}
+
+void Host_Free( void *p )
+{
+	HostBlock *pBlock;
+
+	if ( !p ) return;
+	pBlock = (HostBlock *)p - 1;
+	sHost.stats.nFree++;
+	sHost.stats.nBytesInUse -= pBlock->nSize;
+	free( pBlock );
+}
+
+void *Host_Realloc( void *p, uint32 nSize )
+{
+	void *pNew;
+	uint32 nOld;
+
+	if ( !p ) return Host_Malloc( nSize );
+	nOld = ( (HostBlock *)p - 1 )->nSize;
+	pNew = Host_Malloc( nSize );
+	if ( !pNew ) return NULL;
+	memcpy( pNew, p, nOld < nSize ? nOld : nSize );
+	Host_Free( p );
+	return pNew;
+}
+
+void Host_DbgPrintf( const char *pszFormat, ... )
+{
+	va_list args;
+
+	if ( !sHost.bDebug ) return;
+	va_start( args, pszFormat );
+	vfprintf( stderr, pszFormat, args );
+	va_end( args );
+	fputc( '\n', stderr );
+}
+
+uint32 Host_GetTimeMS( void )
+{
+	return sHost.nNow;
+}
+
+uint32 Host_GetUpTimeMS( void )
+{
+	// Unlike GETTIMEMS, this is the host's real clock, so that
+	// handler timings measure real work.
+	struct timespec ts;
+
+	if ( sHost.bVirtualUpTime ) return sHost.nNow;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint32)( ts.tv_sec * 1000 + ts.tv_nsec / 1000000 );
+}
+
+void Host_GetRand( byte *pDest, int nSize )
+{
+	// A fixed-seed generator keeps benchmark runs comparable.
+	while ( nSize-- > 0 )
+	{
+		sHost.nRand = sHost.nRand * 1103515245 + 12345;
+		*pDest++ = (byte)( sHost.nRand >> 16 );
+	}
+}
+
+IApplet *Host_GetAppInstance( void )
+{
+	return (IApplet *)sHost.pApplet;
+}
+
+int Host_WStrLen( const AECHAR *p )
+{
+	int n = 0;
+
+	if ( !p ) return 0;
+	while ( *p++ ) n++;
+	return n;
+}
+
+
+/*
+ * Applet helper
+ */
+
+boolean AEEApplet_New( int16 nIn, AEECLSID clsID, IShell *pIShell,
+					   IModule *pIModule, IApplet **ppobj,
+					   AEEHANDLER pAppHandleEvent,
+					   PFNFREEAPPDATA pFreeAppData )
+{
+	AEEApplet *pApplet;
+
+	*ppobj = NULL;
+	if ( nIn < (int16)sizeof( AEEApplet ) ) return FALSE;
+
+	pApplet = (AEEApplet *)Host_Malloc( (uint32)nIn );
+	if ( !pApplet ) return FALSE;
+
+	pApplet->m_pIShell = pIShell;
+	pApplet->m_pIModule = pIModule;
+	pApplet->m_pIDisplay = &sHost.display;
+	pApplet->clsID = clsID;
+	pApplet->m_nRefs = 1;
+	pApplet->pAppHandleEvent = pAppHandleEvent;
+	pApplet->pFreeAppData = pFreeAppData;
+
+	sHost.pApplet = pApplet;
+	*ppobj = (IApplet *)pApplet;
+	return TRUE;
+}
+
+
+/*
+ * IShell
+ */
+
+int Host_ShellCreateInstance( IShell *p, AEECLSID cls, void **ppObj )
+{
+	IControl *pControl;
+
+	(void)p;
+	*ppObj = NULL;
+	switch ( cls )
+	{
+		case AEECLSID_MENUCTL:
+		case AEECLSID_SOFTKEYCTL:
+		case AEECLSID_LISTCTL:
+		case AEECLSID_TEXTCTL:
+		case AEECLSID_STATIC:
+			pControl = (IControl *)Host_Malloc( sizeof( IControl ) );
+			if ( !pControl ) return ENOMEMORY;
+			pControl->cls = cls;
+			*ppObj = pControl;
+			return SUCCESS;
+
+		case AEECLSID_HEAP:
+			*ppObj = Host_Malloc( sizeof( IHeap ) );
+			return *ppObj ? SUCCESS : ENOMEMORY;
+
+		case AEECLSID_FILEMGR:
+			*ppObj = Host_Malloc( sizeof( IFileMgr ) );
+			return *ppObj ? SUCCESS : ENOMEMORY;
+
+		case AEECLSID_DBMGR:
+			*ppObj = Host_Malloc( sizeof( IDBMgr ) );
+			return *ppObj ? SUCCESS : ENOMEMORY;
+
+		case AEECLSID_SPRITE:
+			return Host_SpriteNew( (ISprite **)ppObj );
+
+		default:
+			return ECLASSNOTSUPPORT;
+	}
+}
+
+void Host_ShellGetDeviceInfo( IShell *p, AEEDeviceInfo *pdi )
+{
+	(void)p;
+	memset( pdi, 0, sizeof( AEEDeviceInfo ) );
+	pdi->cxScreen = (uint16)sHost.display.cx;
+	pdi->cyScreen = (uint16)sHost.display.cy;
+	pdi->nColorDepth = (uint16)sHost.nColorDepth;
+	pdi->dwStructSize = sizeof( AEEDeviceInfo );
+}
+
+int Host_ShellGetPrefs( IShell *p, AEECLSID cls, uint16 wVer,
+						void *pCfg, uint16 nSize )
+{
+	(void)p;
+	if ( !sHost.prefs.pData || sHost.prefs.cls != cls ||
+		 sHost.prefs.wVer != wVer || sHost.prefs.nSize != nSize )
+		return EFAILED;
+	memcpy( pCfg, sHost.prefs.pData, nSize );
+	return SUCCESS;
+}
+
+int Host_ShellSetPrefs( IShell *p, AEECLSID cls, uint16 wVer,
+						void *pCfg, uint16 nSize )
+{
+	(void)p;
+	// Prefs are the emulator's, not the applet's, so bypass MALLOC.
+	free( sHost.prefs.pData );
+	sHost.prefs.pData = malloc( nSize );
+	if ( !sHost.prefs.pData ) return ENOMEMORY;
+	memcpy( sHost.prefs.pData, pCfg, nSize );
+	sHost.prefs.cls = cls;
+	sHost.prefs.wVer = wVer;
+	sHost.prefs.nSize = nSize;
+	return SUCCESS;
+}
+
+int Host_ShellSetTimer( IShell *p, int32 dwMSecs,
+						PFNNOTIFY pfn, void *pUser )
+{
+	int i, iFree = -1;
+
+	(void)p;
+	// Like BREW, setting an existing timer reschedules it.
+	for ( i = 0; i < HOST_MAX_TIMERS; i++ )
+	{
+		if ( sHost.arTimers[ i ].pfn == pfn &&
+			 sHost.arTimers[ i ].pUser == pUser )
+		{
+			iFree = i;
+			break;
+		}
+		if ( iFree < 0 && !sHost.arTimers[ i ].pfn ) iFree = i;
+	}
+	if ( iFree < 0 ) return ENOMEMORY;
+
+	sHost.arTimers[ iFree ].pfn = pfn;
+	sHost.arTimers[ iFree ].pUser = pUser;
+	sHost.arTimers[ iFree ].nDue = sHost.nNow + ( dwMSecs > 0 ? dwMSecs : 0 );
+	return SUCCESS;
+}
+
+int Host_ShellCancelTimer( IShell *p, PFNNOTIFY pfn, void *pUser )
+{
+	int i;
+
+	(void)p;
+	for ( i = 0; i < HOST_MAX_TIMERS; i++ )
+	{
+		if ( ( !pfn || sHost.arTimers[ i ].pfn == pfn ) &&
+			 sHost.arTimers[ i ].pUser == pUser )
+		{
+			sHost.arTimers[ i ].pfn = NULL;
+		}
+	}
+	return SUCCESS;
+}
+
+boolean Host_ShellPostEvent( IShell *p, AEECLSID cls, AEEEvent eCode,
+							 uint16 wParam, uint32 dwParam )
+{
+	HostEvent *pEvent;
+
+	(void)p;
+	(void)cls;
+	if ( sHost.nEventCount == HOST_MAX_EVENTS ) return FALSE;
+
+	pEvent = &sHost.arEvents[ ( sHost.nEventHead + sHost.nEventCount ) %
+							  HOST_MAX_EVENTS ];
+	pEvent->eCode = eCode;
+	pEvent->wParam = wParam;
+	pEvent->dwParam = dwParam;
+	sHost.nEventCount++;
+	return TRUE;
+}
+
+boolean Host_ShellSendEvent( IShell *p, AEECLSID cls, AEEEvent eCode,
+							 uint16 wParam, uint32 dwParam )
+{
+	(void)p;
+	(void)cls;
+	return Host_SendAppEvent( eCode, wParam, dwParam );
+}
+
+IImage *Host_ShellLoadResImage( IShell *p, const char *pszFile,
+								uint16 nID )
+{
+	(void)p;
+	(void)pszFile;
+	(void)nID;
+	return NULL;
+}
+
+IBitmap *Host_ShellLoadResBitmap( IShell *p, const char *pszFile,
+								  uint16 nID )
+{
+	(void)p;
+	(void)pszFile;
+	(void)nID;
+	return NULL;
+}
+
+int Host_ShellLoadResString( IShell *p, const char *pszFile, uint16 nID,
+							 AECHAR *pBuff, int nSize )
+{
+	char szTemp[ 16 ];
+	int i, n;
+
+	(void)p;
+	(void)pszFile;
+	if ( !pBuff || nSize < (int)sizeof( AECHAR ) ) return 0;
+
+	// Resource strings are synthesized from their IDs.
+	n = snprintf( szTemp, sizeof( szTemp ), "IDS_%u", nID );
+	if ( n > (int)( nSize / sizeof( AECHAR ) ) - 1 )
+		n = (int)( nSize / sizeof( AECHAR ) ) - 1;
+	for ( i = 0; i < n; i++ ) pBuff[ i ] = (AECHAR)szTemp[ i ];
+	pBuff[ n ] = 0;
+	return n;
+}
+
+void *Host_ShellLoadResDataEx( IShell *p, const char *pszFile, uint16 nID,
+							   ResType nType, void *pBuff, uint32 *pnSize )
+{
+	FILE *pFile = NULL;
+	byte *pData = NULL;
+	long nFile;
+	int i;
+
+	(void)p;
+	(void)pszFile;
+	for ( i = 0; i < HOST_MAX_RESOURCES; i++ )
+		if ( sHost.arResources[ i ].nID == nID ) break;
+	if ( i == HOST_MAX_RESOURCES || nType != RESTYPE_IMAGE ) return NULL;
+
+	pFile = fopen( sHost.arResources[ i ].szFile, "rb" );
+	if ( !pFile ) return NULL;
+	fseek( pFile, 0, SEEK_END );
+	nFile = ftell( pFile );
+	fseek( pFile, 0, SEEK_SET );
+
+	// The image's data follows a one-byte header giving its offset,
+	// so it's as unaligned as the handset may leave it.
+	if ( nFile >= 0 && 
+		 ( !pBuff || !pnSize || *pnSize >= (uint32)nFile + 1 ) )
+		pData = pBuff ? (byte *)pBuff : (byte *)Host_Malloc( nFile + 1 );
+	if ( pData )
+	{
+		pData[ 0 ] = 1;
+		if ( fread( pData + 1, 1, nFile, pFile ) != (size_t)nFile )
+		{
+			if ( !pBuff ) Host_Free( pData );
+			pData = NULL;
+		}
+	}
+	if ( pnSize ) *pnSize = nFile >= 0 ? (uint32)nFile + 1 : 0;
+	fclose( pFile );
+	return pData;
+}
+
+void Host_ShellFreeResData( IShell *p, void *pData )
+{
+	(void)p;
+	Host_Free( pData );
+}
+
+int Host_ShellCloseApplet( IShell *p, boolean bReturnToIdle )
+{
+	(void)p;
+	(void)bReturnToIdle;
+	sHost.bClosed = TRUE;
+	return SUCCESS;
+}
+
+uint32 Host_ShellGetSeconds( IShell *p )
+{
+	(void)p;
+	// Some arbitrary afternoon in 2003, plus virtual time.
+	return 734000000 + sHost.nNow / 1000;
+}
+
+
+/*
+ * IHeap
+ */
+
+uint32 Host_HeapGetMemStats( IHeap *p )
+{
+	(void)p;
+	return sHost.stats.nBytesInUse;
+}
+
+uint32 Host_HeapRelease( IHeap *p )
+{
+	Host_Free( p );
+	return 0;
+}
+
+
+/*
+ * IFileMgr and IFile
+ */
+
+IFile *Host_FileMgrOpenFile( IFileMgr *p, const char *pszFile, int mode )
+{
+	IFile *pIFile;
+	FILE *fp;
+
+	(void)p;
+	if ( mode & _OFM_CREATE )
+	{
+		// BREW refuses to create a file that already exists.
+		if ( Host_FileMgrTest( p, pszFile ) == SUCCESS ) return NULL;
+		fp = fopen( pszFile, "w+b" );
+	}
+	else if ( mode & _OFM_READ )
+	{
+		fp = fopen( pszFile, "rb" );
+	}
+	else
+	{
+		fp = fopen( pszFile, "r+b" );
+		if ( fp && ( mode & _OFM_APPEND ) ) fseek( fp, 0, SEEK_END );
+	}
+	if ( !fp ) return NULL;
+
+	pIFile = (IFile *)Host_Malloc( sizeof( IFile ) );
+	if ( !pIFile )
+	{
+		fclose( fp );
+		return NULL;
+	}
+	pIFile->fp = fp;
+	return pIFile;
+}
+
+int Host_FileMgrTest( IFileMgr *p, const char *pszName )
+{
+	FILE *fp;
+
+	(void)p;
+	fp = fopen( pszName, "rb" );
+	if ( !fp ) return EFILENOEXISTS;
+	fclose( fp );
+	return SUCCESS;
+}
+
+int Host_FileMgrRemove( IFileMgr *p, const char *pszName )
+{
+	(void)p;
+	return remove( pszName ) == 0 ? SUCCESS : EFILENOEXISTS;
+}
+
+uint32 Host_FileMgrRelease( IFileMgr *p )
+{
+	Host_Free( p );
+	return 0;
+}
+
+int32 Host_FileRead( IFile *p, void *pDest, uint32 nSize )
+{
+	return (int32)fread( pDest, 1, nSize, p->fp );
+}
+
+uint32 Host_FileWrite( IFile *p, const void *pSrc, uint32 nSize )
+{
+	return (uint32)fwrite( pSrc, 1, nSize, p->fp );
+}
+
+int Host_FileSeek( IFile *p, FileSeekType type, int32 nPos )
+{
+	int whence = type == _SEEK_START ? SEEK_SET : 
+				 type == _SEEK_END ? SEEK_END : SEEK_CUR;
+
+	return fseek( p->fp, nPos, whence ) == 0 ? SUCCESS : EFAILED;
+}
+
+int Host_FileTruncate( IFile *p, uint32 nPos )
+{
+	fflush( p->fp );
+	return ftruncate( fileno( p->fp ), nPos ) == 0 ? SUCCESS : EFAILED;
+}
+
+uint32 Host_FileRelease( IFile *p )
+{
+	fclose( p->fp );
+	Host_Free( p );
+	return 0;
+}
+
+
+/*
+ * IDBMgr, IDatabase and IDBRecord
+ */
+
+static HostDBRecord *_dbNewRecord( const AEEDBField *arFields, int nFields )
+{
+	HostDBRecord *pRec;
+	size_t nSize = sizeof( HostDBRecord ) + nFields * sizeof( AEEDBField );
+	byte *pData;
+	int i;
+
+	for ( i = 0; i < nFields; i++ ) nSize += arFields[ i ].wDataLen;
+	pRec = (HostDBRecord *)malloc( nSize );
+	if ( !pRec ) return NULL;
+	pRec->nFields = nFields;
+	pData = (byte *)&pRec->arFields[ nFields ];
+	for ( i = 0; i < nFields; i++ )
+	{
+		pRec->arFields[ i ] = arFields[ i ];
+		pRec->arFields[ i ].pBuffer = pData;
+		memcpy( pData, arFields[ i ].pBuffer, arFields[ i ].wDataLen );
+		pData += arFields[ i ].wDataLen;
+	}
+	return pRec;
+}
+
+static IDBRecord *_dbRecordInterface( HostDatabase *pDb, HostDBRecord *pRec )
+{
+	IDBRecord *pIDBRecord;
+
+	if ( !pRec ) return NULL;
+	pIDBRecord = (IDBRecord *)Host_Malloc( sizeof( IDBRecord ) );
+	if ( !pIDBRecord ) return NULL;
+	pIDBRecord->pDb = pDb;
+	pIDBRecord->pRec = pRec;
+	pIDBRecord->iField = -1;
+	sHost.stats.nDBRecordFetches++;
+	return pIDBRecord;
+}
+
+IDatabase *Host_DBMgrOpenDatabase( IDBMgr *p, const char *pszFile, boolean bCreate )
+{
+	HostDatabase *pDb = NULL;
+	IDatabase *pIDatabase;
+	int i;
+
+	(void)p;
+	for ( i = 0; i < HOST_MAX_DATABASES && !pDb; i++ )
+		if ( !strcmp( sHost.arDatabases[ i ].szName, pszFile ) )
+			pDb = &sHost.arDatabases[ i ];
+	for ( i = 0; i < HOST_MAX_DATABASES && !pDb && bCreate; i++ )
+		if ( !sHost.arDatabases[ i ].szName[ 0 ] )
+		{
+			pDb = &sHost.arDatabases[ i ];
+			strncpy( pDb->szName, pszFile, MAX_FILE_NAME - 1 );
+		}
+	if ( !pDb ) return NULL;
+
+	pIDatabase = (IDatabase *)Host_Malloc( sizeof( IDatabase ) );
+	if ( pIDatabase ) pIDatabase->pDb = pDb;
+	return pIDatabase;
+}
+
+int Host_DBMgrRemove( IDBMgr *p, const char *pszFile )
+{
+	HostDatabase *pDb = NULL;
+	uint32 j;
+	int i;
+
+	(void)p;
+	for ( i = 0; i < HOST_MAX_DATABASES && !pDb; i++ )
+		if ( !strcmp( sHost.arDatabases[ i ].szName, pszFile ) )
+			pDb = &sHost.arDatabases[ i ];
+	if ( !pDb ) return EFILENOEXISTS;
+
+	for ( j = 0; j < pDb->nSlots; j++ ) free( pDb->arRecords[ j ] );
+	free( pDb->arRecords );
+	memset( pDb, 0, sizeof( HostDatabase ) );
+	return SUCCESS;
+}
+
+uint32 Host_DBMgrRelease( IDBMgr *p )
+{
+	Host_Free( p );
+	return 0;
+}
+
+uint32 Host_DatabaseGetRecordCount( IDatabase *p )
+{
+	return p->pDb->nRecords;
+}
+
+void Host_DatabaseReset( IDatabase *p )
+{
+	p->iNext = 0;
+}
+
+IDBRecord *Host_DatabaseGetNextRecord( IDatabase *p )
+{
+	HostDatabase *pDb = p->pDb;
+
+	while ( p->iNext < pDb->nSlots && !pDb->arRecords[ p->iNext ] ) p->iNext++;
+	if ( p->iNext >= pDb->nSlots ) return NULL;
+	return _dbRecordInterface( pDb, pDb->arRecords[ p->iNext++ ] );
+}
+
+IDBRecord *Host_DatabaseGetRecordByID( IDatabase *p, uint16 wID )
+{
+	HostDatabase *pDb = p->pDb;
+
+	if ( wID >= pDb->nSlots ) return NULL;
+	return _dbRecordInterface( pDb, pDb->arRecords[ wID ] );
+}
+
+IDBRecord *Host_DatabaseCreateRecord( IDatabase *p, AEEDBField *arFields, int nFields )
+{
+	HostDatabase *pDb = p->pDb;
+	HostDBRecord *pRec, **arNew;
+
+	if ( pDb->nSlots >= 0xFFFF ) return NULL;
+	if ( pDb->nSlots == pDb->nAlloc )
+	{
+		arNew = (HostDBRecord **)realloc( pDb->arRecords,
+			( pDb->nAlloc * 2 + 16 ) * sizeof( HostDBRecord * ) );
+		if ( !arNew ) return NULL;
+		pDb->arRecords = arNew;
+		pDb->nAlloc = pDb->nAlloc * 2 + 16;
+	}
+	pRec = _dbNewRecord( arFields, nFields );
+	if ( !pRec ) return NULL;
+	pRec->wID = (uint16)pDb->nSlots;
+	pDb->arRecords[ pDb->nSlots++ ] = pRec;
+	pDb->nRecords++;
+	return _dbRecordInterface( pDb, pRec );
+}
+
+uint32 Host_DatabaseRelease( IDatabase *p )
+{
+	Host_Free( p );
+	return 0;
+}
+
+uint16 Host_DBRecordGetID( IDBRecord *p )
+{
+	return p->pRec->wID;
+}
+
+void Host_DBRecordReset( IDBRecord *p )
+{
+	p->iField = -1;
+}
+
+AEEDBFieldType Host_DBRecordNextField( IDBRecord *p, AEEDBFieldName *pName,
+									   uint16 *pnLen )
+{
+	AEEDBField *pField;
+
+	if ( p->iField + 1 >= p->pRec->nFields ) return AEEDB_FT_NONE;
+	pField = &p->pRec->arFields[ ++p->iField ];
+	if ( pName ) *pName = pField->fName;
+	if ( pnLen ) *pnLen = pField->wDataLen;
+	return pField->fType;
+}
+
+byte *Host_DBRecordGetField( IDBRecord *p, AEEDBFieldName *pName,
+							 AEEDBFieldType *pType, uint16 *pnLen )
+{
+	AEEDBField *pField;
+
+	if ( p->iField < 0 || p->iField >= p->pRec->nFields ) return NULL;
+	pField = &p->pRec->arFields[ p->iField ];
+	if ( pName ) *pName = pField->fName;
+	if ( pType ) *pType = pField->fType;
+	if ( pnLen ) *pnLen = pField->wDataLen;
+	sHost.stats.nDBFieldReads++;
+	return (byte *)pField->pBuffer;
+}
+
+int Host_DBRecordUpdate( IDBRecord *p, AEEDBField *arFields, int nFields )
+{
+	HostDBRecord *pRec = _dbNewRecord( arFields, nFields );
+
+	if ( !pRec ) return ENOMEMORY;
+	pRec->wID = p->pRec->wID;
+	p->pDb->arRecords[ pRec->wID ] = pRec;
+	free( p->pRec );
+	p->pRec = pRec;
+	p->iField = -1;
+	return SUCCESS;
+}
+
+int Host_DBRecordRemove( IDBRecord *p )
+{
+	p->pDb->arRecords[ p->pRec->wID ] = NULL;
+	p->pDb->nRecords--;
+	free( p->pRec );
+	Host_Free( p );
+	return SUCCESS;
+}
+
+uint32 Host_DBRecordRelease( IDBRecord *p )
+{
+	Host_Free( p );
+	return 0;
+}
+
+
+/*
+ * IDisplay and IImage
+ */
+
+static void _fillRect( IDisplay *p, const AEERect *prc, uint16 color )
+{
+	int x0, y0, x1, y1, y;
+
+	x0 = prc->x < 0 ? 0 : prc->x;
+	y0 = prc->y < 0 ? 0 : prc->y;
+	x1 = prc->x + prc->dx > p->cx ? p->cx : prc->x + prc->dx;
+	y1 = prc->y + prc->dy > p->cy ? p->cy : prc->y + prc->dy;
+
+	for ( y = y0; y < y1; y++ )
+	{
+		uint16 *pPixel = p->pFrame + y * p->cx + x0;
+		int x;
+
+		for ( x = x0; x < x1; x++ ) *pPixel++ = color;
+	}
+}
+
+void Host_DisplayClearScreen( IDisplay *p )
+{
+	sHost.stats.nDisplayClears++;
+	memset( p->pFrame, 0xFF, p->cx * p->cy * sizeof( uint16 ) );
+}
+
+void Host_DisplayUpdate( IDisplay *p )
+{
+	sHost.stats.nDisplayUpdates++;
+	sHost.stats.nPixelsPushed += (uint64)p->cx * p->cy;
+	memcpy( p->pPanel, p->pFrame, p->cx * p->cy * sizeof( uint16 ) );
+}
+
+void Host_DisplayEraseRect( IDisplay *p, const AEERect *prc )
+{
+	_fillRect( p, prc, 0xFFFF );
+}
+
+int Host_DisplayGetFontMetrics( IDisplay *p, AEEFont nFont,
+								int *pnAscent, int *pnDescent )
+{
+	(void)p;
+	if ( pnAscent ) *pnAscent = nFont == AEE_FONT_LARGE ? 14 : 10;
+	if ( pnDescent ) *pnDescent = 3;
+	return nFont == AEE_FONT_LARGE ? 17 : 13;
+}
+
+int Host_DisplayDrawText( IDisplay *p, AEEFont nFont,
+						  const AECHAR *pcText, int nChars,
+						  int x, int y, const AEERect *prcBackground,
+						  uint32 dwFlags )
+{
+	AEERect rc;
+	int n = nChars < 0 ? Host_WStrLen( pcText ) : nChars;
+
+	(void)dwFlags;
+	if ( prcBackground ) _fillRect( p, prcBackground, 0xFFFF );
+	SETAEERECT( &rc, x, y, n * 6, Host_DisplayGetFontMetrics( p, nFont,
+															 NULL, NULL ) );
+	_fillRect( p, &rc, 0x0000 );
+	return SUCCESS;
+}
+
+void Host_ImageDraw( IImage *p, int x, int y )
+{
+	(void)p;
+	(void)x;
+	(void)y;
+}
+
+uint32 Host_ImageRelease( IImage *p )
+{
+	Host_Free( p );
+	return 0;
+}
+
+
+/*
+ * IBitmap
+ */
+
+int Host_DisplayGetDeviceBitmap( IDisplay *p, IBitmap **ppIBitmap )
+{
+	(void)p;
+	sHost.deviceBitmap.nRefs++;
+	*ppIBitmap = &sHost.deviceBitmap;
+	return SUCCESS;
+}
+
+int Host_BitmapCreateCompatibleBitmap( IBitmap *p, IBitmap **ppIBitmap,
+									   uint16 w, uint16 h )
+{
+	IBitmap *pNew;
+
+	(void)p;
+	*ppIBitmap = NULL;
+	pNew = (IBitmap *)Host_Malloc( sizeof( IBitmap ) +
+								   (uint32)w * h * sizeof( uint16 ) );
+	if ( !pNew ) return ENOMEMORY;
+	pNew->cx = w;
+	pNew->cy = h;
+	pNew->pBits = (uint16 *)( pNew + 1 );
+	pNew->wKey = HOST_KEY_MAGENTA;
+	pNew->nRefs = 1;
+	*ppIBitmap = pNew;
+	return SUCCESS;
+}
+
+int Host_BitmapBltIn( IBitmap *p, int xDst, int yDst, int dx, int dy,
+					  IBitmap *pSrc, int xSrc, int ySrc,
+					  AEERasterOp rop )
+{
+	uint16 *pd, *ps;
+	int x, y;
+
+	// Clip to both bitmaps.
+	if ( xSrc < 0 ) { xDst -= xSrc; dx += xSrc; xSrc = 0; }
+	if ( ySrc < 0 ) { yDst -= ySrc; dy += ySrc; ySrc = 0; }
+	if ( xDst < 0 ) { xSrc -= xDst; dx += xDst; xDst = 0; }
+	if ( yDst < 0 ) { ySrc -= yDst; dy += yDst; yDst = 0; }
+	if ( xSrc + dx > pSrc->cx ) dx = pSrc->cx - xSrc;
+	if ( ySrc + dy > pSrc->cy ) dy = pSrc->cy - ySrc;
+	if ( xDst + dx > p->cx ) dx = p->cx - xDst;
+	if ( yDst + dy > p->cy ) dy = p->cy - yDst;
+	if ( dx <= 0 || dy <= 0 ) return SUCCESS;
+
+	sHost.stats.nPixelsBlitted += (uint64)dx * dy;
+	for ( y = 0; y < dy; y++ )
+	{
+		pd = p->pBits + ( yDst + y ) * p->cx + xDst;
+		ps = pSrc->pBits + ( ySrc + y ) * pSrc->cx + xSrc;
+		if ( rop == AEE_RO_TRANSPARENT )
+		{
+			for ( x = 0; x < dx; x++ )
+				if ( ps[ x ] != pSrc->wKey ) pd[ x ] = ps[ x ];
+		}
+		else
+		{
+			memmove( pd, ps, dx * sizeof( uint16 ) );
+		}
+	}
+	return SUCCESS;
+}
+
+int Host_BitmapGetInfo( IBitmap *p, AEEBitmapInfo *pInfo, int nSize )
+{
+	if ( nSize < (int)sizeof( AEEBitmapInfo ) ) return EBADPARM;
+	pInfo->cx = p->cx;
+	pInfo->cy = p->cy;
+	pInfo->nDepth = 16;
+	return SUCCESS;
+}
+
+int Host_BitmapSetTransparencyColor( IBitmap *p, NativeColor color )
+{
+	p->wKey = (uint16)color;
+	return SUCCESS;
+}
+
+int Host_BitmapQueryInterface( IBitmap *p, AEECLSID cls, void **ppObj )
+{
+	*ppObj = NULL;
+	if ( cls != AEECLSID_DIB ) return ECLASSNOTSUPPORT;
+	p->dib.pIBitmap = p;
+	p->dib.pBmp = (byte *)p->pBits;
+	p->dib.ncTransparent = p->wKey;
+	p->dib.cx = (uint16)p->cx;
+	p->dib.cy = (uint16)p->cy;
+	p->dib.nPitch = (int16)( p->cx * sizeof( uint16 ) );
+	p->dib.nDepth = 16;
+	p->dib.nColorScheme = IDIB_COLORSCHEME_565;
+	p->nRefs++;
+	*ppObj = &p->dib;
+	return SUCCESS;
+}
+
+NativeColor Host_BitmapRGBToNative( IBitmap *p, RGBVAL rgb )
+{
+	(void)p;
+	// RGBVALs are 0xBBGGRR00; host pixels are 5-6-5.
+	return ( ( ( rgb >> 11 ) & 0x1F ) << 11 ) |
+		   ( ( ( rgb >> 18 ) & 0x3F ) << 5 ) |
+		   ( ( rgb >> 27 ) & 0x1F );
+}
+
+int Host_BitmapFillRect( IBitmap *p, const AEERect *prc, 
+						 NativeColor color, AEERasterOp rop )
+{
+	int x0, y0, x1, y1, x, y;
+
+	(void)rop;
+	x0 = prc->x < 0 ? 0 : prc->x;
+	y0 = prc->y < 0 ? 0 : prc->y;
+	x1 = prc->x + prc->dx > p->cx ? p->cx : prc->x + prc->dx;
+	y1 = prc->y + prc->dy > p->cy ? p->cy : prc->y + prc->dy;
+	for ( y = y0; y < y1; y++ )
+		for ( x = x0; x < x1; x++ )
+			p->pBits[ y * p->cx + x ] = (uint16)color;
+	return SUCCESS;
+}
+
+uint32 Host_DIBRelease( IDIB *p )
+{
+	return Host_BitmapRelease( p->pIBitmap );
+}
+
+uint32 Host_BitmapAddRef( IBitmap *p )
+{
+	return ++p->nRefs;
+}
+
+uint32 Host_BitmapRelease( IBitmap *p )
+{
+	if ( --p->nRefs || p->bDevice ) return p->nRefs;
+	Host_Free( p );
+	return 0;
+}
+
+
+/*
+ * ISound and ISoundPlayer. ISHELL_CreateInstance never makes 
+ * either, so these are never called with an instance.
+ */
+
+void Host_SoundPlayTone( ISound *p, AEESoundToneData tone )
+{
+	(void)p;
+	(void)tone;
+}
+
+void Host_SoundVibrate( ISound *p, uint16 wDuration )
+{
+	(void)p;
+	(void)wDuration;
+}
+
+uint32 Host_SoundRelease( ISound *p )
+{
+	(void)p;
+	return 0;
+}
+
+int Host_SoundPlayerSetInfo( ISoundPlayer *p, AEESoundPlayerInfo *pInfo )
+{
+	(void)p;
+	(void)pInfo;
+	return EUNSUPPORTED;
+}
+
+void Host_SoundPlayerRegisterNotify( ISoundPlayer *p, 
+									 PFNSOUNDPLAYERSTATUS pfn, void *pUser )
+{
+	(void)p;
+	(void)pfn;
+	(void)pUser;
+}
+
+void Host_SoundPlayerPlay( ISoundPlayer *p )
+{
+	(void)p;
+}
+
+uint32 Host_SoundPlayerRelease( ISoundPlayer *p )
+{
+	(void)p;
+	return 0;
+}
+
+
+/*
+ * IControl, IMenuCtl, ITextCtl and IStatic
+ */
+
+static boolean _isMenu( IControl *p )
+{
+	return p->cls == AEECLSID_MENUCTL ||
+		   p->cls == AEECLSID_SOFTKEYCTL ||
+		   p->cls == AEECLSID_LISTCTL;
+}
+
+uint32 Host_ControlRelease( IControl *p )
+{
+	Host_Free( p );
+	return 0;
+}
+
+boolean Host_ControlHandleEvent( IControl *p, AEEEvent eCode,
+								 uint16 wParam, uint32 dwParam )
+{
+	(void)dwParam;
+	sHost.stats.nControlEvents++;
+	if ( !p->bActive || eCode != EVT_KEY ) return FALSE;
+
+	if ( _isMenu( p ) )
+	{
+		switch ( wParam )
+		{
+			case AVK_UP:
+			case AVK_LEFT:
+				if ( p->nSel > 0 ) p->nSel--;
+				Host_ControlRedraw( p );
+				return TRUE;
+
+			case AVK_DOWN:
+			case AVK_RIGHT:
+				if ( p->nSel < p->nItems - 1 ) p->nSel++;
+				Host_ControlRedraw( p );
+				return TRUE;
+
+			case AVK_SELECT:
+				// Like BREW, the selection reaches the applet as EVT_COMMAND.
+				if ( p->nItems == 0 ) return FALSE;
+				Host_SendAppEvent( EVT_COMMAND,
+								   p->arItems[ p->nSel ].wItemID, 0 );
+				return TRUE;
+		}
+		return FALSE;
+	}
+
+	if ( p->cls == AEECLSID_TEXTCTL )
+	{
+		int n = Host_WStrLen( p->pText );
+
+		if ( wParam >= AVK_0 && wParam <= AVK_9 )
+		{
+			if ( n < HOST_MAX_TEXT )
+			{
+				p->szText[ n ] = (AECHAR)( '0' + wParam - AVK_0 );
+				p->szText[ n + 1 ] = 0;
+				p->pText = p->szText;
+			}
+			Host_ControlRedraw( p );
+			return TRUE;
+		}
+		if ( wParam == AVK_CLR && n > 0 )
+		{
+			p->szText[ n - 1 ] = 0;
+			Host_ControlRedraw( p );
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+boolean Host_ControlRedraw( IControl *p )
+{
+	if ( !p->bActive ) return FALSE;
+	_fillRect( &sHost.display, &p->rc, (uint16)p->nSel );
+	return TRUE;
+}
+
+void Host_ControlSetActive( IControl *p, boolean bActive )
+{
+	p->bActive = bActive ? TRUE : FALSE;
+}
+
+boolean Host_ControlIsActive( IControl *p )
+{
+	sHost.stats.nControlQueries++;
+	return p->bActive;
+}
+
+void Host_ControlSetRect( IControl *p, const AEERect *prc )
+{
+	p->rc = *prc;
+}
+
+void Host_ControlGetRect( IControl *p, AEERect *prc )
+{
+	*prc = p->rc;
+	// A soft key menu occupies one line at the bottom of the screen.
+	if ( p->cls == AEECLSID_SOFTKEYCTL && prc->dy == 0 )
+		SETAEERECT( prc, 0, sHost.display.cy - 16, sHost.display.cx, 16 );
+}
+
+void Host_ControlSetProperties( IControl *p, uint32 dwProps )
+{
+	p->dwProps = dwProps;
+}
+
+uint32 Host_ControlGetProperties( IControl *p )
+{
+	return p->dwProps;
+}
+
+void Host_ControlReset( IControl *p )
+{
+	p->bActive = FALSE;
+	p->nItems = 0;
+	p->nSel = 0;
+	p->pText = NULL;
+	p->szText[ 0 ] = 0;
+	p->pSoftKey = NULL;
+}
+
+boolean Host_MenuAddItemEx( IMenuCtl *p, CtlAddItem *pai )
+{
+	if ( p->nItems == HOST_MAX_MENUITEMS ) return FALSE;
+	p->arItems[ p->nItems ].wItemID = pai->wItemID;
+	p->arItems[ p->nItems ].dwData = pai->dwData;
+	p->nItems++;
+	return TRUE;
+}
+
+boolean Host_MenuGetItemData( IMenuCtl *p, uint16 wID, uint32 *pdwData )
+{
+	int i;
+
+	for ( i = 0; i < p->nItems; i++ )
+	{
+		if ( p->arItems[ i ].wItemID == wID )
+		{
+			*pdwData = p->arItems[ i ].dwData;
+			return TRUE;
+		}
+	}
+	// BREW leaves *pdwData alone on failure; the framework then
+	// reads whatever was there, so make that well-defined.
+	*pdwData = 0;
+	return FALSE;
+}
+
+int Host_MenuGetItemCount( IMenuCtl *p )
+{
+	return p->nItems;
+}
+
+uint16 Host_MenuGetSel( IMenuCtl *p )
+{
+	return p->nItems ? p->arItems[ p->nSel ].wItemID : 0;
+}
+
+boolean Host_MenuSetTitle( IMenuCtl *p, const char *pszResFile,
+						   uint16 wResID, AECHAR *pText )
+{
+	(void)p;
+	(void)pszResFile;
+	(void)wResID;
+	(void)pText;
+	return TRUE;
+}
+
+boolean Host_TextSetText( ITextCtl *p, const AECHAR *pszText, int cch )
+{
+	int n = cch < 0 ? Host_WStrLen( pszText ) : cch;
+
+	if ( n > HOST_MAX_TEXT ) n = HOST_MAX_TEXT;
+	if ( pszText ) memcpy( p->szText, pszText, n * sizeof( AECHAR ) );
+	p->szText[ pszText ? n : 0 ] = 0;
+	p->pText = p->szText;
+	return TRUE;
+}
+
+AECHAR *Host_TextGetTextPtr( ITextCtl *p )
+{
+	return p->pText;
+}
+
+boolean Host_TextSetTitle( ITextCtl *p, const char *pszResFile,
+						   uint16 wResID, AECHAR *pText )
+{
+	(void)p;
+	(void)pszResFile;
+	(void)wResID;
+	(void)pText;
+	return TRUE;
+}
+
+void Host_TextSetSoftKeyMenu( ITextCtl *p, IMenuCtl *pm )
+{
+	p->pSoftKey = pm;
+}
+
+boolean Host_StaticSetText( IStatic *p, AECHAR *pTitle, AECHAR *pText,
+							AEEFont fntTitle, AEEFont fntText )
+{
+	(void)pTitle;
+	(void)fntTitle;
+	(void)fntText;
+	return Host_TextSetText( p, pText, -1 );
+}
+
+
+/*
+ * Harness control
+ */
+
+/**
+ * Brings up the emulated handset.
+ * @param int cx: screen width in pixels
+ * @param int cy: screen height in pixels
+ * @param int nColorDepth: bits per pixel reported to the applet
+ * @return SUCCESS, or ENOMEMORY if the display can't be allocated
+ */
+int Host_Init( int cx, int cy, int nColorDepth )
+{
+	memset( &sHost, 0, sizeof( sHost ) );
+	sHost.display.cx = cx;
+	sHost.display.cy = cy;
+	sHost.nColorDepth = nColorDepth;
+	sHost.nRand = 0x2003;
+	sHost.display.pFrame = (uint16 *)calloc( cx * cy, sizeof( uint16 ) );
+	sHost.display.pPanel = (uint16 *)calloc( cx * cy, sizeof( uint16 ) );
+	if ( !sHost.display.pFrame || !sHost.display.pPanel )
+	{
+		Host_Shutdown();
+		return ENOMEMORY;
+	}
+	sHost.deviceBitmap.cx = cx;
+	sHost.deviceBitmap.cy = cy;
+	sHost.deviceBitmap.pBits = sHost.display.pFrame;
+	sHost.deviceBitmap.bDevice = TRUE;
+	sHost.deviceBitmap.wKey = HOST_KEY_MAGENTA;
+	return SUCCESS;
+}
+
+/**
+ * Tears down the emulated handset.
+ * @return nothing
+ */
+void Host_Shutdown( void )
+{
+	int i;
+	uint32 j;
+
+	for ( i = 0; i < HOST_MAX_DATABASES; i++ )
+	{
+		for ( j = 0; j < sHost.arDatabases[ i ].nSlots; j++ )
+			free( sHost.arDatabases[ i ].arRecords[ j ] );
+		free( sHost.arDatabases[ i ].arRecords );
+	}
+	memset( sHost.arDatabases, 0, sizeof( sHost.arDatabases ) );
+	free( sHost.display.pFrame );
+	free( sHost.display.pPanel );
+	free( sHost.prefs.pData );
+	sHost.display.pFrame = sHost.display.pPanel = NULL;
+	sHost.prefs.pData = NULL;
+}
+
+/**
+ * Creates the applet through AEEClsCreateInstance without 
+ * starting it, so a driver can prepare it before sending 
+ * EVT_APP_START itself.
+ * @param AEECLSID cls: class to create
+ * @return SUCCESS, or the error from the applet's constructor
+ */
+int Host_CreateApplet( AEECLSID cls )
+{
+	void *pObj = NULL;
+	int result;
+
+	sHost.bClosed = FALSE;
+	result = AEEClsCreateInstance( cls, &sHost.shell, &sHost.module, &pObj );
+	if ( result != SUCCESS || !pObj ) return result != SUCCESS ? result : EFAILED;
+	return SUCCESS;
+}
+
+/**
+ * Creates the applet through AEEClsCreateInstance and sends it
+ * EVT_APP_START, as the BREW shell does on launch.
+ * @param AEECLSID cls: class to launch
+ * @return SUCCESS, or the error from the applet's constructor
+ */
+int Host_LaunchApplet( AEECLSID cls )
+{
+	int result = Host_CreateApplet( cls );
+
+	if ( result != SUCCESS ) return result;
+	Host_SendAppEvent( EVT_APP_START, 0, 0 );
+	return SUCCESS;
+}
+
+/**
+ * Stops and frees the applet, as the BREW shell does on exit.
+ * @return nothing
+ */
+void Host_ReleaseApplet( void )
+{
+	AEEApplet *pApplet = sHost.pApplet;
+
+	if ( !pApplet ) return;
+	Host_SendAppEvent( EVT_APP_STOP, 0, 0 );
+	if ( pApplet->pFreeAppData )
+		pApplet->pFreeAppData( (IApplet *)pApplet );
+	Host_Free( pApplet );
+	sHost.pApplet = NULL;
+	memset( sHost.arTimers, 0, sizeof( sHost.arTimers ) );
+	sHost.nEventCount = 0;
+}
+
+/**
+ * Delivers an event to the applet's handler immediately.
+ * @param AEEEvent eCode: event code
+ * @param uint16 wParam: event parameter
+ * @param uint32 dwParam: event parameter
+ * @return TRUE if the applet handled the event
+ */
+boolean Host_SendAppEvent( AEEEvent eCode, uint16 wParam, uint32 dwParam )
+{
+	AEEApplet *pApplet = sHost.pApplet;
+
+	if ( !pApplet || !pApplet->pAppHandleEvent ) return FALSE;
+	return pApplet->pAppHandleEvent( pApplet, eCode, wParam, dwParam );
+}
+
+/**
+ * Delivers every event posted with ISHELL_PostEvent, including
+ * any posted while the queue is being drained.
+ * @return the number of events delivered
+ */
+int Host_Pump( void )
+{
+	int n = 0;
+
+	while ( sHost.nEventCount > 0 )
+	{
+		HostEvent event = sHost.arEvents[ sHost.nEventHead ];
+
+		sHost.nEventHead = ( sHost.nEventHead + 1 ) % HOST_MAX_EVENTS;
+		sHost.nEventCount--;
+		Host_SendAppEvent( event.eCode, event.wParam, event.dwParam );
+		n++;
+	}
+	return n;
+}
+
+/**
+ * Advances virtual time, firing timers in deadline order as
+ * they come due and pumping posted events after each one.
+ * @param uint32 nMSecs: milliseconds to advance
+ * @return the number of timers fired
+ */
+int Host_AdvanceTime( uint32 nMSecs )
+{
+	uint32 nEnd = sHost.nNow + nMSecs;
+	int nFired = 0;
+
+	for ( ;; )
+	{
+		int i, iNext = -1;
+		HostTimer timer;
+
+		for ( i = 0; i < HOST_MAX_TIMERS; i++ )
+		{
+			if ( sHost.arTimers[ i ].pfn &&
+				 sHost.arTimers[ i ].nDue <= nEnd &&
+				 ( iNext < 0 ||
+				   sHost.arTimers[ i ].nDue < sHost.arTimers[ iNext ].nDue ) )
+				iNext = i;
+		}
+		if ( iNext < 0 ) break;
+
+		timer = sHost.arTimers[ iNext ];
+		sHost.arTimers[ iNext ].pfn = NULL;
+		if ( timer.nDue > sHost.nNow ) sHost.nNow = timer.nDue;
+		timer.pfn( timer.pUser );
+		Host_Pump();
+		nFired++;
+	}
+	sHost.nNow = nEnd;
+	return nFired;
+}
+
+/**
+ * Reports whether the applet asked to be closed.
+ * @return TRUE once ISHELL_CloseApplet has been called
+ */
+boolean Host_IsAppletClosed( void )
+{
+	return sHost.bClosed;
+}
+
+/**
+ * Returns the emulator's counters.
+ * @return pointer to the live counters
+ */
+HostStats *Host_GetStats( void )
+{
+	return &sHost.stats;
+}
+
+/**
+ * Zeroes the emulator's call counters, keeping the heap totals.
+ * @return nothing
+ */
+void Host_ResetStats( void )
+{
+	uint32 nBytesInUse = sHost.stats.nBytesInUse;
+
+	memset( &sHost.stats, 0, sizeof( sHost.stats ) );
+	sHost.stats.nBytesInUse = sHost.stats.nBytesPeak = nBytesInUse;
+}
+
+/**
+ * Turns DBGPRINTF output to stderr on or off.
+ * @param boolean bOn: TRUE to print debug output
+ * @return nothing
+ */
+void Host_SetDebugOutput( boolean bOn )
+{
+	sHost.bDebug = bOn;
+}
+
+/**
+ * Makes GETUPTIMEMS follow virtual time, as the timers do, for
+ * applets that schedule their frames by it.
+ * @param boolean bOn: TRUE for virtual time, FALSE for the host's clock
+ * @return nothing
+ */
+void Host_SetVirtualUpTime( boolean bOn )
+{
+	sHost.bVirtualUpTime = bOn;
+}
+
+/**
+ * Makes a host file the data of an image resource, for
+ * ISHELL_LoadResDataEx; every resource file has the same ones.
+ * Call it after Host_Init.
+ * @param uint16 nID: the resource ID
+ * @param const char *pszFile: the file
+ * @return SUCCESS, or ENOMEMORY if there's no room for another
+ */
+int Host_SetResource( uint16 nID, const char *pszFile )
+{
+	int i;
+
+	for ( i = 0; i < HOST_MAX_RESOURCES; i++ )
+		if ( sHost.arResources[ i ].nID == nID ) break;
+	if ( i == HOST_MAX_RESOURCES )
+		for ( i = 0; i < HOST_MAX_RESOURCES; i++ )
+			if ( !sHost.arResources[ i ].nID ) break;
+	if ( i == HOST_MAX_RESOURCES ) return ENOMEMORY;
+	if ( strlen( pszFile ) >= sizeof( sHost.arResources[ i ].szFile ) )
+		return EBADPARM;
+
+	sHost.arResources[ i ].nID = nID;
+	strcpy( sHost.arResources[ i ].szFile, pszFile );
+	return SUCCESS;
+}
@@ -0,0 +1,283 @@
+/*
+ *  @name AtlasPack.c
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides the atlas packer for SpriteSample. It reads
+ *  Windows bitmaps, converts them to the 16-bit 5-6-5 pixels the
+ *  handset's display uses, and stacks them in a single atlas with
+ *  a table giving each image's resource ID and position. The
+ *  layout is CAtlasHeader and CAtlasEntry's, from SpriteSample's
+ *  frameworkopts.h; add the output to the application's resource
+ *  file as image RESID_ATLAS and the application loads every
+ *  sprite and tile with one resource read.
+ *
+ *  Usage: atlaspack [-o atlas] id image.bmp [id image.bmp ...]
+ */
+#include <stdlib.h>
+#include "AEE.h"
+
+/**
+ * @name ATLASPACK_MAGIC, ATLASPACK_DEPTH, ATLASPACK_COLORSCHEME
+ * @memo The atlas format.
+ * @doc These must match ATLAS_MAGIC in SpriteSample's frameworkopts.h, and the depth and IDIB color scheme of a 5-6-5 display.
+ */
+#define ATLASPACK_MAGIC ( 0x41544c31 )
+#define ATLASPACK_DEPTH ( 16 )
+#define ATLASPACK_COLORSCHEME ( 16 )
+
+/**
+ * @name ATLASPACK_MAX_IMAGES
+ * @memo Most images in an atlas.
+ */
+#define ATLASPACK_MAX_IMAGES ( 64 )
+
+/**
+ * @name CPackImage
+ * @memo An image read for the atlas.
+ */
+typedef struct
+{
+	/// Resource ID the application asks for it by
+	uint16 nResID;
+	/// Size in pixels
+	int cx, cy;
+	/// Where it goes in the atlas
+	int y;
+	/// The pixels, top row first, 5-6-5
+	uint16 *pBits;
+} CPackImage;
+
+/**
+ * Reads a little-endian number from a buffer.
+ * @param const byte *p: the buffer
+ * @param int nBytes: how many bytes the number takes
+ * @return the number
+ */
+static uint32 packGet( const byte *p, int nBytes )
+{
+	uint32 n = 0;
+
+	while ( nBytes-- ) n = ( n << 8 ) | p[ nBytes ];
+	return n;
+}
+
+/**
+ * Writes a little-endian number to a file.
+ * @param FILE *pFile: the file
+ * @param uint32 n: the number
+ * @param int nBytes: how many bytes the number takes
+ * @return nothing
+ */
+static void packPut( FILE *pFile, uint32 n, int nBytes )
+{
+	while ( nBytes-- )
+	{
+		fputc( n & 0xff, pFile );
+		n >>= 8;
+	}
+}
+
+/**
+ * Reads an uncompressed 8- or 24-bit Windows bitmap, converting
+ * its pixels to 5-6-5.
+ * @param const char *pszFile: the bitmap
+ * @param CPackImage *pImage: the image to fill in
+ * @return SUCCESS, or EFAILED if the file isn't a bitmap we can read
+ */
+static int packLoad( const char *pszFile, CPackImage *pImage )
+{
+	FILE *pFile;
+	byte *pFileData, *pRow;
+	const byte *pColor;
+	long nSize;
+	uint32 nOffset, nHeader, nColors, nPitch;
+	int nDepth, x, y;
+	boolean bTopDown;
+	int result = EFAILED;
+
+	pFile = fopen( pszFile, "rb" );
+	if ( !pFile ) return EFAILED;
+	fseek( pFile, 0, SEEK_END );
+	nSize = ftell( pFile );
+	fseek( pFile, 0, SEEK_SET );
+	pFileData = (byte *)malloc( nSize > 0 ? nSize : 1 );
+	if ( !pFileData || fread( pFileData, 1, nSize, pFile ) != (size_t)nSize ||
+		 nSize < 54 || pFileData[ 0 ] != 'B' || pFileData[ 1 ] != 'M' )
+		goto done;
+
+	nOffset = packGet( pFileData + 10, 4 );
+	nHeader = packGet( pFileData + 14, 4 );
+	pImage->cx = (int)(int32)packGet( pFileData + 18, 4 );
+	pImage->cy = (int)(int32)packGet( pFileData + 22, 4 );
+	nDepth = (int)packGet( pFileData + 28, 2 );
+	nColors = packGet( pFileData + 46, 4 );
+	bTopDown = pImage->cy < 0;
+	if ( bTopDown ) pImage->cy = -pImage->cy;
+	if ( !nColors ) nColors = 256;
+	if ( packGet( pFileData + 30, 4 ) != 0 ||
+		 ( nDepth != 8 && nDepth != 24 ) ||
+		 pImage->cx <= 0 || pImage->cy <= 0 ||
+		 pImage->cx > 0xffff || pImage->cy > 0xffff )
+		goto done;
+
+	// Rows are padded to four bytes
+	nPitch = ( ( pImage->cx * nDepth / 8 ) + 3 ) & ~3;
+	if ( nOffset + nPitch * pImage->cy > (uint32)nSize ||
+		 ( nDepth == 8 && 14 + nHeader + nColors * 4 > nOffset ) )
+		goto done;
+
+	pImage->pBits = (uint16 *)malloc( pImage->cx * pImage->cy *
+									  sizeof( uint16 ) );
+	if ( !pImage->pBits ) goto done;
+	for ( y = 0; y < pImage->cy; y++ )
+	{
+		pRow = pFileData + nOffset +
+			nPitch * ( bTopDown ? y : pImage->cy - 1 - y );
+		for ( x = 0; x < pImage->cx; x++ )
+		{
+			if ( nDepth == 8 )
+			{
+				if ( pRow[ x ] >= nColors ) goto done;
+				pColor = pFileData + 14 + nHeader + pRow[ x ] * 4;
+			}
+			else
+			{
+				pColor = pRow + x * 3;
+			}
+			// Bitmap colors are blue, green, red
+			pImage->pBits[ y * pImage->cx + x ] = (uint16)
+				( ( ( pColor[ 2 ] >> 3 ) << 11 ) |
+				  ( ( pColor[ 1 ] >> 2 ) << 5 ) |
+				  ( pColor[ 0 ] >> 3 ) );
+		}
+	}
+	result = SUCCESS;
+
+done:
+	if ( result != SUCCESS && pImage->pBits )
+	{
+		free( pImage->pBits );
+		pImage->pBits = NULL;
+	}
+	free( pFileData );
+	fclose( pFile );
+	return result;
+}
+
+/**
+ * Writes the atlas: the header, an entry for each image, then
+ * the images stacked top to bottom in the order they were given.
+ * @param const char *pszFile: the atlas to write
+ * @param CPackImage *arImages: the images
+ * @param int nImages: how many images
+ * @return SUCCESS, or EFAILED if the atlas couldn't be written
+ */
+static int packWrite( const char *pszFile, CPackImage *arImages,
+					  int nImages )
+{
+	FILE *pFile;
+	int cx = 0, cy = 0;
+	int i, x, y;
+
+	for ( i = 0; i < nImages; i++ )
+	{
+		arImages[ i ].y = cy;
+		cy += arImages[ i ].cy;
+		if ( arImages[ i ].cx > cx ) cx = arImages[ i ].cx;
+	}
+	if ( cy > 0xffff ) return EFAILED;
+
+	pFile = fopen( pszFile, "wb" );
+	if ( !pFile ) return EFAILED;
+
+	packPut( pFile, ATLASPACK_MAGIC, 4 );
+	packPut( pFile, ATLASPACK_DEPTH, 2 );
+	packPut( pFile, ATLASPACK_COLORSCHEME, 2 );
+	packPut( pFile, cx, 2 );
+	packPut( pFile, cy, 2 );
+	packPut( pFile, nImages, 2 );
+	packPut( pFile, 0, 2 );
+	for ( i = 0; i < nImages; i++ )
+	{
+		packPut( pFile, arImages[ i ].nResID, 2 );
+		packPut( pFile, 0, 2 );
+		packPut( pFile, arImages[ i ].y, 2 );
+		packPut( pFile, arImages[ i ].cx, 2 );
+		packPut( pFile, arImages[ i ].cy, 2 );
+		packPut( pFile, 0, 2 );
+	}
+
+	// Narrower images are padded on the right with black
+	for ( i = 0; i < nImages; i++ )
+		for ( y = 0; y < arImages[ i ].cy; y++ )
+			for ( x = 0; x < cx; x++ )
+				packPut( pFile, x < arImages[ i ].cx ?
+						 arImages[ i ].pBits[ y * arImages[ i ].cx + x ] : 0,
+						 2 );
+
+	if ( fclose( pFile ) != 0 )
+	{
+		remove( pszFile );
+		return EFAILED;
+	}
+	printf( "%s: %d images, %d x %d, %ld bytes\n", pszFile, nImages,
+			cx, cy, 16L + 12L * nImages + 2L * cx * cy );
+	return SUCCESS;
+}
+
+int main( int argc, char **argv )
+{
+	CPackImage arImages[ ATLASPACK_MAX_IMAGES ];
+	const char *pszOut = "atlas.bin";
+	int nImages = 0;
+	int i, j, result;
+
+	memset( arImages, 0, sizeof( arImages ) );
+	for ( i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-o" ) && i + 1 < argc )
+		{
+			pszOut = argv[ ++i ];
+		}
+		else if ( i + 1 < argc && atoi( argv[ i ] ) > 0 &&
+				  atoi( argv[ i ] ) <= 0xffff &&
+				  nImages < ATLASPACK_MAX_IMAGES )
+		{
+			arImages[ nImages ].nResID = (uint16)atoi( argv[ i ] );
+			for ( j = 0; j < nImages; j++ )
+				if ( arImages[ j ].nResID == arImages[ nImages ].nResID )
+				{
+					fprintf( stderr, "%s: resource %u given twice\n",
+							 argv[ 0 ], arImages[ nImages ].nResID );
+					return 2;
+				}
+			if ( packLoad( argv[ ++i ], &arImages[ nImages ] ) != SUCCESS )
+			{
+				fprintf( stderr, "%s: can't read %s\n", argv[ 0 ], argv[ i ] );
+				return 1;
+			}
+			nImages++;
+		}
+		else
+		{
+			fprintf( stderr,
+					 "usage: %s [-o atlas] id image.bmp [id image.bmp ...]\n",
+					 argv[ 0 ] );
+			return 2;
+		}
+	}
+	if ( !nImages ) return 2;
+
+	result = packWrite( pszOut, arImages, nImages );
+	if ( result != SUCCESS )
+		fprintf( stderr, "%s: can't write %s\n", argv[ 0 ], pszOut );
+	for ( i = 0; i < nImages; i++ ) free( arImages[ i ].pBits );
+	return result == SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,632 @@
+/*
+ *  @name Bench.c
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides an event-throughput benchmark for the
+ *  application framework. It launches the real applet through
+ *  AEEClsCreateInstance on the host shell emulator, pushes a
+ *  small tree of benchmark states, and then pumps a scripted
+ *  stream of EVT_KEY, EVT_COMMAND and EVT_APP_SUSPEND/RESUME
+ *  events through Main_HandleEvent, State_HandleEvent and the
+ *  framework's State_PushEx/State_PopEx/State_Transact.
+ *
+ *  It reports events per second, state transitions per second,
+ *  and the 50th and 99th percentile per-event latency.
+ *
+ *  Usage: bench [-n events] [-s seed] [-d depth] [-t file] [-v]
+ *
+ *  -t writes the state transition trace to the file; build with
+ *  make DEFS=-D_DEBUG to enable tracing.
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "inc.h"
+
+/**
+ * @name BENCH_SCREEN_CX, BENCH_SCREEN_CY
+ * @memo Emulated screen size.
+ * @doc A typical 2003 color handset.
+ */
+#define BENCH_SCREEN_CX ( 128 )
+#define BENCH_SCREEN_CY ( 160 )
+
+/**
+ * @name BENCH_WARMUP
+ * @memo Warm-up events.
+ * @doc Events pumped before measurement begins.
+ */
+#define BENCH_WARMUP ( 1000 )
+
+/**
+ * @name BENCH_TEXT_SIZE
+ * @memo Bytes of scratch memory the static state keeps its text in.
+ */
+#define BENCH_TEXT_SIZE ( 32 * sizeof( AECHAR ) )
+
+/**
+ * @name BENCH_TICK_EVENTS, BENCH_TICK_MSECS
+ * @memo Virtual time.
+ * @doc Every BENCH_TICK_EVENTS events the benchmark advances virtual time by BENCH_TICK_MSECS, firing any timers due, the way keys outpace frames on a handset.
+ */
+#define BENCH_TICK_EVENTS ( 4 )
+#define BENCH_TICK_MSECS ( 50 )
+
+/**
+ * @name EBenchItem
+ * @memo Benchmark menu items.
+ * @doc Each benchmark menu offers a deeper menu, a text entry screen and a static screen.
+ */
+typedef enum
+{
+	BenchItem_Menu = 1,
+	BenchItem_Text,
+	BenchItem_Static
+} EBenchItem;
+
+/**
+ * @name BenchEvent
+ * @memo A scripted event.
+ */
+typedef struct
+{
+	AEEEvent eCode;
+	uint16 wParam;
+	uint32 dwParam;
+} BenchEvent;
+
+/*
+ * Benchmark bookkeeping, kept out of the applet so that it
+ * doesn't disturb the framework's own heap usage.
+ */
+static struct
+{
+	/// Deepest menu the script will open
+	int nMaxDepth;
+	/// Script generator state
+	uint32 nSeed;
+	/// TRUE when the next event must be EVT_APP_RESUME
+	boolean bSuspended;
+	/// EVT_APP_START deliveries to benchmark states
+	uint32 nTransitions;
+	/// Deepest stack seen
+	int nPeakDepth;
+	/// Events sent so far
+	uint32 nEvents;
+	/// The last digit sent to the static screen, or zero
+	uint16 wLastDigit;
+} sBench;
+
+static boolean benchMenuHandleEvent( void *p, AEEEvent eCode,
+									 uint16 wParam, uint32 dwParam );
+static boolean benchTextHandleEvent( void *p, AEEEvent eCode,
+									 uint16 wParam, uint32 dwParam );
+static boolean benchStaticHandleEvent( void *p, AEEEvent eCode,
+									   uint16 wParam, uint32 dwParam );
+
+/**
+ * Returns a monotonic timestamp.
+ * @return nanoseconds since an arbitrary epoch
+ */
+static uint64 benchNow( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+}
+
+/**
+ * Returns the next pseudorandom number for the script.
+ * @return a number between 0 and 32767
+ */
+static uint32 benchRand( void )
+{
+	sBench.nSeed = sBench.nSeed * 1103515245 + 12345;
+	return ( sBench.nSeed >> 16 ) & 0x7FFF;
+}
+
+/**
+ * Counts the states on the framework's stack.
+ * @param CAppPtr pThis: the application
+ * @return number of states, including the application's first state
+ */
+static int benchDepth( CAppPtr pThis )
+{
+	CStatePtr pState;
+	int n = 0;
+
+	for ( pState = NodeNext( pThis->m_app.m_pState );
+		  pState;
+		  pState = NodeNext( pState ) )
+		n++;
+	return n;
+}
+
+/**
+ * Adds an item to the navigation menu.
+ * @param CAppPtr pThis: the application
+ * @param uint16 wItemID: item ID
+ * @param PFNSTATEEVENT *pfnState: state to push on selection
+ * @return nothing
+ */
+static void benchAddItem( CAppPtr pThis, uint16 wItemID,
+						  PFNSTATEEVENT *pfnState )
+{
+	CtlAddItem addItemInfo = { 0 };
+
+	addItemInfo.wItemID = wItemID;
+	addItemInfo.dwData = (uint32)(size_t)pfnState;
+	addItemInfo.pszResText = APP_RES_FILE;
+	addItemInfo.wText = wItemID;
+	IMENUCTL_AddItemEx( GetMenu( pThis ), &addItemInfo );
+}
+
+/**
+ * Adds the benchmark's items to the navigation menu.
+ * @param CAppPtr pThis: the application
+ * @return nothing
+ */
+static void benchAddMenuItems( CAppPtr pThis )
+{
+	benchAddItem( pThis, BenchItem_Menu, benchMenuHandleEvent );
+	benchAddItem( pThis, BenchItem_Text, benchTextHandleEvent );
+	benchAddItem( pThis, BenchItem_Static, benchStaticHandleEvent );
+}
+
+/**
+ * Handles events for a benchmark menu state.
+ * @param void *p: this applicaton
+ * @param AEEEvent eCode: event code
+ * @param uint16 wParam: event parameter
+ * @param uint32 dwParam: event parameter
+ * @return TRUE if application handled event
+ */
+static boolean benchMenuHandleEvent( void *p, AEEEvent eCode,
+									 uint16 wParam, uint32 dwParam )
+{
+	CAppPtr pThis = (CAppPtr)p;
+	UNUSED( dwParam );
+
+	switch ( eCode )
+	{
+		case EVT_APP_START:
+			sBench.nTransitions++;
+			State_KeepScreen( p, TRUE );
+			if ( wParam & StateChange_restored )
+			{
+				// The screen is already on the display; just rebuild the menu
+				IMENUCTL_Reset( GetMenu( pThis ) );
+				benchAddMenuItems( pThis );
+				ICONTROL_SetProperties( GetMenu( pThis ), MP_UNDERLINE_TITLE );
+				ICONTROL_SetRect( GetMenu( pThis ), &pThis->m_rc );
+				ICONTROL_SetActive( GetMenu( pThis ), TRUE );
+				Control_SetShown( (IControl *)GetMenu( pThis ), TRUE );
+				return TRUE;
+			}
+			// Fall through
+
+		case EVT_APP_RESUME:
+			Control_InitializeMenu( pThis );
+			benchAddMenuItems( pThis );
+			Control_ShowControl( GetMenu( pThis ), MP_UNDERLINE_TITLE,
+								 pThis->m_rc );
+			State_Invalidate( p, NULL );
+			return TRUE;
+
+		case EVT_APP_STOP:
+		case EVT_APP_SUSPEND:
+			Control_HideControl( GetMenu( pThis ) );
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * Handles events for the benchmark text entry state.
+ * @param void *p: this applicaton
+ * @param AEEEvent eCode: event code
+ * @param uint16 wParam: event parameter
+ * @param uint32 dwParam: event parameter
+ * @return TRUE if application handled event
+ */
+static boolean benchTextHandleEvent( void *p, AEEEvent eCode,
+									 uint16 wParam, uint32 dwParam )
+{
+	CAppPtr pThis = (CAppPtr)p;
+	AECHAR szEmpty[] = { 0 };
+	UNUSED( wParam );
+	UNUSED( dwParam );
+
+	switch ( eCode )
+	{
+		case EVT_APP_START:
+			sBench.nTransitions++;
+			// Fall through
+
+		case EVT_APP_RESUME:
+			IDISPLAY_ClearScreen( GetDisplay( pThis ) );
+			ITEXTCTL_SetText( GetText( pThis ), szEmpty, -1 );
+			Control_ShowControl( GetText( pThis ), TP_FRAME, pThis->m_rc );
+			State_Invalidate( p, NULL );
+			return TRUE;
+
+		case EVT_APP_STOP:
+		case EVT_APP_SUSPEND:
+			Control_HideControl( GetText( pThis ) );
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * Handles events for the benchmark static display state.
+ * @param void *p: this applicaton
+ * @param AEEEvent eCode: event code
+ * @param uint16 wParam: event parameter
+ * @param uint32 dwParam: event parameter
+ * @return TRUE if application handled event
+ */
+static boolean benchStaticHandleEvent( void *p, AEEEvent eCode,
+									   uint16 wParam, uint32 dwParam )
+{
+	CAppPtr pThis = (CAppPtr)p;
+	IStatic *pIStatic = (IStatic *)pThis->m_app.m_apControl[ Ctl_Static ];
+	AECHAR *pszText;
+	AEERect rc;
+	UNUSED( dwParam );
+
+	switch ( eCode )
+	{
+		case EVT_APP_START:
+			sBench.nTransitions++;
+			// The text buffer lives in the state's scratch memory;
+			// after a relaunch it's already there.
+			if ( !( wParam & StateChange_relaunch ) &&
+				 !State_Alloc( p, BENCH_TEXT_SIZE ) ) return FALSE;
+			// Fall through
+
+		case EVT_APP_RESUME:
+			pszText = (AECHAR *)State_GetScratch( p );
+			IDISPLAY_ClearScreen( GetDisplay( pThis ) );
+			ISHELL_LoadResString( GetShell( pThis ), APP_RES_FILE,
+								  BenchItem_Static, pszText, BENCH_TEXT_SIZE );
+			ISTATIC_SetText( pIStatic, NULL, pszText,
+							 AEE_FONT_BOLD, AEE_FONT_NORMAL );
+			Control_ShowControl( pIStatic, ST_NOSCROLL, pThis->m_rc );
+			State_Invalidate( p, NULL );
+			return TRUE;
+
+		case EVT_APP_STOP:
+		case EVT_APP_SUSPEND:
+			Control_HideControl( pIStatic );
+			return TRUE;
+
+		case EVT_KEY:
+			// STAR leaves this screen and its menu for a text screen
+			// in one transition, the way a "done" shortcut would.
+			if ( wParam == AVK_STAR )
+			{
+				CStateOp aOps[ 3 ];
+
+				aOps[ 0 ].m_eOp = StateOp_pop;
+				aOps[ 0 ].m_pfn = NULL;
+				aOps[ 1 ].m_eOp = StateOp_pop;
+				aOps[ 1 ].m_pfn = NULL;
+				aOps[ 2 ].m_eOp = StateOp_push;
+				aOps[ 2 ].m_pfn = benchTextHandleEvent;
+				State_Transact( p, aOps, 3, 0 );
+				return TRUE;
+			}
+			// Digits scroll the display, the way a viewer would;
+			// it's redrawn on the next frame.
+			if ( wParam >= AVK_0 && wParam <= AVK_9 )
+			{
+				State_RequestFrame( p );
+				return TRUE;
+			}
+			break;
+
+		case EVT_KEY_HELD:
+			State_RequestFrame( p );
+			return TRUE;
+
+		case EVT_STATE_FRAME:
+			ICONTROL_Redraw( pIStatic );
+			ICONTROL_GetRect( pIStatic, &rc );
+			State_Invalidate( p, &rc );
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * The states a snapshot may name.
+ */
+static PFNSTATEEVENT * const sapfnBenchStates[] =
+{
+	AS_MainHandleEvent,
+	benchMenuHandleEvent,
+	benchTextHandleEvent,
+	benchStaticHandleEvent
+};
+
+/**
+ * Creates and starts the applet, registering the benchmark's 
+ * states first so a snapshot can name them.
+ * @return SUCCESS, or the error from the applet's constructor
+ */
+static int benchLaunch( void )
+{
+	int result = Host_CreateApplet( AEECLSID_OURS );
+
+	if ( result != SUCCESS ) return result;
+	State_SetRegistry( GETAPPINSTANCE(), sapfnBenchStates,
+		sizeof( sapfnBenchStates ) / sizeof( sapfnBenchStates[ 0 ] ) );
+	Host_SendAppEvent( EVT_APP_START, 0, 0 );
+	Host_Pump();
+	return SUCCESS;
+}
+
+/**
+ * Chooses the next scripted event based on the state now on top.
+ * @param CAppPtr pThis: the application
+ * @param BenchEvent *pEvent: where to store the event
+ * @return nothing
+ */
+static void benchNextEvent( CAppPtr pThis, BenchEvent *pEvent )
+{
+	CStatePtr pState = State_GetCurrentState( pThis );
+	PFNSTATEEVENT *pfn = pState ? State_GetStateEventHandler( pState ) : NULL;
+	uint32 r = benchRand() % 100;
+	int nDepth = benchDepth( pThis );
+
+	pEvent->dwParam = 0;
+
+	// A suspend is always followed by its resume.
+	if ( sBench.bSuspended )
+	{
+		sBench.bSuspended = FALSE;
+		pEvent->eCode = EVT_APP_RESUME;
+		pEvent->wParam = 0;
+		return;
+	}
+	if ( r < 2 )
+	{
+		sBench.bSuspended = TRUE;
+		pEvent->eCode = EVT_APP_SUSPEND;
+		pEvent->wParam = 0;
+		return;
+	}
+
+	pEvent->eCode = EVT_KEY;
+	if ( pfn == benchMenuHandleEvent )
+	{
+		if ( r < 50 )
+		{
+			// Scroll the menu; the control consumes these.
+			pEvent->wParam = r & 1 ? AVK_DOWN : AVK_UP;
+		}
+		else if ( r < 85 || nDepth <= 2 )
+		{
+			// Choose an item; the framework pushes its state.
+			pEvent->eCode = EVT_COMMAND;
+			if ( nDepth - 1 < sBench.nMaxDepth && ( r & 1 ) )
+				pEvent->wParam = BenchItem_Menu;
+			else
+				pEvent->wParam = ( r & 2 ) ? BenchItem_Text : BenchItem_Static;
+		}
+		else
+		{
+			// Back out of a submenu.
+			pEvent->wParam = AVK_CLR;
+		}
+	}
+	else if ( pfn == benchTextHandleEvent )
+	{
+		// SELECT in a text field with no soft keys pops the state.
+		pEvent->wParam = r < 80 ? (uint16)( AVK_0 + r % 10 ) : AVK_SELECT;
+	}
+	else if ( sBench.wLastDigit && r < 40 )
+	{
+		// Hold the last digit down; the keypad repeats it.
+		pEvent->eCode = r < 35 ? EVT_KEY : EVT_KEY_HELD;
+		pEvent->wParam = sBench.wLastDigit;
+	}
+	else
+	{
+		pEvent->wParam = r < 70 ? (uint16)( AVK_0 + r % 10 ) : 
+			r < 80 && nDepth > 3 ? AVK_STAR : AVK_CLR;
+	}
+	sBench.wLastDigit = pfn == benchStaticHandleEvent && 
+		pEvent->wParam >= AVK_0 && pEvent->wParam <= AVK_9 ? 
+		pEvent->wParam : 0;
+}
+
+/**
+ * Orders two latency samples for qsort.
+ */
+static int benchCompare( const void *a, const void *b )
+{
+	uint32 x = *(const uint32 *)a, y = *(const uint32 *)b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/**
+ * Pumps one scripted event through the applet.
+ * @param CAppPtr pThis: the application
+ * @return nanoseconds spent dispatching the event
+ */
+static uint32 benchStep( CAppPtr pThis )
+{
+	BenchEvent event;
+	uint64 nStart;
+	int nDepth;
+
+	benchNextEvent( pThis, &event );
+	nStart = benchNow();
+	Host_SendAppEvent( event.eCode, event.wParam, event.dwParam );
+	Host_Pump();
+	if ( ++sBench.nEvents % BENCH_TICK_EVENTS == 0 )
+		Host_AdvanceTime( BENCH_TICK_MSECS );
+	nStart = benchNow() - nStart;
+
+	nDepth = benchDepth( pThis );
+	if ( nDepth > sBench.nPeakDepth ) sBench.nPeakDepth = nDepth;
+	return (uint32)nStart;
+}
+
+int main( int argc, char **argv )
+{
+	CAppPtr pThis;
+	HostStats *pStats;
+	uint32 *arLatency;
+	uint64 nTotal = 0;
+	double dSeconds;
+	const char *pszTrace = NULL;
+	boolean bVerbose = FALSE;
+	int nEvents = 200000;
+	int i, nDepth;
+
+	sBench.nSeed = 1;
+	sBench.nMaxDepth = 4;
+	for ( i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			nEvents = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-s" ) && i + 1 < argc )
+			sBench.nSeed = (uint32)atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-d" ) && i + 1 < argc )
+			sBench.nMaxDepth = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-t" ) && i + 1 < argc )
+			pszTrace = argv[ ++i ];
+		else if ( !strcmp( argv[ i ], "-v" ) )
+			bVerbose = TRUE;
+		else
+		{
+			fprintf( stderr,
+					 "usage: %s [-n events] [-s seed] [-d depth] [-t file] [-v]\n",
+					 argv[ 0 ] );
+			return 2;
+		}
+	}
+	if ( nEvents <= 0 || sBench.nMaxDepth < 1 ) return 2;
+
+	arLatency = (uint32 *)malloc( nEvents * sizeof( uint32 ) );
+	if ( !arLatency || Host_Init( BENCH_SCREEN_CX, BENCH_SCREEN_CY, 16 ) != SUCCESS )
+	{
+		fprintf( stderr, "out of memory\n" );
+		return 1;
+	}
+	Host_SetDebugOutput( bVerbose );
+
+	// Launch, then dismiss the splash screen the way a user would.
+	remove( STATE_SNAPSHOT_FILE );
+	if ( benchLaunch() != SUCCESS )
+	{
+		fprintf( stderr, "applet failed to launch\n" );
+		return 1;
+	}
+	Host_SendAppEvent( EVT_KEY, AVK_SELECT, 0 );
+	Host_Pump();
+	pThis = (CAppPtr)GETAPPINSTANCE();
+	if ( Host_IsAppletClosed() || !State_GetCurrentState( pThis ) )
+	{
+		fprintf( stderr, "applet did not reach its first state\n" );
+		return 1;
+	}
+
+	// The benchmark's own menu tree sits on top of the first state.
+	State_Push( pThis, benchMenuHandleEvent );
+
+	for ( i = 0; i < BENCH_WARMUP; i++ ) benchStep( pThis );
+	sBench.nTransitions = 0;
+	sBench.nPeakDepth = 0;
+	Host_ResetStats();
+	MEMSET( State_GetDisplayStats( pThis ), 0, sizeof( CStateDisplayStats ) );
+	MEMSET( State_GetCoalesceStats( pThis ), 0, sizeof( CStateCoalesceStats ) );
+
+	for ( i = 0; i < nEvents; i++ )
+	{
+		arLatency[ i ] = benchStep( pThis );
+		nTotal += arLatency[ i ];
+	}
+
+	pStats = Host_GetStats();
+	dSeconds = nTotal / 1e9;
+	qsort( arLatency, nEvents, sizeof( uint32 ), benchCompare );
+
+	printf( "events              %d\n", nEvents );
+	printf( "dispatch time       %.3f ms\n", nTotal / 1e6 );
+	printf( "events/sec          %.0f\n", nEvents / dSeconds );
+	printf( "transitions         %lu\n", sBench.nTransitions );
+	printf( "transitions/sec     %.0f\n", sBench.nTransitions / dSeconds );
+	printf( "latency p50         %lu ns\n", arLatency[ nEvents / 2 ] );
+	printf( "latency p99         %lu ns\n", arLatency[ (int)( nEvents * 0.99 ) ] );
+	printf( "latency max         %lu ns\n", arLatency[ nEvents - 1 ] );
+	printf( "peak stack depth    %d\n", sBench.nPeakDepth );
+	printf( "MALLOC calls        %lu (%.2f/event)\n",
+			pStats->nMalloc, (double)pStats->nMalloc / nEvents );
+	printf( "heap peak           %lu bytes\n", pStats->nBytesPeak );
+	printf( "display updates     %lu (%.2f/event)\n",
+			pStats->nDisplayUpdates, (double)pStats->nDisplayUpdates / nEvents );
+	printf( "flushes             %lu of %lu invalidations\n",
+			State_GetDisplayStats( pThis )->m_nFlushes,
+			State_GetDisplayStats( pThis )->m_nInvalidated );
+	printf( "coalesced           %lu key repeats merged, %lu frames merged, %lu sent\n",
+			State_GetCoalesceStats( pThis )->m_nKeysMerged,
+			State_GetCoalesceStats( pThis )->m_nFramesMerged,
+			State_GetCoalesceStats( pThis )->m_nFrames );
+	printf( "display clears      %lu (%.2f/event)\n",
+			pStats->nDisplayClears, (double)pStats->nDisplayClears / nEvents );
+	printf( "pixels blitted      %llu\n",
+			(unsigned long long)pStats->nPixelsBlitted );
+	printf( "control queries     %lu (%.2f/event)\n",
+			pStats->nControlQueries, (double)pStats->nControlQueries / nEvents );
+	printf( "state pool          high %u, %lu of %lu nodes from heap\n",
+			State_GetPoolStats( pThis )->m_nDepthHigh,
+			State_GetPoolStats( pThis )->m_nFallback,
+			State_GetPoolStats( pThis )->m_nAcquired );
+	printf( "state arena         peak %lu, state peak %lu, %lu refused\n",
+			State_GetArenaStats( pThis )->m_nPeak,
+			State_GetArenaStats( pThis )->m_nStatePeak,
+			State_GetArenaStats( pThis )->m_nFailed );
+
+	printf( "kept screens        %lu kept, %lu restored, %lu evicted\n",
+			State_GetScreenStats( pThis )->m_nKept,
+			State_GetScreenStats( pThis )->m_nRestored,
+			State_GetScreenStats( pThis )->m_nEvicted );
+
+	if ( pszTrace && State_TraceDump( pThis, pszTrace ) != SUCCESS )
+		fprintf( stderr, "couldn't write trace to %s\n", pszTrace );
+
+	// Have the shell stop the applet while it's suspended, then
+	// relaunch it from the snapshot.
+	nDepth = benchDepth( pThis );
+	if ( !sBench.bSuspended ) Host_SendAppEvent( EVT_APP_SUSPEND, 0, 0 );
+	Host_ReleaseApplet();
+	if ( Host_GetStats()->nBytesInUse != 0 )
+		printf( "leaked              %lu bytes\n", Host_GetStats()->nBytesInUse );
+
+	nTotal = benchNow();
+	if ( benchLaunch() == SUCCESS )
+	{
+		nTotal = benchNow() - nTotal;
+		pThis = (CAppPtr)GETAPPINSTANCE();
+		printf( "relaunch            %d of %d states in %.1f us\n",
+				benchDepth( pThis ), nDepth, nTotal / 1e3 );
+		Host_ReleaseApplet();
+		if ( Host_GetStats()->nBytesInUse != 0 )
+			printf( "leaked              %lu bytes\n", Host_GetStats()->nBytesInUse );
+	}
+	Host_Shutdown();
+	free( arLatency );
+	return 0;
+}
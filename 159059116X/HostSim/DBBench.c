@@ -0,0 +1,459 @@
+/*
+ *  @name DBBench.c
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides a database benchmark for DatabaseSample.
+ *  It imports mileage records in random order into the emulated
+ *  handset's database with DBInsertRecords, launches the real 
+ *  applet, and times its menu commands: listing the records in
+ *  order (building and saving the record index), listing them 
+ *  again after a relaunch (loading the saved index), adding 
+ *  records and deleting them (keeping the index and aggregates
+ *  current). It runs a range query with and without the index,
+ *  removes one kind of entry with a batched delete, compacts the
+ *  database, checks the aggregates against the database, and 
+ *  reports how often the applet's states shared an open database.
+ *
+ *  Usage: dbbench [-n records] [-s seed] [-v]
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "inc.h"
+
+/**
+ * @name DBBENCH_SCREEN_CX, DBBENCH_SCREEN_CY
+ * @memo Emulated screen size.
+ */
+#define DBBENCH_SCREEN_CX ( 128 )
+#define DBBENCH_SCREEN_CY ( 160 )
+
+/**
+ * @name EDBBenchCommand
+ * @memo DatabaseSample's menu commands.
+ */
+typedef enum
+{
+	DBBenchCmd_Add = 1,
+	DBBenchCmd_Sort,
+	DBBenchCmd_Delete
+} EDBBenchCommand;
+
+/*
+ * Script generator state.
+ */
+static uint32 snSeed = 1;
+
+/*
+ * The note some imported records carry.
+ */
+static const AECHAR saszNote[] = 
+	{ 'O', 'd', 'o', 'm', 'e', 't', 'e', 'r', ' ', 'e', 's', 't', 0 };
+
+/**
+ * Returns a monotonic timestamp.
+ * @return nanoseconds since an arbitrary epoch
+ */
+static uint64 dbbenchNow( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+}
+
+/**
+ * Returns the next pseudorandom number.
+ * @return a number between 0 and 32767
+ */
+static uint32 dbbenchRand( void )
+{
+	snSeed = snSeed * 1103515245 + 12345;
+	return ( snSeed >> 16 ) & 0x7FFF;
+}
+
+/**
+ * Fills the application database with records whose times
+ * are in random order, as a log imported from elsewhere
+ * would be, and reports the import rate.
+ * @param int nRecords: how many records to create
+ * @return SUCCESS, or EFAILED if the database couldn't be filled
+ */
+static int dbbenchFill( int nRecords )
+{
+	IDBMgr *pIDBMgr;
+	IDatabase *pIDatabase;
+	CAppRecordPtr arRecords;
+	DBInsertStats stats;
+	uint64 nTime;
+	int i, result;
+
+	arRecords = (CAppRecordPtr)calloc( nRecords, sizeof( CAppRecord ) );
+	if ( !arRecords ) return EFAILED;
+	for ( i = 0; i < nRecords; i++ )
+	{
+		arRecords[ i ].m_type = ME_Gas + dbbenchRand() % ( ME_Undefined - ME_Gas );
+		arRecords[ i ].m_nTime = 700000000 + dbbenchRand() * 32768 + dbbenchRand();
+		arRecords[ i ].m_nMiles = dbbenchRand();
+		arRecords[ i ].m_nCost = dbbenchRand();
+		arRecords[ i ].m_nDueTime = arRecords[ i ].m_nTime + 
+			dbbenchRand() * 256;
+		arRecords[ i ].m_nDueMiles = arRecords[ i ].m_nMiles + 
+			dbbenchRand() % 6000;
+
+		// Some entries carry a note, to exercise variable-length fields
+		if ( i % 4 == 0 )
+		{
+			arRecords[ i ].m_pszNote = (AECHAR *)saszNote;
+			arRecords[ i ].m_nNoteBytes = sizeof( saszNote );
+		}
+	}
+
+	pIDatabase = NULL;
+	if ( Host_ShellCreateInstance( NULL, AEECLSID_DBMGR,
+			(void **)&pIDBMgr ) == SUCCESS )
+	{
+		pIDatabase = IDBMGR_OpenDatabase( pIDBMgr, APP_DATABASE_NAME, TRUE );
+		IDBMGR_Release( pIDBMgr );
+	}
+	if ( !pIDatabase )
+	{
+		free( arRecords );
+		return EFAILED;
+	}
+
+	Host_ResetStats();
+	nTime = dbbenchNow();
+	result = DBInsertRecords( pIDatabase, arRecords, (uint16)nRecords,
+							  NULL, NULL, &stats );
+	nTime = dbbenchNow() - nTime;
+	printf( "%-19s %.3f ms, %.0f records/sec (%lu by its own clock), "
+			"%lu MALLOC calls\n",
+			"import", nTime / 1e6, nRecords / ( nTime / 1e9 ),
+			stats.m_nRecordsPerSec, Host_GetStats()->nMalloc );
+
+	IDATABASE_Release( pIDatabase );
+	free( arRecords );
+	return result;
+}
+
+/**
+ * Creates and starts the applet, and dismisses the splash
+ * screen the way a user would.
+ * @return SUCCESS, or EFAILED if the applet didn't reach its first state
+ */
+static int dbbenchLaunch( void )
+{
+	if ( Host_LaunchApplet( AEECLSID_OURS ) != SUCCESS ) return EFAILED;
+	Host_SendAppEvent( EVT_KEY, AVK_SELECT, 0 );
+	Host_Pump();
+	if ( Host_IsAppletClosed() ||
+		 !State_GetCurrentState( (CAppPtr)GETAPPINSTANCE() ) )
+		return EFAILED;
+	return SUCCESS;
+}
+
+/**
+ * Sends one menu command to the applet and reports what it cost.
+ * @param const char *pszName: what to call the command
+ * @param EDBBenchCommand eCommand: the command
+ * @param int nRecords: records the command touches
+ * @return nothing
+ */
+static void dbbenchCommand( const char *pszName,
+							EDBBenchCommand eCommand, int nRecords )
+{
+	HostStats *pStats;
+	uint64 nTime;
+
+	Host_ResetStats();
+	nTime = dbbenchNow();
+	Host_SendAppEvent( EVT_COMMAND, (uint16)eCommand, 0 );
+	Host_Pump();
+	nTime = dbbenchNow() - nTime;
+	pStats = Host_GetStats();
+
+	printf( "%-19s %.3f ms, %.0f records/sec, %.2f fetches and "
+			"%.2f field reads/record, %lu MALLOC calls\n",
+			pszName, nTime / 1e6, nRecords / ( nTime / 1e9 ),
+			(double)pStats->nDBRecordFetches / nRecords,
+			(double)pStats->nDBFieldReads / nRecords,
+			pStats->nMalloc );
+}
+
+/**
+ * Runs one query against the applet's database and reports
+ * what it cost.
+ * @param const char *pszName: what to call the query
+ * @param boolean bIndexed: TRUE to follow the applet's time index
+ * @param uint32 nFrom, nTo: time range to find
+ * @param int nRecords: records in the database
+ * @return number of records the query matched
+ */
+static uint32 dbbenchQuery( const char *pszName, boolean bIndexed,
+							uint32 nFrom, uint32 nTo, int nRecords )
+{
+	CAppDataPtr pAppData = GetAppData( (CAppPtr)GETAPPINSTANCE() );
+	IDatabase *pIDatabase;
+	DBQuery query;
+	DBRecordView view;
+	uint64 nTime;
+
+	pIDatabase = DBHandleGet( pAppData->m_pDBMgr );
+	if ( !pIDatabase ) return 0;
+
+	Host_ResetStats();
+	nTime = dbbenchNow();
+	DBQueryInit( &query, pIDatabase, 
+				 bIndexed ? pAppData->m_apIndex[ Idx_Time ] : NULL );
+	DBQueryWhere( &query, Fld_Time, nFrom, nTo );
+	DBQueryWhere( &query, Fld_EntryType, ME_Gas, ME_Gas );
+	while ( DBQueryNext( &query, &view ) ) DBReleaseRecordView( &view );
+	nTime = dbbenchNow() - nTime;
+
+	printf( "%-19s %.3f ms, %lu matched, %lu of %d records read, "
+			"%.2f field reads/record\n",
+			pszName, nTime / 1e6, query.m_nMatched, query.m_nExamined, 
+			nRecords, (double)Host_GetStats()->nDBFieldReads / nRecords );
+	DBHandleRelease( pAppData->m_pDBMgr );
+	return query.m_nMatched;
+}
+
+/**
+ * Sends the applet a notification, which has it list what's due
+ * soonest, and reports what that cost.
+ * @param const char *pszName: what to call the notification
+ * @return nothing
+ */
+static void dbbenchNotify( const char *pszName )
+{
+	HostStats *pStats;
+	uint64 nTime;
+
+	Host_ResetStats();
+	nTime = dbbenchNow();
+	Host_SendAppEvent( EVT_NOTIFY, 0, 0 );
+	Host_Pump();
+	nTime = dbbenchNow() - nTime;
+	pStats = Host_GetStats();
+
+	printf( "%-19s %.3f ms, %lu fetches, %lu field reads\n",
+			pszName, nTime / 1e6, pStats->nDBRecordFetches,
+			pStats->nDBFieldReads );
+}
+
+/**
+ * Checks the applet's aggregates against its database and 
+ * reports what the check cost.
+ * @param const char *pszName: what to call the check
+ * @return nothing
+ */
+static void dbbenchVerify( const char *pszName )
+{
+	CAppDataPtr pAppData = GetAppData( (CAppPtr)GETAPPINSTANCE() );
+	IDatabase *pIDatabase;
+	uint32 nWrong = 0;
+	uint64 nTime;
+	int result;
+
+	if ( !pAppData->m_pAggregates ) return;
+	pIDatabase = DBHandleGet( pAppData->m_pDBMgr );
+	if ( !pIDatabase ) return;
+
+	nTime = dbbenchNow();
+	result = DBAggregatesVerify( pIDatabase, pAppData->m_pAggregates, &nWrong );
+	nTime = dbbenchNow() - nTime;
+	printf( "%-19s %.3f ms, %s, %lu groups wrong\n", pszName, nTime / 1e6,
+			result == SUCCESS ? "correct" : "rebuilt", nWrong );
+	DBHandleRelease( pAppData->m_pDBMgr );
+}
+
+/**
+ * Reports what a maintenance operation did.
+ * @param const char *pszName: what to call the operation
+ * @param uint64 nTime: how long it took, in nanoseconds
+ * @param DBMaintStatsPtr pStats: what it reported
+ * @param int result: what it returned
+ * @return nothing
+ */
+static void dbbenchMaint( const char *pszName, uint64 nTime,
+						  DBMaintStatsPtr pStats, int result )
+{
+	if ( result != SUCCESS )
+		printf( "%-19s failed, %d\n", pszName, result );
+	else
+		printf( "%-19s %.3f ms, %lu records, %s%lu bytes reclaimed\n",
+				pszName, nTime / 1e6, pStats->m_nRecords, 
+				pStats->m_bEstimated ? "about " : "", pStats->m_nBytes );
+}
+
+/**
+ * Removes every entry of one type from the applet's database 
+ * with a batched delete, keeping its aggregates and indexes, 
+ * and reports what that cost.
+ * @param const char *pszName: what to call the delete
+ * @param EMileageEntryType type: type of entry to remove
+ * @return nothing
+ */
+static void dbbenchPurge( const char *pszName, EMileageEntryType type )
+{
+	CAppDataPtr pAppData = GetAppData( (CAppPtr)GETAPPINSTANCE() );
+	IDatabase *pIDatabase;
+	DBMaintStats stats;
+	DBQuery query;
+	uint64 nTime;
+	int i, result;
+
+	pIDatabase = DBHandleGet( pAppData->m_pDBMgr );
+	if ( !pIDatabase ) return;
+
+	nTime = dbbenchNow();
+	DBQueryInit( &query, pIDatabase, NULL );
+	DBQueryWhere( &query, Fld_EntryType, type, type );
+	result = DBQueryDelete( &query, pAppData->m_pAggregates,
+							pAppData->m_apIndex, Idx_LastIndex, &stats );
+	nTime = dbbenchNow() - nTime;
+	dbbenchMaint( pszName, nTime, &stats, result );
+
+	for ( i = 0; i < Idx_LastIndex; i++ )
+		if ( pAppData->m_apIndex[ i ] && pAppData->m_apIndex[ i ]->m_nEntries !=
+			 IDATABASE_GetRecordCount( pIDatabase ) )
+			printf( "index %d has %u entries for %lu records\n", i, 
+					pAppData->m_apIndex[ i ]->m_nEntries,
+					IDATABASE_GetRecordCount( pIDatabase ) );
+	DBHandleRelease( pAppData->m_pDBMgr );
+}
+
+/**
+ * Compacts the applet's database, and drops the applet's
+ * indexes, whose record IDs compaction changes. Compaction
+ * removes their files.
+ * @param const char *pszName: what to call the compaction
+ * @return nothing
+ */
+static void dbbenchCompact( const char *pszName )
+{
+	CAppDataPtr pAppData = GetAppData( (CAppPtr)GETAPPINSTANCE() );
+	DBMaintStats stats;
+	uint64 nTime;
+	int i, result;
+
+	nTime = dbbenchNow();
+	result = DBHandleCompact( pAppData->m_pDBMgr, &stats );
+	nTime = dbbenchNow() - nTime;
+	dbbenchMaint( pszName, nTime, &stats, result );
+
+	for ( i = 0; i < Idx_LastIndex; i++ )
+	{
+		DBIndexFree( pAppData->m_apIndex[ i ] );
+		pAppData->m_apIndex[ i ] = NULL;
+	}
+}
+
+int main( int argc, char **argv )
+{
+	DBHandleStatsPtr pDBStats;
+	uint32 nFrom, nTo;
+	boolean bVerbose = FALSE;
+	int nRecords = 2000;
+	int i;
+
+	for ( i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			nRecords = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-s" ) && i + 1 < argc )
+			snSeed = (uint32)atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-v" ) )
+			bVerbose = TRUE;
+		else
+		{
+			fprintf( stderr, "usage: %s [-n records] [-s seed] [-v]\n",
+					 argv[ 0 ] );
+			return 2;
+		}
+	}
+	if ( nRecords <= 0 || nRecords > 60000 ) return 2;
+
+	if ( Host_Init( DBBENCH_SCREEN_CX, DBBENCH_SCREEN_CY, 16 ) != SUCCESS )
+	{
+		fprintf( stderr, "out of memory\n" );
+		return 1;
+	}
+	Host_SetDebugOutput( bVerbose );
+	remove( STATE_SNAPSHOT_FILE );
+	remove( APP_INDEX_NAME );
+	remove( APP_DUETIME_INDEX_NAME );
+	remove( APP_DUEMILES_INDEX_NAME );
+	remove( APP_AGGREGATE_NAME );
+	printf( "records             %d\n", nRecords );
+	if ( dbbenchFill( nRecords ) != SUCCESS )
+	{
+		fprintf( stderr, "couldn't fill the database\n" );
+		return 1;
+	}
+
+	if ( dbbenchLaunch() != SUCCESS )
+	{
+		fprintf( stderr, "applet failed to launch\n" );
+		return 1;
+	}
+	dbbenchCommand( "sort (build)", DBBenchCmd_Sort, nRecords );
+	dbbenchCommand( "sort (cached)", DBBenchCmd_Sort, nRecords );
+	Host_ReleaseApplet();
+	if ( Host_GetStats()->nBytesInUse != 0 )
+		printf( "leaked              %lu bytes\n", Host_GetStats()->nBytesInUse );
+
+	// A fresh launch finds the index on disk.
+	if ( dbbenchLaunch() != SUCCESS )
+	{
+		fprintf( stderr, "applet failed to relaunch\n" );
+		return 1;
+	}
+	dbbenchCommand( "sort (load)", DBBenchCmd_Sort, nRecords );
+
+	// Gas fills in a tenth of the time the log covers
+	nFrom = 700000000 + 0x3FFFFFFF / 10 * 4;
+	nTo = nFrom + 0x3FFFFFFF / 10;
+	if ( dbbenchQuery( "query (indexed)", TRUE, nFrom, nTo, nRecords ) !=
+		 dbbenchQuery( "query (scan)", FALSE, nFrom, nTo, nRecords ) )
+		printf( "indexed and scanned queries disagree\n" );
+
+	Host_SendAppEvent( EVT_APP_SUSPEND, 0, 0 );
+	Host_SendAppEvent( EVT_APP_RESUME, 0, 0 );
+	Host_Pump();
+	dbbenchNotify( "due soon (build)" );
+	dbbenchCommand( "add", DBBenchCmd_Add, ME_Undefined - ME_Gas );
+	dbbenchVerify( "aggregates (add)" );
+	dbbenchNotify( "due soon" );
+	dbbenchPurge( "delete where", ME_Parking );
+	dbbenchVerify( "aggregates (where)" );
+	dbbenchCompact( "compact" );
+	dbbenchCommand( "sort (compacted)", DBBenchCmd_Sort, nRecords );
+	dbbenchCommand( "delete", DBBenchCmd_Delete, nRecords );
+	dbbenchVerify( "aggregates (delete)" );
+	Host_AdvanceTime( DB_IDLE_MSECS );
+
+	pDBStats = DBHandleGetStats( 
+		GetAppData( (CAppPtr)GETAPPINSTANCE() )->m_pDBMgr );
+	printf( "database handle     %lu opens, %lu avoided, %lu idle closes\n",
+			pDBStats->m_nOpens, pDBStats->m_nOpensAvoided,
+			pDBStats->m_nIdleCloses );
+	Host_ReleaseApplet();
+	if ( Host_GetStats()->nBytesInUse != 0 )
+		printf( "leaked              %lu bytes\n", Host_GetStats()->nBytesInUse );
+
+	Host_Shutdown();
+	remove( STATE_SNAPSHOT_FILE );
+	remove( APP_INDEX_NAME );
+	remove( APP_DUETIME_INDEX_NAME );
+	remove( APP_DUEMILES_INDEX_NAME );
+	remove( APP_AGGREGATE_NAME );
+	return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ *  @name HostSprite.c
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides the software ISprite declared in
+ *  AEESprite.h. It draws from and to 5-6-5 bitmaps through their
+ *  IDIBs, as an engine on the handset would.
+ *
+ *  Every sprite, however it's transformed, is drawn a row at a
+ *  time: the transform produces the row, and the row is copied
+ *  to the destination skipping key colored pixels. Compilers with
+ *  vector extensions copy the row eight pixels at a time, using a
+ *  compare and select in place of a branch per pixel; the vector
+ *  width is the compiler's to map onto SSE2, NEON or plain
+ *  integers. Host_SpriteSetScalar turns the vector copy off, so
+ *  the two can be compared.
+ */
+#include <stdlib.h>
+#include "AEESprite.h"
+
+/**
+ * @name HOST_SPRITE_SIZES, HOST_SPRITE_MAX
+ * @memo Sprite and tile sizes.
+ * @doc Sizes run from SPRITE_SIZE_8X8 to SPRITE_SIZE_64X64, the largest HOST_SPRITE_MAX pixels on a side.
+ */
+#define HOST_SPRITE_SIZES ( 4 )
+#define HOST_SPRITE_MAX ( 8 << ( HOST_SPRITE_SIZES - 1 ) )
+
+/**
+ * @name HostPixels, HOST_SPRITE_LANES
+ * @memo Vector of pixels.
+ * @doc Defined only where the compiler has vector extensions; elsewhere every row is copied a pixel at a time.
+ */
+#if defined( __GNUC__ )
+typedef uint16 HostPixels __attribute__(( vector_size( 16 ) ));
+#define HOST_SPRITE_LANES ( (int)( sizeof( HostPixels ) / sizeof( uint16 ) ) )
+#endif
+
+struct ISprite
+{
+	/// Sprite images of each size, stacked top to bottom
+	IDIB *arSprites[ HOST_SPRITE_SIZES ];
+	/// Tile images of each size, stacked top to bottom
+	IDIB *arTiles[ HOST_SPRITE_SIZES ];
+	/// Where drawing goes
+	IDIB *pDest;
+	/// Sprites in the order they're drawn, grown as needed
+	uint32 *pOrder;
+	uint32 nOrder;
+	uint32 nRefs;
+};
+
+static boolean sbScalar = FALSE;
+
+/**
+ * Swaps the IDIB held for one of the sprite's bitmaps.
+ * @param IDIB **ppIDIB: the IDIB held
+ * @param IBitmap *pIBitmap: the new bitmap, or NULL for none
+ * @return SUCCESS, or the error from IBITMAP_QueryInterface
+ */
+static int spriteSetBitmap( IDIB **ppIDIB, IBitmap *pIBitmap )
+{
+	IDIB *pIDIB = NULL;
+	int result;
+
+	if ( pIBitmap )
+	{
+		result = IBITMAP_QueryInterface( pIBitmap, AEECLSID_DIB, &pIDIB );
+		if ( result != SUCCESS ) return result;
+	}
+	if ( *ppIDIB ) IDIB_Release( *ppIDIB );
+	*ppIDIB = pIDIB;
+	return SUCCESS;
+}
+
+/**
+ * Copies a row of pixels, leaving the destination alone where
+ * the source is the key color.
+ * @param uint16 *pDst: destination pixels
+ * @param const uint16 *pSrc: source pixels
+ * @param int n: how many pixels
+ * @param uint16 wKey: the key color
+ * @return nothing
+ */
+static void spriteKeyRow( uint16 *pDst, const uint16 *pSrc, int n,
+						  uint16 wKey )
+{
+#ifdef HOST_SPRITE_LANES
+	HostPixels s, d, m, key;
+
+	if ( !sbScalar )
+	{
+		key = (HostPixels){ 0 } + wKey;
+		for ( ; n >= HOST_SPRITE_LANES;
+			  n -= HOST_SPRITE_LANES,
+			  pDst += HOST_SPRITE_LANES, pSrc += HOST_SPRITE_LANES )
+		{
+			memcpy( &s, pSrc, sizeof( s ) );
+			memcpy( &d, pDst, sizeof( d ) );
+			// All ones where the source is transparent
+			m = (HostPixels)( s == key );
+			d = ( d & m ) | ( s & ~m );
+			memcpy( pDst, &d, sizeof( d ) );
+		}
+	}
+#endif
+	for ( ; n > 0; n--, pDst++, pSrc++ )
+		if ( *pSrc != wKey ) *pDst = *pSrc;
+}
+
+/**
+ * Draws one sprite, clipped to the destination.
+ * @param ISprite *p: the sprite engine
+ * @param const AEESpriteCmd *pCmd: the sprite
+ * @return nothing
+ */
+static void spriteDraw( ISprite *p, const AEESpriteCmd *pCmd )
+{
+	IDIB *pSrc, *pDst = p->pDest;
+	uint16 arRow[ 2 * HOST_SPRITE_MAX ];
+	const uint16 *pBase, *pRow;
+	uint16 *pDstRow;
+	int nRotate = pCmd->unTransform & TRANSFORM_ROTATE_MASK;
+	boolean bScale = ( pCmd->unTransform & TRANSFORM_SCALE_2 ) != 0;
+	int n, nSize, nPitch, x, y, x0, x1, y0, y1, r, c, sr;
+
+	if ( pCmd->unSpriteSize >= HOST_SPRITE_SIZES ) return;
+	pSrc = p->arSprites[ pCmd->unSpriteSize ];
+	n = 8 << pCmd->unSpriteSize;
+	if ( !pSrc || !pDst || n > pSrc->cx ||
+		 ( pCmd->unSpriteIndex + 1 ) * n > pSrc->cy )
+		return;
+
+	// Scaled sprites grow about their center
+	nSize = bScale ? 2 * n : n;
+	x = pCmd->x - ( bScale ? n / 2 : 0 );
+	y = pCmd->y - ( bScale ? n / 2 : 0 );
+
+	// The part of the sprite on the destination
+	x0 = x < 0 ? -x : 0;
+	y0 = y < 0 ? -y : 0;
+	x1 = x + nSize > pDst->cx ? pDst->cx - x : nSize;
+	y1 = y + nSize > pDst->cy ? pDst->cy - y : nSize;
+	if ( x0 >= x1 || y0 >= y1 ) return;
+
+	nPitch = pSrc->nPitch / sizeof( uint16 );
+	pBase = (const uint16 *)( pSrc->pBmp +
+							  pCmd->unSpriteIndex * n * pSrc->nPitch );
+	for ( r = y0; r < y1; r++ )
+	{
+		// Row sr of the rotated sprite
+		sr = bScale ? r >> 1 : r;
+		pRow = arRow;
+		switch ( nRotate )
+		{
+			case TRANSFORM_ROTATE_90:
+				for ( c = 0; c < n; c++ )
+					arRow[ c ] = pBase[ ( n - 1 - c ) * nPitch + sr ];
+				break;
+			case TRANSFORM_ROTATE_180:
+				for ( c = 0; c < n; c++ )
+					arRow[ c ] = pBase[ ( n - 1 - sr ) * nPitch + n - 1 - c ];
+				break;
+			case TRANSFORM_ROTATE_270:
+				for ( c = 0; c < n; c++ )
+					arRow[ c ] = pBase[ c * nPitch + n - 1 - sr ];
+				break;
+			default:
+				pRow = pBase + sr * nPitch;
+				break;
+		}
+
+		// Double each pixel, from the right so the row can grow in place
+		if ( bScale )
+		{
+			for ( c = n - 1; c >= 0; c-- )
+				arRow[ 2 * c + 1 ] = arRow[ 2 * c ] = pRow[ c ];
+			pRow = arRow;
+		}
+
+		pDstRow = (uint16 *)( pDst->pBmp + ( y + r ) * pDst->nPitch ) +
+			x + x0;
+		if ( pCmd->unComposite == COMPOSITE_KEYCOLOR )
+			spriteKeyRow( pDstRow, pRow + x0, x1 - x0,
+						  (uint16)pSrc->ncTransparent );
+		else
+			memcpy( pDstRow, pRow + x0, ( x1 - x0 ) * sizeof( uint16 ) );
+	}
+	Host_GetStats()->nSpritesDrawn++;
+}
+
+/**
+ * Draws the visible tiles of a map whose top left corner is at
+ * x, y on the destination.
+ * @param IDIB *pSrc: tile images
+ * @param IDIB *pDst: destination
+ * @param const AEETileMap *pMap: the map
+ * @param int n: tile size in pixels
+ * @param int x: where the map's left edge is
+ * @param int y: where the map's top edge is
+ * @return nothing
+ */
+static void tileDrawMap( IDIB *pSrc, IDIB *pDst, const AEETileMap *pMap,
+						 int n, int x, int y )
+{
+	int w = 1 << pMap->w, h = 1 << pMap->h;
+	int nTiles = pSrc->cy / n;
+	int i0, i1, j0, j1, i, j, tx, ty, x0, x1, y0, y1, r;
+	uint16 nTile;
+
+	if ( x >= pDst->cx || y >= pDst->cy ||
+		 x + w * n <= 0 || y + h * n <= 0 )
+		return;
+
+	// Only the tiles over the destination
+	i0 = x < 0 ? -x / n : 0;
+	j0 = y < 0 ? -y / n : 0;
+	i1 = ( pDst->cx - 1 - x ) / n;
+	j1 = ( pDst->cy - 1 - y ) / n;
+	if ( i1 >= w ) i1 = w - 1;
+	if ( j1 >= h ) j1 = h - 1;
+
+	for ( j = j0; j <= j1; j++ )
+		for ( i = i0; i <= i1; i++ )
+		{
+			nTile = pMap->pMapArray[ j * w + i ];
+			if ( nTile >= nTiles ) continue;
+			tx = x + i * n;
+			ty = y + j * n;
+			x0 = tx < 0 ? -tx : 0;
+			y0 = ty < 0 ? -ty : 0;
+			x1 = tx + n > pDst->cx ? pDst->cx - tx : n;
+			y1 = ty + n > pDst->cy ? pDst->cy - ty : n;
+			for ( r = y0; r < y1; r++ )
+				memcpy( (uint16 *)( pDst->pBmp +
+									( ty + r ) * pDst->nPitch ) + tx + x0,
+						(const uint16 *)( pSrc->pBmp +
+										  ( nTile * n + r ) * pSrc->nPitch ) + x0,
+						( x1 - x0 ) * sizeof( uint16 ) );
+			Host_GetStats()->nTilesDrawn++;
+		}
+}
+
+
+/*
+ * ISprite
+ */
+
+int Host_SpriteNew( ISprite **ppISprite )
+{
+	*ppISprite = (ISprite *)Host_Malloc( sizeof( ISprite ) );
+	if ( !*ppISprite ) return ENOMEMORY;
+	(*ppISprite)->nRefs = 1;
+	return SUCCESS;
+}
+
+int Host_SpriteSetSpriteBuffer( ISprite *p, int nSize, IBitmap *pIBitmap )
+{
+	if ( nSize < 0 || nSize >= HOST_SPRITE_SIZES ) return EBADPARM;
+	return spriteSetBitmap( &p->arSprites[ nSize ], pIBitmap );
+}
+
+int Host_SpriteSetTileBuffer( ISprite *p, int nSize, IBitmap *pIBitmap )
+{
+	if ( nSize < 0 || nSize >= HOST_SPRITE_SIZES ) return EBADPARM;
+	return spriteSetBitmap( &p->arTiles[ nSize ], pIBitmap );
+}
+
+int Host_SpriteSetDestination( ISprite *p, IBitmap *pIBitmap )
+{
+	return spriteSetBitmap( &p->pDest, pIBitmap );
+}
+
+void Host_SpriteDrawSprites( ISprite *p, AEESpriteCmd *pCmds )
+{
+	uint32 arFirst[ 256 + 1 ];
+	uint32 *pOrder;
+	uint32 nCmds, i;
+
+	for ( nCmds = 0; pCmds[ nCmds ].unSpriteSize != SPRITE_SIZE_END; nCmds++ )
+		;
+	if ( nCmds > p->nOrder )
+	{
+		pOrder = (uint32 *)Host_Realloc( p->pOrder, nCmds * sizeof( uint32 ) );
+		if ( !pOrder ) return;
+		p->pOrder = pOrder;
+		p->nOrder = nCmds;
+	}
+
+	// Sort the sprites by layer, keeping their order within a layer
+	memset( arFirst, 0, sizeof( arFirst ) );
+	for ( i = 0; i < nCmds; i++ ) arFirst[ pCmds[ i ].unLayer + 1 ]++;
+	for ( i = 1; i <= 256; i++ ) arFirst[ i ] += arFirst[ i - 1 ];
+	for ( i = 0; i < nCmds; i++ )
+		p->pOrder[ arFirst[ pCmds[ i ].unLayer ]++ ] = i;
+
+	for ( i = 0; i < nCmds; i++ ) spriteDraw( p, &pCmds[ p->pOrder[ i ] ] );
+}
+
+void Host_SpriteDrawTiles( ISprite *p, AEETileMap *pMaps )
+{
+	IDIB *pSrc;
+	int n, nSpanX, nSpanY, x, y, x0, y0;
+
+	if ( !p->pDest ) return;
+	for ( ; pMaps->pMapArray; pMaps++ )
+	{
+		if ( pMaps->unTileSize >= HOST_SPRITE_SIZES ||
+			 pMaps->w > MAP_SIZE_64 || pMaps->h > MAP_SIZE_64 )
+			continue;
+		pSrc = p->arTiles[ pMaps->unTileSize ];
+		n = 8 << pMaps->unTileSize;
+		if ( !pSrc || n > pSrc->cx ) continue;
+
+		if ( !( pMaps->unFlags & MAP_FLAG_WRAP ) )
+		{
+			tileDrawMap( pSrc, p->pDest, pMaps, n, pMaps->x, pMaps->y );
+			continue;
+		}
+
+		// Repeat the map across the destination, starting with the
+		// copy over its top left corner.
+		nSpanX = n << pMaps->w;
+		nSpanY = n << pMaps->h;
+		x0 = pMaps->x % nSpanX;
+		y0 = pMaps->y % nSpanY;
+		if ( x0 > 0 ) x0 -= nSpanX;
+		if ( y0 > 0 ) y0 -= nSpanY;
+		for ( y = y0; y < p->pDest->cy; y += nSpanY )
+			for ( x = x0; x < p->pDest->cx; x += nSpanX )
+				tileDrawMap( pSrc, p->pDest, pMaps, n, x, y );
+	}
+}
+
+uint32 Host_SpriteRelease( ISprite *p )
+{
+	int i;
+
+	if ( --p->nRefs ) return p->nRefs;
+	for ( i = 0; i < HOST_SPRITE_SIZES; i++ )
+	{
+		spriteSetBitmap( &p->arSprites[ i ], NULL );
+		spriteSetBitmap( &p->arTiles[ i ], NULL );
+	}
+	spriteSetBitmap( &p->pDest, NULL );
+	Host_Free( p->pOrder );
+	Host_Free( p );
+	return 0;
+}
+
+/**
+ * Turns the vector row copy off or on, to measure what it saves.
+ * @param boolean bScalar: TRUE to copy a pixel at a time
+ * @return nothing
+ */
+void Host_SpriteSetScalar( boolean bScalar )
+{
+	sbScalar = bScalar;
+}
@@ -0,0 +1,431 @@
+/*
+ *  @name SpriteBench.c
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides a benchmark for the host ISprite in
+ *  HostSprite.c. Each frame it draws a scrolling tile map and
+ *  thousands of 16x16 sprites, rotated, scaled and on different
+ *  layers, mostly key colored as SpriteSample's are. It runs the
+ *  frames with the vector row copy and again a pixel at a time,
+ *  and reports sprites per millisecond for each.
+ *
+ *  Before timing, it checks every transform, clipped at the
+ *  destination's edges, against a pixel by pixel reference; after,
+ *  it checks that both runs drew the same frames.
+ *
+ *  Usage: spritebench [-n sprites] [-f frames] [-s seed]
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "AEE.h"
+#include "AEESprite.h"
+
+/**
+ * @name SPRITEBENCH_SCREEN_CX, SPRITEBENCH_SCREEN_CY
+ * @memo Emulated screen size.
+ */
+#define SPRITEBENCH_SCREEN_CX ( 176 )
+#define SPRITEBENCH_SCREEN_CY ( 208 )
+
+/**
+ * @name SPRITEBENCH_SPRITES, SPRITEBENCH_TILES
+ * @memo Images in the sprite and tile buffers.
+ */
+#define SPRITEBENCH_SPRITES ( 4 )
+#define SPRITEBENCH_TILES ( 3 )
+
+/**
+ * @name SPRITEBENCH_KEY, SPRITEBENCH_BACKGROUND
+ * @memo Colors.
+ * @doc Sprites are transparent where they're SPRITEBENCH_KEY, the default transparency color. The transform check draws over SPRITEBENCH_BACKGROUND.
+ */
+#define SPRITEBENCH_KEY ( 0xF81F )
+#define SPRITEBENCH_BACKGROUND ( 0x1234 )
+
+/*
+ * Script generator state.
+ */
+static uint32 snSeed = 1;
+
+/*
+ * The applet the emulator would launch; the benchmark has none.
+ */
+int AEEClsCreateInstance( AEECLSID clsID, IShell *pIShell,
+						  IModule *pIModule, void **ppObj )
+{
+	(void)clsID;
+	(void)pIShell;
+	(void)pIModule;
+	*ppObj = NULL;
+	return ECLASSNOTSUPPORT;
+}
+
+/**
+ * Returns a monotonic timestamp.
+ * @return nanoseconds since an arbitrary epoch
+ */
+static uint64 spritebenchNow( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+}
+
+/**
+ * Returns the next pseudorandom number.
+ * @return a number between 0 and 32767
+ */
+static uint32 spritebenchRand( void )
+{
+	snSeed = snSeed * 1103515245 + 12345;
+	return ( snSeed >> 16 ) & 0x7FFF;
+}
+
+/**
+ * Returns a pixel of a bitmap.
+ * @param IDIB *pIDIB: the bitmap's pixels
+ * @param int x, y: the pixel
+ * @return the pixel
+ */
+static uint16 spritebenchPixel( IDIB *pIDIB, int x, int y )
+{
+	return ( (uint16 *)( pIDIB->pBmp + y * pIDIB->nPitch ) )[ x ];
+}
+
+/**
+ * Fills a 16-pixel wide bitmap with test images stacked top to
+ * bottom. No image looks the same rotated or mirrored, so a
+ * wrong transform shows; sprites are key colored outside a disc.
+ * @param IBitmap *pIBitmap: the bitmap
+ * @param int nImages: how many images
+ * @param boolean bSprites: TRUE to draw sprites, FALSE for tiles
+ * @return nothing
+ */
+static void spritebenchPaint( IBitmap *pIBitmap, int nImages,
+							  boolean bSprites )
+{
+	IDIB *pIDIB;
+	uint16 *pRow;
+	int i, r, c, dr, dc;
+
+	if ( IBITMAP_QueryInterface( pIBitmap, AEECLSID_DIB, &pIDIB ) != SUCCESS )
+		return;
+	for ( i = 0; i < nImages; i++ )
+		for ( r = 0; r < 16; r++ )
+		{
+			pRow = (uint16 *)( pIDIB->pBmp + ( i * 16 + r ) * pIDIB->nPitch );
+			for ( c = 0; c < 16; c++ )
+			{
+				dr = 2 * r - 15;
+				dc = 2 * c - 15;
+				if ( bSprites && dr * dr + dc * dc > 15 * 15 )
+					pRow[ c ] = SPRITEBENCH_KEY;
+				else
+					pRow[ c ] = (uint16)( ( ( i * 7 + r ) & 0x1f ) << 11 |
+										  ( ( r * 3 + c ) & 0x3f ) << 5 |
+										  ( ( bSprites ? 0 : 16 ) + c ) );
+			}
+		}
+	IDIB_Release( pIDIB );
+}
+
+/**
+ * Draws a sprite with every transform, clipped at each corner of
+ * the destination, and compares each pixel with where the
+ * transform should have taken it from.
+ * @param ISprite *pISprite: sprite engine, with its buffers set
+ * @param IDIB *pSprites: the sprite images
+ * @param IDIB *pDest: the destination
+ * @return SUCCESS, or EFAILED at the first wrong pixel
+ */
+static int spritebenchCheck( ISprite *pISprite, IDIB *pSprites, IDIB *pDest )
+{
+	static const int16 arPos[][ 2 ] =
+		{ { -5, 3 }, { 30, -11 },
+		  { SPRITEBENCH_SCREEN_CX - 9, 40 },
+		  { 50, SPRITEBENCH_SCREEN_CY - 3 } };
+	AEESpriteCmd arCmds[ 2 ];
+	uint16 *pRow, wSrc, wWant;
+	int t, iPos, x, y, u, v, sr, sc, n = 16, nSize, ox, oy, nRotate;
+	boolean bScale;
+
+	for ( t = 0; t < 8; t++ )
+		for ( iPos = 0; iPos < (int)( sizeof( arPos ) / sizeof( arPos[ 0 ] ) );
+			  iPos++ )
+		{
+			for ( y = 0; y < pDest->cy; y++ )
+			{
+				pRow = (uint16 *)( pDest->pBmp + y * pDest->nPitch );
+				for ( x = 0; x < pDest->cx; x++ )
+					pRow[ x ] = SPRITEBENCH_BACKGROUND;
+			}
+
+			nRotate = t & TRANSFORM_ROTATE_MASK;
+			bScale = ( t & 4 ) != 0;
+			memset( arCmds, 0, sizeof( arCmds ) );
+			arCmds[ 0 ].x = arPos[ iPos ][ 0 ];
+			arCmds[ 0 ].y = arPos[ iPos ][ 1 ];
+			arCmds[ 0 ].unSpriteIndex = 1;
+			arCmds[ 0 ].unSpriteSize = SPRITE_SIZE_16X16;
+			arCmds[ 0 ].unComposite = COMPOSITE_KEYCOLOR;
+			arCmds[ 0 ].unTransform =
+				(uint8)( nRotate | ( bScale ? TRANSFORM_SCALE_2 : 0 ) );
+			arCmds[ 1 ].unSpriteSize = SPRITE_SIZE_END;
+			ISPRITE_DrawSprites( pISprite, arCmds );
+
+			nSize = bScale ? 2 * n : n;
+			ox = arCmds[ 0 ].x - ( bScale ? n / 2 : 0 );
+			oy = arCmds[ 0 ].y - ( bScale ? n / 2 : 0 );
+			for ( y = 0; y < pDest->cy; y++ )
+				for ( x = 0; x < pDest->cx; x++ )
+				{
+					u = x - ox;
+					v = y - oy;
+					wWant = SPRITEBENCH_BACKGROUND;
+					if ( u >= 0 && u < nSize && v >= 0 && v < nSize )
+					{
+						if ( bScale ) { u >>= 1; v >>= 1; }
+						// Where row v, column u of the rotated sprite comes from
+						switch ( nRotate )
+						{
+							case TRANSFORM_ROTATE_90:
+								sr = n - 1 - u; sc = v; break;
+							case TRANSFORM_ROTATE_180:
+								sr = n - 1 - v; sc = n - 1 - u; break;
+							case TRANSFORM_ROTATE_270:
+								sr = u; sc = n - 1 - v; break;
+							default:
+								sr = v; sc = u; break;
+						}
+						wSrc = spritebenchPixel( pSprites, sc, n + sr );
+						if ( wSrc != SPRITEBENCH_KEY ) wWant = wSrc;
+					}
+					if ( spritebenchPixel( pDest, x, y ) != wWant )
+					{
+						fprintf( stderr, "transform 0x%02x at %d,%d: pixel %d,%d "
+								 "is 0x%04x, not 0x%04x\n",
+								 arCmds[ 0 ].unTransform, ox, oy, x, y,
+								 spritebenchPixel( pDest, x, y ), wWant );
+						return EFAILED;
+					}
+				}
+		}
+	return SUCCESS;
+}
+
+/**
+ * Draws the frames and reports how fast. The sprites start in
+ * the same places each run, so every run draws the same frames.
+ * @param const char *pszName: what the run is called
+ * @param ISprite *pISprite: sprite engine, with its buffers set
+ * @param IDIB *pDest: the destination
+ * @param int nSprites: sprites a frame
+ * @param int nFrames: frames to draw
+ * @param uint32 *pnChecksum: returns a checksum of every frame
+ * @return SUCCESS, or ENOMEMORY
+ */
+static int spritebenchRun( const char *pszName, ISprite *pISprite,
+						   IDIB *pDest, int nSprites, int nFrames,
+						   uint32 *pnChecksum )
+{
+	AEESpriteCmd *arCmds;
+	int8 *arVelocity;
+	AEETileMap arMaps[ 2 ];
+	uint16 arMap[ 16 * 16 ];
+	uint64 nTiles = 0, nSpritesTime = 0, nTime;
+	uint32 nChecksum = 2166136261U;
+	uint16 *pRow;
+	uint32 nSeed = snSeed;
+	int i, f, x, y;
+
+	arCmds = (AEESpriteCmd *)calloc( nSprites + 1, sizeof( AEESpriteCmd ) );
+	arVelocity = (int8 *)calloc( nSprites, 2 );
+	if ( !arCmds || !arVelocity )
+	{
+		free( arCmds );
+		free( arVelocity );
+		return ENOMEMORY;
+	}
+
+	for ( i = 0; i < nSprites; i++ )
+	{
+		arCmds[ i ].x = (int16)( spritebenchRand() %
+								 ( SPRITEBENCH_SCREEN_CX + 32 ) ) - 16;
+		arCmds[ i ].y = (int16)( spritebenchRand() %
+								 ( SPRITEBENCH_SCREEN_CY + 32 ) ) - 16;
+		arCmds[ i ].unSpriteIndex = (uint8)( spritebenchRand() %
+											 SPRITEBENCH_SPRITES );
+		arCmds[ i ].unSpriteSize = SPRITE_SIZE_16X16;
+		arCmds[ i ].unLayer = (uint8)( spritebenchRand() % 4 );
+		arCmds[ i ].unTransform = (uint8)( spritebenchRand() &
+										   TRANSFORM_ROTATE_MASK );
+		if ( spritebenchRand() % 8 == 0 )
+			arCmds[ i ].unTransform |= TRANSFORM_SCALE_2;
+		arCmds[ i ].unComposite = spritebenchRand() % 16 ?
+			COMPOSITE_KEYCOLOR : COMPOSITE_OPAQUE;
+		arVelocity[ 2 * i ] = (int8)( spritebenchRand() % 5 ) - 2;
+		arVelocity[ 2 * i + 1 ] = (int8)( spritebenchRand() % 5 ) - 2;
+	}
+	arCmds[ nSprites ].unSpriteSize = SPRITE_SIZE_END;
+
+	for ( i = 0; i < 16 * 16; i++ )
+		arMap[ i ] = (uint16)( spritebenchRand() % SPRITEBENCH_TILES );
+	memset( arMaps, 0, sizeof( arMaps ) );
+	arMaps[ 0 ].pMapArray = arMap;
+	arMaps[ 0 ].w = arMaps[ 0 ].h = MAP_SIZE_16;
+	arMaps[ 0 ].unTileSize = TILE_SIZE_16X16;
+	arMaps[ 0 ].unFlags = MAP_FLAG_WRAP;
+
+	Host_ResetStats();
+	for ( f = 0; f < nFrames; f++ )
+	{
+		for ( i = 0; i < nSprites; i++ )
+		{
+			x = arCmds[ i ].x + arVelocity[ 2 * i ];
+			y = arCmds[ i ].y + arVelocity[ 2 * i + 1 ];
+			if ( x < -16 ) x += SPRITEBENCH_SCREEN_CX + 32;
+			if ( x >= SPRITEBENCH_SCREEN_CX + 16 ) x -= SPRITEBENCH_SCREEN_CX + 32;
+			if ( y < -16 ) y += SPRITEBENCH_SCREEN_CY + 32;
+			if ( y >= SPRITEBENCH_SCREEN_CY + 16 ) y -= SPRITEBENCH_SCREEN_CY + 32;
+			arCmds[ i ].x = (int16)x;
+			arCmds[ i ].y = (int16)y;
+		}
+		arMaps[ 0 ].x = -2 * f;
+		arMaps[ 0 ].y = -f;
+
+		nTime = spritebenchNow();
+		ISPRITE_DrawTiles( pISprite, arMaps );
+		nTiles += spritebenchNow() - nTime;
+		nTime = spritebenchNow();
+		ISPRITE_DrawSprites( pISprite, arCmds );
+		nSpritesTime += spritebenchNow() - nTime;
+
+		for ( y = 0; y < pDest->cy; y++ )
+		{
+			pRow = (uint16 *)( pDest->pBmp + y * pDest->nPitch );
+			for ( x = 0; x < pDest->cx; x++ )
+				nChecksum = ( nChecksum ^ pRow[ x ] ) * 16777619U;
+		}
+	}
+
+	printf( "%-8s %6.3f ms, %8.0f sprites/ms, %5.3f ms tiles/frame, "
+			"%.0f fps, %u sprites drawn\n",
+			pszName, nSpritesTime / 1e6,
+			(double)nSprites * nFrames / ( nSpritesTime / 1e6 ),
+			nTiles / 1e6 / nFrames,
+			nFrames / ( ( nTiles + nSpritesTime ) / 1e9 ),
+			(unsigned)Host_GetStats()->nSpritesDrawn );
+
+	*pnChecksum = nChecksum;
+	snSeed = nSeed;
+	free( arCmds );
+	free( arVelocity );
+	return SUCCESS;
+}
+
+int main( int argc, char **argv )
+{
+	IDisplay *pIDisplay = NULL;
+	IBitmap *pIDevice, *pISprites, *pITiles, *pIDest;
+	IDIB *pSprites, *pDest;
+	ISprite *pISprite;
+	uint32 nVector, nScalar;
+	int nSprites = 2000, nFrames = 200;
+	int i, result;
+
+	for ( i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			nSprites = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-f" ) && i + 1 < argc )
+			nFrames = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-s" ) && i + 1 < argc )
+			snSeed = (uint32)atoi( argv[ ++i ] );
+		else
+		{
+			fprintf( stderr, "usage: %s [-n sprites] [-f frames] [-s seed]\n",
+					 argv[ 0 ] );
+			return 2;
+		}
+	}
+	if ( nSprites <= 0 || nFrames <= 0 ) return 2;
+
+	if ( Host_Init( SPRITEBENCH_SCREEN_CX, SPRITEBENCH_SCREEN_CY, 16 ) != SUCCESS ||
+		 ISHELL_CreateInstance( NULL, AEECLSID_SPRITE, &pISprite ) != SUCCESS ||
+		 IDISPLAY_GetDeviceBitmap( pIDisplay, &pIDevice ) != SUCCESS )
+	{
+		fprintf( stderr, "out of memory\n" );
+		return 1;
+	}
+	if ( IBITMAP_CreateCompatibleBitmap( pIDevice, &pISprites, 16,
+			16 * SPRITEBENCH_SPRITES ) != SUCCESS ||
+		 IBITMAP_CreateCompatibleBitmap( pIDevice, &pITiles, 16,
+			16 * SPRITEBENCH_TILES ) != SUCCESS ||
+		 IBITMAP_CreateCompatibleBitmap( pIDevice, &pIDest,
+			SPRITEBENCH_SCREEN_CX, SPRITEBENCH_SCREEN_CY ) != SUCCESS )
+	{
+		fprintf( stderr, "out of memory\n" );
+		return 1;
+	}
+	IBITMAP_Release( pIDevice );
+
+	spritebenchPaint( pISprites, SPRITEBENCH_SPRITES, TRUE );
+	spritebenchPaint( pITiles, SPRITEBENCH_TILES, FALSE );
+	ISPRITE_SetSpriteBuffer( pISprite, SPRITE_SIZE_16X16, pISprites );
+	ISPRITE_SetTileBuffer( pISprite, TILE_SIZE_16X16, pITiles );
+	ISPRITE_SetDestination( pISprite, pIDest );
+	IBITMAP_QueryInterface( pISprites, AEECLSID_DIB, &pSprites );
+	IBITMAP_QueryInterface( pIDest, AEECLSID_DIB, &pDest );
+
+	// The reference check, both ways
+	for ( i = 0; i < 2; i++ )
+	{
+		Host_SpriteSetScalar( (boolean)i );
+		if ( spritebenchCheck( pISprite, pSprites, pDest ) != SUCCESS )
+		{
+			fprintf( stderr, "%s sprites drawn wrong\n",
+					 i ? "scalar" : "vector" );
+			return 1;
+		}
+	}
+	printf( "screen   %d x %d, %d sprites x %d frames\n",
+			SPRITEBENCH_SCREEN_CX, SPRITEBENCH_SCREEN_CY, nSprites, nFrames );
+	printf( "check    transforms match the reference\n" );
+
+	Host_SpriteSetScalar( FALSE );
+	result = spritebenchRun( "vector", pISprite, pDest, nSprites, nFrames,
+							 &nVector );
+	Host_SpriteSetScalar( TRUE );
+	if ( result == SUCCESS )
+		result = spritebenchRun( "scalar", pISprite, pDest, nSprites, nFrames,
+								 &nScalar );
+	if ( result != SUCCESS )
+	{
+		fprintf( stderr, "out of memory\n" );
+		return 1;
+	}
+	if ( nVector != nScalar )
+	{
+		fprintf( stderr, "vector and scalar frames differ\n" );
+		return 1;
+	}
+
+	IDIB_Release( pSprites );
+	IDIB_Release( pDest );
+	IBITMAP_Release( pISprites );
+	IBITMAP_Release( pITiles );
+	IBITMAP_Release( pIDest );
+	ISPRITE_Release( pISprite );
+	if ( Host_GetStats()->nBytesInUse != 0 )
+		printf( "leaked   %u bytes\n", (unsigned)Host_GetStats()->nBytesInUse );
+	Host_Shutdown();
+	return 0;
+}
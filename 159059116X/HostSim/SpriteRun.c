@@ -0,0 +1,250 @@
+/*
+ *  @name SpriteRun.c
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file runs SpriteSample on the host shell emulator, with
+ *  the host ISprite in HostSprite.c drawing. It launches the real
+ *  applet, which loads its sprites and tiles from the atlas and
+ *  makes its world file, then holds the arrow keys down in
+ *  scripted runs, so the cat walks to the edge of the display and
+ *  the world scrolls under it, while virtual time advances a
+ *  frame at a time. Now and then the applet is suspended and
+ *  resumed.
+ *
+ *  It reports the frames the applet drew and dropped, how its
+ *  chunk cache did, the sprites and tiles drawn and the host time
+ *  per frame, then stops the applet and checks for leaks. The
+ *  applet times its frames by GETUPTIMEMS, so that follows
+ *  virtual time too.
+ *
+ *  Usage: spriterun [-n frames] [-s seed] [-w width] [-h height]
+ *                   [-a atlas] [-v]
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "inc.h"
+
+/**
+ * @name SPRITERUN_SCREEN_CX, SPRITERUN_SCREEN_CY
+ * @memo Emulated screen size.
+ * @doc The display the chunk cache is sized for must be at least this large.
+ */
+#define SPRITERUN_SCREEN_CX ( 176 )
+#define SPRITERUN_SCREEN_CY ( 208 )
+
+/**
+ * @name SPRITERUN_ATLAS
+ * @memo The atlas the applet's resource file holds as RESID_ATLAS.
+ */
+#define SPRITERUN_ATLAS ( "../SpriteSample/resources/atlas.bin" )
+
+/**
+ * @name SPRITERUN_SUSPEND_FRAMES
+ * @memo Frames between suspends.
+ */
+#define SPRITERUN_SUSPEND_FRAMES ( 500 )
+
+/*
+ * Script bookkeeping, kept out of the applet.
+ */
+static struct
+{
+	/// Script generator state
+	uint32 nSeed;
+	/// The arrow key being held, and for how many more frames
+	uint16 wKey;
+	int nHold;
+	/// The applet's frame statistics, summed over each resume
+	CFrameStats frames;
+} sRun;
+
+/**
+ * Returns a monotonic timestamp.
+ * @return nanoseconds since an arbitrary epoch
+ */
+static uint64 runNow( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+}
+
+/**
+ * Returns the next pseudorandom number for the script.
+ * @return a number between 0 and 32767
+ */
+static uint32 runRand( void )
+{
+	sRun.nSeed = sRun.nSeed * 1103515245 + 12345;
+	return ( sRun.nSeed >> 16 ) & 0x7FFF;
+}
+
+/**
+ * Adds the applet's frame statistics to the run's, before a
+ * resume starts them over.
+ * @param CAppPtr pThis: the application
+ * @return nothing
+ */
+static void runSumFrames( CAppPtr pThis )
+{
+	CFrameStatsPtr pStats = &GetAppData( pThis )->frameStats;
+
+	sRun.frames.m_nFrames += pStats->m_nFrames;
+	sRun.frames.m_nDropped += pStats->m_nDropped;
+	sRun.frames.m_nSteps += pStats->m_nSteps;
+	sRun.frames.m_nStepsLost += pStats->m_nStepsLost;
+	sRun.frames.m_nUpdates += pStats->m_nUpdates;
+	sRun.frames.m_nPixels += pStats->m_nPixels;
+}
+
+/**
+ * Runs one frame: presses the arrow key being held, choosing
+ * another when its run is over, then advances virtual time a
+ * frame so the applet's timer draws.
+ * @return nothing
+ */
+static void runStep( void )
+{
+	static const uint16 awKeys[] = { AVK_UP, AVK_DOWN, AVK_LEFT, AVK_RIGHT };
+
+	if ( sRun.nHold-- <= 0 )
+	{
+		sRun.wKey = awKeys[ runRand() % 4 ];
+		sRun.nHold = 20 + runRand() % 60;
+	}
+	Host_SendAppEvent( sRun.nHold % 8 ? EVT_KEY_HELD : EVT_KEY_PRESS,
+					   sRun.wKey, 0 );
+	Host_SendAppEvent( EVT_KEY, sRun.wKey, 0 );
+	Host_Pump();
+	Host_AdvanceTime( FRAME_DELAY_MSECS );
+}
+
+int main( int argc, char **argv )
+{
+	CAppPtr pThis;
+	CAppDataPtr pData;
+	HostStats *pStats;
+	uint64 nTotal;
+	const char *pszAtlas = SPRITERUN_ATLAS;
+	boolean bVerbose = FALSE;
+	int cx = SPRITERUN_SCREEN_CX, cy = SPRITERUN_SCREEN_CY;
+	int nFrames = 2000;
+	int i;
+
+	sRun.nSeed = 1;
+	for ( i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			nFrames = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-s" ) && i + 1 < argc )
+			sRun.nSeed = (uint32)atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-w" ) && i + 1 < argc )
+			cx = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-h" ) && i + 1 < argc )
+			cy = atoi( argv[ ++i ] );
+		else if ( !strcmp( argv[ i ], "-a" ) && i + 1 < argc )
+			pszAtlas = argv[ ++i ];
+		else if ( !strcmp( argv[ i ], "-v" ) )
+			bVerbose = TRUE;
+		else
+		{
+			fprintf( stderr,
+					 "usage: %s [-n frames] [-s seed] [-w width] [-h height] "
+					 "[-a atlas] [-v]\n", argv[ 0 ] );
+			return 2;
+		}
+	}
+	if ( nFrames <= 0 || cx <= 0 || cy <= 0 ) return 2;
+
+	if ( Host_Init( cx, cy, 16 ) != SUCCESS ||
+		 Host_SetResource( RESID_ATLAS, pszAtlas ) != SUCCESS )
+	{
+		fprintf( stderr, "out of memory\n" );
+		return 1;
+	}
+	Host_SetDebugOutput( bVerbose );
+	Host_SetVirtualUpTime( TRUE );
+
+	// Start from nothing: the applet makes its world on launch.
+	remove( WORLD_FILE );
+	remove( STATE_SNAPSHOT_FILE );
+	if ( Host_LaunchApplet( AEECLSID_OURS ) != SUCCESS )
+	{
+		fprintf( stderr, "applet failed to launch\n" );
+		Host_Shutdown();
+		return 1;
+	}
+	Host_Pump();
+	Host_SendAppEvent( EVT_KEY, AVK_SELECT, 0 );
+	Host_Pump();
+	pThis = (CAppPtr)GETAPPINSTANCE();
+	if ( Host_IsAppletClosed() || !State_GetCurrentState( pThis ) )
+	{
+		fprintf( stderr, "applet did not reach its first state\n" );
+		Host_ReleaseApplet();
+		Host_Shutdown();
+		return 1;
+	}
+	Host_ResetStats();
+
+	nTotal = runNow();
+	for ( i = 1; i <= nFrames; i++ )
+	{
+		runStep();
+		if ( i % SPRITERUN_SUSPEND_FRAMES == 0 )
+		{
+			runSumFrames( pThis );
+			Host_SendAppEvent( EVT_APP_SUSPEND, 0, 0 );
+			Host_AdvanceTime( 1000 );
+			Host_SendAppEvent( EVT_APP_RESUME, 0, 0 );
+			Host_Pump();
+		}
+	}
+	nTotal = runNow() - nTotal;
+	runSumFrames( pThis );
+
+	pData = GetAppData( pThis );
+	pStats = Host_GetStats();
+	printf( "frames              %d of %d x %d\n", nFrames, cx, cy );
+	printf( "drawn               %lu, %lu dropped, %lu steps, %lu lost\n",
+			sRun.frames.m_nFrames, sRun.frames.m_nDropped,
+			sRun.frames.m_nSteps, sRun.frames.m_nStepsLost );
+	printf( "updates             %lu, %lu pixels redrawn each\n",
+			sRun.frames.m_nUpdates, sRun.frames.m_nUpdates ?
+			sRun.frames.m_nPixels / sRun.frames.m_nUpdates : 0 );
+	printf( "view                at %ld, %ld\n",
+			(long)pData->nViewX, (long)pData->nViewY );
+	printf( "chunks              %lu read, %lu read ahead, %lu hits, %lu evicted\n",
+			pData->chunks.m_nLoads, pData->chunks.m_nAheadLoads,
+			pData->chunks.m_nHits, pData->chunks.m_nEvictions );
+	printf( "sprites drawn       %llu\n",
+			(unsigned long long)pStats->nSpritesDrawn );
+	printf( "tiles drawn         %llu\n",
+			(unsigned long long)pStats->nTilesDrawn );
+	printf( "pixels pushed       %llu\n",
+			(unsigned long long)pStats->nPixelsPushed );
+	printf( "MALLOC calls        %lu (%.2f/frame)\n",
+			pStats->nMalloc, (double)pStats->nMalloc / nFrames );
+	printf( "heap peak           %lu bytes\n", pStats->nBytesPeak );
+	printf( "host time           %.3f ms, %.1f us/frame\n",
+			nTotal / 1e6, nTotal / 1e3 / nFrames );
+
+	// Have the shell stop the applet while it's suspended.
+	Host_SendAppEvent( EVT_APP_SUSPEND, 0, 0 );
+	Host_ReleaseApplet();
+	if ( Host_GetStats()->nBytesInUse != 0 )
+		printf( "leaked              %lu bytes\n", Host_GetStats()->nBytesInUse );
+
+	Host_Shutdown();
+	remove( WORLD_FILE );
+	remove( STATE_SNAPSHOT_FILE );
+	return 0;
+}
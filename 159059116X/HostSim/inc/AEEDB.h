@@ -0,0 +1,2 @@
+// Host stand-in for the BREW SDK header of the same name.
+#include "AEEHost.h"
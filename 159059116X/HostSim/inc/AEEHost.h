@@ -0,0 +1,790 @@
+/*
+ *  @name AEEHost.h
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides a host-side stand-in for the subset of the
+ *  BREW API used by the application framework, so that the
+ *  framework sources can be compiled and measured on a desktop
+ *  machine without the QUALCOMM SDK. Each AEE*.h header in this
+ *  directory simply includes this file.
+ *
+ *  Only the surface the framework actually calls is provided:
+ *  IShell (timers, events, prefs, resources), IDisplay, IBitmap,
+ *  IDIB, IFileMgr, IDBMgr, and the IMenuCtl, ITextCtl and IStatic 
+ *  controls; AEESprite.h adds ISprite. Interfaces are plain
+ *  structures rather than vtables, and the interface macros map
+ *  directly to the functions in AEEHost.c.
+ */
+#ifndef AEEHOST_H
+#define AEEHOST_H
+
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+/*
+ * Base types
+ */
+typedef unsigned char	boolean;
+typedef unsigned char	byte;
+typedef unsigned char	uint8;
+typedef signed char		int8;
+typedef unsigned short	uint16;
+typedef signed short	int16;
+/*
+ * The framework passes pointers through uint32 values (menu item
+ * data, the pfn_OnError slot in dwParam), which is sound on the
+ * 32-bit handset. On a 64-bit host uint32 is widened to hold a
+ * pointer; nothing in the framework depends on it wrapping at 2^32.
+ */
+typedef unsigned long	uint32;
+typedef signed int		int32;
+typedef unsigned long long	uint64;
+typedef signed long long	int64;
+typedef uint16			AECHAR;
+typedef uint16			AEEEvent;
+typedef uint32			AEECLSID;
+typedef uint32			RGBVAL;
+
+#ifndef TRUE
+#define TRUE	1
+#define FALSE	0
+#endif
+#ifndef NULL
+#define NULL	((void *)0)
+#endif
+
+#define MAX_FILE_NAME	64
+#define MAX_UINT32		0xFFFFFFFFUL
+
+/*
+ * Error codes
+ */
+#define SUCCESS				0
+#define AEE_SUCCESS			0
+#define EFAILED				1
+#define ENOMEMORY			2
+#define ECLASSNOTSUPPORT	3
+#define EBADPARM			14
+#define EBADCLASS			10
+#define EUNSUPPORTED		20
+#define EITEMBUSY			32
+#define EFILEEXISTS			0x100
+#define EFILENOEXISTS		0x101
+
+/*
+ * Events
+ */
+#define EVT_APP_START			0x0000
+#define EVT_APP_STOP			0x0001
+#define EVT_APP_SUSPEND			0x0002
+#define EVT_APP_RESUME			0x0003
+#define EVT_APP_CONFIG			0x0004
+#define EVT_APP_HIDDEN_CONFIG	0x0005
+#define EVT_APP_BROWSE_URL		0x0006
+#define EVT_APP_BROWSE_FILE		0x0007
+#define EVT_APP_MESSAGE			0x0008
+#define EVT_ALARM				0x0009
+#define EVT_NOTIFY				0x000A
+#define EVT_SUSPEND				EVT_APP_SUSPEND
+#define EVT_RESUME				EVT_APP_RESUME
+#define EVT_KEY					0x0100
+#define EVT_KEY_PRESS			0x0101
+#define EVT_KEY_RELEASE			0x0102
+#define EVT_KEY_HELD			0x0103
+#define EVT_CHAR				0x0104
+#define EVT_COMMAND				0x0200
+#define EVT_CTL_TAB				0x0201
+#define EVT_CTL_SET_TITLE		0x0202
+#define EVT_CTL_SET_TEXT		0x0203
+#define EVT_COPYRIGHT_END		0x0206
+#define EVT_USER				0x7000
+
+/*
+ * Virtual key codes
+ */
+#define AVK_UNDEFINED	0xE010
+#define AVK_FIRST		AVK_UNDEFINED
+#define AVK_0			0xE021
+#define AVK_1			0xE022
+#define AVK_2			0xE023
+#define AVK_3			0xE024
+#define AVK_4			0xE025
+#define AVK_5			0xE026
+#define AVK_6			0xE027
+#define AVK_7			0xE028
+#define AVK_8			0xE029
+#define AVK_9			0xE02A
+#define AVK_STAR		0xE02B
+#define AVK_POUND		0xE02C
+#define AVK_POWER		0xE02D
+#define AVK_END			0xE02E
+#define AVK_SEND		0xE02F
+#define AVK_CLR			0xE030
+#define AVK_UP			0xE031
+#define AVK_DOWN		0xE032
+#define AVK_LEFT		0xE033
+#define AVK_RIGHT		0xE034
+#define AVK_SELECT		0xE035
+
+/*
+ * Class IDs
+ */
+#define AEECLSID_SHELL			0x01001001
+#define AEECLSID_DISPLAY		0x01001002
+#define AEECLSID_MENUCTL		0x01001008
+#define AEECLSID_SOFTKEYCTL		0x01001009
+#define AEECLSID_LISTCTL		0x0100100A
+#define AEECLSID_TEXTCTL		0x0100100B
+#define AEECLSID_STATIC			0x0100100C
+#define AEECLSID_CLOCKCTL		0x0100100D
+#define AEECLSID_DBMGR			0x01001020
+#define AEECLSID_FILEMGR		0x01001021
+#define AEECLSID_HEAP			0x01001022
+#define AEECLSID_DIB			0x01001030
+#define AEECLSID_SPRITE			0x01001031
+#define AEECLSID_SOUND			0x01001040
+#define AEECLSID_SOUNDPLAYER	0x01001041
+
+/*
+ * Geometry and display
+ */
+typedef struct _AEERect
+{
+	int16 x, y, dx, dy;
+} AEERect;
+
+#define SETAEERECT( prc, l, t, w, h ) \
+	( (prc)->x = (int16)(l), (prc)->y = (int16)(t), \
+	  (prc)->dx = (int16)(w), (prc)->dy = (int16)(h) )
+
+typedef enum
+{
+	AEE_FONT_NORMAL = 0,
+	AEE_FONT_BOLD,
+	AEE_FONT_LARGE
+} AEEFont;
+
+typedef enum
+{
+	AEE_RO_COPY = 0,
+	AEE_RO_TRANSPARENT
+} AEERasterOp;
+
+typedef uint32 NativeColor;
+
+typedef struct _AEEBitmapInfo
+{
+	uint32 cx;
+	uint32 cy;
+	uint32 nDepth;
+} AEEBitmapInfo;
+
+#define RGB_WHITE	0xFFFFFF00
+#define RGB_BLACK	0x00000000
+
+typedef struct _AEEDeviceInfo
+{
+	uint16 cxScreen;
+	uint16 cyScreen;
+	uint16 cxAltScreen;
+	uint16 cyAltScreen;
+	uint16 cxScrollBar;
+	uint16 wEncoding;
+	uint16 wMenuTextScroll;
+	uint16 nColorDepth;
+	uint32 wMenuImageDelay;
+	uint32 dwRAM;
+	uint32 dwStructSize;
+} AEEDeviceInfo;
+
+/*
+ * Control properties
+ */
+#define MP_UNDERLINE_TITLE		0x00000001
+#define MP_NO_ARROWS			0x00000002
+#define TP_MULTILINE			0x00000001
+#define TP_FRAME				0x00000002
+#define TP_T9_MODE				0x00000004
+#define TP_PASSWORD				0x00000008
+#define ST_CENTERTEXT			0x00000001
+#define ST_CENTERTITLE			0x00000002
+#define ST_NOSCROLL				0x00000004
+
+typedef struct _CtlAddItem
+{
+	const AECHAR *pText;
+	void *pImage;
+	const char *pszResImage;
+	const char *pszResText;
+	uint16 wText;
+	uint16 wFont;
+	uint16 wImage;
+	uint16 wItemID;
+	uint32 dwData;
+} CtlAddItem;
+
+/*
+ * Interfaces. Every framework control is an IControl; the
+ * specific control types are synonyms so that the casts the
+ * framework performs between them are harmless.
+ */
+typedef struct IShell		IShell;
+typedef struct IDisplay		IDisplay;
+typedef struct IModule		IModule;
+typedef struct IApplet		IApplet;
+typedef struct IImage		IImage;
+typedef struct IBitmap		IBitmap;
+typedef struct IControl		IControl;
+typedef struct IControl		IMenuCtl;
+typedef struct IControl		ITextCtl;
+typedef struct IControl		IStatic;
+typedef struct IHeap		IHeap;
+typedef struct IFileMgr		IFileMgr;
+typedef struct IFile		IFile;
+
+typedef void (*PFNNOTIFY)( void *pData );
+typedef boolean (*AEEHANDLER)( void *pData, AEEEvent evt,
+							   uint16 wParam, uint32 dwParam );
+typedef void (*PFNFREEAPPDATA)( IApplet *po );
+
+/**
+ * @name AEEApplet
+ * @memo Applet base structure.
+ * @doc Mirrors the layout the BREW AEEAppGen helper gives every applet, without the vtable.
+ */
+typedef struct _AEEApplet
+{
+	IShell *m_pIShell;
+	IModule *m_pIModule;
+	IDisplay *m_pIDisplay;
+	AEECLSID clsID;
+	uint32 m_nRefs;
+	AEEHANDLER pAppHandleEvent;
+	PFNFREEAPPDATA pFreeAppData;
+} AEEApplet;
+
+/*
+ * Database types.
+ */
+typedef enum
+{
+	AEEDB_FT_NONE = 0,
+	AEEDB_FT_BYTE,
+	AEEDB_FT_WORD,
+	AEEDB_FT_DWORD,
+	AEEDB_FT_STRING,
+	AEEDB_FT_BINARY,
+	AEEDB_FT_PHONE,
+	AEEDB_FT_BITMAP
+} AEEDBFieldType;
+
+typedef int AEEDBFieldName;
+
+typedef struct _AEEDBField
+{
+	AEEDBFieldType fType;
+	AEEDBFieldName fName;
+	uint16 wDataLen;
+	void *pBuffer;
+} AEEDBField;
+
+typedef struct IDBMgr		IDBMgr;
+typedef struct IDatabase	IDatabase;
+typedef struct IDBRecord	IDBRecord;
+
+/*
+ * Standard library
+ */
+void *Host_Malloc( uint32 nSize );
+void Host_Free( void *p );
+void *Host_Realloc( void *p, uint32 nSize );
+void Host_DbgPrintf( const char *pszFormat, ... );
+uint32 Host_GetTimeMS( void );
+uint32 Host_GetUpTimeMS( void );
+void Host_GetRand( byte *pDest, int nSize );
+IApplet *Host_GetAppInstance( void );
+
+#define MALLOC( n )				Host_Malloc( (uint32)(n) )
+#define FREE( p )				Host_Free( (void *)(p) )
+#define REALLOC( p, n )			Host_Realloc( (void *)(p), (uint32)(n) )
+#define MEMSET( p, c, n )		memset( (p), (c), (n) )
+#define MEMCPY( d, s, n )		memcpy( (d), (s), (n) )
+#define MEMMOVE( d, s, n )		memmove( (d), (s), (n) )
+#define MEMCMP( a, b, n )		memcmp( (a), (b), (n) )
+#define STRLEN( s )				strlen( s )
+#define STRCPY( d, s )			strcpy( (d), (s) )
+#define STRCAT( d, s )			strcat( (d), (s) )
+#define STRCMP( a, b )			strcmp( (a), (b) )
+#define SPRINTF					sprintf
+#define SNPRINTF				snprintf
+#define DBGPRINTF				Host_DbgPrintf
+#define GETTIMEMS()				Host_GetTimeMS()
+#define GETUPTIMEMS()			Host_GetUpTimeMS()
+#define GETRAND( p, n )			Host_GetRand( (p), (n) )
+#define GETAPPINSTANCE()		Host_GetAppInstance()
+#define WSTRSIZE( p )			( ( Host_WStrLen( p ) + 1 ) * sizeof( AECHAR ) )
+#define WSTRLEN( p )			Host_WStrLen( p )
+
+int Host_WStrLen( const AECHAR *p );
+
+/*
+ * Applet helper
+ */
+boolean AEEApplet_New( int16 nIn, AEECLSID clsID, IShell *pIShell,
+					   IModule *pIModule, IApplet **ppobj,
+					   AEEHANDLER pAppHandleEvent,
+					   PFNFREEAPPDATA pFreeAppData );
+
+/*
+ * IShell
+ */
+int Host_ShellCreateInstance( IShell *p, AEECLSID cls, void **ppObj );
+void Host_ShellGetDeviceInfo( IShell *p, AEEDeviceInfo *pdi );
+int Host_ShellGetPrefs( IShell *p, AEECLSID cls, uint16 wVer,
+						void *pCfg, uint16 nSize );
+int Host_ShellSetPrefs( IShell *p, AEECLSID cls, uint16 wVer,
+						void *pCfg, uint16 nSize );
+int Host_ShellSetTimer( IShell *p, int32 dwMSecs,
+						PFNNOTIFY pfn, void *pUser );
+int Host_ShellCancelTimer( IShell *p, PFNNOTIFY pfn, void *pUser );
+boolean Host_ShellPostEvent( IShell *p, AEECLSID cls, AEEEvent eCode,
+							 uint16 wParam, uint32 dwParam );
+boolean Host_ShellSendEvent( IShell *p, AEECLSID cls, AEEEvent eCode,
+							 uint16 wParam, uint32 dwParam );
+IImage *Host_ShellLoadResImage( IShell *p, const char *pszFile,
+								uint16 nID );
+IBitmap *Host_ShellLoadResBitmap( IShell *p, const char *pszFile,
+								  uint16 nID );
+int Host_ShellLoadResString( IShell *p, const char *pszFile, uint16 nID,
+							 AECHAR *pBuff, int nSize );
+int Host_ShellCloseApplet( IShell *p, boolean bReturnToIdle );
+uint32 Host_ShellGetSeconds( IShell *p );
+
+/**
+ * @name ResType
+ * @memo Resource types.
+ * @doc Image resources start with a byte giving the offset to the image's data, as on the handset. Only images registered with Host_SetResource can be loaded.
+ */
+typedef enum
+{
+	RESTYPE_STRING = 0x5001,
+	RESTYPE_IMAGE = 0x5006
+} ResType;
+
+void *Host_ShellLoadResDataEx( IShell *p, const char *pszFile, uint16 nID,
+							   ResType nType, void *pBuff, uint32 *pnSize );
+void Host_ShellFreeResData( IShell *p, void *pData );
+
+#define ISHELL_CreateInstance( p, c, pp ) \
+	Host_ShellCreateInstance( p, c, (void **)(pp) )
+#define ISHELL_GetDeviceInfo( p, pdi )	Host_ShellGetDeviceInfo( p, pdi )
+#define ISHELL_GetPrefs( p, c, v, pc, n ) \
+	Host_ShellGetPrefs( p, c, v, pc, n )
+#define ISHELL_SetPrefs( p, c, v, pc, n ) \
+	Host_ShellSetPrefs( p, c, v, pc, n )
+#define ISHELL_SetTimer( p, ms, pfn, pu ) \
+	Host_ShellSetTimer( p, ms, (PFNNOTIFY)(pfn), (void *)(pu) )
+#define ISHELL_CancelTimer( p, pfn, pu ) \
+	Host_ShellCancelTimer( p, (PFNNOTIFY)(pfn), (void *)(pu) )
+#define ISHELL_PostEvent( p, c, e, w, dw ) \
+	Host_ShellPostEvent( p, c, e, w, dw )
+#define ISHELL_SendEvent( p, c, e, w, dw ) \
+	Host_ShellSendEvent( p, c, e, w, dw )
+#define ISHELL_LoadResImage( p, f, n )	Host_ShellLoadResImage( p, f, n )
+#define ISHELL_LoadResBitmap( p, f, n )	Host_ShellLoadResBitmap( p, f, n )
+#define ISHELL_LoadResString( p, f, n, b, s ) \
+	Host_ShellLoadResString( p, f, n, b, s )
+#define ISHELL_CloseApplet( p, b )		Host_ShellCloseApplet( p, b )
+#define ISHELL_GetSeconds( p )			Host_ShellGetSeconds( p )
+#define ISHELL_LoadResDataEx( p, f, n, t, pb, pn ) \
+	Host_ShellLoadResDataEx( p, f, n, t, pb, pn )
+#define ISHELL_LoadResData( p, f, n, t ) \
+	Host_ShellLoadResDataEx( p, f, n, t, NULL, NULL )
+#define ISHELL_FreeResData( p, pd )		Host_ShellFreeResData( p, pd )
+
+/*
+ * IDisplay and IImage
+ */
+void Host_DisplayClearScreen( IDisplay *p );
+void Host_DisplayUpdate( IDisplay *p );
+void Host_DisplayEraseRect( IDisplay *p, const AEERect *prc );
+int Host_DisplayGetFontMetrics( IDisplay *p, AEEFont nFont,
+								int *pnAscent, int *pnDescent );
+int Host_DisplayDrawText( IDisplay *p, AEEFont nFont,
+						  const AECHAR *pcText, int nChars,
+						  int x, int y, const AEERect *prcBackground,
+						  uint32 dwFlags );
+void Host_ImageDraw( IImage *p, int x, int y );
+uint32 Host_ImageRelease( IImage *p );
+
+#define IDISPLAY_ClearScreen( p )		Host_DisplayClearScreen( p )
+#define IDISPLAY_Update( p )			Host_DisplayUpdate( p )
+#define IDISPLAY_EraseRect( p, prc )	Host_DisplayEraseRect( p, prc )
+#define IDISPLAY_GetFontMetrics( p, f, pa, pd ) \
+	Host_DisplayGetFontMetrics( p, f, pa, pd )
+#define IDISPLAY_DrawText( p, f, t, n, x, y, prc, fl ) \
+	Host_DisplayDrawText( p, f, t, n, x, y, prc, fl )
+#define IIMAGE_Draw( p, x, y )			Host_ImageDraw( p, x, y )
+#define IIMAGE_Release( p )				Host_ImageRelease( p )
+
+/*
+ * IBitmap. Bitmaps are 16 bits per pixel, like the emulated
+ * display; the device bitmap draws straight into the display.
+ */
+int Host_DisplayGetDeviceBitmap( IDisplay *p, IBitmap **ppIBitmap );
+int Host_BitmapCreateCompatibleBitmap( IBitmap *p, IBitmap **ppIBitmap,
+									   uint16 w, uint16 h );
+int Host_BitmapBltIn( IBitmap *p, int xDst, int yDst, int dx, int dy,
+					  IBitmap *pSrc, int xSrc, int ySrc,
+					  AEERasterOp rop );
+int Host_BitmapGetInfo( IBitmap *p, AEEBitmapInfo *pInfo, int nSize );
+int Host_BitmapSetTransparencyColor( IBitmap *p, NativeColor color );
+NativeColor Host_BitmapRGBToNative( IBitmap *p, RGBVAL rgb );
+int Host_BitmapFillRect( IBitmap *p, const AEERect *prc, 
+						 NativeColor color, AEERasterOp rop );
+uint32 Host_BitmapAddRef( IBitmap *p );
+uint32 Host_BitmapRelease( IBitmap *p );
+
+#define IDISPLAY_GetDeviceBitmap( p, pp ) \
+	Host_DisplayGetDeviceBitmap( p, pp )
+#define IBITMAP_CreateCompatibleBitmap( p, pp, w, h ) \
+	Host_BitmapCreateCompatibleBitmap( p, pp, w, h )
+#define IBITMAP_BltIn( p, x, y, dx, dy, ps, xs, ys, r ) \
+	Host_BitmapBltIn( p, x, y, dx, dy, ps, xs, ys, r )
+#define IBITMAP_GetInfo( p, pi, n )		Host_BitmapGetInfo( p, pi, n )
+#define IBITMAP_SetTransparencyColor( p, c ) \
+	Host_BitmapSetTransparencyColor( p, c )
+#define IBITMAP_RGBToNative( p, rgb )	Host_BitmapRGBToNative( p, rgb )
+#define IBITMAP_FillRect( p, prc, c, r ) Host_BitmapFillRect( p, prc, c, r )
+#define IBITMAP_AddRef( p )				Host_BitmapAddRef( p )
+#define IBITMAP_Release( p )			Host_BitmapRelease( p )
+
+/**
+ * @name IDIB
+ * @memo A bitmap's pixels.
+ * @doc IBITMAP_QueryInterface with AEECLSID_DIB returns the bitmap's pixels, as on the handset; the IDIB holds a reference to its bitmap until IDIB_Release. Host bitmaps are always 5-6-5.
+ */
+#define IDIB_COLORSCHEME_565	16
+typedef struct IDIB
+{
+	/// The bitmap these are the pixels of
+	IBitmap *pIBitmap;
+	/// The pixels, row by row, nPitch bytes apart
+	byte *pBmp;
+	/// The bitmap's transparency color
+	NativeColor ncTransparent;
+	uint16 cx, cy;
+	int16 nPitch;
+	uint8 nDepth;
+	uint8 nColorScheme;
+} IDIB;
+
+int Host_BitmapQueryInterface( IBitmap *p, AEECLSID cls, void **ppObj );
+uint32 Host_DIBRelease( IDIB *p );
+
+#define IBITMAP_QueryInterface( p, c, pp ) \
+	Host_BitmapQueryInterface( p, c, (void **)(pp) )
+#define IDIB_Release( p )				Host_DIBRelease( p )
+
+/*
+ * IControl, IMenuCtl, ITextCtl and IStatic
+ */
+uint32 Host_ControlRelease( IControl *p );
+boolean Host_ControlHandleEvent( IControl *p, AEEEvent eCode,
+								 uint16 wParam, uint32 dwParam );
+boolean Host_ControlRedraw( IControl *p );
+void Host_ControlSetActive( IControl *p, boolean bActive );
+boolean Host_ControlIsActive( IControl *p );
+void Host_ControlSetRect( IControl *p, const AEERect *prc );
+void Host_ControlGetRect( IControl *p, AEERect *prc );
+void Host_ControlSetProperties( IControl *p, uint32 dwProps );
+uint32 Host_ControlGetProperties( IControl *p );
+void Host_ControlReset( IControl *p );
+
+boolean Host_MenuAddItemEx( IMenuCtl *p, CtlAddItem *pai );
+boolean Host_MenuGetItemData( IMenuCtl *p, uint16 wID, uint32 *pdwData );
+int Host_MenuGetItemCount( IMenuCtl *p );
+uint16 Host_MenuGetSel( IMenuCtl *p );
+boolean Host_MenuSetTitle( IMenuCtl *p, const char *pszResFile,
+						   uint16 wResID, AECHAR *pText );
+
+boolean Host_TextSetText( ITextCtl *p, const AECHAR *pszText, int cch );
+AECHAR *Host_TextGetTextPtr( ITextCtl *p );
+boolean Host_TextSetTitle( ITextCtl *p, const char *pszResFile,
+						   uint16 wResID, AECHAR *pText );
+void Host_TextSetSoftKeyMenu( ITextCtl *p, IMenuCtl *pm );
+
+boolean Host_StaticSetText( IStatic *p, AECHAR *pTitle, AECHAR *pText,
+							AEEFont fntTitle, AEEFont fntText );
+
+#define ICONTROL_Release( p )		Host_ControlRelease( (IControl *)(p) )
+#define ICONTROL_HandleEvent( p, e, w, dw ) \
+	Host_ControlHandleEvent( (IControl *)(p), e, w, dw )
+#define ICONTROL_Redraw( p )		Host_ControlRedraw( (IControl *)(p) )
+#define ICONTROL_SetActive( p, b )	Host_ControlSetActive( (IControl *)(p), b )
+#define ICONTROL_IsActive( p )		Host_ControlIsActive( (IControl *)(p) )
+#define ICONTROL_SetRect( p, prc )	Host_ControlSetRect( (IControl *)(p), prc )
+#define ICONTROL_GetRect( p, prc )	Host_ControlGetRect( (IControl *)(p), prc )
+#define ICONTROL_SetProperties( p, d ) \
+	Host_ControlSetProperties( (IControl *)(p), d )
+#define ICONTROL_GetProperties( p ) \
+	Host_ControlGetProperties( (IControl *)(p) )
+#define ICONTROL_Reset( p )			Host_ControlReset( (IControl *)(p) )
+
+#define IMENUCTL_Release( p )		ICONTROL_Release( p )
+#define IMENUCTL_HandleEvent( p, e, w, dw ) ICONTROL_HandleEvent( p, e, w, dw )
+#define IMENUCTL_Redraw( p )		ICONTROL_Redraw( p )
+#define IMENUCTL_SetActive( p, b )	ICONTROL_SetActive( p, b )
+#define IMENUCTL_IsActive( p )		ICONTROL_IsActive( p )
+#define IMENUCTL_SetRect( p, prc )	ICONTROL_SetRect( p, prc )
+#define IMENUCTL_GetRect( p, prc )	ICONTROL_GetRect( p, prc )
+#define IMENUCTL_SetProperties( p, d ) ICONTROL_SetProperties( p, d )
+#define IMENUCTL_Reset( p )			ICONTROL_Reset( p )
+#define IMENUCTL_AddItemEx( p, pai ) Host_MenuAddItemEx( p, pai )
+#define IMENUCTL_GetItemData( p, w, pd ) Host_MenuGetItemData( p, w, pd )
+#define IMENUCTL_GetItemCount( p )	Host_MenuGetItemCount( p )
+#define IMENUCTL_GetSel( p )		Host_MenuGetSel( p )
+#define IMENUCTL_SetTitle( p, f, id, t ) Host_MenuSetTitle( p, f, id, t )
+
+#define ITEXTCTL_Release( p )		ICONTROL_Release( p )
+#define ITEXTCTL_HandleEvent( p, e, w, dw ) ICONTROL_HandleEvent( p, e, w, dw )
+#define ITEXTCTL_Redraw( p )		ICONTROL_Redraw( p )
+#define ITEXTCTL_SetActive( p, b )	ICONTROL_SetActive( p, b )
+#define ITEXTCTL_IsActive( p )		ICONTROL_IsActive( p )
+#define ITEXTCTL_SetRect( p, prc )	ICONTROL_SetRect( p, prc )
+#define ITEXTCTL_GetRect( p, prc )	ICONTROL_GetRect( p, prc )
+#define ITEXTCTL_SetProperties( p, d ) ICONTROL_SetProperties( p, d )
+#define ITEXTCTL_Reset( p )			ICONTROL_Reset( p )
+#define ITEXTCTL_SetText( p, t, n )	Host_TextSetText( p, t, n )
+#define ITEXTCTL_GetTextPtr( p )	Host_TextGetTextPtr( p )
+#define ITEXTCTL_SetTitle( p, f, id, t ) Host_TextSetTitle( p, f, id, t )
+#define ITEXTCTL_SetSoftKeyMenu( p, pm ) Host_TextSetSoftKeyMenu( p, pm )
+
+#define ISTATIC_Release( p )		ICONTROL_Release( p )
+#define ISTATIC_HandleEvent( p, e, w, dw ) ICONTROL_HandleEvent( p, e, w, dw )
+#define ISTATIC_Redraw( p )			ICONTROL_Redraw( p )
+#define ISTATIC_SetActive( p, b )	ICONTROL_SetActive( p, b )
+#define ISTATIC_IsActive( p )		ICONTROL_IsActive( p )
+#define ISTATIC_SetRect( p, prc )	ICONTROL_SetRect( p, prc )
+#define ISTATIC_GetRect( p, prc )	ICONTROL_GetRect( p, prc )
+#define ISTATIC_SetProperties( p, d ) ICONTROL_SetProperties( p, d )
+#define ISTATIC_Reset( p )			ICONTROL_Reset( p )
+#define ISTATIC_SetText( p, t, x, ft, fx ) Host_StaticSetText( p, t, x, ft, fx )
+
+/*
+ * ISound and ISoundPlayer. The emulated handset has no sound, so
+ * ISHELL_CreateInstance refuses AEECLSID_SOUND and 
+ * AEECLSID_SOUNDPLAYER; applications carry on without them.
+ */
+typedef struct ISound		ISound;
+typedef struct ISoundPlayer	ISoundPlayer;
+
+typedef enum
+{
+	AEE_TONE_REORDER_TONE = 0x1b
+} AEESoundTone;
+
+typedef struct _AEESoundToneData
+{
+	AEESoundTone eTone;
+	uint16 wDuration;
+} AEESoundToneData;
+
+typedef enum
+{
+	SDT_NONE = 0,
+	SDT_FILE,
+	SDT_BUFFER
+} AEESoundPlayerInput;
+
+typedef struct _AEESoundPlayerInfo
+{
+	AEESoundPlayerInput eInput;
+	void *pData;
+	uint32 dwSize;
+} AEESoundPlayerInfo;
+
+typedef enum
+{
+	AEE_SOUNDPLAYER_PLAY_CB = 1
+} AEESoundPlayerCmd;
+
+typedef enum
+{
+	AEE_SOUNDPLAYER_SUCCESS = 0,
+	AEE_SOUNDPLAYER_DONE = 2
+} AEESoundPlayerStatus;
+
+typedef void (*PFNSOUNDPLAYERSTATUS)( void *pUser, AEESoundPlayerCmd eCmd,
+									  AEESoundPlayerStatus eStatus,
+									  uint32 dwParam );
+
+void Host_SoundPlayTone( ISound *p, AEESoundToneData tone );
+void Host_SoundVibrate( ISound *p, uint16 wDuration );
+uint32 Host_SoundRelease( ISound *p );
+int Host_SoundPlayerSetInfo( ISoundPlayer *p, AEESoundPlayerInfo *pInfo );
+void Host_SoundPlayerRegisterNotify( ISoundPlayer *p, 
+									 PFNSOUNDPLAYERSTATUS pfn, void *pUser );
+void Host_SoundPlayerPlay( ISoundPlayer *p );
+uint32 Host_SoundPlayerRelease( ISoundPlayer *p );
+
+#define ISOUND_PlayTone( p, t )			Host_SoundPlayTone( p, t )
+#define ISOUND_Vibrate( p, n )			Host_SoundVibrate( p, n )
+#define ISOUND_Release( p )				Host_SoundRelease( p )
+#define ISOUNDPLAYER_SetInfo( p, pi )	Host_SoundPlayerSetInfo( p, pi )
+#define ISOUNDPLAYER_RegisterNotify( p, pfn, pu ) \
+	Host_SoundPlayerRegisterNotify( p, (PFNSOUNDPLAYERSTATUS)(pfn), \
+									(void *)(pu) )
+#define ISOUNDPLAYER_Play( p )			Host_SoundPlayerPlay( p )
+#define ISOUNDPLAYER_Release( p )		Host_SoundPlayerRelease( p )
+
+/*
+ * IHeap
+ */
+uint32 Host_HeapGetMemStats( IHeap *p );
+uint32 Host_HeapRelease( IHeap *p );
+
+#define IHEAP_GetMemStats( p )		Host_HeapGetMemStats( p )
+#define IHEAP_Release( p )			Host_HeapRelease( p )
+
+/*
+ * IFileMgr and IFile. Files live in the host's current directory.
+ */
+#define _OFM_READ		0x0001
+#define _OFM_READWRITE	0x0002
+#define _OFM_CREATE		0x0004
+#define _OFM_APPEND		0x0008
+
+typedef enum
+{
+	_SEEK_START,
+	_SEEK_END,
+	_SEEK_CURRENT
+} FileSeekType;
+
+IFile *Host_FileMgrOpenFile( IFileMgr *p, const char *pszFile, int mode );
+int Host_FileMgrTest( IFileMgr *p, const char *pszName );
+int Host_FileMgrRemove( IFileMgr *p, const char *pszName );
+uint32 Host_FileMgrRelease( IFileMgr *p );
+int32 Host_FileRead( IFile *p, void *pDest, uint32 nSize );
+uint32 Host_FileWrite( IFile *p, const void *pSrc, uint32 nSize );
+int Host_FileSeek( IFile *p, FileSeekType type, int32 nPos );
+int Host_FileTruncate( IFile *p, uint32 nPos );
+uint32 Host_FileRelease( IFile *p );
+
+#define IFILEMGR_OpenFile( p, f, m )	Host_FileMgrOpenFile( p, f, m )
+#define IFILEMGR_Test( p, f )			Host_FileMgrTest( p, f )
+#define IFILEMGR_Remove( p, f )			Host_FileMgrRemove( p, f )
+#define IFILEMGR_Release( p )			Host_FileMgrRelease( p )
+#define IFILE_Read( p, d, n )			Host_FileRead( p, d, n )
+#define IFILE_Write( p, s, n )			Host_FileWrite( p, s, n )
+#define IFILE_Seek( p, t, n )			Host_FileSeek( p, t, n )
+#define IFILE_Truncate( p, n )			Host_FileTruncate( p, n )
+#define IFILE_Release( p )				Host_FileRelease( p )
+
+/*
+ * IDBMgr, IDatabase and IDBRecord. Databases are kept in host
+ * memory, and a record's ID is its position in the database.
+ */
+IDatabase *Host_DBMgrOpenDatabase( IDBMgr *p, const char *pszFile, boolean bCreate );
+int Host_DBMgrRemove( IDBMgr *p, const char *pszFile );
+uint32 Host_DBMgrRelease( IDBMgr *p );
+uint32 Host_DatabaseGetRecordCount( IDatabase *p );
+void Host_DatabaseReset( IDatabase *p );
+IDBRecord *Host_DatabaseGetNextRecord( IDatabase *p );
+IDBRecord *Host_DatabaseGetRecordByID( IDatabase *p, uint16 wID );
+IDBRecord *Host_DatabaseCreateRecord( IDatabase *p, AEEDBField *arFields, int nFields );
+uint32 Host_DatabaseRelease( IDatabase *p );
+uint16 Host_DBRecordGetID( IDBRecord *p );
+void Host_DBRecordReset( IDBRecord *p );
+AEEDBFieldType Host_DBRecordNextField( IDBRecord *p, AEEDBFieldName *pName,
+									   uint16 *pnLen );
+byte *Host_DBRecordGetField( IDBRecord *p, AEEDBFieldName *pName,
+							 AEEDBFieldType *pType, uint16 *pnLen );
+int Host_DBRecordUpdate( IDBRecord *p, AEEDBField *arFields, int nFields );
+int Host_DBRecordRemove( IDBRecord *p );
+uint32 Host_DBRecordRelease( IDBRecord *p );
+
+#define IDBMGR_OpenDatabase( p, f, c )		Host_DBMgrOpenDatabase( p, f, c )
+#define IDBMGR_Remove( p, f )				Host_DBMgrRemove( p, f )
+#define IDBMGR_Release( p )					Host_DBMgrRelease( p )
+#define IDATABASE_GetRecordCount( p )		Host_DatabaseGetRecordCount( p )
+#define IDATABASE_Reset( p )				Host_DatabaseReset( p )
+#define IDATABASE_GetNextRecord( p )		Host_DatabaseGetNextRecord( p )
+#define IDATABASE_GetRecordByID( p, id )	Host_DatabaseGetRecordByID( p, id )
+#define IDATABASE_CreateRecord( p, f, n )	Host_DatabaseCreateRecord( p, f, n )
+#define IDATABASE_Release( p )				Host_DatabaseRelease( p )
+#define IDBRECORD_GetID( p )				Host_DBRecordGetID( p )
+#define IDBRECORD_Reset( p )				Host_DBRecordReset( p )
+#define IDBRECORD_NextField( p, n, l )		Host_DBRecordNextField( p, n, l )
+#define IDBRECORD_GetField( p, n, t, l )	Host_DBRecordGetField( p, n, t, l )
+#define IDBRECORD_Update( p, f, n )			Host_DBRecordUpdate( p, f, n )
+#define IDBRECORD_Remove( p )				Host_DBRecordRemove( p )
+#define IDBRECORD_Release( p )				Host_DBRecordRelease( p )
+
+/*
+ * Harness control. These are not part of BREW; the benchmark
+ * driver uses them to play the role of the handset's event pump.
+ */
+
+/**
+ * @name HostStats
+ * @memo Shell emulator counters.
+ * @doc Counts the calls the framework made into the emulated shell.
+ */
+typedef struct _HostStats
+{
+	/// Calls to MALLOC
+	uint32 nMalloc;
+	/// Calls to FREE with a non-NULL pointer
+	uint32 nFree;
+	/// Bytes currently allocated through MALLOC
+	uint32 nBytesInUse;
+	/// Most bytes ever allocated at once through MALLOC
+	uint32 nBytesPeak;
+	/// Calls to IDISPLAY_Update
+	uint32 nDisplayUpdates;
+	/// Calls to IDISPLAY_ClearScreen
+	uint32 nDisplayClears;
+	/// Pixels copied to the emulated panel by IDISPLAY_Update
+	uint64 nPixelsPushed;
+	/// Pixels copied by IBITMAP_BltIn
+	uint64 nPixelsBlitted;
+	/// Sprites drawn by ISPRITE_DrawSprites
+	uint64 nSpritesDrawn;
+	/// Tiles drawn by ISPRITE_DrawTiles
+	uint64 nTilesDrawn;
+	/// Calls to ICONTROL_HandleEvent
+	uint32 nControlEvents;
+	/// Calls to ICONTROL_IsActive
+	uint32 nControlQueries;
+	/// Records fetched from a database
+	uint32 nDBRecordFetches;
+	/// Fields read from database records
+	uint32 nDBFieldReads;
+} HostStats;
+
+int Host_Init( int cx, int cy, int nColorDepth );
+void Host_Shutdown( void );
+int Host_CreateApplet( AEECLSID cls );
+int Host_LaunchApplet( AEECLSID cls );
+void Host_ReleaseApplet( void );
+boolean Host_SendAppEvent( AEEEvent eCode, uint16 wParam, uint32 dwParam );
+int Host_Pump( void );
+int Host_AdvanceTime( uint32 nMSecs );
+boolean Host_IsAppletClosed( void );
+HostStats *Host_GetStats( void );
+void Host_ResetStats( void );
+void Host_SetDebugOutput( boolean bOn );
+void Host_SetVirtualUpTime( boolean bOn );
+int Host_SetResource( uint16 nID, const char *pszFile );
+
+#endif // AEEHOST_H
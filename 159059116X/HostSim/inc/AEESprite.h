@@ -0,0 +1,120 @@
+/*
+ *  @name AEESprite.h
+ *  @author Ray Rischpater, KF6GPE
+ *
+ *  Copyright (c) 2003 by the author. All rights reserved.
+ *  This file is provided without any warranty, express or implied,
+ *  including but not limited to fitness of purpose.
+ *  You may use this file so long as the copyright attribution
+ *  remains.
+ *
+ *  @doc
+ *  This file provides a host-side stand-in for the BREW ISprite
+ *  interface, implemented in software by HostSprite.c so that
+ *  sprite drawing can be measured on a desktop machine.
+ *
+ *  Only what SpriteSample uses is provided: sprite and tile
+ *  buffers of square images stacked top to bottom, sprites on
+ *  layers with COMPOSITE_KEYCOLOR or COMPOSITE_OPAQUE, the
+ *  TRANSFORM_ROTATE_* and TRANSFORM_SCALE_2 transforms, and tile
+ *  maps drawn at their x and y on the destination, or repeated
+ *  across it with MAP_FLAG_WRAP.
+ */
+#ifndef AEESPRITE_H
+#define AEESPRITE_H
+
+#include "AEEHost.h"
+
+typedef struct ISprite		ISprite;
+
+/*
+ * Sprite and tile sizes; a size is 8 << the constant pixels square.
+ */
+#define SPRITE_SIZE_8X8		0
+#define SPRITE_SIZE_16X16	1
+#define SPRITE_SIZE_32X32	2
+#define SPRITE_SIZE_64X64	3
+#define SPRITE_SIZE_END		0xFF
+
+#define TILE_SIZE_8X8		0
+#define TILE_SIZE_16X16		1
+#define TILE_SIZE_32X32		2
+#define TILE_SIZE_64X64		3
+
+/*
+ * Tile map sizes; a map is 1 << the constant tiles on a side.
+ */
+#define MAP_SIZE_1			0
+#define MAP_SIZE_2			1
+#define MAP_SIZE_4			2
+#define MAP_SIZE_8			3
+#define MAP_SIZE_16			4
+#define MAP_SIZE_32			5
+#define MAP_SIZE_64			6
+
+#define MAP_FLAG_WRAP		0x01
+
+/*
+ * Transforms. Rotations are clockwise; TRANSFORM_SCALE_2 doubles
+ * the sprite about its center, after rotating it.
+ */
+#define TRANSFORM_ROTATE_90		0x01
+#define TRANSFORM_ROTATE_180	0x02
+#define TRANSFORM_ROTATE_270	0x03
+#define TRANSFORM_ROTATE_MASK	0x03
+#define TRANSFORM_SCALE_2		0x10
+
+#define COMPOSITE_OPAQUE	0
+#define COMPOSITE_KEYCOLOR	1
+
+/**
+ * @name AEESpriteCmd
+ * @memo A sprite to draw.
+ * @doc Sprites on higher layers are drawn over those on lower ones; within a layer, later sprites are drawn over earlier ones. A sprite whose unSpriteSize is SPRITE_SIZE_END ends the list.
+ */
+typedef struct _AEESpriteCmd
+{
+	int16 x, y;
+	uint8 unSpriteIndex;
+	uint8 unSpriteSize;
+	uint8 unComposite;
+	uint8 unLayer;
+	uint8 unTransform;
+	uint8 reserved[ 3 ];
+} AEESpriteCmd;
+
+/**
+ * @name AEETileMap
+ * @memo A tile map to draw.
+ * @doc Each entry of pMapArray is a tile index, row by row. A map whose pMapArray is NULL ends the list.
+ */
+typedef struct _AEETileMap
+{
+	uint16 *pMapArray;
+	int32 x, y;
+	uint8 w, h;
+	uint8 unTileSize;
+	uint8 unFlags;
+	uint32 reserved[ 4 ];
+	uint8 reserved2[ 3 ];
+} AEETileMap;
+
+int Host_SpriteNew( ISprite **ppISprite );
+int Host_SpriteSetSpriteBuffer( ISprite *p, int nSize, IBitmap *pIBitmap );
+int Host_SpriteSetTileBuffer( ISprite *p, int nSize, IBitmap *pIBitmap );
+int Host_SpriteSetDestination( ISprite *p, IBitmap *pIBitmap );
+void Host_SpriteDrawSprites( ISprite *p, AEESpriteCmd *pCmds );
+void Host_SpriteDrawTiles( ISprite *p, AEETileMap *pMaps );
+uint32 Host_SpriteRelease( ISprite *p );
+void Host_SpriteSetScalar( boolean bScalar );
+
+#define ISPRITE_SetSpriteBuffer( p, n, pb ) \
+	Host_SpriteSetSpriteBuffer( p, n, pb )
+#define ISPRITE_SetTileBuffer( p, n, pb ) \
+	Host_SpriteSetTileBuffer( p, n, pb )
+#define ISPRITE_SetDestination( p, pb )	Host_SpriteSetDestination( p, pb )
+#define ISPRITE_DrawSprites( p, pc )	Host_SpriteDrawSprites( p, pc )
+#define ISPRITE_DrawTiles( p, pm )		Host_SpriteDrawTiles( p, pm )
+#define ISPRITE_Release( p )			Host_SpriteRelease( p )
+
+#endif // AEESPRITE_H
@@ -27,6 +27,11 @@ static boolean Main_HandleEvent( IApplet * pi,
 								uint16 wParam, 
 								uint32 dwParam);
 
+/*
+ * The application's states, as named in state stack snapshots.
+ */
+static PFNSTATEEVENT * const sapfnStates[] = AS_STATES;
+
 /*
  * Create an instance of this class. This constructor is
  * invoked by the BREW shell with the applet is launched.
@@ -121,6 +126,12 @@ static int Main_Start( CAppPtr pThis )
 
 	result = AS_Init( pThis );
 
+	// Only the slots up to the last control created, here or by
+	// the application, are searched for controls to pass events to.
+	for ( i = MAX_NUM_CONTROLS; i > 0; i-- )
+		if ( pThis->m_app.m_apControl[ i - 1 ] ) break;
+	pThis->m_app.m_nControl = (uint8)i;
+
 	return result;	
 }
  
@@ -167,12 +178,27 @@ static int Main_Init( CAppPtr pThis )
 	pThis->m_app.m_pState = MALLOC( sizeof( CState ) );
 	result = pThis->m_app.m_pState ? SUCCESS : EFAILED;
 
+	// Preallocate the state nodes and scratch arena. If the pool
+	// can't be allocated, the framework will take state nodes from 
+	// the heap instead; without an arena, State_Alloc fails.
+	if ( result == SUCCESS )
+	{
+		State_PoolInit( pThis );
+		State_ArenaInit( pThis );
+		State_TraceInit( pThis );
+		State_SetRegistry( pThis, sapfnStates, 
+			sizeof( sapfnStates ) / sizeof( sapfnStates[ 0 ] ) );
+	}
+
 	// Set up the application's preferences
 	if ( result == SUCCESS )
 	{
 		pThis->m_app.m_pAppPrefs = MALLOC( sizeof( CAppPrefs ) );
 		if ( !GetAppPrefs( pThis ) )
 		{
+			State_PoolFree( pThis );
+			State_ArenaFree( pThis );
+			State_TraceFree( pThis );
 			FREE( pThis->m_app.m_pState );
 			result = EFAILED;
 		}
@@ -189,6 +215,9 @@ static int Main_Init( CAppPtr pThis )
 								GetAppPrefs( pThis ), 
 								sizeof(CAppPrefs) ) != SUCCESS )
 			{
+				State_PoolFree( pThis );
+				State_ArenaFree( pThis );
+				State_TraceFree( pThis );
 				FREE( pThis->m_app.m_pState );
 				FREE( GetAppPrefs( pThis ) );
 				result = EFAILED;
@@ -225,6 +254,9 @@ static void Main_Free( IApplet *p )
 	// Release the head of the state list.
 	while( State_GetCurrentState( pThis ) )
 		State_Pop( p );
+	State_PoolFree( pThis );
+	State_ArenaFree( pThis );
+	State_TraceFree( pThis );
 	FREE( pThis->m_app.m_pState );
 
 	// Release all controls
@@ -276,6 +308,18 @@ static boolean Main_HandleEvent( IApplet *p,
 			break;
 			
 		case EVT_APP_START:                        
+			// If the shell stopped us while suspended, go straight
+			// back to where the user was.
+			if ( State_HasSnapshot( pThis, STATE_SNAPSHOT_FILE ) )
+			{
+				if ( Main_Start( pThis ) != SUCCESS )
+					ISHELL_CloseApplet( GetShell( pThis ), FALSE );
+				else if ( State_Restore( pThis, STATE_SNAPSHOT_FILE ) != SUCCESS )
+					State_Push( pThis, AS_FIRSTSTATE );
+				result = TRUE;
+				break;
+			}
+
 			// Show the splash screen
 			ShowCopyright( pThis );
 			result = TRUE;
@@ -26,6 +26,1051 @@
  * Implementation
  */
 
+#ifdef STATE_TRACE
+/*
+ * Calls a state's handler during a transition, recording the
+ * call in the transition trace.
+ */
+#define _stateCall( pThis, pfn, e, w, dw ) \
+	_traceCall( pThis, pfn, e, w, dw )
+#else
+/*
+ * Calls a state's handler during a transition.
+ */
+#define _stateCall( pThis, pfn, e, w, dw ) \
+	(pfn)( (void *)pThis, e, w, dw )
+#endif
+
+static void _stateFrame( void *p );
+
+/*
+ * Drops a pending frame; the state that asked for it is
+ * leaving the top of the stack or the application is suspending.
+ * Call this before the state coming to the top starts, so a frame
+ * it asks for as it starts is kept.
+ * @param CStateAppPtr pThis: pointer to app
+ */
+static void _stateDropFrame( CStateAppPtr pThis )
+{
+	if ( !pThis->m_bFramePending ) return;
+	ISHELL_CancelTimer( pThis->a.m_pIShell, 
+		(PFNNOTIFY)_stateFrame, pThis );
+	pThis->m_bFramePending = FALSE;
+}
+
+/*
+ * Takes a state node from the pool. Falls back to the
+ * heap if the pool is exhausted.
+ * @param CStateAppPtr pThis: pointer to app
+ * @return an empty state node, or NULL if none is available
+ */
+static CStatePtr _stateAcquire( CStateAppPtr pThis )
+{
+	CStatePtr pState = pThis->m_pStateFree;
+
+	if ( pState )
+	{
+		pThis->m_pStateFree = NodeNext( pState );
+		MEMSET( pState, 0, sizeof( CState ) );
+	}
+	else
+	{
+		pState = (CStatePtr)MALLOC( sizeof( CState ) );
+		if ( pState ) pThis->m_poolStats.m_nFallback++;
+	}
+	if ( pState ) 
+	{
+		pThis->m_poolStats.m_nAcquired++;
+		pState->m_nArenaMark = pThis->m_nArenaTop;
+	}
+
+	return pState;
+}
+
+/*
+ * Discards the screen kept for a state, if any.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param CStatePtr pState: state whose screen to discard
+ */
+static void _stateDropScreen( CStateAppPtr pThis, CStatePtr pState )
+{
+	if ( !pState->m_pScreen ) return;
+	IBITMAP_Release( pState->m_pScreen );
+	pState->m_pScreen = NULL;
+	pThis->m_nScreenBytes -= pState->m_nScreenBytes;
+	pState->m_nScreenBytes = 0;
+}
+
+/*
+ * Discards the kept screen of the shallowest state that has one.
+ * @param CStateAppPtr pThis: pointer to app
+ * @return TRUE if a screen was discarded
+ */
+static boolean _stateEvictScreen( CStateAppPtr pThis )
+{
+	CStatePtr pState, pOldest = NULL;
+
+	for ( pState = NodeNext( pThis->m_pState ); 
+		  pState; 
+		  pState = NodeNext( pState ) )
+		if ( pState->m_pScreen ) pOldest = pState;
+
+	if ( !pOldest ) return FALSE;
+	_stateDropScreen( pThis, pOldest );
+	pThis->m_screenStats.m_nEvicted++;
+	return TRUE;
+}
+
+/*
+ * Keeps a copy of the display for a state that's about to be 
+ * covered, if it asked for one and the copy fits in 
+ * STATE_SCREEN_BUDGET after discarding the shallowest states' 
+ * screens.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param CStatePtr pState: state about to be covered
+ */
+static void _stateKeepScreen( CStateAppPtr pThis, CStatePtr pState )
+{
+	IBitmap *pDevice = NULL;
+	AEEBitmapInfo info;
+	uint32 nBytes;
+
+	_stateDropScreen( pThis, pState );
+	if ( !pState->m_bKeepScreen || 
+		 IDISPLAY_GetDeviceBitmap( pThis->a.m_pIDisplay, &pDevice ) != SUCCESS )
+		return;
+
+	if ( IBITMAP_GetInfo( pDevice, &info, sizeof( info ) ) == SUCCESS )
+	{
+		nBytes = info.cx * info.cy * info.nDepth / 8;
+		while ( pThis->m_nScreenBytes + nBytes > STATE_SCREEN_BUDGET &&
+				_stateEvictScreen( pThis ) )
+			;
+		if ( pThis->m_nScreenBytes + nBytes <= STATE_SCREEN_BUDGET &&
+			 IBITMAP_CreateCompatibleBitmap( pDevice, &pState->m_pScreen,
+				(uint16)info.cx, (uint16)info.cy ) == SUCCESS )
+		{
+			IBITMAP_BltIn( pState->m_pScreen, 0, 0, info.cx, info.cy,
+				pDevice, 0, 0, AEE_RO_COPY );
+			pState->m_nScreenBytes = nBytes;
+			pThis->m_nScreenBytes += nBytes;
+			pThis->m_screenStats.m_nKept++;
+		}
+	}
+	IBITMAP_Release( pDevice );
+}
+
+/*
+ * Puts a state's kept screen back on the display and discards it.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param CStatePtr pState: state about to be restarted
+ * @return StateChange_restored if the screen was restored, or 0
+ */
+static uint16 _stateRestoreScreen( CStateAppPtr pThis, CStatePtr pState )
+{
+	IBitmap *pDevice = NULL;
+	AEEBitmapInfo info;
+	uint16 result = 0;
+
+	if ( !pState->m_pScreen ) return 0;
+	if ( IDISPLAY_GetDeviceBitmap( pThis->a.m_pIDisplay, &pDevice ) == SUCCESS )
+	{
+		if ( IBITMAP_GetInfo( pState->m_pScreen, &info, sizeof( info ) ) == SUCCESS )
+		{
+			IBITMAP_BltIn( pDevice, 0, 0, info.cx, info.cy,
+				pState->m_pScreen, 0, 0, AEE_RO_COPY );
+			State_Invalidate( pThis, NULL );
+			pThis->m_screenStats.m_nRestored++;
+			result = StateChange_restored;
+		}
+		IBITMAP_Release( pDevice );
+	}
+	_stateDropScreen( pThis, pState );
+	return result;
+}
+
+/*
+ * Returns a state node to the pool, or to the heap if
+ * it didn't come from the pool. Releases the node's
+ * scratch arena region, too.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param CStatePtr pState: node to release
+ */
+static void _stateRelease( CStateAppPtr pThis, CStatePtr pState )
+{
+	_stateDropScreen( pThis, pState );
+	pThis->m_nArenaTop = pState->m_nArenaMark;
+
+	if ( pThis->m_pStatePool &&
+		 pState >= pThis->m_pStatePool &&
+		 pState < pThis->m_pStatePool + STATE_POOL_DEPTH )
+	{
+		pState->m_pNext = pThis->m_pStateFree;
+		pThis->m_pStateFree = pState;
+	}
+	else
+	{
+		FREE( pState );
+	}
+}
+
+/*
+ * Releases a list of state nodes that were taken but never 
+ * linked to the stack. They were never given scratch memory,
+ * so the arena is left as it is.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param CStatePtr pState: first node of the list, or NULL
+ */
+static void _stateReleaseList( CStateAppPtr pThis, CStatePtr pState )
+{
+	CStatePtr pNext;
+
+	for ( ; pState; pState = pNext )
+	{
+		pNext = NodeNext( pState );
+		pState->m_nArenaMark = pThis->m_nArenaTop;
+		_stateRelease( pThis, pState );
+	}
+}
+
+/*
+ * Links a state node to the top of the state stack.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param CStatePtr pState: node to link
+ */
+static void _stateLink( CStateAppPtr pThis, CStatePtr pState )
+{
+	NodeLinkNext( pThis->m_pState, pState );
+	pThis->m_poolStats.m_nDepth++;
+	if ( pThis->m_poolStats.m_nDepth > pThis->m_poolStats.m_nDepthHigh )
+		pThis->m_poolStats.m_nDepthHigh = pThis->m_poolStats.m_nDepth;
+}
+
+/*
+ * Unlinks the state node at the top of the state stack
+ * and releases it.
+ * @param CStateAppPtr pThis: pointer to app
+ */
+static void _stateUnlink( CStateAppPtr pThis )
+{
+	CStatePtr pState = NodeNext( pThis->m_pState );
+
+	if ( !pState ) return;
+	pThis->m_pState->m_pNext = NodeNext( pState );
+	pThis->m_poolStats.m_nDepth--;
+	_stateRelease( pThis, pState );
+}
+
+/**
+ * Preallocates the state node pool.
+ * If the pool can't be allocated, states come from the heap.
+ * @param void *p: pointer to app
+ * @return SUCCESS if the pool was allocated, EFAILED if not
+ */
+int State_PoolInit( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	int i;
+
+	ASSERT( pThis );
+	MEMSET( &pThis->m_poolStats, 0, sizeof( CStatePoolStats ) );
+	pThis->m_pStateFree = NULL;
+	pThis->m_pStatePool = 
+		(CState *)MALLOC( STATE_POOL_DEPTH * sizeof( CState ) );
+	if ( !pThis->m_pStatePool ) return EFAILED;
+
+	for ( i = STATE_POOL_DEPTH - 1; i >= 0; i-- )
+	{
+		pThis->m_pStatePool[ i ].m_pNext = pThis->m_pStateFree;
+		pThis->m_pStateFree = &pThis->m_pStatePool[ i ];
+	}
+	return SUCCESS;
+}
+
+/**
+ * Releases the state node pool.
+ * Pop all states before calling this.
+ * @param void *p: pointer to app
+ */
+void State_PoolFree( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	DBGPRINTF( "State pool: depth high %d, %d of %d nodes from heap",
+		pThis->m_poolStats.m_nDepthHigh,
+		pThis->m_poolStats.m_nFallback,
+		pThis->m_poolStats.m_nAcquired );
+
+	FREE( pThis->m_pStatePool );
+	pThis->m_pStatePool = NULL;
+	pThis->m_pStateFree = NULL;
+}
+
+/**
+ * Allocates the scratch arena.
+ * If the arena can't be allocated, State_Alloc always fails.
+ * @param void *p: pointer to app
+ * @return SUCCESS if the arena was allocated, EFAILED if not
+ */
+int State_ArenaInit( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	MEMSET( &pThis->m_arenaStats, 0, sizeof( CStateArenaStats ) );
+	pThis->m_nArenaTop = 0;
+	pThis->m_pArenaOwner = NULL;
+	pThis->m_bArenaSealed = FALSE;
+	pThis->m_pArena = (uint8 *)MALLOC( STATE_ARENA_SIZE );
+
+	return pThis->m_pArena ? SUCCESS : EFAILED;
+}
+
+/**
+ * Releases the scratch arena.
+ * Pop all states before calling this.
+ * @param void *p: pointer to app
+ */
+void State_ArenaFree( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	DBGPRINTF( "State arena: peak %d, state peak %d, %d refused",
+		pThis->m_arenaStats.m_nPeak,
+		pThis->m_arenaStats.m_nStatePeak,
+		pThis->m_arenaStats.m_nFailed );
+
+	FREE( pThis->m_pArena );
+	pThis->m_pArena = NULL;
+	pThis->m_nArenaTop = 0;
+	pThis->m_pArenaOwner = NULL;
+	pThis->m_bArenaSealed = FALSE;
+}
+
+/**
+ * Allocates zeroed scratch memory for the state being entered,
+ * or the current state. The memory is released when the state
+ * is popped; don't FREE it. A state should allocate its scratch
+ * memory when it's pushed; a state returning to the top of the
+ * stack after a pop can read its memory with State_GetScratch,
+ * but can't allocate more until that transition ends.
+ * @param void *p: pointer to app
+ * @param uint32 nBytes: number of bytes to allocate
+ * @return pointer to the memory, or NULL if the state's budget 
+ * or the arena is exhausted
+ */
+void *State_Alloc( void *p, uint32 nBytes )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	CStatePtr pState;
+	uint32 nTop, nUsed;
+	void *pResult;
+
+	ASSERT( pThis );
+	pState = pThis->m_pArenaOwner;
+	nTop = pThis->m_nArenaTop + STATE_ARENA_ALIGN( nBytes );
+
+	if ( !pThis->m_pArena || !pState || pThis->m_bArenaSealed ||
+		 nTop > STATE_ARENA_SIZE ||
+		 nTop - pState->m_nArenaMark > STATE_ARENA_BUDGET )
+	{
+		pThis->m_arenaStats.m_nFailed++;
+		return NULL;
+	}
+
+	pResult = pThis->m_pArena + pThis->m_nArenaTop;
+	MEMSET( pResult, 0, nTop - pThis->m_nArenaTop );
+	pThis->m_nArenaTop = nTop;
+
+	nUsed = nTop - pState->m_nArenaMark;
+	if ( nTop > pThis->m_arenaStats.m_nPeak )
+		pThis->m_arenaStats.m_nPeak = nTop;
+	if ( nUsed > pThis->m_arenaStats.m_nStatePeak )
+		pThis->m_arenaStats.m_nStatePeak = nUsed;
+
+	return pResult;
+}
+
+/**
+ * Returns the start of the scratch memory of the state being
+ * entered, or the current state: the first block it obtained
+ * from State_Alloc. A state restarted after a pop gets back the
+ * memory it allocated when it was pushed.
+ * @param void *p: pointer to app
+ * @return pointer to the scratch memory, or NULL if the state has none
+ */
+void *State_GetScratch( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	CStatePtr pState;
+	uint32 nEnd;
+
+	ASSERT( pThis );
+	pState = pThis->m_pArenaOwner;
+	if ( !pThis->m_pArena || !pState ) return NULL;
+
+	// While sealed, the state being popped still sits on top
+	nEnd = pThis->m_bArenaSealed ? 
+		State_GetCurrentState( pThis )->m_nArenaMark : pThis->m_nArenaTop;
+	if ( nEnd == pState->m_nArenaMark ) 
+		return NULL;
+
+	return pThis->m_pArena + pState->m_nArenaMark;
+}
+
+/**
+ * Asks the framework to keep a copy of the state's screen while 
+ * other states cover it, and restore it when they're popped. The
+ * state is then restarted with StateChange_pop | StateChange_restored
+ * and needn't redraw, unless something it shows has changed.
+ * Call this for the state being pushed, or the current state.
+ * @param void *p: pointer to app
+ * @param boolean bKeep: TRUE to keep the state's screen
+ */
+void State_KeepScreen( void *p, boolean bKeep )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	if ( pThis->m_pArenaOwner ) 
+		pThis->m_pArenaOwner->m_bKeepScreen = bKeep;
+}
+
+/**
+ * Discards every kept screen, so every covered state redraws 
+ * when it's restarted. Call this when application data shown 
+ * on covered screens changes.
+ * @param void *p: pointer to app
+ */
+void State_DropScreens( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	CStatePtr pState;
+
+	ASSERT( pThis );
+	for ( pState = NodeNext( pThis->m_pState ); 
+		  pState; 
+		  pState = NodeNext( pState ) )
+		_stateDropScreen( pThis, pState );
+}
+
+/*
+ * Gets the whole display, finding its size on first use.
+ * @param CStateAppPtr pThis: pointer to app
+ * @return the display's rectangle
+ */
+static const AEERect *_stateDisplayRect( CStateAppPtr pThis )
+{
+	AEEDeviceInfo dm;
+
+	if ( pThis->m_rcDisplay.dx <= 0 )
+	{
+		dm.dwStructSize = sizeof( dm );
+		ISHELL_GetDeviceInfo( pThis->a.m_pIShell, &dm );
+		SETAEERECT( &pThis->m_rcDisplay, 0, 0, 
+			dm.cxScreen, dm.cyScreen );
+	}
+	return &pThis->m_rcDisplay;
+}
+
+/**
+ * Marks a region of the display as needing an update. The 
+ * framework combines the regions invalidated while it dispatches
+ * an event and updates the display once when the event's done;
+ * outside of State_HandleEvent, it updates the display at once.
+ * @param void *p: pointer to app
+ * @param const AEERect *prc: region to update, or NULL for the 
+ * whole display
+ */
+void State_Invalidate( void *p, const AEERect *prc )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	AEERect *prcDirty;
+	int16 x, y, x1, y1;
+
+	ASSERT( pThis );
+	prcDirty = &pThis->m_rcDirty;
+	pThis->m_displayStats.m_nInvalidated++;
+
+	if ( !prc ) prc = _stateDisplayRect( pThis );
+
+	if ( prc->dx > 0 && prc->dy > 0 )
+	{
+		if ( prcDirty->dx <= 0 || prcDirty->dy <= 0 )
+		{
+			*prcDirty = *prc;
+		}
+		else
+		{
+			x = prc->x < prcDirty->x ? prc->x : prcDirty->x;
+			y = prc->y < prcDirty->y ? prc->y : prcDirty->y;
+			x1 = prc->x + prc->dx;
+			if ( x1 < prcDirty->x + prcDirty->dx ) 
+				x1 = prcDirty->x + prcDirty->dx;
+			y1 = prc->y + prc->dy;
+			if ( y1 < prcDirty->y + prcDirty->dy ) 
+				y1 = prcDirty->y + prcDirty->dy;
+			SETAEERECT( prcDirty, x, y, x1 - x, y1 - y );
+		}
+	}
+
+	if ( !pThis->m_bDispatching ) State_Flush( p );
+}
+
+/**
+ * Updates the display if any of it has been invalidated since 
+ * the last update. IDISPLAY_Update sends the whole display to 
+ * the screen, however little of it was invalidated; there's no
+ * call that sends only part of it, so the invalidated region 
+ * only decides whether to update at all.
+ * @param void *p: pointer to app
+ */
+void State_Flush( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	AEERect *prcDirty;
+
+	ASSERT( pThis );
+	prcDirty = &pThis->m_rcDirty;
+	if ( prcDirty->dx <= 0 || prcDirty->dy <= 0 ) return;
+
+	IDISPLAY_Update( pThis->a.m_pIDisplay );
+	pThis->m_displayStats.m_nFlushes++;
+	SETAEERECT( prcDirty, 0, 0, 0, 0 );
+}
+
+/*
+ * Sends the frame requested with State_RequestFrame to the 
+ * current state.
+ * @param void *p: pointer to app
+ */
+static void _stateFrame( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	pThis->m_bFramePending = FALSE;
+	pThis->m_coalesceStats.m_nFrames++;
+	State_HandleEvent( p, EVT_STATE_FRAME, 0, 0 );
+}
+
+/**
+ * Asks for an EVT_STATE_FRAME to be sent to the current state 
+ * STATE_FRAME_MSECS from now. Requests made while a frame is 
+ * pending are merged into it, so a state that handles each key
+ * as it comes but redraws only on EVT_STATE_FRAME draws at most
+ * once a frame however fast keys arrive.
+ * @param void *p: pointer to app
+ */
+void State_RequestFrame( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	if ( pThis->m_bFramePending )
+	{
+		pThis->m_coalesceStats.m_nFramesMerged++;
+		return;
+	}
+	if ( ISHELL_SetTimer( pThis->a.m_pIShell, STATE_FRAME_MSECS, 
+			(PFNNOTIFY)_stateFrame, pThis ) == SUCCESS )
+		pThis->m_bFramePending = TRUE;
+}
+
+/**
+ * Cancels a pending frame. A state that has just drawn its 
+ * screen for another reason, such as an animation timer, calls
+ * this to merge the pending frame into the one it drew.
+ * @param void *p: pointer to app
+ */
+void State_CancelFrame( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	if ( !pThis->m_bFramePending ) return;
+	_stateDropFrame( pThis );
+	pThis->m_coalesceStats.m_nFramesMerged++;
+}
+
+/*
+ * Counts the key repeats whose redraw is merged into a pending 
+ * frame. Every key event still goes to the controls and the 
+ * state; only the drawing is merged. Drops the pending frame
+ * on suspend.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param AEEEvent eCode: event code
+ * @param uint16 wParam: key code
+ */
+static void _stateCoalesceKey( CStateAppPtr pThis, 
+							   AEEEvent eCode, 
+							   uint16 wParam )
+{
+	switch ( eCode )
+	{
+		case EVT_KEY:
+		case EVT_KEY_HELD:
+			// EVT_KEY follows every EVT_KEY_PRESS; only a second one repeats
+			if ( pThis->m_bFramePending && wParam == pThis->m_wLastKey &&
+				 ( eCode == EVT_KEY_HELD || pThis->m_eLastKey != EVT_KEY_PRESS ) )
+				pThis->m_coalesceStats.m_nKeysMerged++;
+			// Fall through
+
+		case EVT_KEY_PRESS:
+			pThis->m_eLastKey = eCode;
+			pThis->m_wLastKey = wParam;
+			break;
+
+		case EVT_KEY_RELEASE:
+			pThis->m_eLastKey = eCode;
+			pThis->m_wLastKey = 0;
+			break;
+
+		case EVT_APP_SUSPEND:
+			_stateDropFrame( pThis );
+			break;
+	}
+}
+
+#ifdef STATE_TRACE
+/*
+ * Calls a state's handler, recording the call in the next
+ * entry of the transition trace ring buffer.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param PFNSTATEEVENT *pfn: handler to call
+ * @param AEEEvent eCode: event code
+ * @param uint16 wParam: event parameter
+ * @param uint32 dwParam: event parameter
+ * @return what the handler returned
+ */
+static boolean _traceCall( CStateAppPtr pThis, PFNSTATEEVENT *pfn,
+						   AEEEvent eCode, uint16 wParam, uint32 dwParam )
+{
+	CStateTrace *pTrace;
+	uint32 nHeap;
+	boolean result;
+
+	pTrace = &pThis->m_aTrace[ pThis->m_nTrace++ % STATE_TRACE_DEPTH ];
+	pTrace->m_pfn = pfn;
+	pTrace->m_eCode = eCode;
+	pTrace->m_wReason = wParam;
+	pTrace->m_nDepth = pThis->m_poolStats.m_nDepth;
+	nHeap = pThis->m_pIHeap ? IHEAP_GetMemStats( pThis->m_pIHeap ) : 0;
+	pTrace->m_nTime = GETUPTIMEMS();
+
+	result = (pfn)( (void *)pThis, eCode, wParam, dwParam );
+
+	pTrace->m_nDuration = (uint16)( GETUPTIMEMS() - pTrace->m_nTime );
+	pTrace->m_nHeapDelta = pThis->m_pIHeap ? 
+		(int32)( IHEAP_GetMemStats( pThis->m_pIHeap ) - nHeap ) : 0;
+	pTrace->m_bResult = result;
+
+	return result;
+}
+
+/**
+ * Prepares transition tracing.
+ * @param void *p: pointer to app
+ * @return SUCCESS, or EFAILED if heap use can't be measured
+ */
+int State_TraceInit( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	pThis->m_nTrace = 0;
+	return ISHELL_CreateInstance( pThis->a.m_pIShell, AEECLSID_HEAP,
+		(void **)&pThis->m_pIHeap ) == SUCCESS ? SUCCESS : EFAILED;
+}
+
+/**
+ * Ends transition tracing, writing the trace to the debug log.
+ * @param void *p: pointer to app
+ */
+void State_TraceFree( void *p )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	State_TraceDump( p, NULL );
+	if ( pThis->m_pIHeap ) IHEAP_Release( pThis->m_pIHeap );
+	pThis->m_pIHeap = NULL;
+}
+
+/**
+ * Writes the transition trace, oldest entry first.
+ * @param void *p: pointer to app
+ * @param const char *pszFile: file to write, or NULL for the debug log
+ * @return SUCCESS, or EFAILED if the file couldn't be written
+ */
+int State_TraceDump( void *p, const char *pszFile )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	IFileMgr *pIFileMgr = NULL;
+	IFile *pIFile = NULL;
+	CStateTrace *pTrace;
+	char szLine[ 96 ];
+	uint32 i;
+	int result = SUCCESS;
+
+	ASSERT( pThis );
+	if ( pszFile )
+	{
+		if ( ISHELL_CreateInstance( pThis->a.m_pIShell, AEECLSID_FILEMGR,
+				(void **)&pIFileMgr ) != SUCCESS )
+			return EFAILED;
+		IFILEMGR_Remove( pIFileMgr, pszFile );
+		pIFile = IFILEMGR_OpenFile( pIFileMgr, pszFile, _OFM_CREATE );
+		if ( !pIFile )
+		{
+			IFILEMGR_Release( pIFileMgr );
+			return EFAILED;
+		}
+	}
+
+	i = pThis->m_nTrace > STATE_TRACE_DEPTH ? 
+		pThis->m_nTrace - STATE_TRACE_DEPTH : 0;
+	for ( ; i < pThis->m_nTrace; i++ )
+	{
+		pTrace = &pThis->m_aTrace[ i % STATE_TRACE_DEPTH ];
+		SPRINTF( szLine, "%lu %s %08lx cause %04x depth %d %d ms heap %d %s",
+			(uint32)pTrace->m_nTime,
+			pTrace->m_eCode == EVT_APP_START ? "START" : "STOP ",
+			(uint32)pTrace->m_pfn,
+			pTrace->m_wReason,
+			pTrace->m_nDepth,
+			pTrace->m_nDuration,
+			pTrace->m_nHeapDelta,
+			pTrace->m_bResult ? "ok" : "refused" );
+		if ( pIFile )
+		{
+			STRCAT( szLine, "\n" );
+			if ( IFILE_Write( pIFile, szLine, STRLEN( szLine ) ) != 
+				 STRLEN( szLine ) )
+				result = EFAILED;
+		}
+		else
+		{
+			DBGPRINTF( "%s", szLine );
+		}
+	}
+
+	if ( pIFile ) IFILE_Release( pIFile );
+	if ( pIFileMgr ) IFILEMGR_Release( pIFileMgr );
+	return result;
+}
+#endif
+
+/*
+ * Pops the state on top of the stack without restarting the
+ * state beneath it. A state that has started is told it's
+ * being popped; one State_Transact pushed but never started
+ * is simply dropped.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param unsigned char info: additional information for the state
+ */
+static void _stateDiscard( CStateAppPtr pThis, unsigned char info )
+{
+	CStatePtr pState = State_GetCurrentState( pThis );
+	PFNSTATEEVENT *pfn;
+	PFNSTATEEVENT *pfn_OnError = NULL;
+
+	if ( !pState ) return;
+	if ( !pState->m_bDeferred && 
+		 ( pfn = State_GetStateEventHandler( pState ) ) )
+		_stateCall( pThis, pfn, EVT_APP_STOP, 
+			(uint16)( StateChange_pop | info ), (uint32)&pfn_OnError );
+	_stateUnlink( pThis );
+}
+
+/*
+ * Starts the state on top of the stack. A state that 
+ * State_Transact pushed is started as if it were being pushed;
+ * any other state is restarted as if the state above it were 
+ * popped. If the state refuses, its pfn_OnError is honoured as
+ * State_PushEx or State_PopEx would, and the new top is started.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param unsigned char info: additional information for the state
+ * @return TRUE if a state started, FALSE if not
+ */
+static boolean _stateStartTop( CStateAppPtr pThis, unsigned char info )
+{
+	CStatePtr pState;
+	PFNSTATEEVENT *pfn;
+	PFNSTATEEVENT *pfn_OnError;
+	boolean bDeferred, bRelaunched, result = TRUE;
+
+	// The pending frame belongs to the state that left the top.
+	_stateDropFrame( pThis );
+	while ( ( pState = State_GetCurrentState( pThis ) ) )
+	{
+		bDeferred = pState->m_bDeferred;
+		bRelaunched = pState->m_bRelaunched;
+		pState->m_bDeferred = FALSE;
+		pState->m_bRelaunched = FALSE;
+		pfn_OnError = NULL;
+		result = TRUE;
+		pThis->m_pArenaOwner = pState;
+		if ( ( pfn = State_GetStateEventHandler( pState ) ) )
+			result = _stateCall( pThis, pfn, EVT_APP_START, 
+				(uint16)( ( bDeferred ? StateChange_push : 
+					StateChange_pop | _stateRestoreScreen( pThis, pState ) ) | 
+					( bRelaunched ? StateChange_relaunch : 0 ) | info ),
+				(uint32)&pfn_OnError );
+		if ( result ) break;
+
+		// A state that refuses to start is dropped; one that 
+		// refuses to restart stays unless it asks to be popped.
+		if ( bDeferred ) _stateUnlink( pThis );
+		if ( pfn_OnError == State_PopState )
+		{
+			_stateDiscard( pThis, info );
+		}
+		else if ( pfn_OnError )
+		{
+			if ( !( pState = _stateAcquire( pThis ) ) ) break;
+			State_SetStateEventHandler( pState, pfn_OnError );
+			pState->m_bDeferred = TRUE;
+			_stateLink( pThis, pState );
+		}
+		else if ( !bDeferred ) 
+		{
+			break;
+		}
+	}
+
+	pThis->m_pArenaOwner = State_GetCurrentState( pThis );
+	return result;
+}
+
+/*
+ * Snapshot file layout: a CStateSnapshot header, one 
+ * CStateRecord for each state from the top of the stack down,
+ * then the arena's bytes.
+ */
+#define STATE_SNAPSHOT_MAGIC ( 0x534E5031 )
+
+typedef struct _CStateSnapshot
+{
+	/// STATE_SNAPSHOT_MAGIC
+	uint32        m_dwMagic;
+	/// Bytes of arena that follow the records
+	uint32        m_nArenaBytes;
+	/// Number of records
+	uint16        m_nStates;
+	/// Size of CState when the snapshot was written
+	uint16        m_nStateSize;
+} CStateSnapshot;
+
+typedef struct _CStateRecord
+{
+	/// Where the state's scratch data begins in the arena
+	uint32        m_nArenaMark;
+	/// Index of the state's function in the registry
+	uint8         m_iState;
+	/// TRUE if the state keeps its screen when covered
+	uint8         m_bKeepScreen;
+	uint16        m_nReserved;
+} CStateRecord;
+
+/*
+ * Deletes the snapshot file, if there is one.
+ * @param CStateAppPtr pThis: pointer to app
+ * @param const char *pszFile: snapshot file name
+ */
+static void _stateDropSnapshot( CStateAppPtr pThis, const char *pszFile )
+{
+	IFileMgr *pIFileMgr = NULL;
+
+	if ( ISHELL_CreateInstance( pThis->a.m_pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return;
+	IFILEMGR_Remove( pIFileMgr, pszFile );
+	IFILEMGR_Release( pIFileMgr );
+}
+
+/**
+ * Writes the state stack and the arena to a snapshot file, 
+ * naming each state by its index in the registry. Only the 
+ * arena is saved, so a state that wants to survive a relaunch
+ * must keep what it needs there, without pointers. If any 
+ * state isn't in the registry, no snapshot is written.
+ * @param void *p: pointer to app
+ * @param const char *pszFile: snapshot file name
+ * @return SUCCESS if the snapshot was written, EFAILED if not
+ */
+int State_Save( void *p, const char *pszFile )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	IFileMgr *pIFileMgr = NULL;
+	IFile *pIFile = NULL;
+	CStateSnapshot header;
+	CStateRecord record;
+	CStatePtr pState;
+	int i, result = SUCCESS;
+
+	ASSERT( pThis );
+	MEMSET( &header, 0, sizeof( header ) );
+	MEMSET( &record, 0, sizeof( record ) );
+	header.m_dwMagic = STATE_SNAPSHOT_MAGIC;
+	header.m_nArenaBytes = pThis->m_nArenaTop;
+	header.m_nStateSize = sizeof( CState );
+	header.m_nStates = pThis->m_poolStats.m_nDepth;
+
+	if ( ISHELL_CreateInstance( pThis->a.m_pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return EFAILED;
+	IFILEMGR_Remove( pIFileMgr, pszFile );
+	if ( header.m_nStates )
+		pIFile = IFILEMGR_OpenFile( pIFileMgr, pszFile, _OFM_CREATE );
+	if ( !pIFile ||
+		 IFILE_Write( pIFile, &header, sizeof( header ) ) != sizeof( header ) )
+		result = EFAILED;
+
+	for ( pState = NodeNext( pThis->m_pState ); 
+		  pState && result == SUCCESS; 
+		  pState = NodeNext( pState ) )
+	{
+		for ( i = 0; i < pThis->m_nRegistry; i++ )
+			if ( pThis->m_apfnRegistry[ i ] == 
+				 State_GetStateEventHandler( pState ) ) break;
+		record.m_nArenaMark = pState->m_nArenaMark;
+		record.m_iState = (uint8)i;
+		record.m_bKeepScreen = (uint8)pState->m_bKeepScreen;
+		if ( i == pThis->m_nRegistry ||
+			 IFILE_Write( pIFile, &record, sizeof( record ) ) != sizeof( record ) )
+			result = EFAILED;
+	}
+
+	if ( result == SUCCESS &&
+		 IFILE_Write( pIFile, pThis->m_pArena, header.m_nArenaBytes ) != 
+			header.m_nArenaBytes )
+		result = EFAILED;
+	if ( pIFile ) IFILE_Release( pIFile );
+
+	// Don't leave a partial snapshot behind
+	if ( result != SUCCESS ) IFILEMGR_Remove( pIFileMgr, pszFile );
+	IFILEMGR_Release( pIFileMgr );
+	return result;
+}
+
+/**
+ * Tells whether a snapshot file is waiting to be restored.
+ * @param void *p: pointer to app
+ * @param const char *pszFile: snapshot file name
+ * @return TRUE if the file exists
+ */
+boolean State_HasSnapshot( void *p, const char *pszFile )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	IFileMgr *pIFileMgr = NULL;
+	boolean result;
+
+	ASSERT( pThis );
+	if ( ISHELL_CreateInstance( pThis->a.m_pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return FALSE;
+	result = IFILEMGR_Test( pIFileMgr, pszFile ) == SUCCESS;
+	IFILEMGR_Release( pIFileMgr );
+	return result;
+}
+
+/**
+ * Rebuilds the state stack and the arena from a snapshot file 
+ * written by State_Save, then starts the top state. Each 
+ * state is started with StateChange_push | StateChange_relaunch
+ * when it reaches the top, and finds its scratch data where it 
+ * left it. The stack must be empty. The file is read in full 
+ * and checked before any state is pushed; it's deleted either way.
+ * @param void *p: pointer to app
+ * @param const char *pszFile: snapshot file name
+ * @return SUCCESS if a state was started, EFAILED if not
+ */
+int State_Restore( void *p, const char *pszFile )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	IFileMgr *pIFileMgr = NULL;
+	IFile *pIFile = NULL;
+	CStateSnapshot header;
+	CStateRecord *pRecords = NULL;
+	CStatePtr pState;
+	uint32 nRecordBytes = 0;
+	int i, result = SUCCESS;
+
+	ASSERT( pThis );
+	if ( State_GetCurrentState( pThis ) || !pThis->m_pArena ||
+		 ISHELL_CreateInstance( pThis->a.m_pIShell, AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return EFAILED;
+
+	pIFile = IFILEMGR_OpenFile( pIFileMgr, pszFile, _OFM_READ );
+	if ( !pIFile ||
+		 IFILE_Read( pIFile, &header, sizeof( header ) ) != sizeof( header ) ||
+		 header.m_dwMagic != STATE_SNAPSHOT_MAGIC ||
+		 header.m_nStateSize != sizeof( CState ) ||
+		 header.m_nStates == 0 ||
+		 header.m_nArenaBytes > STATE_ARENA_SIZE )
+		result = EFAILED;
+
+	if ( result == SUCCESS )
+	{
+		nRecordBytes = header.m_nStates * sizeof( CStateRecord );
+		pRecords = (CStateRecord *)MALLOC( nRecordBytes );
+		if ( !pRecords ||
+			 IFILE_Read( pIFile, pRecords, nRecordBytes ) != nRecordBytes ||
+			 IFILE_Read( pIFile, pThis->m_pArena, header.m_nArenaBytes ) != 
+				header.m_nArenaBytes )
+			result = EFAILED;
+	}
+
+	// No state's scratch data starts below that of the state beneath it
+	for ( i = 0; result == SUCCESS && i < header.m_nStates; i++ )
+		if ( pRecords[ i ].m_iState >= pThis->m_nRegistry ||
+			 pRecords[ i ].m_nArenaMark > header.m_nArenaBytes ||
+			 ( i && pRecords[ i ].m_nArenaMark > pRecords[ i - 1 ].m_nArenaMark ) )
+			result = EFAILED;
+
+	if ( pIFile ) IFILE_Release( pIFile );
+	IFILEMGR_Remove( pIFileMgr, pszFile );
+	IFILEMGR_Release( pIFileMgr );
+
+	// Push from the bottom of the stack up
+	for ( i = header.m_nStates - 1; result == SUCCESS && i >= 0; i-- )
+	{
+		pThis->m_nArenaTop = pRecords[ i ].m_nArenaMark;
+		if ( !( pState = _stateAcquire( pThis ) ) )
+		{
+			result = ENOMEMORY;
+			break;
+		}
+		State_SetStateEventHandler( pState, 
+			pThis->m_apfnRegistry[ pRecords[ i ].m_iState ] );
+		pState->m_bKeepScreen = (boolean)pRecords[ i ].m_bKeepScreen;
+		pState->m_bDeferred = TRUE;
+		pState->m_bRelaunched = TRUE;
+		_stateLink( pThis, pState );
+	}
+
+	if ( result == SUCCESS )
+	{
+		pThis->m_nArenaTop = header.m_nArenaBytes;
+		if ( pThis->m_nArenaTop > pThis->m_arenaStats.m_nPeak )
+			pThis->m_arenaStats.m_nPeak = pThis->m_nArenaTop;
+		_stateStartTop( pThis, 0 );
+		if ( !State_GetCurrentState( pThis ) ) result = EFAILED;
+	}
+	else
+	{
+		// Nothing started, so there's no one to tell
+		while ( State_GetCurrentState( pThis ) ) _stateUnlink( pThis );
+		pThis->m_nArenaTop = 0;
+	}
+
+	if ( pRecords ) FREE( pRecords );
+	return result;
+}
+
 /*
  * Pushes indicated state on stack with add'l info;
  * transitions to that state.
@@ -44,26 +1089,30 @@ boolean State_Replace( void *p,
 	int result;
 
 	pCurState = State_GetCurrentState( pThis );
-	pfn = State_GetStateEventHandler( pCurState );
-	if ( pCurState && pfn )
-		result = (pfn)( p, EVT_APP_STOP, StateChange_pop, (uint32)&pfn_OnError );
+	if ( pCurState && ( pfn = State_GetStateEventHandler( pCurState ) ) )
+		result = _stateCall( pThis, pfn, EVT_APP_STOP, StateChange_pop, (uint32)&pfn_OnError );
 	
 	// Pop the state from the stack.
-	NodeUnlinkNext(pThis->m_pState);
+	_stateUnlink( pThis );
 
-	pNewState = (CStatePtr)MALLOC( sizeof( CState ) );
+	pNewState = _stateAcquire( pThis );
+	if ( !pNewState ) return FALSE;
 
 	State_SetStateEventHandler( pNewState, pfEvent );
 
-	result = (pfEvent)(p, EVT_APP_START, StateChange_push, (uint32)&pfn_OnError);
+	// The new state may allocate scratch memory and ask for a frame
+	// as it starts.
+	_stateDropFrame( pThis );
+	pThis->m_pArenaOwner = pNewState;
+	result = _stateCall( pThis, pfEvent, EVT_APP_START, StateChange_push, (uint32)&pfn_OnError );
 
 	if(result)
 	{
 		// Push the new state onto the stack..
-		NodeLinkNext( pThis->m_pState, pNewState);	
+		_stateLink( pThis, pNewState );
 	} else {
 		// Free the current state.
-		FREE( pNewState );
+		_stateRelease( pThis, pNewState );
 
 		// if pfn_OnError is set, this is our new state...
 		if ( pfn_OnError )
@@ -71,16 +1120,17 @@ boolean State_Replace( void *p,
 			if ( pfn_OnError == State_PopState )
 			{
 				// Pop this state instead
-				result = State_PopEx( pThis, NULL );
+				result = State_PopEx( pThis, 0 );
 			}
 			else
 			{
 				// Push the replacement state
-				result =  State_PushEx( pThis, pfn_OnError, NULL, TRUE );
+				result =  State_PushEx( pThis, pfn_OnError, 0, TRUE );
 			}
 		}
 		// If pfn_OnError is NULL, we stayed in the same state.
 	}
+	pThis->m_pArenaOwner = State_GetCurrentState( pThis );
 	return result;
 }
 
@@ -102,32 +1152,42 @@ boolean State_PushEx( void *p,
 	if ( pfEvent == State_PopState )
 		return State_PopEx( p, info );
 
+	if ( !pThis ) return FALSE;
+
 	pCurState = State_GetCurrentState( pThis );
-	pNewState = (CStatePtr)MALLOC( sizeof( CState ) );
+	pNewState = _stateAcquire( pThis );
+	if ( !pNewState ) return FALSE;
+
 	State_SetStateEventHandler( pNewState, pfEvent );
-	
-	if ( !pNewState || !pThis ) return FALSE;
 
 	if(!bError)
 	{
+		if ( pCurState )
+			_stateKeepScreen( pThis, pCurState );
 		if ( pCurState && ( pfn = State_GetStateEventHandler( pCurState ) ) )
-			result = (pfn)( p, EVT_APP_STOP, reason, (uint32)&pfn_OnError );
+			result = _stateCall( pThis, pfn, EVT_APP_STOP, reason, (uint32)&pfn_OnError );
 	}
 	
 	// If the current state function said it's OK, start the new state.
+	// The new state may allocate scratch memory and ask for a frame
+	// as it starts.
+	if ( result ) _stateDropFrame( pThis );
+	pThis->m_pArenaOwner = pNewState;
 	if ( result && ( pfn = State_GetStateEventHandler( pNewState ) ) )
-		result = (pfn)( p, EVT_APP_START, reason, (uint32)&pfn_OnError );
+		result = _stateCall( pThis, pfn, EVT_APP_START, reason, (uint32)&pfn_OnError );
 
 	// If result is TRUE, the current state is ready
 	if ( result )
 	{
 		// Push the new state onto the stack..
-		NodeLinkNext( pThis->m_pState, pNewState);		
+		_stateLink( pThis, pNewState );
 	}
 	else
 	{	
-		// Free the current state.
-		FREE( pNewState );
+		// Free the current state, and the screen kept for the
+		// state that stays on top.
+		_stateRelease( pThis, pNewState );
+		if ( pCurState ) _stateDropScreen( pThis, pCurState );
 		// if pfn_OnError is set, this is our new state...
 		if ( pfn_OnError )
 		{
@@ -145,9 +1205,123 @@ boolean State_PushEx( void *p,
 		// If pfn_OnError is NULL, we stayed in the same state.
 	}
 
+	pThis->m_pArenaOwner = State_GetCurrentState( pThis );
 	return result;
 }
 
+/**
+ * Applies several pushes, pops and replacements to the state 
+ * stack as one transition. The current state gets EVT_APP_STOP
+ * and only the state left on top gets EVT_APP_START, so states
+ * passed through along the way never draw. States popped along
+ * the way that had started get EVT_APP_STOP; states pushed beneath
+ * the new top start when they first reach the top of the stack.
+ * The steps are checked, and a node taken for every push, before
+ * the current state is stopped; if a step would pop an empty stack
+ * or there's no node for a push, nothing changes. If the current 
+ * state refuses to stop, its pfn_OnError is honoured as 
+ * State_PushEx would, and the steps are not applied.
+ * @param void *p: pointer to app
+ * @param const CStateOp *pOps: the steps, applied in order
+ * @param int nOps: number of steps
+ * @param unsigned char info: additional information for the states
+ * @return TRUE if every step was applied and the new top started
+ */
+boolean State_Transact( void *p,
+						const CStateOp *pOps,
+						int nOps,
+						unsigned char info )
+{
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+	CStatePtr pCurState, pState, pPushed = NULL;
+	boolean result = TRUE;
+	boolean bCurPopped;
+	PFNSTATEEVENT *pfn;
+	PFNSTATEEVENT *pfn_OnError = NULL;
+	int i, nDepth;
+
+	ASSERT( p );
+	ASSERT( pOps );
+	if ( !p || !pOps || nOps <= 0 ) return FALSE;
+
+	// Check every step before anything changes: each pop needs a 
+	// state to pop, and each push gets its node now.
+	nDepth = pThis->m_poolStats.m_nDepth;
+	for ( i = 0; i < nOps; i++ )
+	{
+		pfn = pOps[ i ].m_pfn;
+		if ( pOps[ i ].m_eOp != StateOp_push || pfn == State_PopState )
+		{
+			if ( nDepth == 0 ) break;
+			nDepth--;
+		}
+		if ( pOps[ i ].m_eOp != StateOp_pop && pfn != State_PopState )
+		{
+			if ( !( pState = _stateAcquire( pThis ) ) ) break;
+			pState->m_pNext = pPushed;
+			pPushed = pState;
+			nDepth++;
+		}
+	}
+	if ( i < nOps )
+	{
+		_stateReleaseList( pThis, pPushed );
+		return FALSE;
+	}
+
+	// Tell the current state whether it's being popped or covered.
+	bCurPopped = pOps[ 0 ].m_eOp != StateOp_push ||
+				 pOps[ 0 ].m_pfn == State_PopState;
+	pCurState = State_GetCurrentState( pThis );
+	if ( pCurState && !bCurPopped )
+		_stateKeepScreen( pThis, pCurState );
+	if ( pCurState && ( pfn = State_GetStateEventHandler( pCurState ) ) )
+		result = _stateCall( pThis, pfn, EVT_APP_STOP, 
+			(uint16)( ( bCurPopped ? StateChange_pop : StateChange_push ) | info ),
+			(uint32)&pfn_OnError );
+
+	if ( !result )
+	{
+		_stateReleaseList( pThis, pPushed );
+		if ( pCurState ) _stateDropScreen( pThis, pCurState );
+		if ( pfn_OnError == State_PopState )
+			return State_PopEx( pThis, info );
+		if ( pfn_OnError )
+			return State_PushEx( pThis, pfn_OnError, info, TRUE );
+		return FALSE;
+	}
+
+	// Nothing can fail from here on.
+	for ( i = 0; i < nOps; i++ )
+	{
+		pfn = pOps[ i ].m_pfn;
+		if ( pOps[ i ].m_eOp != StateOp_push || pfn == State_PopState )
+		{
+			pState = State_GetCurrentState( pThis );
+			// The current state already knows it's being popped.
+			if ( pState == pCurState && bCurPopped )
+				_stateUnlink( pThis );
+			else
+				_stateDiscard( pThis, info );
+			if ( pState == pCurState ) pCurState = NULL;
+		}
+		if ( pOps[ i ].m_eOp != StateOp_pop && pfn != State_PopState )
+		{
+			// Its scratch memory starts above what's left after 
+			// the pops before it.
+			pState = pPushed;
+			pPushed = NodeNext( pState );
+			pState->m_nArenaMark = pThis->m_nArenaTop;
+			State_SetStateEventHandler( pState, pfn );
+			pState->m_bDeferred = TRUE;
+			_stateLink( pThis, pState );
+		}
+	}
+
+	// Only the state that ends up on top starts.
+	return _stateStartTop( pThis, info );
+}
+
 /**
  * Pushes indicated state on stack.
  * Transitions to that state.
@@ -189,19 +1363,34 @@ boolean State_PopEx( void *p,
 
 	// Call the present state's exit function
 	if ( ( pfn = State_GetStateEventHandler( pCurState ) ) )
-		result = (pfn)( p, EVT_APP_STOP, reason, (uint32)&pfn_OnError );
+		result = _stateCall( pThis, pfn, EVT_APP_STOP, reason, (uint32)&pfn_OnError );
 		
+	// A state State_Transact pushed but never started is started
+	// as if it were being pushed, once the current state is gone.
+	if ( result && pOldState && pOldState->m_bDeferred )
+	{
+		_stateUnlink( pThis );
+		return _stateStartTop( pThis, info );
+	}
+
 	// If the current state function said it's OK, 
-	// restart the previous state.
+	// restart the previous state. Its scratch memory lies below
+	// the current state's, so it can read it but not allocate more yet.
+	if ( result ) _stateDropFrame( pThis );
+	pThis->m_pArenaOwner = pOldState;
+	pThis->m_bArenaSealed = TRUE;
 	if ( result && pOldState &&
 		 ( pfn = State_GetStateEventHandler( pOldState ) ) )
-		result = (pfn)( p, EVT_APP_START, reason, (uint32)&pfn_OnError );
+		result = _stateCall( pThis, pfn, EVT_APP_START, 
+			(uint16)( reason | _stateRestoreScreen( pThis, pOldState ) ), 
+			(uint32)&pfn_OnError );
+	pThis->m_bArenaSealed = FALSE;
 		
 	// If result is TRUE, we can pop the current state
 	if ( result )
 	{
 		// Pop the state from the stack.
-		NodeUnlinkNext( pThis->m_pState );		
+		_stateUnlink( pThis );		
 	}
 	else
 	{	
@@ -211,14 +1400,14 @@ boolean State_PopEx( void *p,
 			if ( pfn_OnError == State_PopState )
 			{
 				// Pop the current state...
-				NodeUnlinkNext( pThis->m_pState );
+				_stateUnlink( pThis );
 				// ... and the previous one as well
 				result = State_PopEx( pThis, info );
 			}
 			else
 			{
 				// Pop the state from the stack.
-				NodeUnlinkNext( pThis->m_pState );		
+				_stateUnlink( pThis );		
 				// Push the replacement state				
 				result =  State_PushEx( pThis, pfn_OnError, info, FALSE );
 			}
@@ -226,6 +1415,7 @@ boolean State_PopEx( void *p,
 		// If pfn_OnError is NULL, we stayed in the same state.
 	}
 
+	pThis->m_pArenaOwner = State_GetCurrentState( pThis );
 	return result;
 }
 
@@ -259,32 +1449,37 @@ _controlHandleEvent( CStateAppPtr pThis,
 					 uint32 dwParam )
 {
 	boolean result = FALSE;
-	boolean bTextControlOnscreen;
-	boolean bSoftMenuOnscreen;
+	boolean bTextControlOnscreen = FALSE;
+	boolean bSoftMenuOnscreen = FALSE;
+	uint32 nDispatch;
 	int wCurrCtl;
 	
-	if ( pThis->m_apControl[ Ctl_TextInput ] ) 
-	{
-		bTextControlOnscreen = ITEXTCTL_GetTextPtr( (ITextCtl *)pThis->m_apControl[ Ctl_TextInput ] ) != NULL ? TRUE : FALSE;
-	}
-	else 
-	{
-		bTextControlOnscreen = FALSE;
-	}
-	if ( pThis->m_apControl[ Ctl_SoftKeyMenu ] )
-	{
-		bSoftMenuOnscreen = IMENUCTL_GetItemCount( (IMenuCtl *)pThis->m_apControl[ Ctl_SoftKeyMenu ] ) != 0 ? TRUE : FALSE;
-	}
-	else
+	// Only up and down move between the text control and its soft
+	// key menu. Controls never shown with Control_ShowControl are 
+	// asked, as before.
+	if ( eCode == EVT_KEY && ( wParam == AVK_UP || wParam == AVK_DOWN ) )
 	{
-		bSoftMenuOnscreen = FALSE;
+		if ( pThis->m_nTrackedMask & ( 1 << Ctl_TextInput ) )
+			bTextControlOnscreen = State_IsControlShown( pThis, Ctl_TextInput );
+		else
+			bTextControlOnscreen = pThis->m_apControl[ Ctl_TextInput ] &&
+				ITEXTCTL_GetTextPtr( (ITextCtl *)pThis->m_apControl[ Ctl_TextInput ] ) != NULL;
+		if ( pThis->m_nTrackedMask & ( 1 << Ctl_SoftKeyMenu ) )
+			bSoftMenuOnscreen = State_IsControlShown( pThis, Ctl_SoftKeyMenu );
+		else
+			bSoftMenuOnscreen = pThis->m_apControl[ Ctl_SoftKeyMenu ] &&
+				IMENUCTL_GetItemCount( (IMenuCtl *)pThis->m_apControl[ Ctl_SoftKeyMenu ] ) != 0;
 	}
 	
-	// Dispatch the event to any of the active controls
-	for ( wCurrCtl = 0; 
-		  wCurrCtl < pThis->m_nControl; 
-		  wCurrCtl++ )
+	// Dispatch the event to any of the active controls on screen,
+	// and to any active control the framework isn't tracking, 
+	// visiting only the slots in the mask
+	nDispatch = ( pThis->m_nShownMask | ~pThis->m_nTrackedMask ) &
+		( pThis->m_nControl < 32 ? 
+		  ( 1UL << pThis->m_nControl ) - 1 : 0xFFFFFFFFUL );
+	for ( wCurrCtl = 0; nDispatch; wCurrCtl++, nDispatch >>= 1 )
 	{
+		if ( !( nDispatch & 1 ) ) continue;
 		if ( pThis->m_apControl[ wCurrCtl ] &&
 			ICONTROL_IsActive( pThis->m_apControl[ wCurrCtl ] ) )
 		{
@@ -377,18 +1572,15 @@ _controlHandleEvent( CStateAppPtr pThis,
  * @param uint32 dwParan: event parameter
  * @return boolean FALSE if app framework should continue handling event
  */
-boolean State_HandleEvent( void *p, 
-						  AEEEvent eCode, 
-						  uint16 wParam, 
-						  uint32 dwParam )
+static boolean _stateHandleEvent( CStateAppPtr pThis, 
+								  AEEEvent eCode, 
+								  uint16 wParam, 
+								  uint32 dwParam )
 {
 	boolean result = FALSE;
 	CStatePtr pCurState;
-	CStateAppPtr pThis = ( CStateAppPtr )p;
+	void *p = pThis;
 	PFNSTATEEVENT *pfn;
-
-	ASSERT( pThis );
-	if (!pThis) return FALSE;
 	
 	// Offer the event to the framework controls first
 	result = _controlHandleEvent( pThis, eCode, wParam, dwParam );
@@ -433,3 +1625,54 @@ boolean State_HandleEvent( void *p,
 	return result;
 }
 
+/**
+ * Handles events for the application, updating the display 
+ * once afterwards for any regions invalidated along the way.
+ * @param void *p: pointer to app
+ * @param AEEEvent eCode: event code
+ * @param uint16 wParam: event parameter
+ * @param uint32 dwParam: event parameter
+ * @return TRUE if the event was handled
+ */
+boolean State_HandleEvent( void *p, 
+						  AEEEvent eCode, 
+						  uint16 wParam, 
+						  uint32 dwParam )
+{
+	boolean result, bDispatching;
+	CStateAppPtr pThis = ( CStateAppPtr )p;
+
+	ASSERT( pThis );
+	if (!pThis) return FALSE;
+
+	_stateCoalesceKey( pThis, eCode, wParam );
+
+	bDispatching = pThis->m_bDispatching;
+	pThis->m_bDispatching = TRUE;
+	result = _stateHandleEvent( pThis, eCode, wParam, dwParam );
+	pThis->m_bDispatching = bDispatching;
+	if ( !bDispatching ) State_Flush( p );
+
+	// Keep a snapshot while suspended, in case the shell stops us
+	// then; it's stale once we resume or exit normally.
+	if ( !bDispatching && pThis->m_nRegistry ) switch ( eCode )
+	{
+		case EVT_APP_SUSPEND:
+			State_Save( p, STATE_SNAPSHOT_FILE );
+			pThis->m_bSuspended = TRUE;
+			break;
+
+		case EVT_APP_RESUME:
+			pThis->m_bSuspended = FALSE;
+			_stateDropSnapshot( pThis, STATE_SNAPSHOT_FILE );
+			break;
+
+		case EVT_APP_STOP:
+			if ( !pThis->m_bSuspended ) 
+				_stateDropSnapshot( pThis, STATE_SNAPSHOT_FILE );
+			break;
+	}
+
+	return result;
+}
+
@@ -58,8 +58,32 @@ typedef enum
 	Ctl_LastFrameworkControl
 } EStateControl;
 
-typedef struct _Node CState;
-typedef struct _Node *CStatePtr;
+/**
+ * @name CState
+ * @memo A state on the state stack.
+ * @doc Holds a state's event handler and private data. The leading fields match _Node, so the node macros in utils.h work on the state stack.
+ */
+typedef struct _CState
+{
+	/// The state below this one on the stack
+	struct _CState *m_pNext;
+	/// The state's private data
+	void          *m_pData;
+	/// The state's event handler
+	void          *m_pMetaData;
+	/// Where this state's region of the scratch arena begins
+	uint32         m_nArenaMark;
+	/// TRUE if State_Transact pushed this state and it hasn't started yet
+	boolean        m_bDeferred;
+	/// TRUE if the framework should keep this state's screen when covered
+	boolean        m_bKeepScreen;
+	/// This state's screen, kept while another state covers it
+	IBitmap       *m_pScreen;
+	/// Size of the kept screen, in bytes
+	uint32         m_nScreenBytes;
+	/// TRUE if State_Restore rebuilt this state and it hasn't started yet
+	boolean        m_bRelaunched;
+} CState, *CStatePtr;
 
 /**
  * @name EStateChangeCause
@@ -76,6 +100,10 @@ typedef enum
 	StateChange_suspend = 2048, 
 	/// The system has sent an EVT_RESUME
 	StateChange_resume = 4096, 
+	/// Along with StateChange_pop: the framework has restored the state's screen
+	StateChange_restored = 8192,
+	/// Along with StateChange_push: the framework rebuilt the state and its scratch data from the suspend snapshot
+	StateChange_relaunch = 16384,
 	/// The state change cause mask
 	StateChange_causemask = 0xFF00,
 	StateChange_infomask = 0x00FF
@@ -141,6 +169,136 @@ typedef boolean (PFNSTATEEVENT)( void *pApp,
 /// Synonymous with POP when used as a state function.
 #define State_PopState ((PFNSTATEEVENT *)(-1))
 
+/**
+ * @name EStateOp
+ * @memo State stack operations.
+ * @doc Names the operations State_Transact can apply to the state stack.
+ */
+typedef enum
+{
+	/// Push the state in m_pfn.
+	StateOp_push,
+	/// Pop the current state.
+	StateOp_pop,
+	/// Replace the current state with the state in m_pfn.
+	StateOp_replace
+} EStateOp;
+
+/**
+ * @name CStateOp
+ * @memo One step of a state transaction.
+ * @doc An operation for State_Transact, and the state it pushes, if any.
+ */
+typedef struct _CStateOp
+{
+	/// The operation
+	EStateOp       m_eOp;
+	/// The state to push for StateOp_push and StateOp_replace
+	PFNSTATEEVENT *m_pfn;
+} CStateOp;
+
+/**
+ * @name CStatePoolStats
+ * @memo State node pool statistics.
+ * @doc Tracks how deep the state stack has grown and how often the state node pool had to fall back to the heap, so you can size STATE_POOL_DEPTH from real sessions.
+ */
+typedef struct _CStatePoolStats
+{
+	/// Number of states on the stack now.
+	uint16        m_nDepth;
+	/// Deepest the stack has been since launch.
+	uint16        m_nDepthHigh;
+	/// Number of state nodes handed out.
+	uint32        m_nAcquired;
+	/// Number of state nodes that came from the heap because the pool was empty.
+	uint32        m_nFallback;
+} CStatePoolStats;
+
+/**
+ * @name CStateArenaStats
+ * @memo Scratch arena statistics.
+ * @doc Tracks how much of the scratch arena states use, so you can size STATE_ARENA_SIZE and STATE_ARENA_BUDGET from real sessions.
+ */
+typedef struct _CStateArenaStats
+{
+	/// Most bytes in use across the whole stack.
+	uint32        m_nPeak;
+	/// Most bytes in use by any one state.
+	uint32        m_nStatePeak;
+	/// Number of allocations refused.
+	uint32        m_nFailed;
+} CStateArenaStats;
+
+#ifdef STATE_TRACE
+/**
+ * @name CStateTrace
+ * @memo State transition trace entry.
+ * @doc Records one call the framework made to a state's event handler during a state transition.
+ */
+typedef struct _CStateTrace
+{
+	/// When the handler was called, in milliseconds since power-up.
+	uint32        m_nTime;
+	/// The handler called.
+	PFNSTATEEVENT *m_pfn;
+	/// EVT_APP_START or EVT_APP_STOP.
+	AEEEvent      m_eCode;
+	/// The EStateChangeCause and EStateChangeInfo passed in wParam.
+	uint16        m_wReason;
+	/// How long the handler took, in milliseconds.
+	uint16        m_nDuration;
+	/// Number of states on the stack when the handler was called.
+	uint16        m_nDepth;
+	/// Change in heap use across the call, in bytes.
+	int32         m_nHeapDelta;
+	/// What the handler returned.
+	boolean       m_bResult;
+} CStateTrace;
+#endif
+
+/**
+ * @name CStateScreenStats
+ * @memo Kept screen statistics.
+ * @doc Tracks how often the framework kept and restored the screens of covered states, so you can size STATE_SCREEN_BUDGET from real sessions.
+ */
+typedef struct _CStateScreenStats
+{
+	/// Number of screens kept.
+	uint32        m_nKept;
+	/// Number of screens restored on pop.
+	uint32        m_nRestored;
+	/// Number of screens discarded to stay within budget.
+	uint32        m_nEvicted;
+} CStateScreenStats;
+
+/**
+ * @name CStateDisplayStats
+ * @memo Display invalidation statistics.
+ * @doc Tracks how often states invalidated the display and how often the framework flushed it. IDISPLAY_Update has no way to send part of the display, so each flush sends all of it; the regions invalidated only decide whether there's a flush at all.
+ */
+typedef struct _CStateDisplayStats
+{
+	/// Number of calls to State_Invalidate.
+	uint32        m_nInvalidated;
+	/// Number of display updates made by State_Flush.
+	uint32        m_nFlushes;
+} CStateDisplayStats;
+
+/**
+ * @name CStateCoalesceStats
+ * @memo Event coalescing statistics.
+ * @doc Tracks the key repeats and frame requests the framework merged into a pending frame.
+ */
+typedef struct _CStateCoalesceStats
+{
+	/// Number of key repeats that arrived while a frame was pending.
+	uint32        m_nKeysMerged;
+	/// Number of frame requests merged into a pending frame.
+	uint32        m_nFramesMerged;
+	/// Number of EVT_STATE_FRAME events sent.
+	uint32        m_nFrames;
+} CStateCoalesceStats;
+
 /**
  * @name CStateApp
  * @memo Application state data.
@@ -153,6 +311,76 @@ typedef struct _CStateApp
 
 	/// The state stack
 	CStatePtr      m_pState;
+
+	/// The preallocated state nodes
+	CState        *m_pStatePool;
+
+	/// Unused state nodes in the pool
+	CStatePtr      m_pStateFree;
+
+	/// Statistics on state node use
+	CStatePoolStats m_poolStats;
+
+	/// The scratch arena shared by the states on the stack
+	uint8         *m_pArena;
+
+	/// Bytes in use in the scratch arena
+	uint32         m_nArenaTop;
+
+	/// The state whose scratch memory the arena calls work on now
+	CStatePtr      m_pArenaOwner;
+
+	/// TRUE while the owner's scratch memory lies below another state's
+	boolean        m_bArenaSealed;
+
+	/// Statistics on scratch arena use
+	CStateArenaStats m_arenaStats;
+
+	/// Bytes used by kept screens
+	uint32         m_nScreenBytes;
+
+	/// Statistics on kept screens
+	CStateScreenStats m_screenStats;
+
+	/// The whole display, filled in on first use
+	AEERect        m_rcDisplay;
+
+	/// The union of the regions invalidated since the last flush
+	AEERect        m_rcDirty;
+
+	/// TRUE while State_HandleEvent is dispatching an event
+	boolean        m_bDispatching;
+
+	/// Statistics on invalidation and flushing
+	CStateDisplayStats m_displayStats;
+
+	/// TRUE if an EVT_STATE_FRAME is on its way
+	boolean        m_bFramePending;
+
+	/// The last key event passed on to the states, and its key
+	AEEEvent       m_eLastKey;
+	uint16         m_wLastKey;
+
+	/// Statistics on coalesced events
+	CStateCoalesceStats m_coalesceStats;
+
+	/// The application's state functions, by snapshot index
+	PFNSTATEEVENT * const *m_apfnRegistry;
+	uint8          m_nRegistry;
+
+	/// TRUE between EVT_APP_SUSPEND and EVT_APP_RESUME
+	boolean        m_bSuspended;
+
+#ifdef STATE_TRACE
+	/// The transition trace ring buffer
+	CStateTrace    m_aTrace[ STATE_TRACE_DEPTH ];
+
+	/// Number of trace entries ever recorded
+	uint32         m_nTrace;
+
+	/// The heap, for measuring each handler's heap use
+	IHeap         *m_pIHeap;
+#endif
 	
 	/// The application preferences
 	CAppPrefs	   *m_pAppPrefs;
@@ -160,11 +388,24 @@ typedef struct _CStateApp
 	/// The application global data
 	CAppData	   *m_pAppData;
 
-	/// The pool of controls that the framework will manage.
+	/// The pool of controls that the framework will manage, and
+	/// the number of its slots up to the last that holds a control.
 	IControl      *m_apControl[ MAX_NUM_CONTROLS ];
 	uint8         m_nControl;
+
+	/// One bit for each pool slot whose control is on screen.
+	uint32        m_nShownMask;
+
+	/// One bit for each pool slot ever shown or hidden with 
+	/// Control_SetShown; the others get every event, as before.
+	uint32        m_nTrackedMask;
 } CStateApp, *CStateAppPtr;
 
+// m_nShownMask and m_nTrackedMask have a bit for each pool slot
+#if MAX_NUM_CONTROLS > 32
+#error MAX_NUM_CONTROLS must be 32 or fewer
+#endif
+
 // Handy-dandy accessors and such.
 
 /**
@@ -244,6 +485,76 @@ typedef struct _CStateApp
       ((CStateAppPtr)(app))->m_pState->m_pNext : NULL )
 
 
+/**
+ * @name State_IsControlShown
+ * @memo Returns whether a framework control is on screen.
+ * @doc Returns TRUE if the control in the indicated slot of the control pool was shown with Control_ShowControl and hasn't been hidden since. Controls shown by calling ICONTROL_SetActive directly aren't tracked, and aren't reported here.
+ */
+#define State_IsControlShown( app, c ) \
+	( ( ((CStateAppPtr)(app))->m_nShownMask & ( 1 << (c) ) ) != 0 )
+
+/**
+ * @name State_GetPoolStats
+ * @memo Returns the state node pool statistics.
+ * @doc Returns a pointer to the CStatePoolStats for the application's state node pool.
+ */
+#define State_GetPoolStats( app ) \
+	( &((CStateAppPtr)(app))->m_poolStats )
+
+/**
+ * @name State_GetArenaStats
+ * @memo Returns the scratch arena statistics.
+ * @doc Returns a pointer to the CStateArenaStats for the application's scratch arena.
+ */
+#define State_GetArenaStats( app ) \
+	( &((CStateAppPtr)(app))->m_arenaStats )
+
+/**
+ * @name State_GetScreenStats
+ * @memo Returns the kept screen statistics.
+ * @doc Returns a pointer to the CStateScreenStats for the application's kept screens.
+ */
+#define State_GetScreenStats( app ) \
+	( &((CStateAppPtr)(app))->m_screenStats )
+
+/**
+ * @name State_GetDisplayStats
+ * @memo Returns the display invalidation statistics.
+ * @doc Returns a pointer to the CStateDisplayStats for the application's display.
+ */
+#define State_GetDisplayStats( app ) \
+	( &((CStateAppPtr)(app))->m_displayStats )
+
+/**
+ * @name State_GetCoalesceStats
+ * @memo Returns the event coalescing statistics.
+ * @doc Returns a pointer to the CStateCoalesceStats for the application.
+ */
+#define State_GetCoalesceStats( app ) \
+	( &((CStateAppPtr)(app))->m_coalesceStats )
+
+/**
+ * @name State_SetRegistry
+ * @memo Sets the state registry.
+ * @doc Tells the framework which state functions a snapshot may name; pass an array like AS_STATES and its length. Without a registry, the framework doesn't write snapshots.
+ */
+#define State_SetRegistry( app, apfn, n ) \
+	( ((CStateAppPtr)(app))->m_apfnRegistry = (apfn), \
+	  ((CStateAppPtr)(app))->m_nRegistry = (uint8)(n) )
+
+/**
+ * @name EVT_STATE_FRAME
+ * @memo Frame event.
+ * @doc The framework sends this to the current state when a frame requested with State_RequestFrame is due. Draw the state's screen and invalidate what changed.
+ */
+#define EVT_STATE_FRAME ( EVT_USER + 0x0100 )
+
+/**
+ * @name STATE_ARENA_ALIGN
+ * @memo Rounds a scratch allocation up to pointer alignment.
+ */
+#define STATE_ARENA_ALIGN( n ) ( ( (n) + 7 ) & ~7 )
+
 /** 
  * @name STATE_DEFERREDACTIONDELAY
  * @memo Delay for deferred action
@@ -263,6 +574,27 @@ typedef struct _CStateApp
 	p );
 
 
+/**
+ * @name State_TraceInit
+ * @memo Prepares transition tracing.
+ * @doc Does nothing unless STATE_TRACE is defined.
+ */
+/**
+ * @name State_TraceFree
+ * @memo Ends transition tracing.
+ * @doc Writes the trace to the debug log. Does nothing unless STATE_TRACE is defined.
+ */
+/**
+ * @name State_TraceDump
+ * @memo Writes the transition trace.
+ * @doc Writes the trace entries, oldest first, to the named file, or to the debug log if the name is NULL. Does nothing unless STATE_TRACE is defined.
+ */
+#ifndef STATE_TRACE
+#define State_TraceInit( p ) ( SUCCESS )
+#define State_TraceFree( p )
+#define State_TraceDump( p, f ) ( SUCCESS )
+#endif
+
 /*
  * Prototypes
  */
@@ -282,3 +614,27 @@ boolean State_PushEx( void *p,
 				             boolean bError);
 boolean State_Replace( void *p,
 						PFNSTATEEVENT *pfEvent);
+boolean State_Transact( void *p,
+						const CStateOp *pOps,
+						int nOps,
+						unsigned char info );
+int State_PoolInit( void *p );
+void State_PoolFree( void *p );
+int State_ArenaInit( void *p );
+void State_ArenaFree( void *p );
+void *State_Alloc( void *p, uint32 nBytes );
+void *State_GetScratch( void *p );
+void State_KeepScreen( void *p, boolean bKeep );
+void State_DropScreens( void *p );
+void State_Invalidate( void *p, const AEERect *prc );
+void State_Flush( void *p );
+void State_RequestFrame( void *p );
+void State_CancelFrame( void *p );
+int State_Save( void *p, const char *pszFile );
+int State_Restore( void *p, const char *pszFile );
+boolean State_HasSnapshot( void *p, const char *pszFile );
+#ifdef STATE_TRACE
+int State_TraceInit( void *p );
+void State_TraceFree( void *p );
+int State_TraceDump( void *p, const char *pszFile );
+#endif
@@ -87,7 +87,7 @@ typedef struct _Node
 	void *m_pData;
 	/// Pointer to any additional data for this node.
 	void *m_pMetaData;
-};
+} Node;
 
 /** 
  * @name NodeLinkNext
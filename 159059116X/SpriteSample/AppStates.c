@@ -21,17 +21,28 @@
 * Prototypes
 */
 static void initSprites( AEESpriteCmd *pSprites );
-static int initTiles( CAppPtr pThis, 
-	AEETileMap *pTileMap, 
-	int width, int height,
-	uint16 *pRandom );
+static void initChunk( uint16 *pTile, uint16 *pRandom, int *pFlower );
+static int worldCreate( IFileMgr *pIFileMgr );
+static int worldOpen( CAppPtr pThis, CChunkCachePtr pCache );
+static CChunkPtr chunkGet( CAppPtr pThis, int cx, int cy, boolean bAhead );
+static void viewTiles( CAppPtr pThis );
+static void viewLoadAhead( CAppPtr pThis );
+static void viewScroll( CAppPtr pThis, int dx, int dy );
 static int createBitmap( CAppPtr pThis, int16 w, int16 h, IBitmap **ppIBitmap );
+static int loadAtlas( CAppPtr pThis, IBitmap **ppISprites, 
+					  IBitmap **ppITiles );
 static int loadSprites( CAppPtr pThis, IBitmap **ppBitmap );
 static int loadTiles( CAppPtr pThis, IBitmap **ppBitmap );
+static void spriteBounds( AEESpriteCmd *pSprite, AEERect *prc );
+static int addDirtyRect( CAppPtr pThis, AEERect *arDirty, int nDirty,
+						 const AEERect *prc );
 static void mainDrawUpdate( CAppPtr pThis );
 static void moveButterflies( CAppPtr pThis, uint16 *pRandom );
 static void moveMouse( CAppPtr pThis, uint16 *pRandom );
+static void mainStep( CAppPtr pThis );
+static void mainDrawStart( CAppPtr pThis );
 static void mainDraw( void *p );
+static void mainDrawReport( CAppPtr pThis );
 static void mainSoundNotifyCallback( void *p, 
 									 AEESoundPlayerCmd  eType,
 									 AEESoundPlayerStatus eStatus,
@@ -48,10 +59,19 @@ static boolean mainExit( void *p,
 */
 
 
+/*
+* Sprites are kept PIN_MARGIN pixels inside the display's edges.
+*/
+#define PIN_MARGIN ( 8 )
+#define PIN_SPRITE_PIXELS ( 16 )
 #define PIN_X_COORD( pThis, x ) \
-	if ( x < 8 ) x = 8; else if ( x > 100 ) x = 100;
+	if ( x < PIN_MARGIN ) x = PIN_MARGIN; \
+	else if ( x > (pThis)->m_cx - PIN_SPRITE_PIXELS - PIN_MARGIN ) \
+		x = (pThis)->m_cx - PIN_SPRITE_PIXELS - PIN_MARGIN;
 #define PIN_Y_COORD( pThis, y ) \
-	if ( y < 8 ) y = 8; else if ( y > 100 ) y = 100;
+	if ( y < PIN_MARGIN ) y = PIN_MARGIN; \
+	else if ( y > (pThis)->m_cy - PIN_SPRITE_PIXELS - PIN_MARGIN ) \
+		y = (pThis)->m_cy - PIN_SPRITE_PIXELS - PIN_MARGIN;
 
 
 static void initSprites( AEESpriteCmd *pSprites )
@@ -97,23 +117,19 @@ static void initSprites( AEESpriteCmd *pSprites )
 	pSprites[Sprite_Butterfly_Blue].unComposite = COMPOSITE_KEYCOLOR;
 }
 
-static int initTiles( CAppPtr pThis, 
-	AEETileMap *pTileMap, 
-	int width, int height,
-	uint16 *pRandom )
+/**
+* Fills in a chunk of the world, mostly grass with the odd flower.
+* @param uint16 *pTile: the chunk's tiles
+* @param uint16 *pRandom: a random number for each tile
+* @param int *pFlower: counts flowers, to alternate their colors
+* @return nothing
+*/
+static void initChunk( uint16 *pTile, uint16 *pRandom, int *pFlower )
 {
 	int i;
-	uint16 *pTile;
-	int flower = 0;
-	
-	// Create the tile map array.
-	pTileMap->pMapArray = (uint16 *)MALLOC( width * height * sizeof( uint16 ) );
 
-	if ( !pTileMap->pMapArray ) return ENOMEMORY;
-	// Now fill it
-	pTile = pTileMap->pMapArray;
 	for ( i = 0; 
-		  i < ( width * height ); 
+		  i < ( CHUNK_TILES * CHUNK_TILES ); 
 		  i++ )
 	{
 		*pTile = *pRandom % 24;
@@ -121,7 +137,7 @@ static int initTiles( CAppPtr pThis,
 		if ( *pTile == 0 )
 		{
 			// Get another random bit to choose the tile
-			if ( flower % 2 )
+			if ( *pFlower % 2 )
 			{
 				*pTile = Tile_Pink;
 			}
@@ -129,7 +145,7 @@ static int initTiles( CAppPtr pThis,
 			{
 				*pTile = Tile_Purple;
 			}
-			flower++;
+			(*pFlower)++;
 		}
 		else
 		{
@@ -138,35 +154,270 @@ static int initTiles( CAppPtr pThis,
 		pRandom++;
 		pTile++;
 	}
-	
-	// Center the tile map on the display.
-	pTileMap->x = 0;
-	pTileMap->y = 0;
-	pTileMap->w = MAP_SIZE_8;
-	pTileMap->h = MAP_SIZE_8;
-	
-	// The tiles are 16x16 pixels
-	pTileMap->unTileSize = TILE_SIZE_16X16;
+}
+
+/**
+* Makes the world file, a chunk at a time.
+* @param IFileMgr *pIFileMgr: file manager
+* @return SUCCESS, or EFAILED if the file couldn't be written
+*/
+static int worldCreate( IFileMgr *pIFileMgr )
+{
+	IFile *pIFile;
+	CWorldHeader header;
+	uint16 arTiles[ CHUNK_TILES * CHUNK_TILES ];
+	uint16 arRandom[ CHUNK_TILES * CHUNK_TILES ];
+	int flower = 0;
+	int i, result = SUCCESS;
+
+	IFILEMGR_Remove( pIFileMgr, WORLD_FILE );
+	pIFile = IFILEMGR_OpenFile( pIFileMgr, WORLD_FILE, _OFM_CREATE );
+	if ( !pIFile ) return EFAILED;
+
+	MEMSET( &header, 0, sizeof( header ) );
+	header.m_nMagic = WORLD_MAGIC;
+	header.m_nChunksX = WORLD_CHUNKS_X;
+	header.m_nChunksY = WORLD_CHUNKS_Y;
+	header.m_nChunkTiles = CHUNK_TILES;
+	if ( IFILE_Write( pIFile, &header, sizeof( header ) ) != 
+		 sizeof( header ) )
+		result = EFAILED;
+
+	for ( i = 0; 
+		  result == SUCCESS && i < WORLD_CHUNKS_X * WORLD_CHUNKS_Y; 
+		  i++ )
+	{
+		GETRAND( (byte *)arRandom, sizeof( arRandom ) );
+		initChunk( arTiles, arRandom, &flower );
+		if ( IFILE_Write( pIFile, arTiles, sizeof( arTiles ) ) != 
+			 sizeof( arTiles ) )
+			result = EFAILED;
+	}
+
+	IFILE_Release( pIFile );
+	if ( result != SUCCESS ) IFILEMGR_Remove( pIFileMgr, WORLD_FILE );
+	return result;
+}
+
+/**
+* Opens the world file, making it first if it's missing or was
+* made with different options.
+* @param CAppPtr pThis: this application
+* @param CChunkCachePtr pCache: chunk cache to read the world into
+* @return SUCCESS, or EFAILED if there's no world to read
+*/
+static int worldOpen( CAppPtr pThis, CChunkCachePtr pCache )
+{
+	IFileMgr *pIFileMgr = NULL;
+	CWorldHeader header;
+	int i, result = SUCCESS;
+
+	for ( i = 0; i < CHUNK_CACHE_SLOTS; i++ )
+	{
+		pCache->m_arChunks[ i ].m_nX = -1;
+		pCache->m_arChunks[ i ].m_nY = -1;
+	}
+
+	if ( ISHELL_CreateInstance( GetShell( pThis ), AEECLSID_FILEMGR,
+			(void **)&pIFileMgr ) != SUCCESS )
+		return EFAILED;
+
+	pCache->m_pIFile = IFILEMGR_OpenFile( pIFileMgr, WORLD_FILE, _OFM_READ );
+	if ( pCache->m_pIFile &&
+		 ( IFILE_Read( pCache->m_pIFile, &header, sizeof( header ) ) != 
+		   sizeof( header ) ||
+		   header.m_nMagic != WORLD_MAGIC ||
+		   header.m_nChunksX != WORLD_CHUNKS_X ||
+		   header.m_nChunksY != WORLD_CHUNKS_Y ||
+		   header.m_nChunkTiles != CHUNK_TILES ) )
+	{
+		IFILE_Release( pCache->m_pIFile );
+		pCache->m_pIFile = NULL;
+	}
+
+	if ( !pCache->m_pIFile )
+	{
+		result = worldCreate( pIFileMgr );
+		if ( result == SUCCESS )
+			pCache->m_pIFile = 
+				IFILEMGR_OpenFile( pIFileMgr, WORLD_FILE, _OFM_READ );
+		if ( !pCache->m_pIFile ) result = EFAILED;
+	}
+
+	IFILEMGR_Release( pIFileMgr );
+	return result;
+}
+
+/**
+* Gets a chunk of the world, reading it from the world file if 
+* it's not in memory. When the cache is full, the chunk used 
+* least recently makes room.
+* @param CAppPtr pThis: this application
+* @param int cx: chunk column
+* @param int cy: chunk row
+* @param boolean bAhead: TRUE if the chunk isn't in view yet
+* @return the chunk, or NULL if it couldn't be read
+*/
+static CChunkPtr chunkGet( CAppPtr pThis, int cx, int cy, boolean bAhead )
+{
+	CChunkCachePtr pCache = &GetAppData( pThis )->chunks;
+	CChunkPtr pChunk = NULL;
+	CChunkPtr pSlot;
+	int i;
+
+	pCache->m_nClock++;
+	for ( i = 0; i < CHUNK_CACHE_SLOTS; i++ )
+	{
+		pSlot = &pCache->m_arChunks[ i ];
+		if ( pSlot->m_nX == cx && pSlot->m_nY == cy )
+		{
+			pSlot->m_nUsed = pCache->m_nClock;
+			if ( !bAhead ) pCache->m_nHits++;
+			return pSlot;
+		}
+		// Empty slots first, then the least recently used
+		if ( !pChunk || 
+			 ( pChunk->m_nX >= 0 && 
+			   ( pSlot->m_nX < 0 || pSlot->m_nUsed < pChunk->m_nUsed ) ) )
+			pChunk = pSlot;
+	}
+
+	if ( pChunk->m_nX >= 0 ) pCache->m_nEvictions++;
+	pChunk->m_nX = pChunk->m_nY = -1;
+	if ( IFILE_Seek( pCache->m_pIFile, _SEEK_START, 
+			sizeof( CWorldHeader ) + 
+			( cy * WORLD_CHUNKS_X + cx ) * sizeof( pChunk->m_arTiles ) ) 
+			!= SUCCESS ||
+		 IFILE_Read( pCache->m_pIFile, pChunk->m_arTiles, 
+			sizeof( pChunk->m_arTiles ) ) != sizeof( pChunk->m_arTiles ) )
+		return NULL;
+
+	pChunk->m_nX = (int16)cx;
+	pChunk->m_nY = (int16)cy;
+	pChunk->m_nUsed = pCache->m_nClock;
+	if ( bAhead ) pCache->m_nAheadLoads++;
+	else pCache->m_nLoads++;
+	return pChunk;
+}
+
+/**
+* Builds the tile map list for ISPRITE_DrawTiles from the chunks
+* the display shows now; the rest of the world isn't drawn.
+* @param CAppPtr pThis: this application
+* @return nothing
+*/
+static void viewTiles( CAppPtr pThis )
+{
+	CAppDataPtr pData = GetAppData( pThis );
+	AEETileMap *pTileMap = pData->arTileMap;
+	CChunkPtr pChunk;
+	int cx0, cy0, cx1, cy1, cx, cy;
+	int n = 0;
+
+	cx0 = pData->nViewX / CHUNK_PIXELS;
+	cy0 = pData->nViewY / CHUNK_PIXELS;
+	cx1 = ( pData->nViewX + pThis->m_cx - 1 ) / CHUNK_PIXELS;
+	cy1 = ( pData->nViewY + pThis->m_cy - 1 ) / CHUNK_PIXELS;
+	if ( cx1 >= WORLD_CHUNKS_X ) cx1 = WORLD_CHUNKS_X - 1;
+	if ( cy1 >= WORLD_CHUNKS_Y ) cy1 = WORLD_CHUNKS_Y - 1;
+
+	ASSERT( ( cx1 - cx0 + 1 ) * ( cy1 - cy0 + 1 ) <= VIEW_MAX_CHUNKS );
+	for ( cy = cy0; cy <= cy1; cy++ )
+		for ( cx = cx0; cx <= cx1 && n < VIEW_MAX_CHUNKS; cx++ )
+		{
+			pChunk = chunkGet( pThis, cx, cy, FALSE );
+			if ( !pChunk ) continue;
+
+			pTileMap->pMapArray = pChunk->m_arTiles;
+
+			// Place the chunk where it falls on the display
+			pTileMap->x = (int16)( cx * CHUNK_PIXELS - pData->nViewX );
+			pTileMap->y = (int16)( cy * CHUNK_PIXELS - pData->nViewY );
+			pTileMap->w = CHUNK_MAP_SIZE;
+			pTileMap->h = CHUNK_MAP_SIZE;
+
+			// The tiles are 16x16 pixels
+			pTileMap->unTileSize = TILE_SIZE_16X16;
+
+			// No flags
+			pTileMap->unFlags = 0;
+
+			// You MUST set these to zero, or bad things happen.
+			pTileMap->reserved[ 0 ] = 
+			pTileMap->reserved[ 1 ] = 
+			pTileMap->reserved[ 2 ] = 
+			pTileMap->reserved[ 3 ] = 0;
+
+			pTileMap->reserved2[ 0 ] = 
+			pTileMap->reserved2[ 1 ] = 
+			pTileMap->reserved2[ 2 ] = 0;
+
+			pTileMap++;
+			n++;
+		}
 
-	// No flags
-	pTileMap->unFlags = 0;
-	
-	// You MUST set these to zero, or bad things happen.
-	pTileMap->reserved[ 0 ] = 
-	pTileMap->reserved[ 1 ] = 
-	pTileMap->reserved[ 2 ] = 
-	pTileMap->reserved[ 3 ] = 0;
-	
-	pTileMap->reserved2[ 0 ] = 
-	pTileMap->reserved2[ 1 ] = 
-	pTileMap->reserved2[ 2 ] = 0;
-	
 	// Initialize the end-of-tile-map structure
-	pTileMap++;
-	
 	pTileMap->pMapArray = NULL;
-	
-	return SUCCESS;
+}
+
+/**
+* Reads the chunks just past the edge of the display the view
+* last scrolled toward, so they're ready when they come into view.
+* @param CAppPtr pThis: this application
+* @return nothing
+*/
+static void viewLoadAhead( CAppPtr pThis )
+{
+	CAppDataPtr pData = GetAppData( pThis );
+	int cx0, cy0, cx1, cy1, cx, cy, c;
+
+	cx0 = pData->nViewX / CHUNK_PIXELS;
+	cy0 = pData->nViewY / CHUNK_PIXELS;
+	cx1 = ( pData->nViewX + pThis->m_cx - 1 ) / CHUNK_PIXELS;
+	cy1 = ( pData->nViewY + pThis->m_cy - 1 ) / CHUNK_PIXELS;
+
+	if ( pData->nScrollDX )
+	{
+		cx = pData->nScrollDX > 0 ? cx1 + 1 : cx0 - 1;
+		if ( cx >= 0 && cx < WORLD_CHUNKS_X )
+			for ( c = cy0; c <= cy1 && c < WORLD_CHUNKS_Y; c++ )
+				chunkGet( pThis, cx, c, TRUE );
+	}
+	if ( pData->nScrollDY )
+	{
+		cy = pData->nScrollDY > 0 ? cy1 + 1 : cy0 - 1;
+		if ( cy >= 0 && cy < WORLD_CHUNKS_Y )
+			for ( c = cx0; c <= cx1 && c < WORLD_CHUNKS_X; c++ )
+				chunkGet( pThis, c, cy, TRUE );
+	}
+}
+
+/**
+* Scrolls the view over the world, as far as the world goes.
+* @param CAppPtr pThis: this application
+* @param int dx: pixels to scroll right
+* @param int dy: pixels to scroll down
+* @return nothing
+*/
+static void viewScroll( CAppPtr pThis, int dx, int dy )
+{
+	CAppDataPtr pData = GetAppData( pThis );
+	int32 maxX = WORLD_CHUNKS_X * CHUNK_PIXELS - pThis->m_cx;
+	int32 maxY = WORLD_CHUNKS_Y * CHUNK_PIXELS - pThis->m_cy;
+	int32 x = pData->nViewX + dx;
+	int32 y = pData->nViewY + dy;
+
+	if ( x > maxX ) x = maxX;
+	if ( x < 0 ) x = 0;
+	if ( y > maxY ) y = maxY;
+	if ( y < 0 ) y = 0;
+	if ( x == pData->nViewX && y == pData->nViewY ) return;
+
+	pData->nScrollDX = x - pData->nViewX;
+	pData->nScrollDY = y - pData->nViewY;
+	pData->nViewX = x;
+	pData->nViewY = y;
+	pData->bRedrawAll = TRUE;
 }
 
 static int createBitmap( CAppPtr pThis, int16 w, int16 h, IBitmap **ppIBitmap )
@@ -194,6 +445,128 @@ static int createBitmap( CAppPtr pThis, int16 w, int16 h, IBitmap **ppIBitmap )
 	return SUCCESS;
 }
 
+/**
+* Makes the sprite and tile buffers from the atlas, read from the
+* resource file in one piece. The atlas is already in the 
+* display's pixel format, so its rows are copied straight into
+* the buffers rather than converted image by image; an atlas
+* that isn't 16 bits per pixel, runs past the end of the 
+* resource, or doesn't hold every sprite and tile exactly once,
+* isn't used.
+* @param CAppPtr pThis: this application
+* @param IBitmap **ppISprites: returns the sprite buffer
+* @param IBitmap **ppITiles: returns the tile buffer
+* @return SUCCESS, or EFAILED if there's no atlas the display can use
+*/
+static int loadAtlas( CAppPtr pThis, IBitmap **ppISprites, 
+					  IBitmap **ppITiles )
+{
+	byte *pRes, *pData, *pPixels;
+	uint32 nSize = 0;
+	CAtlasHeader header;
+	CAtlasEntry entry;
+	IDIB *arDIB[ 2 ] = { NULL, NULL };
+	IDIB *pIDIB;
+	int i, y, nRow, nImage;
+	uint32 nWritten = 0;
+	int result = SUCCESS;
+
+	*ppISprites = *ppITiles = NULL;
+
+	pRes = (byte *)ISHELL_LoadResDataEx( GetShell( pThis ), APP_RES_FILE, 
+										 RESID_ATLAS, RESTYPE_IMAGE, 
+										 NULL, &nSize );
+	if ( !pRes ) return EFAILED;
+
+	// Image resources start with the offset to their data, which
+	// needn't be aligned; so the header and entries are copied out.
+	if ( nSize < 1 || *pRes + sizeof( CAtlasHeader ) > nSize )
+	{
+		ISHELL_FreeResData( GetShell( pThis ), pRes );
+		return EFAILED;
+	}
+	pData = pRes + *pRes;
+	nSize -= *pRes;
+	MEMCPY( &header, pData, sizeof( CAtlasHeader ) );
+	pPixels = pData + sizeof( CAtlasHeader ) + 
+		header.m_nEntries * sizeof( CAtlasEntry );
+
+	// The pixels are copied as they are, so they must be 16-bit, 
+	// and the entries and every row must be in the resource.
+	if ( header.m_anMagic[ 0 ] != (uint16)ATLAS_MAGIC ||
+		 header.m_anMagic[ 1 ] != (uint16)( ATLAS_MAGIC >> 16 ) ||
+		 header.m_nDepth != 16 ||
+		 header.m_nEntries != Sprite_Last + Tile_Last ||
+		 sizeof( CAtlasHeader ) + 
+		 header.m_nEntries * sizeof( CAtlasEntry ) +
+		 (uint32)header.m_cx * header.m_cy * sizeof( uint16 ) > nSize ||
+		 createBitmap( pThis, 16, 16 * Sprite_Last, ppISprites ) != SUCCESS ||
+		 createBitmap( pThis, 16, 16 * Tile_Last, ppITiles ) != SUCCESS ||
+		 IBITMAP_QueryInterface( *ppISprites, AEECLSID_DIB, 
+								 (void **)&arDIB[ 0 ] ) != SUCCESS ||
+		 IBITMAP_QueryInterface( *ppITiles, AEECLSID_DIB, 
+								 (void **)&arDIB[ 1 ] ) != SUCCESS ||
+		 arDIB[ 0 ]->nDepth != header.m_nDepth ||
+		 arDIB[ 0 ]->nColorScheme != header.m_nColorScheme )
+		result = EFAILED;
+
+	for ( i = 0; result == SUCCESS && i < header.m_nEntries; i++ )
+	{
+		MEMCPY( &entry, pData + sizeof( CAtlasHeader ) + 
+				i * sizeof( CAtlasEntry ), sizeof( CAtlasEntry ) );
+		if ( entry.m_nResID >= RESID_SPRITE_BASE && 
+			 entry.m_nResID < RESID_SPRITE_BASE + Sprite_Last )
+		{
+			pIDIB = arDIB[ 0 ];
+			nImage = entry.m_nResID - RESID_SPRITE_BASE;
+			nRow = 16 * nImage;
+		}
+		else if ( entry.m_nResID >= RESID_TILE_BASE && 
+				  entry.m_nResID < RESID_TILE_BASE + Tile_Last )
+		{
+			pIDIB = arDIB[ 1 ];
+			nRow = 16 * ( entry.m_nResID - RESID_TILE_BASE );
+			nImage = Sprite_Last + entry.m_nResID - RESID_TILE_BASE;
+		}
+		else 
+		{
+			result = EFAILED;
+			break;
+		}
+		// Each image must be in the atlas once; one that's missing
+		// would be left as createBitmap's fill.
+		if ( nWritten & ( 1UL << nImage ) ||
+			 entry.m_cx != 16 || entry.m_cy != 16 ||
+			 entry.m_x + entry.m_cx > header.m_cx ||
+			 entry.m_y + entry.m_cy > header.m_cy )
+		{
+			result = EFAILED;
+			break;
+		}
+
+		for ( y = 0; y < 16; y++ )
+			MEMCPY( pIDIB->pBmp + ( nRow + y ) * pIDIB->nPitch,
+					pPixels + ( ( entry.m_y + y ) * header.m_cx + 
+								entry.m_x ) * sizeof( uint16 ),
+					16 * sizeof( uint16 ) );
+		nWritten |= 1UL << nImage;
+	}
+	if ( result == SUCCESS && 
+		 nWritten != ( 1UL << ( Sprite_Last + Tile_Last ) ) - 1 )
+		result = EFAILED;
+
+	if ( arDIB[ 0 ] ) IDIB_Release( arDIB[ 0 ] );
+	if ( arDIB[ 1 ] ) IDIB_Release( arDIB[ 1 ] );
+	ISHELL_FreeResData( GetShell( pThis ), pRes );
+	if ( result != SUCCESS )
+	{
+		if ( *ppISprites ) IBITMAP_Release( *ppISprites );
+		if ( *ppITiles ) IBITMAP_Release( *ppITiles );
+		*ppISprites = *ppITiles = NULL;
+	}
+	return result;
+}
+
 static int loadSprites( CAppPtr pThis, IBitmap **ppBitmap )
 {
 	IBitmap *pISpriteBitmap;
@@ -309,16 +682,16 @@ int AS_Init( CAppPtr pThis )
 {
 	CAppDataPtr pAppData;
 	int result = EFAILED;
-	uint16 arRandom[ 256  ];
-	int width, height;
-	IBitmap *pIBitmap;
+	IBitmap *pIBitmap, *pITileBitmap;
 	ISprite *pISprite;
-	
-	width = 8;
-	height = 8;
 
 	ASSERT( pThis );
 
+	// The world's drawn a chunk at a time, and there's only room
+	// for the chunks a display up to VIEW_MAX_CX by VIEW_MAX_CY shows.
+	if ( pThis->m_cx > VIEW_MAX_CX || pThis->m_cy > VIEW_MAX_CY )
+		return EFAILED;
+
 	// Create the application's global data here.
 	pAppData = MALLOC( sizeof( CAppData ) );
 
@@ -334,59 +707,62 @@ int AS_Init( CAppPtr pThis )
 
 		if ( result == SUCCESS )
 		{
-			// Get a bag of random numbers
-			GETRAND( (byte *)arRandom, 
-			( 2 * Sprite_Last + width * height ) 
-				* sizeof( uint16 ) );
-
-			// Initialize our sprites
+			// Initialize our sprites and tiles, from the atlas
+			// if there's one the display can use.
 			initSprites( pAppData->arSprites );
-			result = loadSprites( pThis, &pIBitmap );
+			result = loadAtlas( pThis, &pIBitmap, &pITileBitmap );
 			if ( result != SUCCESS )
 			{
-				if ( pIBitmap ) IBITMAP_Release( pIBitmap );
-				ISPRITE_Release( pISprite );
-				return result;
+				result = loadSprites( pThis, &pIBitmap );
+				if ( result == SUCCESS )
+				{
+					result = loadTiles( pThis, &pITileBitmap );
+					if ( result != SUCCESS ) IBITMAP_Release( pIBitmap );
+				}
 			}
-			ISPRITE_SetSpriteBuffer( pISprite, TILE_SIZE_16X16, pIBitmap );
-			IBITMAP_Release( pIBitmap );
-			
-			pIBitmap = NULL;
-			
-			// Initialize our tile map
-			result = initTiles( pThis, 
-				pAppData->arTileMap,
-				width, height,
-				arRandom );
 			if ( result != SUCCESS )
 			{
-				if ( pIBitmap ) IBITMAP_Release( pIBitmap );
 				ISPRITE_Release( pISprite );
+				FREE( pAppData );
 				return result;
 			}
-			result = loadTiles( pThis, &pIBitmap );
+			ISPRITE_SetSpriteBuffer( pISprite, TILE_SIZE_16X16, pIBitmap );
+			IBITMAP_Release( pIBitmap );
+			ISPRITE_SetTileBuffer( pISprite, TILE_SIZE_16X16, pITileBitmap );
+			IBITMAP_Release( pITileBitmap );
+			
+			// Open the world; its chunks are read as they're seen
+			result = worldOpen( pThis, &pAppData->chunks );
 			if ( result != SUCCESS )
 			{
-				IBITMAP_Release( pIBitmap );
 				ISPRITE_Release( pISprite );
+				FREE( pAppData );
 				return result;
 			}
-			ISPRITE_SetTileBuffer( pISprite, TILE_SIZE_16X16, pIBitmap );
-			IBITMAP_Release( pIBitmap );
 
 			// Set the destination
 			result = createBitmap( pThis, pThis->m_cx, pThis->m_cy, &pIBitmap );
 			if ( result != SUCCESS )
 			{
+				IFILE_Release( pAppData->chunks.m_pIFile );
 				ISPRITE_Release( pISprite );
+				FREE( pAppData );
 				return result;
 			}
 			ISPRITE_SetDestination( pAppData->pISprite, pIBitmap );
 			pAppData->pIBitmap = pIBitmap;
+
+			// Keep a copy of the tiles if there's room; without
+			// one, every update redraws the whole display.
+			if ( createBitmap( pThis, pThis->m_cx, pThis->m_cy, 
+							   &pAppData->pIBackground ) != SUCCESS )
+				pAppData->pIBackground = NULL;
 			
 			// Stash aside our application globals
 			SetAppData( pThis, pAppData );
 		}
+		else
+			FREE( pAppData );
 	}
 
 	return result;
@@ -408,8 +784,10 @@ void AS_Free( CAppPtr pThis )
 	{
 		if ( pAppData->pISprite ) ISPRITE_Release( pAppData->pISprite );
 		if ( pAppData->pIBitmap ) IBITMAP_Release( pAppData->pIBitmap );
-		if ( pAppData->arTileMap[0].pMapArray )
-			FREE( pAppData->arTileMap[0].pMapArray );
+		if ( pAppData->pIBackground ) 
+			IBITMAP_Release( pAppData->pIBackground );
+		if ( pAppData->chunks.m_pIFile ) 
+			IFILE_Release( pAppData->chunks.m_pIFile );
 			
 		FREE( pAppData );
 		pAppData = NULL;
@@ -504,30 +882,150 @@ int AS_DBFieldToDatabase( CAppRecordPtr pRecord,
 	return result;
 }
 
+/**
+* Finds the part of the display a sprite covers. SpriteSample's
+* sprites are 16x16; a sprite drawn at twice its size is given a
+* box that covers it whether it grows from its corner or its 
+* center.
+* @param AEESpriteCmd *pSprite: sprite
+* @param AEERect *prc: where to store the sprite's bounds
+* @return nothing
+*/
+static void spriteBounds( AEESpriteCmd *pSprite, AEERect *prc )
+{
+	if ( pSprite->unTransform & TRANSFORM_SCALE_2 )
+		SETAEERECT( prc, pSprite->x - 8, pSprite->y - 8, 40, 40 );
+	else
+		SETAEERECT( prc, pSprite->x, pSprite->y, 16, 16 );
+}
+
+/**
+* Adds a rectangle to a list of regions to redraw, clipped to the 
+* display. Regions that overlap are merged, so no pixel is drawn
+* twice.
+* @param CAppPtr pThis: this application
+* @param AEERect *arDirty: regions to redraw
+* @param int nDirty: number of regions
+* @param const AEERect *prc: rectangle to add
+* @return new number of regions
+*/
+static int addDirtyRect( CAppPtr pThis, AEERect *arDirty, int nDirty,
+						 const AEERect *prc )
+{
+	AEERect rc;
+	int16 x, y, x1, y1;
+	int i;
+
+	x = prc->x < 0 ? 0 : prc->x;
+	y = prc->y < 0 ? 0 : prc->y;
+	x1 = prc->x + prc->dx > pThis->m_cx ? pThis->m_cx : prc->x + prc->dx;
+	y1 = prc->y + prc->dy > pThis->m_cy ? pThis->m_cy : prc->y + prc->dy;
+	if ( x1 <= x || y1 <= y ) return nDirty;
+	SETAEERECT( &rc, x, y, x1 - x, y1 - y );
+
+	// Absorb every region this one overlaps, and start over
+	for ( i = 0; i < nDirty; i++ )
+	{
+		if ( arDirty[ i ].x >= rc.x + rc.dx || 
+			 arDirty[ i ].y >= rc.y + rc.dy ||
+			 rc.x >= arDirty[ i ].x + arDirty[ i ].dx ||
+			 rc.y >= arDirty[ i ].y + arDirty[ i ].dy )
+			continue;
+		x = arDirty[ i ].x < rc.x ? arDirty[ i ].x : rc.x;
+		y = arDirty[ i ].y < rc.y ? arDirty[ i ].y : rc.y;
+		x1 = arDirty[ i ].x + arDirty[ i ].dx > rc.x + rc.dx ? 
+			arDirty[ i ].x + arDirty[ i ].dx : rc.x + rc.dx;
+		y1 = arDirty[ i ].y + arDirty[ i ].dy > rc.y + rc.dy ? 
+			arDirty[ i ].y + arDirty[ i ].dy : rc.y + rc.dy;
+		SETAEERECT( &rc, x, y, x1 - x, y1 - y );
+		arDirty[ i ] = arDirty[ --nDirty ];
+		i = -1;
+	}
+	arDirty[ nDirty++ ] = rc;
+	return nDirty;
+}
+
+/**
+* Updates the display. Only the regions where sprites were and
+* now are get redrawn: the tiles there are copied back from the
+* background, the sprites drawn over them, and just those 
+* regions copied to the display.
+* @param CAppPtr pThis: this application
+* @return nothing
+*/
 static void mainDrawUpdate( CAppPtr pThis )
 {
 	CAppDataPtr pData = GetAppData( pThis );
 	ISprite *pISprite = pData->pISprite;
 	IBitmap *pIDisplayBitmap = NULL;
-	int result;
-	
+	AEERect arDirty[ 2 * Sprite_Last ];
+	AEERect rc;
+	int16 x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	int nDirty = 0;
+	int i, result;
 
-	// Draw the tiles
-	ISPRITE_DrawTiles( pISprite, pData->arTileMap);
+	if ( pData->bRedrawAll || !pData->pIBackground )
+	{
+		// Draw the tiles in view, and keep them to draw over sprites with
+		viewTiles( pThis );
+		ISPRITE_DrawTiles( pISprite, pData->arTileMap);
+		if ( pData->pIBackground )
+			IBITMAP_BltIn( pData->pIBackground, 0, 0, 
+				pThis->m_cx, pThis->m_cy,
+				pData->pIBitmap, 0, 0, AEE_RO_COPY );
+		SETAEERECT( &rc, 0, 0, pThis->m_cx, pThis->m_cy );
+		nDirty = addDirtyRect( pThis, arDirty, nDirty, &rc );
+		pData->bRedrawAll = FALSE;
+	}
+	else
+	{
+		// Put the tiles back where the sprites were and will be
+		for ( i = 0; i < Sprite_Last; i++ )
+		{
+			nDirty = addDirtyRect( pThis, arDirty, nDirty, 
+								   &pData->arSpriteRect[ i ] );
+			spriteBounds( &pData->arSprites[ i ], &rc );
+			nDirty = addDirtyRect( pThis, arDirty, nDirty, &rc );
+		}
+		for ( i = 0; i < nDirty; i++ )
+			IBITMAP_BltIn( pData->pIBitmap, 
+				arDirty[ i ].x, arDirty[ i ].y,
+				arDirty[ i ].dx, arDirty[ i ].dy,
+				pData->pIBackground, arDirty[ i ].x, arDirty[ i ].y, 
+				AEE_RO_COPY );
+	}
 
 	// Draw the sprites
 	ISPRITE_DrawSprites( pISprite, pData->arSprites );
+	for ( i = 0; i < Sprite_Last; i++ )
+		spriteBounds( &pData->arSprites[ i ], &pData->arSpriteRect[ i ] );
 	
 	// Update the display
 	result = IDISPLAY_GetDeviceBitmap( GetDisplay( pThis ), &pIDisplayBitmap );
 	if ( result == SUCCESS )
 	{
-		IBITMAP_BltIn( pIDisplayBitmap,
-			0, 0, // destination origin
-			pThis->m_cx, pThis->m_cy,
-			pData->pIBitmap, 0, 0, AEE_RO_COPY );
+		for ( i = 0; i < nDirty; i++ )
+		{
+			IBITMAP_BltIn( pIDisplayBitmap,
+				arDirty[ i ].x, arDirty[ i ].y,
+				arDirty[ i ].dx, arDirty[ i ].dy,
+				pData->pIBitmap, arDirty[ i ].x, arDirty[ i ].y, 
+				AEE_RO_COPY );
+			pData->frameStats.m_nPixels += 
+				arDirty[ i ].dx * arDirty[ i ].dy;
+
+			// One update for the lot
+			if ( !i || arDirty[ i ].x < x0 ) x0 = arDirty[ i ].x;
+			if ( !i || arDirty[ i ].y < y0 ) y0 = arDirty[ i ].y;
+			if ( !i || arDirty[ i ].x + arDirty[ i ].dx > x1 ) 
+				x1 = arDirty[ i ].x + arDirty[ i ].dx;
+			if ( !i || arDirty[ i ].y + arDirty[ i ].dy > y1 ) 
+				y1 = arDirty[ i ].y + arDirty[ i ].dy;
+		}
+		pData->frameStats.m_nUpdates++;
 
-		IDISPLAY_Update( GetDisplay( pThis ) );
+		SETAEERECT( &rc, x0, y0, x1 - x0, y1 - y0 );
+		if ( nDirty ) State_Invalidate( pThis, &rc );
 		IBITMAP_Release( pIDisplayBitmap );
 	}
 }
@@ -635,20 +1133,20 @@ static void moveMouse( CAppPtr pThis, uint16 *pRandom )
 	}
 }
 
-static void mainDraw( void *p )
+/**
+* Runs one FRAME_DELAY_MSECS step of the simulation.
+* @param CAppPtr pThis: this application
+* @return nothing
+*/
+static void mainStep( CAppPtr pThis )
 {
-	CAppPtr pThis = (CAppPtr)p;
 	CAppDataPtr pData = GetAppData( pThis );
-	ISprite *pISprite = pData->pISprite;
 	uint16 arRandom[ 3 ];
 	
 	// Get a bag of random numbers
 	GETRAND( (byte *)arRandom, 
 			 ( 2 + 1 ) * sizeof( uint16 ) );
-		
-	// Update the display
-	mainDrawUpdate( pThis );	
-	
+
 	/* 
 	   Figure out where things are going to move.
 	   Butterflies move every turn
@@ -664,14 +1162,114 @@ static void mainDraw( void *p )
 		moveMouse( pThis, arRandom + 2 );
 	}
 
-	// And do it again!
 	pData->nTurn++;
-	
+	pData->frameStats.m_nSteps++;
+}
+
+/**
+* Starts the animation, with the first step due now.
+* @param CAppPtr pThis: this application
+* @return nothing
+*/
+static void mainDrawStart( CAppPtr pThis )
+{
+	CAppDataPtr pData = GetAppData( pThis );
+	uint32 now = GETUPTIMEMS();
+
+	MEMSET( &pData->frameStats, 0, sizeof( CFrameStats ) );
+	pData->frameStats.m_nStart = pData->frameStats.m_nLast = now;
+	pData->nDeadline = now;
+	pData->bRedrawAll = TRUE;
+	mainDraw( pThis );
+}
+
+/**
+* Draws a frame of the animation. The simulation runs in fixed
+* FRAME_DELAY_MSECS steps, as many as are due, and the next frame
+* is timed from the step deadline rather than from when this
+* frame finished drawing, so the animation keeps time however
+* long drawing takes. When drawing falls behind, frames are 
+* skipped rather than the simulation slowed.
+* @param void *p: this application
+* @return nothing
+*/
+static void mainDraw( void *p )
+{
+	CAppPtr pThis = (CAppPtr)p;
+	CAppDataPtr pData = GetAppData( pThis );
+	CFrameStatsPtr pStats = &pData->frameStats;
+	uint32 now = GETUPTIMEMS();
+	uint32 nLost;
+	int32 nWait;
+	int nSteps = 0;
+	int iBucket;
+
+	// Catch the simulation up with the clock
+	while ( (int32)( now - pData->nDeadline ) >= 0 && 
+			nSteps < FRAME_MAX_STEPS )
+	{
+		mainStep( pThis );
+		pData->nDeadline += FRAME_DELAY_MSECS;
+		nSteps++;
+	}
+	if ( (int32)( now - pData->nDeadline ) >= 0 )
+	{
+		// Too far behind to catch up; start over from now
+		nLost = ( now - pData->nDeadline ) / FRAME_DELAY_MSECS + 1;
+		pData->nDeadline += nLost * FRAME_DELAY_MSECS;
+		pStats->m_nStepsLost += nLost;
+	}
+	if ( nSteps > 1 ) pStats->m_nDropped += nSteps - 1;
+
+	// Update the display; any frame a key asked for is in this one.
+	mainDrawUpdate( pThis );	
+	State_CancelFrame( pThis );
+
+	// Get ready for where the view's headed
+	viewLoadAhead( pThis );
+
+	iBucket = ( now - pStats->m_nLast ) / FRAME_HIST_MSECS;
+	if ( iBucket >= FRAME_HIST_BUCKETS ) iBucket = FRAME_HIST_BUCKETS - 1;
+	if ( pStats->m_nFrames ) pStats->m_arHist[ iBucket ]++;
+	pStats->m_nFrames++;
+	pStats->m_nLast = now;
+
+	// And do it again when the next step is due!
+	nWait = (int32)( pData->nDeadline - GETUPTIMEMS() );
 	ISHELL_SetTimer( GetShell( pThis ), 
-					FRAME_DELAY_MSECS, 
+					nWait > 0 ? nWait : 0, 
 					mainDraw, pThis );
 }
 
+/**
+* Reports how the animation kept up to the debug log.
+* @param CAppPtr pThis: this application
+* @return nothing
+*/
+static void mainDrawReport( CAppPtr pThis )
+{
+	CAppDataPtr pData = GetAppData( pThis );
+	CFrameStatsPtr pStats = &pData->frameStats;
+	uint32 nMSecs = pStats->m_nLast - pStats->m_nStart;
+	int i;
+
+	DBGPRINTF( "%d frames, %d fps, %d dropped, %d steps, %d lost",
+			   pStats->m_nFrames, 
+			   nMSecs ? pStats->m_nFrames * 1000 / nMSecs : 0,
+			   pStats->m_nDropped, pStats->m_nSteps, 
+			   pStats->m_nStepsLost );
+	for ( i = 0; i < FRAME_HIST_BUCKETS; i++ )
+		DBGPRINTF( "%3d ms: %d frames", i * FRAME_HIST_MSECS, 
+				   pStats->m_arHist[ i ] );
+	DBGPRINTF( "%d pixels redrawn per update of %d", 
+			   pStats->m_nUpdates ? 
+			   pStats->m_nPixels / pStats->m_nUpdates : 0,
+			   pThis->m_cx * pThis->m_cy );
+	DBGPRINTF( "%d chunks read, %d read ahead, %d hits, %d evicted",
+			   pData->chunks.m_nLoads, pData->chunks.m_nAheadLoads,
+			   pData->chunks.m_nHits, pData->chunks.m_nEvictions );
+}
+
 static void mainSoundNotifyCallback( void *p, 
 									 AEESoundPlayerCmd  eType,
 									 AEESoundPlayerStatus eStatus,
@@ -746,12 +1344,15 @@ static void mainMusicStop( CAppPtr pThis )
 {
 	CAppDataPtr pData = GetAppData( pThis );
 
+	// The state's stopped again when the shell stops a suspended
+	// application, so don't release these twice.
 	if ( pData->pISoundPlayer )
 		ISOUNDPLAYER_Release( pData->pISoundPlayer );
+	pData->pISoundPlayer = NULL;
 
 	if ( pData->pISound )
 		ISOUND_Release( pData->pISound );
-		
+	pData->pISound = NULL;
 }
 /* 
 * This is the first state of the application
@@ -781,7 +1382,7 @@ static boolean mainEntry( void *p,
 	IDISPLAY_ClearScreen( GetDisplay( pThis ) );
 
 	// Draw the board and start the animation.
-	mainDraw( pThis );
+	mainDrawStart( pThis );
 #endif
 
 	// Start the background music
@@ -806,6 +1407,10 @@ static boolean mainExit( void *p,
 
 	ASSERT( pThis );
 
+	// Stop the animation
+	ISHELL_CancelTimer( GetShell( pThis ), mainDraw, pThis );
+	mainDrawReport( pThis );
+
 	mainMusicStop( pThis );
 
 	return TRUE;
@@ -855,12 +1460,20 @@ static boolean mainHandleKey( CAppPtr pThis, uint16 wParam )
 		PIN_X_COORD( pThis, newX );
 		PIN_Y_COORD( pThis, newY );
 
+		// At the edge, the cat stays put and the world moves instead
+		if ( newX != pData->arSprites[ Sprite_Cat ].x + dx ||
+			 newY != pData->arSprites[ Sprite_Cat ].y + dy )
+			viewScroll( pThis, 
+				newX != pData->arSprites[ Sprite_Cat ].x + dx ? dx : 0,
+				newY != pData->arSprites[ Sprite_Cat ].y + dy ? dy : 0 );
+
 		pData->arSprites[ Sprite_Cat ].x = (uint16)newX;
 		pData->arSprites[ Sprite_Cat ].y = (uint16)newY;
 
-		// Update the display --- don't wait until the next pass.
+		// Update the display --- don't wait until the next pass,
+		// but draw once for however many keys arrive before the frame.
 		pData->nTime = now;
-		mainDrawUpdate( pThis );
+		State_RequestFrame( pThis );
 	}
 
 	return result;
@@ -904,6 +1517,11 @@ boolean AS_MainHandleEvent( void *p,
 			result = mainHandleKey( p, wParam );
 			break;
 
+		case EVT_STATE_FRAME:
+			mainDrawUpdate( pThis );
+			result = TRUE;
+			break;
+
 		default:
 			break;
 	}
@@ -931,7 +1549,7 @@ static boolean _entry( void *p,
 	// Clear the display
 	IDISPLAY_ClearScreen( GetDisplay( pThis )  );
 
-	IDISPLAY_Update( GetDisplay( pThis ) );
+	State_Invalidate( pThis, NULL );
 	return TRUE;  
 }
 
@@ -15,6 +15,7 @@
 #define IDI_GRASS1		6000
 #define IDI_GRASS2		6001
 #define IDI_GRASS3		6002
+#define IDI_ATLAS		7000
 
 
 #endif  // MAIN_RES_H
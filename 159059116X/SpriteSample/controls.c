@@ -71,4 +71,40 @@ void Control_TextSetDefaultSoftKeyInfo( ITextCtl *pITextCtl,
 	
 	// Link the soft key menu to the control
 	ITEXTCTL_SetSoftKeyMenu( pITextCtl,  pIMenuCtl );
+
+	// The soft key menu is on screen along with the text control
+	Control_SetShown( (IControl *)pIMenuCtl, TRUE );
+}
+
+/**
+ * @name Control_SetShown
+ * @memo Tracks whether a framework control is on screen.
+ * @doc Adds the control to or removes it from the set of shown controls the framework passes events to. Control_ShowControl and Control_HideControl call this for you. Once a control has been through here, it gets events only while it's shown; a control that never has gets them whenever it's active, as with plain ICONTROL_SetActive. Hiding the text control hides its soft key menu, too. Controls outside the framework's control pool are ignored.
+ * @param IControl *pIControl: target control
+ * @param boolean bShown: TRUE if the control is on screen
+ * @return nothing
+ */
+void Control_SetShown( IControl *pIControl, boolean bShown )
+{
+	CAppPtr pThis = (CAppPtr)GETAPPINSTANCE();
+	int i;
+
+	for ( i = 0; i < pThis->m_app.m_nControl; i++ )
+		if ( pThis->m_app.m_apControl[ i ] == pIControl ) break;
+	if ( i == pThis->m_app.m_nControl ) return;
+
+	pThis->m_app.m_nTrackedMask |= ( 1 << i );
+	if ( bShown )
+	{
+		pThis->m_app.m_nShownMask |= ( 1 << i );
+	}
+	else
+	{
+		pThis->m_app.m_nShownMask &= ~( 1 << i );
+		if ( i == Ctl_TextInput ) 
+		{
+			pThis->m_app.m_nTrackedMask |= ( 1 << Ctl_SoftKeyMenu );
+			pThis->m_app.m_nShownMask &= ~( 1 << Ctl_SoftKeyMenu );
+		}
+	}
 }
\ No newline at end of file
@@ -34,6 +34,64 @@
  */
 #define MAX_NUM_CONTROLS ( 10 )
 
+/**
+ * @name STATE_POOL_DEPTH
+ * @memo number of preallocated state nodes.
+ * @doc This tells the framework how many state nodes to preallocate at launch. Deeper state stacks still work, but take their nodes from the heap; check the pool statistics to see if this is large enough.
+ */
+#define STATE_POOL_DEPTH ( 8 )
+
+/**
+ * @name STATE_ARENA_SIZE
+ * @memo size of the state scratch arena.
+ * @doc This tells the framework how many bytes of scratch memory to share among all of the states on the stack. States obtain scratch memory with State_Alloc; it's released when the state is popped.
+ */
+#define STATE_ARENA_SIZE ( 2048 )
+
+/**
+ * @name STATE_ARENA_BUDGET
+ * @memo scratch memory available to one state.
+ * @doc This tells the framework the most scratch memory any one state may obtain from the arena.
+ */
+#define STATE_ARENA_BUDGET ( 512 )
+
+/**
+ * @name STATE_TRACE
+ * @memo state transition tracing.
+ * @doc Define this to have the framework record each call it makes to a state's event handler during a transition, and write the record to the debug log on exit. Tracing costs nothing when this isn't defined.
+ */
+#ifdef _DEBUG
+#define STATE_TRACE
+#endif
+
+/**
+ * @name STATE_TRACE_DEPTH
+ * @memo number of state transition trace entries.
+ * @doc This tells the framework how many of the most recent handler calls to keep when tracing state transitions.
+ */
+#define STATE_TRACE_DEPTH ( 32 )
+
+/**
+ * @name STATE_SCREEN_BUDGET
+ * @memo heap bytes for kept screens.
+ * @doc This tells the framework how much heap it may use to keep copies of covered states' screens. A 128x160 16-bit display takes 40960 bytes per screen; when the budget is full the shallowest states' screens are discarded first.
+ */
+#define STATE_SCREEN_BUDGET ( 81920 )
+
+/**
+ * @name STATE_FRAME_MSECS
+ * @memo delay before a requested frame.
+ * @doc This tells the framework how long to wait after State_RequestFrame before sending EVT_STATE_FRAME. Requests that arrive in the meantime are merged into the one frame, and key repeats are delivered but drawn by it; zero sends it on the next pass through the shell's event loop.
+ */
+#define STATE_FRAME_MSECS ( 0 )
+
+/**
+ * @name STATE_SNAPSHOT_FILE
+ * @memo state stack snapshot file.
+ * @doc The framework writes the state stack and each state's scratch data to this file on EVT_APP_SUSPEND. If the shell stops the application while it's suspended, the next launch restores the stack from it instead of showing the copyright screen.
+ */
+#define STATE_SNAPSHOT_FILE "stack.snp"
+
 /**
  * @name AS_FIRSTSTATE
  * @memo Application first state.
@@ -41,6 +99,13 @@
  */
 #define AS_FIRSTSTATE ( AS_MainHandleEvent ) 
 
+/**
+ * @name AS_STATES
+ * @memo Application state registry.
+ * @doc This lists every state function the application pushes. The state stack snapshot names states by their position in this list, so add new states to the end.
+ */
+#define AS_STATES { AS_MainHandleEvent }
+
 /**
  * @name APP_PREFS_VERSION 
  * @memo Application preferences structure version.
@@ -82,15 +147,102 @@ enum
 };
 #define RESID_TILE_BASE ( 6000 )
 
-enum
+/**
+ * @name RESID_ATLAS
+ * @memo All the sprites and tiles in one resource.
+ * @doc The host's atlaspack tool packs the RESID_SPRITE_BASE and RESID_TILE_BASE images into one atlas, already in the display's pixel format; it's resources/atlas.bin, in the resource file as IDI_ATLAS. Run make atlas in HostSim to pack it again when the images change. If the display's pixel format differs, each image is loaded on its own.
+ */
+#define RESID_ATLAS ( 7000 )
+
+/**
+ * @name CAtlasHeader, CAtlasEntry
+ * @memo What's in the atlas.
+ * @doc The header is followed by m_nEntries entries, giving each image's resource ID and where it is in the atlas, then m_cy rows of m_cx pixels. Everything is little-endian, and in 16-bit halves, so the layout doesn't depend on how wide the compiler makes a uint32.
+ */
+#define ATLAS_MAGIC ( 0x41544c31 )
+typedef struct
 {
-	TileMap_Background = 0,
-	
-	TileMap_Last
-};
+	/// ATLAS_MAGIC, low half first
+	uint16 m_anMagic[ 2 ];
+	/// Bits per pixel and IDIB color scheme of the pixels
+	uint16 m_nDepth, m_nColorScheme;
+	/// Size of the atlas in pixels
+	uint16 m_cx, m_cy;
+	uint16 m_nEntries;
+	uint16 m_nReserved;
+} CAtlasHeader;
+
+typedef struct
+{
+	uint16 m_nResID;
+	uint16 m_x, m_y;
+	uint16 m_cx, m_cy;
+	uint16 m_nReserved;
+} CAtlasEntry;
+
+/**
+ * @name WORLD_FILE, WORLD_CHUNKS_X, WORLD_CHUNKS_Y
+ * @memo The world the cat roams.
+ * @doc The world is a tile map WORLD_CHUNKS_X chunks wide and WORLD_CHUNKS_Y chunks high, kept in WORLD_FILE and read a chunk at a time as it comes into view. The application makes the file the first time it's run.
+ */
+#define WORLD_FILE ( "world.map" )
+#define WORLD_CHUNKS_X ( 16 )
+#define WORLD_CHUNKS_Y ( 16 )
+
+/**
+ * @name CHUNK_TILES, CHUNK_MAP_SIZE, CHUNK_PIXELS
+ * @memo Size of a world chunk.
+ * @doc A chunk is CHUNK_TILES by CHUNK_TILES 16x16 tiles, drawn as one AEETileMap of size CHUNK_MAP_SIZE, and covers CHUNK_PIXELS by CHUNK_PIXELS pixels.
+ */
+#define CHUNK_TILES ( 8 )
+#define CHUNK_MAP_SIZE ( MAP_SIZE_8 )
+#define CHUNK_PIXELS ( CHUNK_TILES * 16 )
+
+/**
+ * @name VIEW_MAX_CX, VIEW_MAX_CY
+ * @memo Largest display the application supports.
+ * @doc The chunk cache and tile map list are sized for a display this large; the application won't start on a larger one.
+ */
+#define VIEW_MAX_CX ( 240 )
+#define VIEW_MAX_CY ( 320 )
+
+/**
+ * @name VIEW_MAX_CHUNKS
+ * @memo Most chunks on the display at once.
+ * @doc A display cx by cy pixels shows at most ( cx / CHUNK_PIXELS + 2 ) * ( cy / CHUNK_PIXELS + 2 ) chunks.
+ */
+#define VIEW_MAX_CHUNKS \
+	( ( VIEW_MAX_CX / CHUNK_PIXELS + 2 ) * ( VIEW_MAX_CY / CHUNK_PIXELS + 2 ) )
+
+/**
+ * @name CHUNK_CACHE_BYTES
+ * @memo Memory for world chunks.
+ * @doc This is how much memory the chunks read from WORLD_FILE may use. When it's full, the chunk used least recently is dropped to make room. It holds VIEW_MAX_CHUNKS chunks and a row and a column of chunks to read ahead, for a view scrolling diagonally.
+ */
+#define CHUNK_CACHE_BYTES \
+	( ( VIEW_MAX_CHUNKS + VIEW_MAX_CX / CHUNK_PIXELS + 2 + \
+		VIEW_MAX_CY / CHUNK_PIXELS + 2 ) * \
+	  CHUNK_TILES * CHUNK_TILES * 2 )
+#define CHUNK_CACHE_SLOTS \
+	( CHUNK_CACHE_BYTES / ( CHUNK_TILES * CHUNK_TILES * sizeof( uint16 ) ) )
 
 #define NUM_TILE ( 3 )
 #define FRAME_DELAY_MSECS ( 30 )
+
+/**
+ * @name FRAME_MAX_STEPS
+ * @memo Most simulation steps run before a frame is drawn.
+ * @doc When drawing falls behind, the animation runs as many FRAME_DELAY_MSECS steps as it missed before drawing again, skipping the frames it had no time for. If it's more than this many steps behind, as after a long stall, the rest are given up rather than run all at once.
+ */
+#define FRAME_MAX_STEPS ( 5 )
+
+/**
+ * @name FRAME_HIST_BUCKETS, FRAME_HIST_MSECS
+ * @memo Frame time histogram.
+ * @doc The time between drawn frames is counted in FRAME_HIST_BUCKETS buckets each FRAME_HIST_MSECS wide; the last bucket counts every longer frame.
+ */
+#define FRAME_HIST_BUCKETS ( 8 )
+#define FRAME_HIST_MSECS ( 10 )
 #define PLAYER_DELAY_MSECS ( 25 )
 
 #define CAT_DELTA ( 4 )
@@ -99,6 +251,83 @@ enum
 #define MOUSE_TERRITORY ( 32 )
 #define MOUSE_TOO_CLOSE ( 4 )
 #define MUSIC_FILE ( "TheButterfly.mid" )
+/**
+ * @name CFrameStats
+ * @memo Animation frame statistics.
+ * @doc The frame scheduler counts what it did here.
+ */
+typedef struct
+{
+	/// Uptime at which the animation started
+	uint32 m_nStart;
+	/// Uptime of the last frame drawn
+	uint32 m_nLast;
+	/// Frames drawn
+	uint32 m_nFrames;
+	/// Frames skipped to keep the simulation on time
+	uint32 m_nDropped;
+	/// Simulation steps run
+	uint32 m_nSteps;
+	/// Simulation steps given up after a stall
+	uint32 m_nStepsLost;
+	/// Frames drawn, by time since the previous frame
+	uint32 m_arHist[ FRAME_HIST_BUCKETS ];
+	/// Display updates, whether for a frame or a key
+	uint32 m_nUpdates;
+	/// Pixels redrawn and copied to the display by those updates
+	uint32 m_nPixels;
+} CFrameStats, *CFrameStatsPtr;
+
+/**
+ * @name CChunk
+ * @memo A world chunk read from WORLD_FILE.
+ */
+typedef struct
+{
+	/// The chunk's column and row in the world; -1 if unused
+	int16 m_nX, m_nY;
+	/// When the chunk was last used
+	uint32 m_nUsed;
+	/// The chunk's tiles, row by row
+	uint16 m_arTiles[ CHUNK_TILES * CHUNK_TILES ];
+} CChunk, *CChunkPtr;
+
+/**
+ * @name CWorldHeader
+ * @memo What's at the start of WORLD_FILE.
+ * @doc The chunks follow the header, row by row, each as CHUNK_TILES * CHUNK_TILES tile numbers. A file whose header doesn't match the options it was built with is made again.
+ */
+#define WORLD_MAGIC ( 0x574d4150 )
+typedef struct
+{
+	uint32 m_nMagic;
+	uint16 m_nChunksX, m_nChunksY;
+	uint16 m_nChunkTiles;
+	uint16 m_nReserved;
+} CWorldHeader;
+
+/**
+ * @name CChunkCache
+ * @memo The world chunks in memory.
+ */
+typedef struct
+{
+	/// The world file
+	IFile *m_pIFile;
+	/// Counts chunk uses, to find the least recently used
+	uint32 m_nClock;
+	/// The chunks
+	CChunk m_arChunks[ CHUNK_CACHE_SLOTS ];
+	/// Chunks read because they came into view
+	uint32 m_nLoads;
+	/// Chunks read ahead of the view
+	uint32 m_nAheadLoads;
+	/// Chunks found already in memory
+	uint32 m_nHits;
+	/// Chunks dropped to make room
+	uint32 m_nEvictions;
+} CChunkCache, *CChunkCachePtr;
+
 /**
  * @name CAppData
  * @memo Application data structure.
@@ -115,8 +344,20 @@ typedef struct
 	ISprite	*pISprite;
 	/// Sprite bitmap
 	IBitmap *pIBitmap;
-	/// Tile map
-	AEETileMap	arTileMap[ TileMap_Last + 1 ];
+	/// The tiles alone, to draw over where sprites were, or NULL
+	IBitmap *pIBackground;
+	/// TRUE to redraw the whole display on the next update
+	boolean bRedrawAll;
+	/// Where each sprite was drawn last
+	AEERect arSpriteRect[ Sprite_Last ];
+	/// Tile maps for the chunks in view
+	AEETileMap	arTileMap[ VIEW_MAX_CHUNKS + 1 ];
+	/// World chunks
+	CChunkCache chunks;
+	/// Where the display's top left corner is in the world
+	int32 nViewX, nViewY;
+	/// Which way the view last scrolled
+	int nScrollDX, nScrollDY;
 	/// Sprites
 	AEESpriteCmd arSprites[ Sprite_Last + 1 ];	
 	
@@ -124,6 +365,10 @@ typedef struct
 	int nTurn;
 	/// Last user move
 	uint32 nTime;
+	/// Uptime at which the next simulation step is due
+	uint32 nDeadline;
+	/// How the animation is keeping up
+	CFrameStats frameStats;
 		
 } CAppData, *CAppDataPtr;
 